@@ -42,6 +42,36 @@ static int copy_engine = TRUE;
 static unsigned long copy_opts = 0UL;
 #define COPY_OPT_NO_DELETE_ON_FAILURE	0x0001
 
+/* Helper processes, used for copying the files of a directory concurrently.
+ * The session process still walks the tree, and dispatches the per-file
+ * COPY commands; the workers only copy the data.  Workers are not used when
+ * any module handles COPY commands itself (e.g. mod_quotatab), as such
+ * modules expect the PRE_CMD and POST_CMD phases for one file to be
+ * dispatched before those of the next.
+ */
+struct copy_worker {
+  pid_t pid;
+  int fd;
+
+  /* The COPY command for the file being copied, if any. */
+  cmd_rec *cmd;
+};
+
+static pool *copy_workers_pool = NULL;
+static struct copy_worker *copy_workers = NULL;
+static unsigned int copy_nworkers = 0;
+static unsigned int copy_max_workers = 1;
+static int copy_workers_errno = 0;
+
+/* Progress of the current directory copy. */
+static unsigned int copy_nfiles = 0;
+static off_t copy_nbytes = 0;
+
+/* Log the progress of a directory copy every Nth file. */
+#ifndef COPY_PROGRESS_NFILES
+# define COPY_PROGRESS_NFILES		1000
+#endif
+
 static const char *trace_channel = "copy";
 
 static int copy_sess_init(void);
@@ -188,11 +218,438 @@ static int copy_symlink(pool *p, const char *src_path, const char *dst_path,
   return 0;
 }
 
+/* Finishes the COPY command for a copied file, successfully or not. */
+static int copy_file_done(cmd_rec *cmd, int res, int xerrno) {
+  struct stat st;
+  const char *src_path, *dst_path;
+  char *abs_path;
+
+  src_path = cmd->argv[2];
+  dst_path = cmd->argv[3];
+
+  if (res < 0) {
+    pr_log_debug(DEBUG7, MOD_COPY_VERSION
+      ": error copying file '%s' to '%s': %s", src_path, dst_path,
+      strerror(xerrno));
+
+    pr_cmd_dispatch_phase(cmd, POST_CMD_ERR, 0);
+    pr_cmd_dispatch_phase(cmd, LOG_CMD_ERR, 0);
+    pr_response_clear(&resp_err_list);
+
+    errno = xerrno;
+    return -1;
+  }
+
+  pr_cmd_dispatch_phase(cmd, POST_CMD, 0);
+  pr_cmd_dispatch_phase(cmd, LOG_CMD, 0);
+  pr_response_clear(&resp_list);
+
+  /* Write a TransferLog entry as well. */
+
+  pr_fs_clear_cache2(dst_path);
+  if (pr_fsio_stat(dst_path, &st) < 0) {
+    memset(&st, 0, sizeof(st));
+  }
+
+  abs_path = dir_abs_path(cmd->pool, dst_path, TRUE);
+
+  if (session.sf_flags & SF_ANON) {
+    xferlog_write(0, session.c->remote_name, st.st_size, abs_path,
+       (session.sf_flags & SF_ASCII ? 'a' : 'b'), 'd', 'a',
+       session.anon_user, 'c', "_");
+
+  } else {
+    xferlog_write(0, session.c->remote_name, st.st_size, abs_path,
+      (session.sf_flags & SF_ASCII ? 'a' : 'b'), 'd', 'r',
+      session.user, 'c', "_");
+  }
+
+  copy_nfiles++;
+  copy_nbytes += st.st_size;
+
+  pr_scoreboard_entry_update(session.pid,
+    PR_SCORE_XFER_DONE, copy_nbytes,
+    NULL);
+
+  if ((copy_nfiles % COPY_PROGRESS_NFILES) == 0) {
+    pr_log_debug(DEBUG5, MOD_COPY_VERSION
+      ": copied %u files (%" PR_LU " bytes) so far", copy_nfiles,
+      (pr_off_t) copy_nbytes);
+  }
+
+  return 0;
+}
+
+static int copy_read_full(int fd, void *buf, size_t len) {
+  char *ptr = buf;
+
+  while (len > 0) {
+    ssize_t res;
+
+    res = read(fd, ptr, len);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return -1;
+    }
+
+    if (res == 0) {
+      errno = EPIPE;
+      return -1;
+    }
+
+    ptr += res;
+    len -= res;
+  }
+
+  return 0;
+}
+
+static int copy_write_full(int fd, const void *buf, size_t len) {
+  const char *ptr = buf;
+
+  while (len > 0) {
+    ssize_t res;
+
+    res = write(fd, ptr, len);
+    if (res < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return -1;
+    }
+
+    ptr += res;
+    len -= res;
+  }
+
+  return 0;
+}
+
+/* The worker process: copies each file that it is sent, replying with the
+ * result, until the session process closes the connection.
+ */
+static void copy_worker_main(int fd, int flags) {
+  while (TRUE) {
+    uint32_t lens[2];
+    int32_t reply[2];
+    char *src_path, *dst_path;
+    pool *tmp_pool;
+    int res;
+
+    if (copy_read_full(fd, lens, sizeof(lens)) < 0) {
+      break;
+    }
+
+    if (lens[0] == 0 ||
+        lens[0] > PR_TUNABLE_PATH_MAX ||
+        lens[1] == 0 ||
+        lens[1] > PR_TUNABLE_PATH_MAX) {
+      break;
+    }
+
+    tmp_pool = make_sub_pool(session.pool);
+    pr_pool_tag(tmp_pool, "mod_copy worker pool");
+
+    src_path = pcalloc(tmp_pool, lens[0] + 1);
+    dst_path = pcalloc(tmp_pool, lens[1] + 1);
+
+    if (copy_read_full(fd, src_path, lens[0]) < 0 ||
+        copy_read_full(fd, dst_path, lens[1]) < 0) {
+      destroy_pool(tmp_pool);
+      break;
+    }
+
+    res = pr_fs_copy_file2(src_path, dst_path, flags, NULL);
+    reply[0] = res;
+    reply[1] = res < 0 ? errno : 0;
+
+    destroy_pool(tmp_pool);
+
+    if (copy_write_full(fd, reply, sizeof(reply)) < 0) {
+      break;
+    }
+  }
+
+  (void) close(fd);
+  _exit(0);
+}
+
+static void copy_workers_stop(void) {
+  register unsigned int i;
+
+  for (i = 0; i < copy_nworkers; i++) {
+    if (copy_workers[i].fd >= 0) {
+      /* The worker exits once it reads EOF. */
+      (void) close(copy_workers[i].fd);
+      copy_workers[i].fd = -1;
+    }
+
+    while (waitpid(copy_workers[i].pid, NULL, 0) < 0 &&
+           errno == EINTR) {
+      pr_signals_handle();
+    }
+  }
+
+  copy_workers = NULL;
+  copy_nworkers = 0;
+  copy_workers_pool = NULL;
+}
+
+static int copy_workers_start(pool *p, int flags) {
+  register unsigned int i;
+
+  copy_workers_pool = p;
+  copy_workers = pcalloc(p, sizeof(struct copy_worker) * copy_max_workers);
+  copy_nworkers = 0;
+  copy_workers_errno = 0;
+
+  for (i = 0; i < copy_max_workers; i++) {
+    int fds[2];
+    pid_t pid;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+      pr_trace_msg(trace_channel, 3, "error creating worker socket pair: %s",
+        strerror(errno));
+      break;
+    }
+
+    if (fds[0] >= FD_SETSIZE) {
+      (void) close(fds[0]);
+      (void) close(fds[1]);
+      break;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+      pr_log_pri(PR_LOG_WARNING, MOD_COPY_VERSION
+        ": unable to fork copy worker: %s", strerror(errno));
+      (void) close(fds[0]);
+      (void) close(fds[1]);
+      break;
+    }
+
+    if (pid == 0) {
+      register unsigned int j;
+
+      /* Child process */
+      session.pid = getpid();
+
+      /* The worker does nothing but copy; leave the session's timers,
+       * signal handling and other workers' connections to the session.
+       */
+      pr_timer_remove(-1, ANY_MODULE);
+      signal(SIGALRM, SIG_IGN);
+      signal(SIGHUP, SIG_DFL);
+      signal(SIGINT, SIG_DFL);
+      signal(SIGTERM, SIG_DFL);
+      signal(SIGCHLD, SIG_DFL);
+      signal(SIGPIPE, SIG_IGN);
+
+      for (j = 0; j < copy_nworkers; j++) {
+        (void) close(copy_workers[j].fd);
+      }
+
+      (void) close(fds[0]);
+      copy_worker_main(fds[1], flags);
+    }
+
+    (void) close(fds[1]);
+
+    copy_workers[copy_nworkers].pid = pid;
+    copy_workers[copy_nworkers].fd = fds[0];
+    copy_workers[copy_nworkers].cmd = NULL;
+    copy_nworkers++;
+  }
+
+  if (copy_nworkers == 0) {
+    copy_workers = NULL;
+    errno = EAGAIN;
+    return -1;
+  }
+
+  pr_trace_msg(trace_channel, 9, "started %u copy %s", copy_nworkers,
+    copy_nworkers != 1 ? "workers" : "worker");
+  return 0;
+}
+
+/* Waits for busy workers to finish their files, finishing the COPY commands
+ * for those files.  If wait_all is FALSE, returns as soon as a worker is
+ * free for another file.  Returns -1 if any file could not be copied.
+ */
+static int copy_workers_wait(int wait_all) {
+  while (TRUE) {
+    register unsigned int i;
+    fd_set rfds;
+    struct timeval tv;
+    int maxfd = -1, nbusy = 0, nlive = 0, res;
+
+    FD_ZERO(&rfds);
+
+    for (i = 0; i < copy_nworkers; i++) {
+      if (copy_workers[i].fd < 0) {
+        continue;
+      }
+
+      nlive++;
+      if (copy_workers[i].cmd != NULL) {
+        nbusy++;
+        FD_SET(copy_workers[i].fd, &rfds);
+        if (copy_workers[i].fd > maxfd) {
+          maxfd = copy_workers[i].fd;
+        }
+      }
+    }
+
+    if (nbusy == 0 ||
+        (wait_all == FALSE && nbusy < nlive)) {
+      break;
+    }
+
+    /* Wake up every second, so that long copies do not trip any
+     * TimeoutIdle/TimeoutNoTransfer.
+     */
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+
+    res = select(maxfd + 1, &rfds, NULL, NULL, &tv);
+    if (res < 0 &&
+        errno != EINTR) {
+      copy_workers_errno = errno;
+      pr_log_pri(PR_LOG_WARNING, MOD_COPY_VERSION
+        ": error waiting for copy workers: %s", strerror(errno));
+      break;
+    }
+
+    pr_signals_handle();
+
+    (void) pr_timer_reset(PR_TIMER_IDLE, ANY_MODULE);
+    (void) pr_timer_reset(PR_TIMER_NOXFER, ANY_MODULE);
+
+    if (res <= 0) {
+      continue;
+    }
+
+    for (i = 0; i < copy_nworkers; i++) {
+      struct copy_worker *worker;
+      int32_t reply[2];
+      pool *job_pool;
+
+      worker = &(copy_workers[i]);
+      if (worker->fd < 0 ||
+          worker->cmd == NULL ||
+          !FD_ISSET(worker->fd, &rfds)) {
+        continue;
+      }
+
+      if (copy_read_full(worker->fd, reply, sizeof(reply)) < 0) {
+        /* The worker is gone; the file it was copying is a failure. */
+        pr_trace_msg(trace_channel, 3, "copy worker (PID %lu) died: %s",
+          (unsigned long) worker->pid, strerror(errno));
+        (void) close(worker->fd);
+        worker->fd = -1;
+
+        reply[0] = -1;
+        reply[1] = EIO;
+      }
+
+      job_pool = worker->cmd->pool;
+      if (copy_file_done(worker->cmd, reply[0], reply[1]) < 0 &&
+          copy_workers_errno == 0) {
+        copy_workers_errno = reply[1];
+      }
+
+      worker->cmd = NULL;
+      destroy_pool(job_pool);
+    }
+  }
+
+  if (copy_workers_errno != 0) {
+    errno = copy_workers_errno;
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Hands the file of the given COPY command to a free worker. */
+static int copy_workers_submit(cmd_rec *cmd) {
+  register unsigned int i;
+  struct copy_worker *worker = NULL;
+  const char *src_path, *dst_path;
+  uint32_t lens[2];
+
+  for (i = 0; i < copy_nworkers; i++) {
+    if (copy_workers[i].fd >= 0 &&
+        copy_workers[i].cmd == NULL) {
+      worker = &(copy_workers[i]);
+      break;
+    }
+  }
+
+  if (worker == NULL) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  src_path = cmd->argv[2];
+  dst_path = cmd->argv[3];
+  lens[0] = strlen(src_path);
+  lens[1] = strlen(dst_path);
+
+  if (copy_write_full(worker->fd, lens, sizeof(lens)) < 0 ||
+      copy_write_full(worker->fd, src_path, lens[0]) < 0 ||
+      copy_write_full(worker->fd, dst_path, lens[1]) < 0) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 3,
+      "error sending '%s' to copy worker (PID %lu): %s", src_path,
+      (unsigned long) worker->pid, strerror(xerrno));
+    (void) close(worker->fd);
+    worker->fd = -1;
+
+    errno = xerrno;
+    return -1;
+  }
+
+  worker->cmd = cmd;
+  return 0;
+}
+
+/* Returns TRUE if any module has PRE_CMD or POST_CMD handlers for COPY
+ * commands.
+ */
+static int copy_have_copy_handlers(void) {
+  cmdtable *cmdtab;
+  int idx = -1;
+  unsigned int hash = 0;
+
+  cmdtab = pr_stash_get_symbol2(PR_SYM_CMD, "COPY", NULL, &idx, &hash);
+  while (cmdtab != NULL) {
+    pr_signals_handle();
+
+    if (cmdtab->cmd_type == PRE_CMD ||
+        cmdtab->cmd_type == POST_CMD ||
+        cmdtab->cmd_type == POST_CMD_ERR) {
+      pr_trace_msg(trace_channel, 9, "found COPY handler in mod_%s.c",
+        cmdtab->m->name);
+      return TRUE;
+    }
+
+    cmdtab = pr_stash_get_symbol2(PR_SYM_CMD, "COPY", cmdtab, &idx, &hash);
+  }
+
+  return FALSE;
+}
+
 static int copy_dir(pool *p, const char *src_dir, const char *dst_dir,
     int flags) {
   DIR *dh = NULL;
   struct dirent *dent = NULL;
-  int res = 0;
+  int res = 0, xerrno;
   pool *iter_pool = NULL;
 
   dh = opendir(src_dir);
@@ -244,12 +701,28 @@ static int copy_dir(pool *p, const char *src_dir, const char *dst_dir,
     /* Is this path to a regular file? */
     } else if (S_ISREG(st.st_mode)) {
       cmd_rec *cmd;
+      pool *cmd_pool;
+
+      /* With workers, wait until one of them is free to copy this file,
+       * before dispatching its COPY command.
+       */
+      if (copy_nworkers > 0 &&
+          copy_workers_wait(FALSE) < 0) {
+        res = -1;
+        break;
+      }
+
+      /* The command may outlive this directory, when a worker copies the
+       * file.
+       */
+      cmd_pool = make_sub_pool(copy_nworkers > 0 ? copy_workers_pool : p);
+      pr_pool_tag(cmd_pool, "mod_copy COPY cmd pool");
 
       /* Dispatch fake COPY command, e.g. for mod_quotatab */
-      cmd = pr_cmd_alloc(iter_pool, 4, pstrdup(iter_pool, "SITE"),
-        pstrdup(iter_pool, "COPY"), pstrdup(iter_pool, src_path),
-        pstrdup(iter_pool, dst_path));
-      cmd->arg = pstrcat(iter_pool, "COPY ", src_path, " ", dst_path, NULL);
+      cmd = pr_cmd_alloc(cmd_pool, 4, pstrdup(cmd_pool, "SITE"),
+        pstrdup(cmd_pool, "COPY"), pstrdup(cmd_pool, src_path),
+        pstrdup(cmd_pool, dst_path));
+      cmd->arg = pstrcat(cmd_pool, "COPY ", src_path, " ", dst_path, NULL);
       cmd->cmd_class = CL_WRITE;
 
       pr_response_clear(&resp_list);
@@ -265,54 +738,31 @@ static int copy_dir(pool *p, const char *src_dir, const char *dst_dir,
         pr_cmd_dispatch_phase(cmd, POST_CMD_ERR, 0);
         pr_cmd_dispatch_phase(cmd, LOG_CMD_ERR, 0);
         pr_response_clear(&resp_err_list);
+        destroy_pool(cmd_pool);
 
         errno = xerrno;
         res = -1;
         break;
+      }
 
-      } else {
-        if (pr_fs_copy_file2(src_path, dst_path, flags, NULL) < 0) {
-          int xerrno = errno;
-
-          pr_log_debug(DEBUG7, MOD_COPY_VERSION
-            ": error copying file '%s' to '%s': %s", src_path, dst_path,
-            strerror(xerrno));
-
-          pr_cmd_dispatch_phase(cmd, POST_CMD_ERR, 0);
-          pr_cmd_dispatch_phase(cmd, LOG_CMD_ERR, 0);
-          pr_response_clear(&resp_err_list);
-
-          errno = xerrno;
-          res = -1;
-          break;
-
-        } else {
-          char *abs_path;
-          
-          pr_cmd_dispatch_phase(cmd, POST_CMD, 0);
-          pr_cmd_dispatch_phase(cmd, LOG_CMD, 0);
-          pr_response_clear(&resp_list);
-
-          /* Write a TransferLog entry as well. */
-
-          pr_fs_clear_cache2(dst_path);
-          pr_fsio_stat(dst_path, &st);
+      if (copy_nworkers > 0 &&
+          copy_workers_submit(cmd) == 0) {
+        continue;
+      }
 
-          abs_path = dir_abs_path(p, dst_path, TRUE);
+      res = pr_fs_copy_file2(src_path, dst_path, flags, NULL);
+      if (copy_file_done(cmd, res, errno) < 0) {
+        int xerrno = errno;
 
-          if (session.sf_flags & SF_ANON) {
-            xferlog_write(0, session.c->remote_name, st.st_size, abs_path,
-               (session.sf_flags & SF_ASCII ? 'a' : 'b'), 'd', 'a',
-               session.anon_user, 'c', "_");
+        destroy_pool(cmd_pool);
 
-          } else {
-            xferlog_write(0, session.c->remote_name, st.st_size, abs_path,
-              (session.sf_flags & SF_ASCII ? 'a' : 'b'), 'd', 'r',
-              session.user, 'c', "_");
-          }
-        }
+        errno = xerrno;
+        res = -1;
+        break;
       }
 
+      destroy_pool(cmd_pool);
+      res = 0;
       continue;
 
     /* Is this path a symlink? */
@@ -331,11 +781,15 @@ static int copy_dir(pool *p, const char *src_dir, const char *dst_dir,
     }
   }
 
+  xerrno = errno;
+
   if (iter_pool != NULL) {
     destroy_pool(iter_pool);
   }
 
   closedir(dh);
+
+  errno = xerrno;
   return res;
 }
 
@@ -431,9 +885,11 @@ static int copy_paths(pool *p, const char *from, const char *to) {
     }
 
   } else if (S_ISDIR(st.st_mode)) {
+    int xerrno;
+
     res = create_path(p, to);
     if (res < 0) {
-      int xerrno = errno;
+      xerrno = errno;
 
       pr_log_debug(DEBUG7, MOD_COPY_VERSION
         ": error creating path '%s': %s", to, strerror(xerrno));
@@ -442,10 +898,42 @@ static int copy_paths(pool *p, const char *from, const char *to) {
       return -1;
     }
 
+    copy_nfiles = 0;
+    copy_nbytes = 0;
+    pr_scoreboard_entry_update(session.pid,
+      PR_SCORE_XFER_DONE, copy_nbytes,
+      NULL);
+
+    if (copy_max_workers > 1) {
+      if (copy_have_copy_handlers()) {
+        pr_trace_msg(trace_channel, 5,
+          "COPY handlers present, copying '%s' one file at a time", from);
+
+      } else if (copy_workers_start(p, flags) < 0) {
+        pr_trace_msg(trace_channel, 3,
+          "unable to start copy workers, copying '%s' sequentially", from);
+      }
+    }
+
     res = copy_dir(p, from, to, flags);
-    if (res < 0) {
-      int xerrno = errno;
+    xerrno = errno;
 
+    if (copy_nworkers > 0) {
+      /* Wait for the files still being copied, even if the walk failed. */
+      if (copy_workers_wait(TRUE) < 0 &&
+          res == 0) {
+        xerrno = errno;
+        res = -1;
+      }
+
+      copy_workers_stop();
+    }
+
+    pr_log_debug(DEBUG5, MOD_COPY_VERSION
+      ": copied %u files (%" PR_LU " bytes) from '%s' to '%s'", copy_nfiles,
+      (pr_off_t) copy_nbytes, from, to);
+
+    if (res < 0) {
       pr_log_debug(DEBUG7, MOD_COPY_VERSION
         ": error copying directory '%s' to '%s': %s", from, to,
         strerror(xerrno));
@@ -546,6 +1034,26 @@ MODRET set_copyoptions(cmd_rec *cmd) {
   return PR_HANDLED(cmd);
 }
 
+/* usage: CopyMaxWorkers count */
+MODRET set_copymaxworkers(cmd_rec *cmd) {
+  config_rec *c;
+  int count;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  count = atoi(cmd->argv[1]);
+  if (count < 1) {
+    CONF_ERROR(cmd, "count must be 1 or greater");
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[0]) = count;
+
+  return PR_HANDLED(cmd);
+}
+
 /* Command handlers
  */
 
@@ -905,6 +1413,11 @@ MODRET copy_post_pass(cmd_rec *cmd) {
     c = find_config_next(c, c->next, CONF_PARAM, "CopyOptions", FALSE);
   }
 
+  c = find_config(main_server->conf, CONF_PARAM, "CopyMaxWorkers", FALSE);
+  if (c != NULL) {
+    copy_max_workers = *((unsigned int *) c->argv[0]);
+  }
+
   return PR_DECLINED(cmd);
 }
 
@@ -933,6 +1446,7 @@ static int copy_sess_init(void) {
 
 static conftable copy_conftab[] = {
   { "CopyEngine",	set_copyengine,		NULL },
+  { "CopyMaxWorkers",	set_copymaxworkers,	NULL },
   { "CopyOptions",	set_copyoptions,	NULL },
 
   { NULL }
@@ -57,6 +57,8 @@ static pr_netio_stream_t *(*deflate_next_netio_open)(pr_netio_stream_t *, int, i
 static int (*deflate_next_netio_read)(pr_netio_stream_t *, char *, size_t) = NULL;
 static int (*deflate_next_netio_shutdown)(pr_netio_stream_t *, int) = NULL;
 static int (*deflate_next_netio_write)(pr_netio_stream_t *, char *, size_t) = NULL;
+static int (*deflate_next_netio_writev)(pr_netio_stream_t *,
+  const struct iovec *, int) = NULL;
 
 /* Draft-recommended ZLIB defaults:
  *
@@ -666,6 +668,64 @@ static int deflate_netio_shutdown_cb(pr_netio_stream_t *nstrm, int how) {
   return shutdown(nstrm->strm_fd, how);
 }
 
+/* Writes out the first `datalen' bytes of deflated data in deflate_zbuf,
+ * resetting the zstream's output buffer once they are all written.
+ */
+static int deflate_netio_write_zbuf(pr_netio_stream_t *nstrm,
+    z_stream *zstrm, size_t datalen) {
+  int res = 0;
+  size_t offset = 0;
+
+  while (datalen > 0) {
+    pr_signals_handle();
+
+    if (deflate_next_netio_write != NULL) {
+      res = (deflate_next_netio_write)(nstrm,
+        (char *) (deflate_zbuf + offset), datalen);
+
+    } else {
+      res = write(nstrm->strm_fd, deflate_zbuf + offset, datalen);
+    }
+
+    if (res < 0) {
+      if (errno == EINTR ||
+          errno == EAGAIN) {
+        /* The socket might be busy, especially if the peer is a bit
+         * slow in reading data from it.
+         */
+        pr_signals_handle();
+        continue;
+      }
+
+      (void) pr_log_writefile(deflate_logfd, MOD_DEFLATE_VERSION,
+        "error writing to socket %d: %s", nstrm->strm_fd, strerror(errno));
+      return -1;
+    }
+
+    /* Manually adjust the "raw" bytes counter, so that it will be
+     * accurate for %O logging.
+     */
+    session.total_raw_out += res;
+
+    (void) pr_log_writefile(deflate_logfd, MOD_DEFLATE_VERSION,
+      "wrote %d (of %lu) bytes of compressed of data to socket %d", res,
+      (unsigned long) datalen, nstrm->strm_fd);
+
+    /* Watch out for short writes */
+    if ((size_t) res == datalen) {
+      zstrm->next_out = deflate_zbuf;
+      zstrm->avail_out = deflate_zbufsz;
+      break;
+
+    } else {
+      offset += res;
+      datalen -= res;
+    }
+  }
+
+  return 0;
+}
+
 static int deflate_netio_write_cb(pr_netio_stream_t *nstrm, char *buf,
     size_t buflen) {
 
@@ -675,7 +735,7 @@ static int deflate_netio_write_cb(pr_netio_stream_t *nstrm, char *buf,
 
   if (nstrm->strm_type == PR_NETIO_STRM_DATA) {
     int res = 0, xerrno;
-    size_t datalen, offset = 0;
+    size_t datalen;
     z_stream *zstrm;
 
     zstrm = (z_stream *) pr_table_get(nstrm->notes, DEFLATE_NETIO_NOTE, NULL);
@@ -721,51 +781,9 @@ static int deflate_netio_write_cb(pr_netio_stream_t *nstrm, char *buf,
 
     datalen = deflate_zbufsz - zstrm->avail_out;
 
-    while (datalen > 0) {
-      pr_signals_handle();
-
-      if (deflate_next_netio_write != NULL) {
-        res = (deflate_next_netio_write)(nstrm,
-          (char *) (deflate_zbuf + offset), datalen);
-
-      } else {
-        res = write(nstrm->strm_fd, deflate_zbuf + offset, datalen);
-      }
-
-      if (res < 0) {
-        if (errno == EINTR ||
-            errno == EAGAIN) {
-          /* The socket might be busy, especially if the peer is a bit
-           * slow in reading data from it.
-           */
-          pr_signals_handle();
-          continue;
-        }
-
-        (void) pr_log_writefile(deflate_logfd, MOD_DEFLATE_VERSION,
-          "error writing to socket %d: %s", nstrm->strm_fd, strerror(errno));
-        return -1;
-      }
-
-      /* Manually adjust the "raw" bytes counter, so that it will be
-       * accurate for %O logging.
-       */
-      session.total_raw_out += res;
-
-      (void) pr_log_writefile(deflate_logfd, MOD_DEFLATE_VERSION,
-        "wrote %d (of %lu) bytes of compressed of data to socket %d", res,
-        (unsigned long) datalen, nstrm->strm_fd);
-
-      /* Watch out for short writes */
-      if ((size_t) res == datalen) {
-        zstrm->next_out = deflate_zbuf;
-        zstrm->avail_out = deflate_zbufsz;
-        break;
-
-      } else {
-        offset += res;
-        datalen -= res;
-      }
+    res = deflate_netio_write_zbuf(nstrm, zstrm, datalen);
+    if (res < 0) {
+      return -1;
     }
 
     /* Manually adjust the "raw" bytes in counter, so that it will
@@ -789,6 +807,96 @@ static int deflate_netio_write_cb(pr_netio_stream_t *nstrm, char *buf,
   return write(nstrm->strm_fd, buf, buflen);
 }
 
+static int deflate_netio_writev_cb(pr_netio_stream_t *nstrm,
+    const struct iovec *iov, int iovcnt) {
+  register int i;
+  int res = 0;
+  size_t total = 0;
+  z_stream *zstrm;
+
+  if (nstrm->strm_type != PR_NETIO_STRM_DATA) {
+    if (deflate_next_netio_writev != NULL) {
+      return (deflate_next_netio_writev)(nstrm, iov, iovcnt);
+    }
+
+    return writev(nstrm->strm_fd, iov, iovcnt);
+  }
+
+  zstrm = (z_stream *) pr_table_get(nstrm->notes, DEFLATE_NETIO_NOTE, NULL);
+  if (zstrm == NULL) {
+    pr_trace_msg(trace_channel, 2,
+      "no zstream found in stream data for writing");
+    errno = EIO;
+    return -1;
+  }
+
+  /* Deflate all of the vectors as one stream, flushing only after the last
+   * one; this yields better compression, and fewer writes, than deflating
+   * (and flushing) each vector on its own.
+   */
+  for (i = 0; i < iovcnt; i++) {
+    int flush;
+
+    flush = (i == iovcnt - 1) ? Z_SYNC_FLUSH : Z_NO_FLUSH;
+    if (iov[i].iov_len == 0 &&
+        flush == Z_NO_FLUSH) {
+      continue;
+    }
+
+    zstrm->next_in = (Bytef *) iov[i].iov_base;
+    zstrm->avail_in = iov[i].iov_len;
+
+    while (TRUE) {
+      pr_signals_handle();
+
+      deflate_zerrno = deflate(zstrm, flush);
+      if (deflate_zerrno != Z_OK &&
+          deflate_zerrno != Z_BUF_ERROR) {
+        pr_trace_msg(trace_channel, 3,
+          "writev: error deflating data: [%d] %s: %s", deflate_zerrno,
+          deflate_zstrerror(deflate_zerrno),
+          zstrm->msg ? zstrm->msg : "unavailable");
+
+        (void) pr_log_writefile(deflate_logfd, MOD_DEFLATE_VERSION,
+          "error deflating data: [%d] %s", deflate_zerrno,
+          zstrm->msg ? zstrm->msg : deflate_zstrerror(deflate_zerrno));
+
+        errno = EIO;
+        return -1;
+      }
+
+      /* If deflate() filled our output buffer, write it out and let
+       * deflate() continue; otherwise, it has consumed all of this vector.
+       */
+      if (zstrm->avail_out > 0) {
+        break;
+      }
+
+      res = deflate_netio_write_zbuf(nstrm, zstrm, deflate_zbufsz);
+      if (res < 0) {
+        return -1;
+      }
+    }
+
+    total += iov[i].iov_len;
+  }
+
+  res = deflate_netio_write_zbuf(nstrm, zstrm,
+    deflate_zbufsz - zstrm->avail_out);
+  if (res < 0) {
+    return -1;
+  }
+
+  /* As for deflate_netio_write_cb(), subtract what we return, since
+   * pr_netio_writev() will add it back to the raw bytes out counter.
+   */
+  session.total_raw_out -= total;
+
+  pr_trace_msg(trace_channel, 9, "writev: returning %lu bytes for %d vectors",
+    (unsigned long) total, iovcnt);
+  return (int) total;
+}
+
 /* Configuration handlers
  */
 
@@ -984,6 +1092,9 @@ MODRET deflate_mode(cmd_rec *cmd) {
       deflate_next_netio_write = deflate_next_netio->write;
       deflate_next_netio->write = deflate_netio_write_cb;
 
+      deflate_next_netio_writev = deflate_next_netio->writev;
+      deflate_next_netio->writev = deflate_netio_writev_cb;
+
     } else {
       /* Need to install some sort of NetIO handlers here, to handle
        * compression.
@@ -994,6 +1105,7 @@ MODRET deflate_mode(cmd_rec *cmd) {
       deflate_netio->read = deflate_netio_read_cb;
       deflate_netio->shutdown = deflate_netio_shutdown_cb;
       deflate_netio->write = deflate_netio_write_cb;
+      deflate_netio->writev = deflate_netio_writev_cb;
 
       if (pr_register_netio(deflate_netio, PR_NETIO_STRM_DATA) < 0) {
         (void) pr_log_writefile(deflate_logfd, MOD_DEFLATE_VERSION,
@@ -1026,6 +1138,9 @@ MODRET deflate_mode(cmd_rec *cmd) {
         deflate_next_netio->write = deflate_next_netio_write;
         deflate_next_netio_write = NULL;
 
+        deflate_next_netio->writev = deflate_next_netio_writev;
+        deflate_next_netio_writev = NULL;
+
         deflate_next_netio = NULL;
 
       } else {
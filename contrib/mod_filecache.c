@@ -0,0 +1,1228 @@
+/*
+ * ProFTPD: mod_filecache -- a module which caches the contents of small,
+ *                           frequently downloaded files in a SysV shared
+ *                           memory segment
+ * Copyright (c) 2017 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ *
+ * This is mod_filecache, contrib software for proftpd 1.3.x and above.
+ */
+
+#include "conf.h"
+#include "privs.h"
+
+#ifdef PR_USE_CTRLS
+# include "mod_ctrls.h"
+#endif /* PR_USE_CTRLS */
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#define MOD_FILECACHE_VERSION		"mod_filecache/0.1"
+
+/* Make sure the version of proftpd is as necessary. */
+#if PROFTPD_VERSION_NUMBER < 0x0001030602
+# error "ProFTPD 1.3.6rc2 or later required"
+#endif
+
+#define FILECACHE_PROJ_ID		83
+
+/* Number of entries in each set of the cache.  A file can only be cached in
+ * the set to which its device/inode hashes; when that set is full, the
+ * least frequently used entry in the set is the candidate for eviction.
+ */
+#define FILECACHE_NWAYS			8
+
+/* Rows in the frequency sketch. */
+#define FILECACHE_SKETCH_DEPTH		4
+
+/* Maximum value of a frequency sketch counter. */
+#define FILECACHE_SKETCH_MAX		15
+
+#define FILECACHE_DEFAULT_SIZE		(16 * 1024 * 1024)
+#define FILECACHE_DEFAULT_MAX_FILESZ	(64 * 1024)
+
+/* From src/main.c */
+extern pid_t mpid;
+
+module filecache_module;
+
+#ifdef PR_USE_CTRLS
+static ctrls_acttab_t filecache_acttab[];
+#endif /* PR_USE_CTRLS */
+
+/* Pool for this module's use */
+static pool *filecache_pool = NULL;
+
+struct filecache_entry {
+  int used;
+
+  /* The key: the file's device and inode, and its size and change times
+   * when its contents were cached.
+   */
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+  time_t ctime;
+};
+
+/* The header of the shm segment.  It is followed by the entries, the
+ * frequency sketch, and then the cached file contents; each entry has a
+ * fixed-size slot of max_filesz bytes.
+ */
+struct filecache_data {
+
+  /* Cache metadata. */
+  unsigned int nhits;
+  unsigned int nmisses;
+
+  unsigned int nstored;
+  unsigned int nrejected;
+  unsigned int nevicted;
+  unsigned int ninvalidated;
+  unsigned int nerrors;
+
+  unsigned int nsets;
+  unsigned int nentries;
+  unsigned int max_filesz;
+
+  /* The frequency sketch is a count-min sketch of FILECACHE_SKETCH_DEPTH
+   * rows, each of sketch_width counters.  All counters are halved once
+   * sketch_nsamples reaches sketch_max_samples, so that the sketch reflects
+   * recent popularity.
+   */
+  unsigned int sketch_width;
+  unsigned int sketch_nsamples;
+  unsigned int sketch_max_samples;
+};
+
+static int filecache_engine = FALSE;
+static const char *filecache_table = NULL;
+static off_t filecache_size = FILECACHE_DEFAULT_SIZE;
+static off_t filecache_max_filesz = FILECACHE_DEFAULT_MAX_FILESZ;
+
+static pr_fh_t *filecache_tabfh = NULL;
+static int filecache_shmid = -1;
+static struct filecache_data *filecache_data = NULL;
+static struct filecache_entry *filecache_entries = NULL;
+static unsigned char *filecache_sketch = NULL;
+static unsigned char *filecache_slots = NULL;
+
+static const char *trace_channel = "filecache";
+
+static int filecache_lock_shm(int lock_type) {
+  struct flock lock;
+
+  lock.l_type = lock_type;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = 0;
+  lock.l_len = 0;
+
+  while (fcntl(PR_FH_FD(filecache_tabfh), F_SETLKW, &lock) < 0) {
+    if (errno == EINTR) {
+      pr_signals_handle();
+      continue;
+    }
+
+    return -1;
+  }
+
+  return 0;
+}
+
+static void filecache_set_ptrs(void) {
+  unsigned char *ptr;
+
+  ptr = (unsigned char *) filecache_data;
+  ptr += sizeof(struct filecache_data);
+
+  filecache_entries = (struct filecache_entry *) ptr;
+  ptr += sizeof(struct filecache_entry) * filecache_data->nentries;
+
+  filecache_sketch = ptr;
+  ptr += FILECACHE_SKETCH_DEPTH * filecache_data->sketch_width;
+
+  filecache_slots = ptr;
+}
+
+static size_t filecache_get_layout(size_t requested_size, size_t max_filesz,
+    unsigned int *nsets, unsigned int *sketch_width) {
+  size_t per_set, shm_size;
+  unsigned int width;
+
+  /* Each set needs its entries, their data slots, and (at most) room for
+   * four sketch counters per entry in each sketch row.
+   */
+  per_set = FILECACHE_NWAYS * (sizeof(struct filecache_entry) + max_filesz +
+    (FILECACHE_SKETCH_DEPTH * 4));
+
+  *nsets = 1;
+  if (requested_size > sizeof(struct filecache_data) + per_set) {
+    *nsets = (requested_size - sizeof(struct filecache_data)) / per_set;
+  }
+
+  width = 64;
+  while (width < (*nsets * FILECACHE_NWAYS * 4)) {
+    width <<= 1;
+  }
+
+  if (width > (*nsets * FILECACHE_NWAYS * 4)) {
+    width >>= 1;
+  }
+
+  if (width < 64) {
+    width = 64;
+  }
+
+  *sketch_width = width;
+
+  shm_size = sizeof(struct filecache_data) +
+    (*nsets * FILECACHE_NWAYS * (sizeof(struct filecache_entry) + max_filesz)) +
+    (FILECACHE_SKETCH_DEPTH * width);
+  return shm_size;
+}
+
+static struct filecache_data *filecache_get_shm(pr_fh_t *tabfh) {
+  int shmid, shm_existed = FALSE, xerrno;
+  struct filecache_data *data = NULL;
+  unsigned int nsets, sketch_width;
+  size_t shm_size;
+  key_t key;
+
+  /* If we already have a shmid, no need to do anything. */
+  if (filecache_shmid >= 0) {
+    errno = EEXIST;
+    return NULL;
+  }
+
+  key = ftok(tabfh->fh_path, FILECACHE_PROJ_ID);
+  if (key == (key_t) -1) {
+    xerrno = errno;
+
+    pr_trace_msg(trace_channel, 1, "unable to get key for '%s': %s",
+      tabfh->fh_path, strerror(xerrno));
+
+    errno = xerrno;
+    return NULL;
+  }
+
+  shm_size = filecache_get_layout((size_t) filecache_size,
+    (size_t) filecache_max_filesz, &nsets, &sketch_width);
+
+  /* Try first using IPC_CREAT|IPC_EXCL, to check if there is an existing
+   * shm for this key.  If there is, try again, using a flag of zero.
+   *
+   * The segment holds the contents of users' files, so it is only
+   * accessible to root; the session processes inherit the attachment.
+   */
+  PRIVS_ROOT
+  shmid = shmget(key, shm_size, IPC_CREAT|IPC_EXCL|0600);
+  xerrno = errno;
+  PRIVS_RELINQUISH
+
+  if (shmid < 0) {
+    if (xerrno != EEXIST) {
+      pr_trace_msg(trace_channel, 1, "unable to create shm (%lu bytes): %s",
+        (unsigned long) shm_size, strerror(xerrno));
+
+      errno = xerrno;
+      return NULL;
+    }
+
+    shm_existed = TRUE;
+
+    PRIVS_ROOT
+    shmid = shmget(key, 0, 0);
+    xerrno = errno;
+    PRIVS_RELINQUISH
+
+    if (shmid < 0) {
+      pr_trace_msg(trace_channel, 1, "unable to get shm for existing key: %s",
+        strerror(xerrno));
+
+      errno = xerrno;
+      return NULL;
+    }
+  }
+
+  PRIVS_ROOT
+  data = (struct filecache_data *) shmat(shmid, NULL, 0);
+  xerrno = errno;
+  PRIVS_RELINQUISH
+
+  if (data == (struct filecache_data *) -1) {
+    pr_trace_msg(trace_channel, 1, "unable to attach to shm ID %d: %s", shmid,
+      strerror(xerrno));
+
+    errno = xerrno;
+    return NULL;
+  }
+
+  if (shm_existed) {
+    /* The existing segment has its own layout, which may differ from the
+     * configured one; keep using it.
+     */
+    if (data->nentries != nsets * FILECACHE_NWAYS ||
+        data->max_filesz != (unsigned int) filecache_max_filesz) {
+      pr_log_pri(PR_LOG_NOTICE, MOD_FILECACHE_VERSION
+        ": existing cache has %u entries of up to %u bytes; remove it "
+        "(e.g. by restarting the daemon) to use the configured sizes",
+        data->nentries, data->max_filesz);
+    }
+
+  } else {
+    /* Make sure the memory is initialized. */
+    if (filecache_lock_shm(F_WRLCK) < 0) {
+      pr_trace_msg(trace_channel, 1, "error write-locking shm: %s",
+        strerror(errno));
+    }
+
+    memset(data, 0, sizeof(struct filecache_data) +
+      (nsets * FILECACHE_NWAYS * sizeof(struct filecache_entry)) +
+      (FILECACHE_SKETCH_DEPTH * sketch_width));
+
+    data->nsets = nsets;
+    data->nentries = nsets * FILECACHE_NWAYS;
+    data->max_filesz = (unsigned int) filecache_max_filesz;
+    data->sketch_width = sketch_width;
+    data->sketch_max_samples = data->nentries * 10;
+
+    if (filecache_lock_shm(F_UNLCK) < 0) {
+      pr_trace_msg(trace_channel, 1, "error unlocking shm: %s",
+        strerror(errno));
+    }
+  }
+
+  filecache_shmid = shmid;
+  pr_trace_msg(trace_channel, 9,
+    "using shm ID %d for FileCacheTable '%s' (%u entries of up to %u bytes)",
+    filecache_shmid, tabfh->fh_path, data->nentries, data->max_filesz);
+
+  return data;
+}
+
+static void filecache_remove_shm(void) {
+  struct shmid_ds ds;
+  int res;
+
+  if (filecache_data == NULL) {
+    return;
+  }
+
+  (void) shmdt((char *) filecache_data);
+  filecache_data = NULL;
+
+  PRIVS_ROOT
+  res = shmctl(filecache_shmid, IPC_RMID, &ds);
+  PRIVS_RELINQUISH
+
+  if (res < 0) {
+    pr_log_debug(DEBUG1, MOD_FILECACHE_VERSION
+      ": error removing shm ID %d: %s", filecache_shmid, strerror(errno));
+
+  } else {
+    pr_log_debug(DEBUG9, MOD_FILECACHE_VERSION ": removed shm ID %d",
+      filecache_shmid);
+  }
+
+  filecache_shmid = -1;
+}
+
+/* Hashes the device/inode of a file; the hash selects both the cache set
+ * and the sketch counters for the file.
+ */
+static uint64_t filecache_hash(dev_t dev, ino_t ino) {
+  uint64_t h;
+
+  h = ((uint64_t) ino * 0x9e3779b97f4a7c15ULL) ^ (uint64_t) dev;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+}
+
+/* Frequency sketch.  Callers are assumed to hold the shm lock. */
+
+static unsigned char *filecache_sketch_counter(uint64_t h, unsigned int row) {
+  uint32_t h1, h2, idx;
+
+  h1 = (uint32_t) h;
+  h2 = (uint32_t) (h >> 32) | 1;
+  idx = (h1 + (row * h2)) & (filecache_data->sketch_width - 1);
+
+  return &(filecache_sketch[(row * filecache_data->sketch_width) + idx]);
+}
+
+static unsigned int filecache_sketch_estimate(uint64_t h) {
+  register unsigned int i;
+  unsigned int freq = FILECACHE_SKETCH_MAX;
+
+  for (i = 0; i < FILECACHE_SKETCH_DEPTH; i++) {
+    unsigned char *counter;
+
+    counter = filecache_sketch_counter(h, i);
+    if (*counter < freq) {
+      freq = *counter;
+    }
+  }
+
+  return freq;
+}
+
+static void filecache_sketch_increment(uint64_t h) {
+  register unsigned int i;
+  unsigned int freq;
+
+  /* Only increment the smallest counters ("conservative update"), which
+   * reduces the overestimation caused by collisions.
+   */
+  freq = filecache_sketch_estimate(h);
+  if (freq < FILECACHE_SKETCH_MAX) {
+    for (i = 0; i < FILECACHE_SKETCH_DEPTH; i++) {
+      unsigned char *counter;
+
+      counter = filecache_sketch_counter(h, i);
+      if (*counter == freq) {
+        (*counter)++;
+      }
+    }
+  }
+
+  filecache_data->sketch_nsamples++;
+  if (filecache_data->sketch_nsamples >= filecache_data->sketch_max_samples) {
+    unsigned int n;
+
+    n = FILECACHE_SKETCH_DEPTH * filecache_data->sketch_width;
+    for (i = 0; i < n; i++) {
+      filecache_sketch[i] >>= 1;
+    }
+
+    filecache_data->sketch_nsamples /= 2;
+  }
+}
+
+static struct filecache_entry *filecache_get_set(uint64_t h) {
+  return &(filecache_entries[(h % filecache_data->nsets) * FILECACHE_NWAYS]);
+}
+
+static unsigned char *filecache_get_slot(struct filecache_entry *entry) {
+  return filecache_slots +
+    ((entry - filecache_entries) * (size_t) filecache_data->max_filesz);
+}
+
+static int filecache_entry_matches(struct filecache_entry *entry,
+    struct stat *st) {
+  if (entry->size == st->st_size &&
+      entry->mtime == st->st_mtime &&
+      entry->ctime == st->st_ctime) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Chooses the entry in which to store the given file, if the file is to be
+ * admitted: a free entry in its set, or else the entry of the least
+ * frequently used file in the set, if the given file is used more often.
+ * Callers are assumed to hold the shm lock.
+ */
+static struct filecache_entry *filecache_admit(uint64_t h) {
+  register unsigned int i;
+  struct filecache_entry *set, *victim = NULL;
+  unsigned int victim_freq = 0;
+
+  set = filecache_get_set(h);
+
+  for (i = 0; i < FILECACHE_NWAYS; i++) {
+    unsigned int freq;
+
+    if (set[i].used == FALSE) {
+      return &(set[i]);
+    }
+
+    freq = filecache_sketch_estimate(filecache_hash(set[i].dev, set[i].ino));
+    if (victim == NULL ||
+        freq < victim_freq) {
+      victim = &(set[i]);
+      victim_freq = freq;
+    }
+  }
+
+  if (filecache_sketch_estimate(h) > victim_freq) {
+    return victim;
+  }
+
+  return NULL;
+}
+
+/* Reads the entire file into the given buffer, making sure that the file
+ * did not change while doing so.
+ */
+static int filecache_read_file(pr_fh_t *fh, struct stat *st, char *buf) {
+  struct stat st2;
+  off_t total = 0;
+
+  while (total < st->st_size) {
+    int res;
+
+    res = pr_fsio_read(fh, buf + total, (size_t) (st->st_size - total));
+    if (res < 0) {
+      if (errno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      return -1;
+    }
+
+    if (res == 0) {
+      break;
+    }
+
+    total += res;
+  }
+
+  if (total != st->st_size ||
+      pr_fsio_fstat(fh, &st2) < 0 ||
+      st2.st_size != st->st_size ||
+      st2.st_mtime != st->st_mtime ||
+      st2.st_ctime != st->st_ctime) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  return 0;
+}
+
+static pr_buffer_t *filecache_get(pool *p, pr_fh_t *fh) {
+  register unsigned int i;
+  struct stat st;
+  struct filecache_entry *set, *entry = NULL;
+  pr_buffer_t *pbuf;
+  uint64_t h;
+  time_t now;
+
+  /* Note the time before looking at the file; any later change to it gets a
+   * change time of at least this second.
+   */
+  time(&now);
+
+  if (pr_fsio_fstat(fh, &st) < 0) {
+    return NULL;
+  }
+
+  if (!S_ISREG(st.st_mode) ||
+      st.st_size == 0 ||
+      st.st_size > (off_t) filecache_data->max_filesz) {
+    errno = EPERM;
+    return NULL;
+  }
+
+  h = filecache_hash(st.st_dev, st.st_ino);
+
+  pbuf = pcalloc(p, sizeof(pr_buffer_t));
+  pbuf->buf = palloc(p, (size_t) st.st_size);
+  pbuf->buflen = (unsigned long) st.st_size;
+  pbuf->current = pbuf->buf;
+  pbuf->remaining = (size_t) st.st_size;
+
+  if (filecache_lock_shm(F_WRLCK) < 0) {
+    pr_trace_msg(trace_channel, 3, "error write-locking shm: %s",
+      strerror(errno));
+    return NULL;
+  }
+
+  filecache_sketch_increment(h);
+
+  set = filecache_get_set(h);
+  for (i = 0; i < FILECACHE_NWAYS; i++) {
+    if (set[i].used == FALSE ||
+        set[i].dev != st.st_dev ||
+        set[i].ino != st.st_ino) {
+      continue;
+    }
+
+    if (filecache_entry_matches(&(set[i]), &st) == TRUE) {
+      memcpy(pbuf->buf, filecache_get_slot(&(set[i])), (size_t) st.st_size);
+      filecache_data->nhits++;
+      (void) filecache_lock_shm(F_UNLCK);
+
+      pr_trace_msg(trace_channel, 15, "cache hit for '%s' (%" PR_LU " bytes)",
+        fh->fh_path, (pr_off_t) st.st_size);
+      return pbuf;
+    }
+
+    /* The file has changed since it was cached. */
+    set[i].used = FALSE;
+    filecache_data->ninvalidated++;
+    break;
+  }
+
+  filecache_data->nmisses++;
+
+  /* Timestamps only have a granularity of a second, portably.  If a file
+   * which changed in the current second were cached, another change within
+   * that second, keeping its size, would leave the entry looking current;
+   * such recently changed files are thus not cached yet.
+   */
+  if (st.st_ctime >= now - 1) {
+    filecache_data->nrejected++;
+    (void) filecache_lock_shm(F_UNLCK);
+
+    pr_trace_msg(trace_channel, 19, "cache miss for '%s', changed too "
+      "recently to be cached", fh->fh_path);
+    errno = ENOENT;
+    return NULL;
+  }
+
+  if (filecache_admit(h) == NULL) {
+    filecache_data->nrejected++;
+    (void) filecache_lock_shm(F_UNLCK);
+
+    pr_trace_msg(trace_channel, 19, "cache miss for '%s', not admitted",
+      fh->fh_path);
+    errno = ENOENT;
+    return NULL;
+  }
+
+  (void) filecache_lock_shm(F_UNLCK);
+
+  /* Read the file without holding the lock; it is the caller's to serve
+   * from the buffer now, whether or not it can be stored.
+   */
+  if (filecache_read_file(fh, &st, pbuf->buf) < 0) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 3, "error reading '%s' for caching: %s",
+      fh->fh_path, strerror(xerrno));
+
+    if (pr_fsio_lseek(fh, 0, SEEK_SET) == (off_t) -1) {
+      /* The caller cannot read the file itself, either. */
+      xerrno = errno;
+    }
+
+    (void) filecache_lock_shm(F_WRLCK);
+    filecache_data->nerrors++;
+    (void) filecache_lock_shm(F_UNLCK);
+
+    errno = xerrno;
+    return NULL;
+  }
+
+  if (filecache_lock_shm(F_WRLCK) < 0) {
+    return pbuf;
+  }
+
+  /* Another process may have stored this file meanwhile. */
+  for (i = 0; i < FILECACHE_NWAYS; i++) {
+    if (set[i].used == TRUE &&
+        set[i].dev == st.st_dev &&
+        set[i].ino == st.st_ino) {
+      entry = &(set[i]);
+      break;
+    }
+  }
+
+  if (entry == NULL) {
+    entry = filecache_admit(h);
+    if (entry != NULL &&
+        entry->used == TRUE) {
+      filecache_data->nevicted++;
+    }
+  }
+
+  if (entry != NULL) {
+    entry->used = TRUE;
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtime;
+    entry->ctime = st.st_ctime;
+    memcpy(filecache_get_slot(entry), pbuf->buf, (size_t) st.st_size);
+
+    filecache_data->nstored++;
+    pr_trace_msg(trace_channel, 15, "stored '%s' (%" PR_LU " bytes) in cache",
+      fh->fh_path, (pr_off_t) st.st_size);
+  }
+
+  (void) filecache_lock_shm(F_UNLCK);
+  return pbuf;
+}
+
+static void filecache_invalidate(pool *p, const char *path) {
+  register unsigned int i;
+  struct stat st;
+  struct filecache_entry *set;
+
+  path = pr_fs_decode_path(p, path);
+
+  pr_fs_clear_cache2(path);
+  if (pr_fsio_stat(path, &st) < 0 ||
+      !S_ISREG(st.st_mode)) {
+    return;
+  }
+
+  if (filecache_lock_shm(F_WRLCK) < 0) {
+    pr_trace_msg(trace_channel, 3, "error write-locking shm: %s",
+      strerror(errno));
+    return;
+  }
+
+  set = filecache_get_set(filecache_hash(st.st_dev, st.st_ino));
+  for (i = 0; i < FILECACHE_NWAYS; i++) {
+    if (set[i].used == TRUE &&
+        set[i].dev == st.st_dev &&
+        set[i].ino == st.st_ino) {
+      set[i].used = FALSE;
+      filecache_data->ninvalidated++;
+
+      pr_trace_msg(trace_channel, 15, "removed '%s' from cache", path);
+      break;
+    }
+  }
+
+  (void) filecache_lock_shm(F_UNLCK);
+}
+
+#ifdef PR_USE_CTRLS
+/* Controls handlers
+ */
+
+static int filecache_handle_info(pr_ctrls_t *ctrl) {
+  unsigned int nused = 0, nlookups;
+  register unsigned int i;
+
+  if (filecache_lock_shm(F_RDLCK) < 0) {
+    pr_ctrls_add_response(ctrl, "error locking shm: %s", strerror(errno));
+    return -1;
+  }
+
+  for (i = 0; i < filecache_data->nentries; i++) {
+    if (filecache_entries[i].used == TRUE) {
+      nused++;
+    }
+  }
+
+  nlookups = filecache_data->nhits + filecache_data->nmisses;
+
+  pr_ctrls_add_response(ctrl, "Shared memory (shm) file cache provided by "
+    MOD_FILECACHE_VERSION);
+  pr_ctrls_add_response(ctrl, "Shared memory segment ID: %d",
+    filecache_shmid);
+  pr_ctrls_add_response(ctrl, "Max cached file size: %u bytes",
+    filecache_data->max_filesz);
+  pr_ctrls_add_response(ctrl, "Max cache size: %u files",
+    filecache_data->nentries);
+  pr_ctrls_add_response(ctrl, "Current cache size: %u files", nused);
+  pr_ctrls_add_response(ctrl, "%s", "");
+  pr_ctrls_add_response(ctrl, "Cache lifetime hits: %u (%.1f%%)",
+    filecache_data->nhits,
+    nlookups > 0 ? (filecache_data->nhits * 100.0) / nlookups : 0.0);
+  pr_ctrls_add_response(ctrl, "Cache lifetime misses: %u",
+    filecache_data->nmisses);
+  pr_ctrls_add_response(ctrl, "%s", "");
+  pr_ctrls_add_response(ctrl, "Cache lifetime files stored: %u",
+    filecache_data->nstored);
+  pr_ctrls_add_response(ctrl, "Cache lifetime files not admitted: %u",
+    filecache_data->nrejected);
+  pr_ctrls_add_response(ctrl, "Cache lifetime files evicted: %u",
+    filecache_data->nevicted);
+  pr_ctrls_add_response(ctrl, "Cache lifetime files invalidated: %u",
+    filecache_data->ninvalidated);
+  pr_ctrls_add_response(ctrl, "Cache lifetime errors reading files: %u",
+    filecache_data->nerrors);
+
+  (void) filecache_lock_shm(F_UNLCK);
+  return 0;
+}
+
+static int filecache_handle_clear(pr_ctrls_t *ctrl) {
+  if (filecache_lock_shm(F_WRLCK) < 0) {
+    pr_ctrls_add_response(ctrl, "error locking shm: %s", strerror(errno));
+    return -1;
+  }
+
+  memset(filecache_entries, 0,
+    sizeof(struct filecache_entry) * filecache_data->nentries);
+  memset(filecache_sketch, 0,
+    FILECACHE_SKETCH_DEPTH * filecache_data->sketch_width);
+  filecache_data->sketch_nsamples = 0;
+
+  (void) filecache_lock_shm(F_UNLCK);
+
+  pr_ctrls_add_response(ctrl, "file cache cleared");
+  return 0;
+}
+
+static int filecache_handle_filecache(pr_ctrls_t *ctrl, int reqargc,
+    char **reqargv) {
+
+  if (!pr_ctrls_check_acl(ctrl, filecache_acttab, "filecache")) {
+    pr_ctrls_add_response(ctrl, "access denied");
+    return -1;
+  }
+
+  if (reqargc == 0 ||
+      reqargv == NULL) {
+    pr_ctrls_add_response(ctrl, "missing parameters");
+    return -1;
+  }
+
+  if (filecache_data == NULL) {
+    pr_ctrls_add_response(ctrl, MOD_FILECACHE_VERSION " not enabled");
+    return -1;
+  }
+
+  if (strcmp(reqargv[0], "info") == 0) {
+    return filecache_handle_info(ctrl);
+  }
+
+  if (strcmp(reqargv[0], "clear") == 0) {
+    return filecache_handle_clear(ctrl);
+  }
+
+  pr_ctrls_add_response(ctrl, "unknown filecache action: '%s'", reqargv[0]);
+  return -1;
+}
+#endif /* PR_USE_CTRLS */
+
+/* Configuration handlers
+ */
+
+#ifdef PR_USE_CTRLS
+/* usage: FileCacheControlsACLs actions|all allow|deny user|group list */
+MODRET set_filecachectrlsacls(cmd_rec *cmd) {
+  char *bad_action = NULL, **actions = NULL;
+
+  CHECK_ARGS(cmd, 4);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  actions = ctrls_parse_acl(cmd->tmp_pool, cmd->argv[1]);
+
+  if (strcmp(cmd->argv[2], "allow") != 0 &&
+      strcmp(cmd->argv[2], "deny") != 0) {
+    CONF_ERROR(cmd, "second parameter must be 'allow' or 'deny'");
+  }
+
+  if (strcmp(cmd->argv[3], "user") != 0 &&
+      strcmp(cmd->argv[3], "group") != 0) {
+    CONF_ERROR(cmd, "third parameter must be 'user' or 'group'");
+  }
+
+  bad_action = pr_ctrls_set_module_acls(filecache_acttab, filecache_pool,
+    actions, cmd->argv[2], cmd->argv[3], cmd->argv[4]);
+  if (bad_action != NULL) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, ": unknown action: '",
+      bad_action, "'", NULL));
+  }
+
+  return PR_HANDLED(cmd);
+}
+#endif /* PR_USE_CTRLS */
+
+/* usage: FileCacheEngine on|off */
+MODRET set_filecacheengine(cmd_rec *cmd) {
+  int engine = -1;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  engine = get_boolean(cmd, 1);
+  if (engine == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = engine;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: FileCacheMaxFileSize size [units] */
+MODRET set_filecachemaxfilesize(cmd_rec *cmd) {
+  off_t nbytes = 0;
+
+  if (cmd->argc-1 < 1 ||
+      cmd->argc-1 > 2) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  if (pr_str_get_nbytes(cmd->argv[1], cmd->argc-1 == 2 ? cmd->argv[2] : NULL,
+      &nbytes) < 0) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unable to parse: ",
+      cmd->argv[1], ": ", strerror(errno), NULL));
+  }
+
+  if (nbytes == 0 ||
+      nbytes > (off_t) (64 * 1024 * 1024)) {
+    CONF_ERROR(cmd, "size must be greater than zero, and at most 64 MB");
+  }
+
+  filecache_max_filesz = nbytes;
+  return PR_HANDLED(cmd);
+}
+
+/* usage: FileCacheSize size [units] */
+MODRET set_filecachesize(cmd_rec *cmd) {
+  off_t nbytes = 0;
+
+  if (cmd->argc-1 < 1 ||
+      cmd->argc-1 > 2) {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  if (pr_str_get_nbytes(cmd->argv[1], cmd->argc-1 == 2 ? cmd->argv[2] : NULL,
+      &nbytes) < 0) {
+    CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unable to parse: ",
+      cmd->argv[1], ": ", strerror(errno), NULL));
+  }
+
+  if (nbytes == 0) {
+    CONF_ERROR(cmd, "size must be greater than zero");
+  }
+
+  filecache_size = nbytes;
+  return PR_HANDLED(cmd);
+}
+
+/* usage: FileCacheTable path */
+MODRET set_filecachetable(cmd_rec *cmd) {
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  if (pr_fs_valid_path(cmd->argv[1]) < 0) {
+    CONF_ERROR(cmd, "must be an absolute path");
+  }
+
+  filecache_table = pstrdup(filecache_pool, cmd->argv[1]);
+  return PR_HANDLED(cmd);
+}
+
+/* Command handlers
+ */
+
+/* Hook used by mod_xfer (RETR) and mod_sftp (READ): given an open file
+ * handle, returns a pr_buffer_t holding the entire contents of the file, if
+ * the file is cached, or was just read in order to be cached.  Otherwise,
+ * the handle's offset is left unchanged, and the caller reads the file
+ * itself.
+ */
+MODRET filecache_get_hook(cmd_rec *cmd) {
+  pr_fh_t *fh;
+  pr_buffer_t *pbuf;
+
+  if (filecache_engine == FALSE ||
+      filecache_data == NULL) {
+    return PR_DECLINED(cmd);
+  }
+
+  fh = cmd->argv[0];
+  if (fh == NULL) {
+    return PR_DECLINED(cmd);
+  }
+
+  pbuf = filecache_get(cmd->pool, fh);
+  if (pbuf == NULL) {
+    return PR_DECLINED(cmd);
+  }
+
+  return mod_create_data(cmd, pbuf);
+}
+
+/* Files are cached by device/inode, and each entry records the size and
+ * change times of the file when cached; as only files which have not changed
+ * for a second or more are cached, changed files are never served from the
+ * cache.  Removing the entries of files which are about to be changed or
+ * removed merely frees their space sooner.
+ */
+MODRET filecache_pre_write(cmd_rec *cmd) {
+  if (filecache_engine == FALSE ||
+      filecache_data == NULL ||
+      cmd->arg == NULL ||
+      *cmd->arg == '\0') {
+    return PR_DECLINED(cmd);
+  }
+
+  filecache_invalidate(cmd->tmp_pool, cmd->arg);
+  return PR_DECLINED(cmd);
+}
+
+MODRET filecache_post_write(cmd_rec *cmd) {
+  const char *path;
+
+  if (filecache_engine == FALSE ||
+      filecache_data == NULL) {
+    return PR_DECLINED(cmd);
+  }
+
+  path = pr_table_get(cmd->notes, "mod_xfer.store-path", NULL);
+  if (path == NULL) {
+    path = cmd->arg;
+  }
+
+  if (path != NULL &&
+      *path != '\0') {
+    filecache_invalidate(cmd->tmp_pool, path);
+  }
+
+  return PR_DECLINED(cmd);
+}
+
+/* Event handlers
+ */
+
+#if defined(PR_SHARED_MODULE)
+static void filecache_mod_unload_ev(const void *event_data, void *user_data) {
+  if (strcmp("mod_filecache.c", (const char *) event_data) == 0) {
+# ifdef PR_USE_CTRLS
+    register unsigned int i;
+
+    for (i = 0; filecache_acttab[i].act_action; i++) {
+      (void) pr_ctrls_unregister(&filecache_module,
+        filecache_acttab[i].act_action);
+    }
+# endif /* PR_USE_CTRLS */
+
+    pr_event_unregister(&filecache_module, NULL, NULL);
+    filecache_remove_shm();
+
+    if (filecache_pool != NULL) {
+      destroy_pool(filecache_pool);
+      filecache_pool = NULL;
+    }
+  }
+}
+#endif /* PR_SHARED_MODULE */
+
+static void filecache_postparse_ev(const void *event_data, void *user_data) {
+  struct filecache_data *data;
+  int xerrno;
+
+  if (filecache_table == NULL) {
+    return;
+  }
+
+  if (filecache_tabfh == NULL) {
+    PRIVS_ROOT
+    filecache_tabfh = pr_fsio_open(filecache_table, O_RDWR|O_CREAT);
+    xerrno = errno;
+    PRIVS_RELINQUISH
+
+    if (filecache_tabfh == NULL) {
+      pr_log_pri(PR_LOG_WARNING, MOD_FILECACHE_VERSION
+        ": unable to open FileCacheTable '%s': %s", filecache_table,
+        strerror(xerrno));
+      return;
+    }
+
+    if (filecache_tabfh->fh_fd <= STDERR_FILENO) {
+      int usable_fd;
+
+      usable_fd = pr_fs_get_usable_fd(filecache_tabfh->fh_fd);
+      if (usable_fd >= 0) {
+        (void) close(filecache_tabfh->fh_fd);
+        filecache_tabfh->fh_fd = usable_fd;
+      }
+    }
+  }
+
+  data = filecache_get_shm(filecache_tabfh);
+  if (data == NULL) {
+    if (errno != EEXIST) {
+      pr_log_pri(PR_LOG_WARNING, MOD_FILECACHE_VERSION
+        ": unable to get shared memory for FileCacheTable '%s': %s",
+        filecache_table, strerror(errno));
+    }
+
+    return;
+  }
+
+  filecache_data = data;
+  filecache_set_ptrs();
+}
+
+static void filecache_restart_ev(const void *event_data, void *user_data) {
+#ifdef PR_USE_CTRLS
+  register unsigned int i;
+#endif /* PR_USE_CTRLS */
+
+  if (filecache_pool != NULL) {
+    destroy_pool(filecache_pool);
+  }
+
+  filecache_pool = make_sub_pool(permanent_pool);
+  pr_pool_tag(filecache_pool, MOD_FILECACHE_VERSION);
+
+#ifdef PR_USE_CTRLS
+  for (i = 0; filecache_acttab[i].act_action; i++) {
+    filecache_acttab[i].act_acl = pcalloc(filecache_pool, sizeof(ctrls_acl_t));
+    pr_ctrls_init_acl(filecache_acttab[i].act_acl);
+  }
+#endif /* PR_USE_CTRLS */
+
+  /* The configuration is about to be re-read; the shm is kept, along with
+   * its contents.
+   */
+  filecache_table = NULL;
+  filecache_size = FILECACHE_DEFAULT_SIZE;
+  filecache_max_filesz = FILECACHE_DEFAULT_MAX_FILESZ;
+}
+
+static void filecache_shutdown_ev(const void *event_data, void *user_data) {
+  if (mpid == getpid() &&
+      ServerType == SERVER_STANDALONE) {
+    filecache_remove_shm();
+  }
+}
+
+/* Initialization functions
+ */
+
+static int filecache_init(void) {
+#ifdef PR_USE_CTRLS
+  register unsigned int i;
+#endif /* PR_USE_CTRLS */
+
+  filecache_pool = make_sub_pool(permanent_pool);
+  pr_pool_tag(filecache_pool, MOD_FILECACHE_VERSION);
+
+#ifdef PR_USE_CTRLS
+  for (i = 0; filecache_acttab[i].act_action; i++) {
+    filecache_acttab[i].act_acl = pcalloc(filecache_pool, sizeof(ctrls_acl_t));
+    pr_ctrls_init_acl(filecache_acttab[i].act_acl);
+
+    if (pr_ctrls_register(&filecache_module, filecache_acttab[i].act_action,
+        filecache_acttab[i].act_desc, filecache_acttab[i].act_cb) < 0) {
+      pr_log_pri(PR_LOG_NOTICE, MOD_FILECACHE_VERSION
+        ": error registering '%s' control: %s",
+        filecache_acttab[i].act_action, strerror(errno));
+    }
+  }
+#endif /* PR_USE_CTRLS */
+
+#if defined(PR_SHARED_MODULE)
+  pr_event_register(&filecache_module, "core.module-unload",
+    filecache_mod_unload_ev, NULL);
+#endif /* PR_SHARED_MODULE */
+  pr_event_register(&filecache_module, "core.postparse",
+    filecache_postparse_ev, NULL);
+  pr_event_register(&filecache_module, "core.restart",
+    filecache_restart_ev, NULL);
+  pr_event_register(&filecache_module, "core.shutdown",
+    filecache_shutdown_ev, NULL);
+
+  return 0;
+}
+
+static int filecache_sess_init(void) {
+  config_rec *c;
+
+  pr_event_unregister(&filecache_module, "core.restart", NULL);
+
+  c = find_config(main_server->conf, CONF_PARAM, "FileCacheEngine", FALSE);
+  if (c != NULL) {
+    filecache_engine = *((int *) c->argv[0]);
+  }
+
+  if (filecache_engine == TRUE &&
+      filecache_data == NULL) {
+    pr_log_debug(DEBUG3, MOD_FILECACHE_VERSION
+      ": FileCacheEngine enabled, but no cache available (missing "
+      "FileCacheTable?)");
+    filecache_engine = FALSE;
+  }
+
+  return 0;
+}
+
+#ifdef PR_USE_CTRLS
+/* Controls table
+ */
+
+static ctrls_acttab_t filecache_acttab[] = {
+  { "filecache", "show information about, or clear, the file cache", NULL,
+    filecache_handle_filecache },
+  { NULL, NULL, NULL, NULL }
+};
+#endif /* PR_USE_CTRLS */
+
+/* Module API tables
+ */
+
+static conftable filecache_conftab[] = {
+#ifdef PR_USE_CTRLS
+  { "FileCacheControlsACLs",	set_filecachectrlsacls,		NULL },
+#endif /* PR_USE_CTRLS */
+  { "FileCacheEngine",		set_filecacheengine,		NULL },
+  { "FileCacheMaxFileSize",	set_filecachemaxfilesize,	NULL },
+  { "FileCacheSize",		set_filecachesize,		NULL },
+  { "FileCacheTable",		set_filecachetable,		NULL },
+  { NULL }
+};
+
+static cmdtable filecache_cmdtab[] = {
+  { PRE_CMD,	C_APPE,	G_NONE,	filecache_pre_write,	FALSE,	FALSE },
+  { PRE_CMD,	C_DELE,	G_NONE,	filecache_pre_write,	FALSE,	FALSE },
+  { PRE_CMD,	C_RNTO,	G_NONE,	filecache_pre_write,	FALSE,	FALSE },
+  { PRE_CMD,	C_STOR,	G_NONE,	filecache_pre_write,	FALSE,	FALSE },
+  { POST_CMD,	C_APPE,	G_NONE,	filecache_post_write,	FALSE,	FALSE },
+  { POST_CMD,	C_STOR,	G_NONE,	filecache_post_write,	FALSE,	FALSE },
+  { HOOK,	"filecache_get", G_NONE, filecache_get_hook,	FALSE,	FALSE },
+  { 0, NULL }
+};
+
+module filecache_module = {
+  NULL, NULL,
+
+  /* Module API version 2.0 */
+  0x20,
+
+  /* Module name */
+  "filecache",
+
+  /* Module configuration handler table */
+  filecache_conftab,
+
+  /* Module command handler table */
+  filecache_cmdtab,
+
+  /* Module authentication handler table */
+  NULL,
+
+  /* Module initialization function */
+  filecache_init,
+
+  /* Session initialization function */
+  filecache_sess_init,
+
+  /* Module version */
+  MOD_FILECACHE_VERSION
+};
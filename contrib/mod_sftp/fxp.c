@@ -220,6 +220,11 @@ struct fxp_handle {
    */
   size_t fh_bytes_xferred;
 
+  /* For files opened for reading, whose contents were provided by a cache
+   * (e.g. mod_filecache); READ requests are then served from this buffer.
+   */
+  pr_buffer_t *fh_cache;
+
   void *dirh;
   const char *dir;
 };
@@ -2901,6 +2906,33 @@ static int fxp_handle_add(uint32_t channel_id, struct fxp_handle *fxh) {
   return res;
 }
 
+/* Looks up the given file, just opened for reading, in the cache provided
+ * by e.g. mod_filecache, if any.  Returns a buffer holding the entire file,
+ * or NULL if the file is to be read as usual.
+ */
+static pr_buffer_t *fxp_get_cached(pool *p, pr_fh_t *fh) {
+  cmdtable *cmdtab;
+  cmd_rec *cmd;
+  modret_t *res;
+
+  cmdtab = pr_stash_get_symbol2(PR_SYM_HOOK, "filecache_get", NULL, NULL,
+    NULL);
+  if (cmdtab == NULL) {
+    return NULL;
+  }
+
+  cmd = pr_cmd_alloc(p, 1, fh);
+  res = pr_module_call(cmdtab->m, cmdtab->handler, cmd);
+  if (MODRET_ISHANDLED(res) &&
+      MODRET_HASDATA(res)) {
+    pr_trace_msg(trace_channel, 9, "serving '%s' (%lu bytes) from cache",
+      fh->fh_path, ((pr_buffer_t *) res->data)->buflen);
+    return res->data;
+  }
+
+  return NULL;
+}
+
 static struct fxp_handle *fxp_handle_create(pool *p) {
   unsigned char *data;
   char *handle;
@@ -9371,6 +9403,11 @@ static int fxp_handle_open(struct fxp_packet *fxp) {
   fxh->fh_existed = file_existed;
   memcpy(fxh->fh_st, &st, sizeof(struct stat));
 
+  if (open_flags == O_RDONLY &&
+      S_ISREG(st.st_mode)) {
+    fxh->fh_cache = fxp_get_cached(fxh->pool, fh);
+  }
+
   if (hiddenstore_path) {
     fxh->fh_real_path = pstrdup(fxh->pool, path);
   }
@@ -9995,7 +10032,8 @@ static int fxp_handle_read(struct fxp_packet *fxp) {
   }
 
   if (S_ISREG(fxh->fh_st->st_mode)) {
-    if (pr_fsio_lseek(fxh->fh, offset, SEEK_SET) < 0) {
+    if (fxh->fh_cache == NULL &&
+        pr_fsio_lseek(fxh->fh, offset, SEEK_SET) < 0) {
       uint32_t status_code;
       const char *reason;
       int xerrno = errno;
@@ -10042,7 +10080,21 @@ static int fxp_handle_read(struct fxp_packet *fxp) {
     data = palloc(fxp->pool, datalen);
   }
 
-  res = pr_fsio_read(fxh->fh, (char *) data, datalen);
+  if (fxh->fh_cache != NULL) {
+    res = 0;
+
+    if ((off_t) offset < (off_t) fxh->fh_cache->buflen) {
+      res = fxh->fh_cache->buflen - offset;
+      if ((uint32_t) res > datalen) {
+        res = datalen;
+      }
+
+      memcpy(data, fxh->fh_cache->buf + offset, res);
+    }
+
+  } else {
+    res = pr_fsio_read(fxh->fh, (char *) data, datalen);
+  }
 
   if (pr_data_get_timeout(PR_DATA_TIMEOUT_NO_TRANSFER) > 0) {
     pr_timer_reset(PR_TIMER_NOXFER, ANY_MODULE);
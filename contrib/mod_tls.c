@@ -521,6 +521,7 @@ static unsigned char *tls_authenticated = NULL;
 #define TLS_OPT_VERIFY_CERT_CN				0x0800
 #define TLS_OPT_NO_AUTO_ECDH				0x1000
 #define TLS_OPT_ALLOW_WEAK_DH				0x2000
+#define TLS_OPT_ENABLE_KTLS				0x4000
 
 /* mod_tls SSCN modes */
 #define TLS_SSCN_MODE_SERVER				0
@@ -577,6 +578,20 @@ static unsigned char tls_renegotiate_required = TRUE;
 
 #define TLS_NETIO_NOTE		"mod_tls.SSL"
 
+/* Set on the data write/read streams when the kernel is doing the TLS
+ * encryption/decryption of that stream (kTLS), such that e.g. sendfile(2)
+ * or splice(2) can be used on it.
+ */
+#define TLS_KTLS_SEND_NOTE	"mod_tls.ktls-send"
+#define TLS_KTLS_RECV_NOTE	"mod_tls.ktls-recv"
+
+/* Number of protected data transfers, and how many of those had their
+ * encryption/decryption offloaded to the kernel, for this session.
+ */
+static unsigned int tls_data_xfer_count = 0;
+static unsigned int tls_data_ktls_send_count = 0;
+static unsigned int tls_data_ktls_recv_count = 0;
+
 static pr_netio_t *tls_ctrl_netio = NULL;
 static pr_netio_stream_t *tls_ctrl_rd_nstrm = NULL;
 static pr_netio_stream_t *tls_ctrl_wr_nstrm = NULL;
@@ -7195,6 +7210,94 @@ static int tls_compare_session_ids(SSL_SESSION *ctrl_sess,
   return res;
 }
 
+/* Ask OpenSSL to hand the record encryption for a data connection over to
+ * the kernel (kTLS), if the EnableKTLS TLSOption is in effect.  Whether the
+ * kernel actually takes it (depending on the kernel, and on the negotiated
+ * protocol version and cipher) is only known once the handshake completes.
+ */
+static void tls_data_enable_ktls(SSL *ssl) {
+#if defined(SSL_OP_ENABLE_KTLS)
+  if (!(tls_opts & TLS_OPT_ENABLE_KTLS)) {
+    return;
+  }
+
+  /* The kernel cannot rekey the connection for us, so renegotiations would
+   * fail on a kTLS connection.
+   */
+  if (tls_opts & TLS_OPT_ALLOW_CLIENT_RENEGOTIATIONS) {
+    pr_trace_msg(trace_channel, 9, "%s",
+      "AllowClientRenegotiations TLSOption in effect, not using kTLS for "
+      "data connection");
+    return;
+  }
+
+  SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+#endif /* SSL_OP_ENABLE_KTLS */
+}
+
+/* Note whether the kernel is encrypting/decrypting the data streams, for the
+ * benefit of e.g. mod_xfer.
+ */
+static void tls_data_note_ktls(pr_netio_stream_t *nstrm) {
+  SSL *ssl;
+#if defined(SSL_OP_ENABLE_KTLS)
+  int ktls_send = FALSE, ktls_recv = FALSE;
+#endif /* SSL_OP_ENABLE_KTLS */
+
+  tls_data_xfer_count++;
+
+  ssl = (SSL *) pr_table_get(nstrm->notes, TLS_NETIO_NOTE, NULL);
+  if (ssl == NULL) {
+    return;
+  }
+
+#if defined(SSL_OP_ENABLE_KTLS)
+  if (BIO_get_ktls_send(SSL_get_wbio(ssl)) > 0) {
+    if (pr_table_add(tls_data_wr_nstrm->notes,
+        pstrdup(tls_data_wr_nstrm->strm_pool, TLS_KTLS_SEND_NOTE), "true",
+        0) < 0) {
+      if (errno != EEXIST) {
+        tls_log("error stashing '%s' note on data write stream: %s",
+          TLS_KTLS_SEND_NOTE, strerror(errno));
+      }
+
+    } else {
+      ktls_send = TRUE;
+      tls_data_ktls_send_count++;
+    }
+  }
+
+  if (BIO_get_ktls_recv(SSL_get_rbio(ssl)) > 0) {
+    if (pr_table_add(tls_data_rd_nstrm->notes,
+        pstrdup(tls_data_rd_nstrm->strm_pool, TLS_KTLS_RECV_NOTE), "true",
+        0) < 0) {
+      if (errno != EEXIST) {
+        tls_log("error stashing '%s' note on data read stream: %s",
+          TLS_KTLS_RECV_NOTE, strerror(errno));
+      }
+
+    } else {
+      ktls_recv = TRUE;
+      tls_data_ktls_recv_count++;
+    }
+  }
+
+  if (tls_opts & TLS_OPT_ENABLE_KTLS) {
+    if (ktls_send == TRUE ||
+        ktls_recv == TRUE) {
+      tls_log("using kTLS (%s%s%s) for data connection (%s, %s)",
+        ktls_send ? "send" : "", ktls_send && ktls_recv ? ", " : "",
+        ktls_recv ? "receive" : "", SSL_get_version(ssl),
+        SSL_get_cipher_name(ssl));
+
+    } else {
+      tls_log("kTLS not available for data connection (%s, %s), using "
+        "OpenSSL", SSL_get_version(ssl), SSL_get_cipher_name(ssl));
+    }
+  }
+#endif /* SSL_OP_ENABLE_KTLS */
+}
+
 static int tls_accept(conn_t *conn, unsigned char on_data) {
   static unsigned char logged_data = FALSE;
   int blocking, res = 0, xerrno = 0;
@@ -7260,6 +7363,8 @@ static int tls_accept(conn_t *conn, unsigned char on_data) {
         "error disabling TCP_CORK on data conn: %s", strerror(errno));
     }
 
+    tls_data_enable_ktls(ssl);
+
     cache_mode = SSL_CTX_get_session_cache_mode(ssl_ctx);
     if (cache_mode != SSL_SESS_CACHE_OFF) {
       /* Disable STORING of any new session IDs in the session cache. We DO
@@ -7825,6 +7930,9 @@ static int tls_connect(conn_t *conn) {
    */
   SSL_set_verify(ssl, SSL_VERIFY_NONE, NULL);
 
+  /* tls_connect() is only used for data connections, in SSCN client mode. */
+  tls_data_enable_ktls(ssl);
+
   /* This works with either rfd or wfd (I hope). */
   rbio = BIO_new_socket(conn->rfd, FALSE);
   wbio = BIO_new_socket(conn->rfd, FALSE);
@@ -11222,6 +11330,10 @@ static int tls_netio_close_cb(pr_netio_stream_t *nstrm) {
       tls_end_sess(ssl, session.d, 0);
       pr_table_remove(tls_data_rd_nstrm->notes, TLS_NETIO_NOTE, NULL);
       pr_table_remove(tls_data_wr_nstrm->notes, TLS_NETIO_NOTE, NULL);
+      (void) pr_table_remove(tls_data_wr_nstrm->notes, TLS_KTLS_SEND_NOTE,
+        NULL);
+      (void) pr_table_remove(tls_data_rd_nstrm->notes, TLS_KTLS_RECV_NOTE,
+        NULL);
       tls_data_netio = NULL;
       tls_flags &= ~TLS_SESS_ON_DATA;
     }
@@ -11408,6 +11520,8 @@ static int tls_netio_postopen_cb(pr_netio_stream_t *nstrm) {
         }
      }
 
+      tls_data_note_ktls(nstrm);
+
 #if OPENSSL_VERSION_NUMBER < 0x0090702fL
       /* Make sure blinding is turned on. (For some reason, this only seems
        * to be allowed on SSL objects, not on SSL_CTX objects.  Bummer).
@@ -11641,6 +11755,49 @@ static int tls_netio_write_cb(pr_netio_stream_t *nstrm, char *buf,
   return write(nstrm->strm_fd, buf, buflen);
 }
 
+/* The largest amount of plaintext carried in a single TLS record. */
+#if defined(SSL3_RT_MAX_PLAIN_LENGTH)
+# define TLS_NETIO_RECORD_SIZE		SSL3_RT_MAX_PLAIN_LENGTH
+#else
+# define TLS_NETIO_RECORD_SIZE		16384
+#endif
+
+static int tls_netio_writev_cb(pr_netio_stream_t *nstrm,
+    const struct iovec *iov, int iovcnt) {
+  static char buf[TLS_NETIO_RECORD_SIZE];
+  register int i;
+  size_t buflen = 0;
+  SSL *ssl;
+
+  ssl = (SSL *) pr_table_get(nstrm->notes, TLS_NETIO_NOTE, NULL);
+  if (ssl == NULL) {
+    return writev(nstrm->strm_fd, iov, iovcnt);
+  }
+
+  /* Each SSL_write() emits at least one record, so rather than writing
+   * each vector on its own, e.g. each short line of a response, coalesce
+   * the vectors into full records.  A vector that fills a record by itself
+   * is written as is.
+   */
+  if (iov[0].iov_len >= sizeof(buf)) {
+    return tls_netio_write_cb(nstrm, iov[0].iov_base, iov[0].iov_len);
+  }
+
+  for (i = 0; i < iovcnt && buflen < sizeof(buf); i++) {
+    size_t len;
+
+    len = iov[i].iov_len;
+    if (len > sizeof(buf) - buflen) {
+      len = sizeof(buf) - buflen;
+    }
+
+    memcpy(buf + buflen, iov[i].iov_base, len);
+    buflen += len;
+  }
+
+  return tls_netio_write_cb(nstrm, buf, buflen);
+}
+
 static void tls_netio_install_ctrl(void) {
   pr_netio_t *netio;
 
@@ -11662,6 +11819,7 @@ static void tls_netio_install_ctrl(void) {
   netio->reopen = tls_netio_reopen_cb;
   netio->shutdown = tls_netio_shutdown_cb;
   netio->write = tls_netio_write_cb;
+  netio->writev = tls_netio_writev_cb;
 
   pr_unregister_netio(PR_NETIO_STRM_CTRL);
 
@@ -11685,6 +11843,7 @@ static void tls_netio_install_data(void) {
   netio->reopen = tls_netio_reopen_cb;
   netio->shutdown = tls_netio_shutdown_cb;
   netio->write = tls_netio_write_cb;
+  netio->writev = tls_netio_writev_cb;
 
   pr_unregister_netio(PR_NETIO_STRM_DATA);
 
@@ -13276,6 +13435,13 @@ MODRET set_tlsoptions(cmd_rec *cmd) {
     } else if (strcmp(cmd->argv[i], "EnableDiags") == 0) {
       opts |= TLS_OPT_ENABLE_DIAGS;
 
+    } else if (strcmp(cmd->argv[i], "EnableKTLS") == 0) {
+#if defined(SSL_OP_ENABLE_KTLS)
+      opts |= TLS_OPT_ENABLE_KTLS;
+#else
+      pr_log_pri(PR_LOG_NOTICE, MOD_TLS_VERSION ": TLSOption EnableKTLS not supported (OpenSSL version is too old, or lacks kTLS support)");
+#endif /* SSL_OP_ENABLE_KTLS */
+
     } else if (strcmp(cmd->argv[i], "ExportCertData") == 0) {
       opts |= TLS_OPT_EXPORT_CERT_DATA;
 
@@ -14535,6 +14701,14 @@ static void tls_exit_ev(const void *event_data, void *user_data) {
     tls_log("[stat]: SSL/TLS session cache size exceeded: %ld", res);
   }
 
+  if (tls_opts & TLS_OPT_ENABLE_KTLS) {
+    tls_log("[stat]: data transfers protected: %u", tls_data_xfer_count);
+    tls_log("[stat]: data transfers offloaded to kTLS (send): %u",
+      tls_data_ktls_send_count);
+    tls_log("[stat]: data transfers offloaded to kTLS (receive): %u",
+      tls_data_ktls_recv_count);
+  }
+
   if (tls_pkey != NULL) {
     tls_scrub_pkey(tls_pkey);
     tls_pkey = NULL;
@@ -60,4 +60,16 @@ int pr_ascii_ftp_from_crlf(pool *p, char *in, size_t inlen, char **out,
 int pr_ascii_ftp_to_crlf(pool *p, char *in, size_t inlen, char **out,
   size_t *outlen);
 
+/* Like pr_ascii_ftp_to_crlf(), except that the translated data is written
+ * into the caller-provided `out' buffer, of `outsz' bytes, rather than into
+ * memory allocated for each call; `out' must not overlap `in'.  Callers
+ * translating many buffers, e.g. for a transfer, can thus reuse a single
+ * buffer; if `outsz' is at least twice `inlen', the data will always fit.
+ *
+ * Returns the number of CRs added on success, and -1 on error, setting
+ * errno appropriately (E2BIG if the translated data would not fit).
+ */
+int pr_ascii_ftp_to_crlf2(const char *in, size_t inlen, char *out,
+  size_t outsz, size_t *outlen);
+
 #endif /* PR_ASCII_H */
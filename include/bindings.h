@@ -104,7 +104,9 @@ int pr_ipbind_close(const pr_netaddr_t *addr, unsigned int port,
   unsigned char close_namebinds);
 
 /* Close all listenings fds.  This needs to happen just after a process
- * has been forked to handle a session.
+ * has been forked to handle a session.  In a session process, the listening
+ * conns themselves are not modified, so that their memory stays shared with
+ * the daemon.
  */
 int pr_ipbind_close_listeners(void);
 
@@ -138,6 +140,13 @@ server_rec *pr_ipbind_get_server(const pr_netaddr_t *addr, unsigned int port);
  */
 int pr_ipbind_listen(fd_set *readfds);
 
+/* Prepares each active listening connection for accepting connections, and
+ * registers it with the daemon's I/O loop (see ioloop.h).  The work is only
+ * redone when the bindings have changed since the previous call.  Returns
+ * the number of listening connections.
+ */
+int pr_ipbind_watch_listeners(void);
+
 /* Prepares the IP-based binding associated with the given server for listening.
  * Returns 0 on success, -1 on failure.
  */
@@ -148,6 +157,39 @@ int pr_ipbind_open(const pr_netaddr_t *addr, unsigned int port,
 conn_t *pr_ipbind_get_listening_conn(server_rec *server,
   const pr_netaddr_t *addr, unsigned int port);
 
+/* Replaces the socket of each listening connection which is not yet
+ * listening with a freshly created socket, bound to the same address and
+ * port, keeping the same descriptor number.  Used by listener shards, so
+ * that each shard has its own SO_REUSEPORT socket, rather than sharing the
+ * one inherited from the daemon.  Returns the number of sockets replaced,
+ * or -1 on error.
+ */
+int pr_ipbind_reopen_listeners(void);
+
+/* Registers the nfds listening sockets, starting at descriptor fd, which
+ * were inherited from a previous daemon process (see upgrade_daemon()).  A
+ * binding for the same address and port uses the inherited socket, rather
+ * than opening a new one.  Descriptors which are not stream sockets are
+ * closed.  Returns the number of sockets registered, or -1 on error.
+ */
+int pr_ipbind_inherit_fds(int fd, int nfds);
+
+/* Closes any inherited listening sockets which were not claimed by a
+ * binding, once the bindings are initialized.  Returns the number of
+ * sockets closed.
+ */
+int pr_ipbind_close_inherited_fds(void);
+
+/* Returns an array of the descriptors of all of the listening sockets, for
+ * handing off to a new daemon process.
+ */
+array_header *pr_ipbind_get_listening_fds(pool *p);
+
+/* Stops the daemon's I/O loop from watching any of the listening
+ * connections.  Returns the number of listening connections.
+ */
+int pr_ipbind_unwatch_listeners(void);
+
 /* Close the pr_namebind_t with the given name. */
 int pr_namebind_close(const char *name, const pr_netaddr_t *addr);
 
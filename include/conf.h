@@ -79,6 +79,8 @@
 #include "timers.h"
 #include "inet.h"
 #include "child.h"
+#include "prefork.h"
+#include "ioloop.h"
 #include "netaddr.h"
 #include "netacl.h"
 #include "class.h"
@@ -40,6 +40,15 @@ int pr_data_open(char *, char *, int, off_t);
 void pr_data_close(int);
 void pr_data_abort(int, int);
 int pr_data_xfer(char *, size_t);
+
+/* Writes the data in the given vectors to the data connection, in order,
+ * e.g. a buffer of listing output and the line which did not fit into it.
+ * Unless ASCII translation applies, the vectors are written as they are,
+ * using pr_netio_writev(), rather than copied into the transfer buffer;
+ * otherwise each is passed to pr_data_xfer().  Returns the number of bytes
+ * written, or -1 on error.
+ */
+int pr_data_xferv(const struct iovec *, int);
 void pr_data_reset(void);
 void pr_data_set_linger(long);
 
@@ -73,4 +82,13 @@ typedef ssize_t pr_sendfile_t;
 
 pr_sendfile_t pr_data_sendfile(int retr_fd, off_t *offset, off_t count);
 
+/* Moves up to count bytes of uploaded data from the data connection directly
+ * into the given file (e.g. using splice(2)), bypassing any ASCII translation
+ * and NetIO processing.  A data NetIO is only bypassed when the kernel does
+ * its work, i.e. when mod_tls has noted kTLS receive on the stream.  Returns
+ * the number of bytes moved, 0 at the end of the data, or -1 on error; ENOSYS
+ * means that pr_data_xfer() must be used.
+ */
+int pr_data_splice(int stor_fd, size_t count);
+
 #endif /* PR_DATA_H */
@@ -80,6 +80,31 @@ void pr_event_generate(const char *event, const void *event_data);
  */
 int pr_event_listening(const char *event);
 
+/* Returns the ID for the given event name, interning the name if needed,
+ * or -1 (with errno set appropriately) if there was an error.  Event IDs
+ * are never zero, and remain valid for the life of the process; callers
+ * which generate an event frequently can look up its ID once, and use
+ * pr_event_generate_id() and PR_EVENT_LISTENING() thereafter.
+ */
+int pr_event_get_id(const char *event);
+
+/* Generate the event with the given ID, as returned by pr_event_get_id(). */
+void pr_event_generate_id(int event_id, const void *event_data);
+
+/* The number of registered listeners, indexed by event ID.  Use the
+ * PR_EVENT_LISTENING() macro, rather than these directly.
+ */
+extern unsigned int *pr_event_listeners;
+extern unsigned int pr_event_max_id;
+
+/* Evaluates to the number of registered listeners for the given event ID.
+ * This is cheap enough that callers can check it before building the
+ * event-specific data, and skip doing so when no one is listening.
+ */
+#define PR_EVENT_LISTENING(id) \
+  ((unsigned int) (id) <= pr_event_max_id ? \
+    pr_event_listeners[(id)] : 0)
+
 /* Dump Events information. */
 void pr_event_dump(void (*)(const char *, ...));
 
@@ -228,6 +228,9 @@ struct fh_rec {
 
   /* Hint of the optimal buffer size for IO on this file. */
   size_t fh_iosz;
+
+  /* Adaptive read-ahead state, if enabled via pr_fsio_set_readahead(). */
+  struct fh_readahead_rec *fh_readahead;
 };
 
 /* Maximum symlink count, for loop detection. */
@@ -437,6 +440,11 @@ void pr_resolve_fs_map(void);
 /* Close all but the main three fds. */
 void pr_fs_close_extra_fds(void);
 
+/* Close all fds from lowfd on, leaving the main three fds, and any fds
+ * between them and lowfd (e.g. inherited listening sockets) open.
+ */
+void pr_fs_close_extra_fds2(int lowfd);
+
 /* The main three fds (stdin, stdout, stderr) need to be protected, reserved
  * for use.  This function uses dup(2) to open new fds on the given fd
  * until the new fd is not one of the big three.
@@ -486,6 +494,33 @@ void pr_fs_fadvise(int fd, off_t offset, off_t len, int advice);
 #define PR_FS_FADVISE_DONTNEED		14
 #define PR_FS_FADVISE_NOREUSE		15
 
+/* Enable adaptive read-ahead for the given handle, for files which are read
+ * (or sent, e.g. using sendfile(2)) sequentially.  The caller reports each
+ * range of the file it has consumed using pr_fsio_readahead().  While the
+ * accesses are sequential, the platform is advised to read ahead of the
+ * current offset, using a window which starts at min_window bytes and
+ * doubles up to max_window bytes; a non-sequential access resets the window.
+ *
+ * With PR_FSIO_READAHEAD_FL_DROP_BEHIND, the pages which have already been
+ * consumed (keeping one window's worth) are dropped from the page cache, so
+ * that reading one large file does not evict other cached data.  A
+ * min_window of zero disables read-ahead for the handle.
+ */
+int pr_fsio_set_readahead(pr_fh_t *fh, off_t min_window, off_t max_window,
+  int flags);
+#define PR_FSIO_READAHEAD_FL_DROP_BEHIND	0x0001
+
+void pr_fsio_readahead(pr_fh_t *fh, off_t offset, off_t len);
+
+/* Enable (or disable) direct I/O, i.e. bypassing the page cache, on the
+ * given file descriptor.  Direct I/O generally requires that the offset,
+ * length, and memory address of each read be aligned, e.g. to the block
+ * size of the device.  Returns -1, with errno set to ENOSYS, on platforms
+ * without direct I/O, or with EINVAL, for filesystems which do not
+ * support it.
+ */
+int pr_fs_set_direct_io(int fd, int use_direct);
+
 /* For internal use only. */
 int init_fs(void);
 
@@ -145,6 +145,13 @@ void pr_inet_close(pool *, conn_t *);
 void pr_inet_lingering_abort(pool *, conn_t *, long);
 void pr_inet_lingering_close(pool *, conn_t *, long);
 int pr_inet_set_default_family(pool *, int);
+
+/* Sets whether SO_REUSEPORT is used for sockets created by the daemon
+ * process, returning the previous setting.  Returns -1, with errno set to
+ * ENOSYS, if the platform does not support SO_REUSEPORT.
+ */
+int pr_inet_set_reuse_port(int reuse_port);
+
 int pr_inet_set_async(pool *, conn_t *);
 int pr_inet_set_block(pool *, conn_t *);
 int pr_inet_set_nonblock(pool *, conn_t *);
@@ -158,6 +165,14 @@ int pr_inet_listen(pool *p, conn_t *conn, int backlog, int flags);
 
 int pr_inet_resetlisten(pool *, conn_t *);
 int pr_inet_accept_nowait(pool *, conn_t *);
+
+/* Accepts up to nfds pending connections on the given listening conn,
+ * which should be in nonblocking mode, storing the new sockets (which are
+ * in blocking mode) in fds.  Returns the number of connections accepted,
+ * or -1 if no connection could be accepted due to an error.  Note that
+ * EAGAIN/EWOULDBLOCK are not errors here; zero is returned in that case.
+ */
+int pr_inet_accept_batch(pool *p, conn_t *c, int *fds, unsigned int nfds);
 int pr_inet_connect(pool *, conn_t *, const pr_netaddr_t *, int);
 int pr_inet_connect_nowait(pool *, conn_t *, const pr_netaddr_t *, int);
 int pr_inet_get_conn_info(conn_t *, int);
@@ -167,6 +182,10 @@ conn_t *pr_inet_openrw(pool *, conn_t *, const pr_netaddr_t *, int, int, int,
 int pr_inet_generate_socket_event(const char *, server_rec *,
   const pr_netaddr_t *, int);
 
+/* Descriptor passing over Unix domain sockets. */
+int pr_inet_send_fd(int sockfd, int fd, const void *data, size_t datasz);
+int pr_inet_recv_fd(int sockfd, int *fd, void *data, size_t datasz);
+
 void init_inet(void);
 
 #endif /* PR_INET_H */
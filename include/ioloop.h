@@ -0,0 +1,80 @@
+/*
+ * ProFTPD - FTP server daemon
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* Daemon I/O readiness loop */
+
+#ifndef PR_IOLOOP_H
+#define PR_IOLOOP_H
+
+/* The kinds of descriptors watched by the daemon. */
+#define PR_IOLOOP_TYPE_LISTENER		1
+#define PR_IOLOOP_TYPE_CHILD		2
+#define PR_IOLOOP_TYPE_UPGRADE		3
+
+typedef struct {
+  int fd;
+  int type;
+  void *data;
+} pr_ioloop_event_t;
+
+/* Creates the I/O loop, using epoll(7) where available, and poll(2)
+ * otherwise, including when an epoll instance cannot be created at
+ * runtime.  Calling this when the loop is already open is a no-op.
+ */
+int pr_ioloop_open(void);
+
+/* Closes the loop, discarding all registered descriptors.  Newly forked
+ * processes should call this, as they do not own the daemon's loop.
+ */
+void pr_ioloop_close(void);
+
+/* Watches the given descriptor for readability (including EOF and errors).
+ * The type and data are handed back, along with the descriptor, when the
+ * descriptor is ready.  Returns -1, with errno set to EEXIST, if the
+ * descriptor is already registered.
+ */
+int pr_ioloop_add_fd(int fd, int type, void *data);
+
+/* Stops watching the given descriptor.  This must be done before the
+ * descriptor is closed: another process may share the underlying file, and
+ * epoll(7) only forgets a file once every reference to it is gone.
+ */
+int pr_ioloop_remove_fd(int fd);
+
+/* Waits up to timeout milliseconds (or indefinitely, for a negative timeout)
+ * for any registered descriptor to become ready, filling in at most
+ * nevents events.  Returns the number of events, zero on timeout, or -1
+ * on error (errno is EINTR if interrupted by a signal).
+ */
+int pr_ioloop_wait(pr_ioloop_event_t *events, int nevents, int timeout);
+
+/* Returns the number of registered descriptors. */
+unsigned int pr_ioloop_get_count(void);
+
+/* Returns the name of the readiness mechanism in use by the open loop,
+ * e.g. "epoll".
+ */
+const char *pr_ioloop_get_backend(void);
+
+#endif /* PR_IOLOOP_H */
@@ -138,6 +138,11 @@ typedef struct {
   int (*shutdown)(pr_netio_stream_t *, int);
   int (*write)(pr_netio_stream_t *, char *, size_t);
 
+  /* Optional; if NULL, pr_netio_writev() coalesces the vectors and uses
+   * the write callback.
+   */
+  int (*writev)(pr_netio_stream_t *, const struct iovec *, int);
+
   /* Registering/owning module */
   module *owner;
   const char *owner_name;
@@ -206,8 +211,22 @@ char *pr_netio_telnet_gets(char *, size_t, pr_netio_stream_t *,
 int pr_netio_telnet_gets2(char *, size_t, pr_netio_stream_t *,
   pr_netio_stream_t *);
 
+/* Returns TRUE if a complete command line, e.g. from a client pipelining its
+ * commands, has already been read from the given stream and is waiting in
+ * the stream's buffer, FALSE otherwise.
+ */
+int pr_netio_telnet_pending(pr_netio_stream_t *);
+
 int pr_netio_write(pr_netio_stream_t *, char *, size_t);
 
+/* Writes all of the data in the given vectors, in order, as one logical
+ * write, e.g. a header and a body held in separate buffers, without first
+ * copying them into a single buffer.  NetIOs without a writev callback, or
+ * streams with write event listeners, see a single coalesced buffer instead.
+ * Returns the number of bytes written, or -1 (-2 if aborted) on error.
+ */
+int pr_netio_writev(pr_netio_stream_t *, const struct iovec *, int);
+
 /* This is a bit odd, because io_ functions are opaque, we can't be sure
  * we are dealing with a conn_t or that it is in O_NONBLOCK mode.  Trying
  * to do this without O_NONBLOCK would cause the kernel itself to block
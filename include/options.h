@@ -31,7 +31,7 @@
 
 /* Tunable parameters */
 
-/* This defines the timeout for the main select() loop, defines the number
+/* This defines the timeout for the daemon's main I/O loop, defines the number
  * of seconds to wait for a session request before checking for things such
  * as shutdown requests, perform signal dispatching, etc before waitinng
  * for requests again.
@@ -52,6 +52,20 @@
 # define PR_TUNABLE_DEFAULT_BACKLOG	128
 #endif /* PR_TUNABLE_DEFAULT_BACKLOG */
 
+/* The maximum number of pending connections which the daemon accepts, from
+ * a single listening socket, each time that socket becomes readable.
+ */
+#ifndef PR_TUNABLE_ACCEPT_BATCH_SIZE
+# define PR_TUNABLE_ACCEPT_BATCH_SIZE	32
+#endif /* PR_TUNABLE_ACCEPT_BATCH_SIZE */
+
+/* The maximum number of ready descriptors handled by the daemon for each
+ * wakeup of its main I/O loop.
+ */
+#ifndef PR_TUNABLE_IOLOOP_MAX_EVENTS
+# define PR_TUNABLE_IOLOOP_MAX_EVENTS	64
+#endif /* PR_TUNABLE_IOLOOP_MAX_EVENTS */
+
 /* The default TCP send/receive buffer sizes, should explicit sizes not
  * be defined at compile time, or should the runtime determination process
  * fail.
@@ -167,6 +181,15 @@
 # define PR_TUNABLE_NEW_POOL_SIZE	512
 #endif
 
+/* Maximum number of bytes of freed pool blocks each process keeps around
+ * for reuse by later pools.  Beyond this, freed blocks are handed back to
+ * the system allocator.  Zero means no limit.
+ */
+
+#ifndef PR_TUNABLE_POOL_MAX_FREE
+# define PR_TUNABLE_POOL_MAX_FREE	0
+#endif
+
 /* Number of bytes in certain scoreboard fields, usually for reporting
  * the full command received from the connected client, or the current
  * working directory for the session.
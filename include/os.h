@@ -143,6 +143,10 @@ char *strchr(),*strrchr();
 # include <sys/socket.h>
 #endif
 
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif
+
 #ifdef HAVE_NETDB_H
 # include <netdb.h>
 #endif
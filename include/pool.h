@@ -51,6 +51,20 @@ void *pcalloc(struct pool_rec *, size_t);
 void *pcallocsz(struct pool_rec *, size_t);
 void pr_pool_tag(struct pool_rec *, const char *);
 
+/* Hands the blocks kept on the free list, for reuse by later pools, back
+ * to the system allocator, e.g. when an idle session hibernates.  Returns
+ * the number of bytes released.
+ */
+unsigned long pr_pool_release_free_blocks(void);
+
+/* Sets the maximum number of bytes kept on the free list; when freeing a
+ * pool's blocks would exceed this, the largest free blocks are released
+ * until the free list is down to half of the maximum.  Zero means no limit,
+ * which is the default unless PR_TUNABLE_POOL_MAX_FREE says otherwise.
+ * Returns the previous maximum.
+ */
+size_t pr_pool_set_max_free(size_t max_free);
+
 #ifdef PR_USE_DEVEL
 void pr_pool_debug_memory(void (*)(const char *, ...));
 
@@ -0,0 +1,76 @@
+/*
+ * ProFTPD - FTP server daemon
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* Prefork session worker pool */
+
+#ifndef PR_PREFORK_H
+#define PR_PREFORK_H
+
+/* Default number of idle workers, if PreforkSpareWorkers is not used. */
+#ifndef PR_PREFORK_DEFAULT_MIN_SPARE
+# define PR_PREFORK_DEFAULT_MIN_SPARE		5
+#endif /* PR_PREFORK_DEFAULT_MIN_SPARE */
+
+#ifndef PR_PREFORK_DEFAULT_MAX_SPARE
+# define PR_PREFORK_DEFAULT_MAX_SPARE		20
+#endif /* PR_PREFORK_DEFAULT_MAX_SPARE */
+
+/* Maximum number of workers spawned by a single pr_prefork_maintain() call,
+ * so that the daemon process gets back to accepting connections quickly.
+ */
+#ifndef PR_PREFORK_SPAWN_BATCH
+# define PR_PREFORK_SPAWN_BATCH			8
+#endif /* PR_PREFORK_SPAWN_BATCH */
+
+/* Configures the bounds on the number of idle workers to keep, and the
+ * callback invoked, in the worker process, for the connection handed to
+ * that worker.  A max_spare of zero disables the pool, retiring any idle
+ * workers.
+ */
+int pr_prefork_set_workers(unsigned int min_spare, unsigned int max_spare,
+  void (*session_cb)(int, conn_t *));
+
+/* Hands the accepted connection, received on the given listening conn, off
+ * to an idle worker.  Returns -1, with errno set to ENOENT, if no idle worker
+ * was available; the caller still owns the descriptor in that case.
+ */
+int pr_prefork_dispatch(int fd, conn_t *listener);
+
+/* Grows or shrinks the set of idle workers, based on recently seen load.
+ * Called periodically by the daemon process.
+ */
+void pr_prefork_maintain(void);
+
+/* Retires all idle workers, e.g. when the configuration is reloaded. */
+void pr_prefork_retire(void);
+
+/* Returns the number of idle workers. */
+unsigned int pr_prefork_get_idle_count(void);
+
+/* For internal use only: closes the daemon's ends of the worker sockets,
+ * in a newly forked process.
+ */
+void pr_prefork_close_workers(void);
+
+#endif /* PR_PREFORK_H */
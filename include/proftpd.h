@@ -269,6 +269,7 @@ extern char ServerType;
 #define RECEIVED_SIG_EVENT	0x0100
 #define RECEIVED_SIG_CHLD	0x0200
 #define RECEIVED_SIG_ALRM	0x0400
+#define RECEIVED_SIG_UPGRADE	0x0800
 
 /* Timers */
 #define PR_TIMER_LOGIN		1
@@ -276,6 +277,7 @@ extern char ServerType;
 #define PR_TIMER_NOXFER		3
 #define PR_TIMER_STALLED	4
 #define PR_TIMER_SESSION	5
+#define PR_TIMER_HIBERNATE	6
 
 /* Developer code */
 
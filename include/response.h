@@ -57,6 +57,19 @@ int pr_response_block(int);
 void pr_response_clear(pr_response_t **);
 void pr_response_flush(pr_response_t **);
 
+/* Responses are written to the client in batches, e.g. so that responses to
+ * pipelined commands are sent together.  This function sends any responses
+ * still being held back; it is used before waiting on the client, e.g. for
+ * a data connection.  Returns the number of bytes written, or -1 on error.
+ */
+int pr_response_flush_pending(void);
+
+/* Frees the buffer in which responses are held back, e.g. when an idle
+ * session releases memory; it is allocated again when next needed.  Fails
+ * with EAGAIN if responses are still being held back.
+ */
+int pr_response_free_pending(void);
+
 /* Retrieves the response code and response message from the last response
  * sent/added for flushing to the client.  The strings for the values are
  * allocated out of the given pool.
@@ -140,6 +140,11 @@ int pr_restore_scoreboard(void);
 int pr_rewind_scoreboard(void);
 
 pid_t pr_scoreboard_get_daemon_pid(void);
+
+/* Records the given PID as that of the daemon in the open scoreboard, e.g.
+ * when a new daemon process takes over an existing scoreboard.
+ */
+int pr_scoreboard_set_daemon_pid(pid_t pid);
 time_t pr_scoreboard_get_daemon_uptime(void);
 int pr_scoreboard_scrub(void);
 
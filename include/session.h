@@ -117,6 +117,16 @@ void pr_session_send_banner(server_rec *, int);
  */
 int pr_session_set_idle(void);
 
+/* Returns the memory cached by an idle session process (the pool free list,
+ * the stat cache, the held-back responses buffer, the stash indexes, and any
+ * free heap pages) to the system, after generating the
+ * "core.session-hibernate" event so that modules may drop their own caches
+ * and buffers.  The session remains connected, and carries on as usual when its
+ * next command arrives.  Returns the number of bytes of pool memory
+ * released.
+ */
+unsigned long pr_session_hibernate(void);
+
 /* Sets the current protocol name. */
 int pr_session_set_protocol(const char *);
 
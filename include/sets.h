@@ -42,6 +42,19 @@ struct XAset {
   xasetmember_t *xas_list;
   struct pool_rec *pool;
   XASET_COMPARE xas_compare;
+
+  /* The last member of the list, so that appending with xaset_insert_end()
+   * need not walk the entire list.  Maintained by the xaset functions.
+   */
+  xasetmember_t *xas_last;
+
+  /* Bumped whenever a member is inserted into, or removed from, the set, so
+   * that lookup caches kept for the set (see xas_index) can tell when they
+   * are stale.  The xas_index pointer is for use by the owner of the set;
+   * the xaset functions only initialize it.
+   */
+  unsigned int xas_generation;
+  void *xas_index;
 };
 
 /* Prototypes */
@@ -52,4 +65,10 @@ int xaset_insert_end(xaset_t *, xasetmember_t *);
 int xaset_insert_sort(xaset_t *, xasetmember_t *, int);
 int xaset_remove(xaset_t *, xasetmember_t *);
 
+/* Returns the number of sets created so far.  Caches which depend on which
+ * sets exist, e.g. on which members have child sets, can use this to detect
+ * newly created sets.
+ */
+unsigned int xaset_get_generation(void);
+
 #endif /* PR_SETS_H */
@@ -51,6 +51,17 @@ int pr_stash_remove_cmd(const char *cmd_name, module *m,
 int pr_stash_remove_auth(const char *api_name, module *m);
 int pr_stash_remove_hook(const char *hook_name, module *m);
 
+/* Returns a counter which changes whenever a symbol is added to, or removed
+ * from, the stash.  Callers which cache the results of symbol lookups can
+ * use this to tell when those results are stale.
+ */
+unsigned int pr_stash_get_generation(void);
+
+/* Frees the indexes used for looking up symbols by name, e.g. when an idle
+ * session releases memory; each is rebuilt when next needed.
+ */
+void pr_stash_free_indexes(void);
+
 void pr_stash_dump(void (*)(const char *, ...));
 
 /* Internal use only */
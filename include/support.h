@@ -76,6 +76,7 @@ void schedule(void (*f)(void *, void *, void *, void *), int, void *, void *,
   void *, void *);
 void run_schedule(void);
 void restart_daemon(void *, void *, void *, void *);
+void upgrade_daemon(void *, void *, void *, void *);
 void shutdown_end_session(void *, void *, void *, void *);
 
 long get_name_max(char *path, int fd);
@@ -68,10 +68,19 @@ int pr_table_add_dup(pr_table_t *tab, const char *key_data,
 /* Allocates a new table from the given pool.  flags can be used to
  * determine the table behavior, e.g. will it allow multiple entries under
  * the same key (PR_TABLE_FL_MULTI_VALUE).
+ *
+ * PR_TABLE_FL_OPEN_ADDR selects open addressing: keys are stored in a single
+ * array of slots, probed in small groups, rather than in chains of separately
+ * allocated entries.  Such tables grow as needed (the number of chains given
+ * to pr_table_nalloc() being used as a hint for the initial number of slots),
+ * and are generally faster for small, frequently used tables.  The
+ * PR_TABLE_CTL_SET_ENT_INSERT and PR_TABLE_CTL_SET_ENT_REMOVE controls do not
+ * apply to them.
  */
 pr_table_t *pr_table_alloc(pool *p, int flags);
 #define PR_TABLE_FL_MULTI_VALUE		0x0001
 #define PR_TABLE_FL_USE_CACHE		0x0002
+#define PR_TABLE_FL_OPEN_ADDR		0x0004
 
 /* Returns the number of entries stored in the table.
  */
@@ -77,4 +77,9 @@ int pr_timer_usleep(unsigned long usecs);
 void handle_alarm(void);
 void timers_init(void);
 
+/* Called in a child process which keeps its parent's timers, to schedule
+ * the alarm for them, as pending alarms are not inherited across fork(2).
+ */
+void timers_handle_fork(void);
+
 #endif /* PR_TIMERS_H */
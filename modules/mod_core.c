@@ -122,6 +122,21 @@ static unsigned long core_exceeded_cmd_rate(cmd_rec *cmd) {
   return res;
 }
 
+static int core_hibernate_cb(CALLBACK_FRAME) {
+
+  /* A data transfer in progress is not idleness. */
+  if (session.sf_flags & SF_XFER) {
+    return 1;
+  }
+
+  pr_session_hibernate();
+
+  /* Keep the timer, so that a long-idle session is trimmed again as needed,
+   * e.g. after a module has cached something anew.
+   */
+  return 1;
+}
+
 static int core_idle_timeout_cb(CALLBACK_FRAME) {
   int timeout;
 
@@ -1062,6 +1077,116 @@ MODRET set_maxconnrate(cmd_rec *cmd) {
   return PR_HANDLED(cmd);
 }
 
+/* usage: ListenShards count|"auto" */
+MODRET set_listenshards(cmd_rec *cmd) {
+  long nshards;
+  char *endp = NULL;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  if (strcasecmp(cmd->argv[1], "auto") == 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    nshards = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nshards < 1) {
+      nshards = 1;
+    }
+#else
+    nshards = 1;
+#endif /* _SC_NPROCESSORS_ONLN */
+
+  } else {
+    nshards = strtol(cmd->argv[1], &endp, 10);
+    if ((endp && *endp) ||
+        nshards < 1) {
+      CONF_ERROR(cmd, "argument must be 'auto' or a number greater than 0");
+    }
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[0]) = (unsigned int) nshards;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: PreforkEngine on|off */
+MODRET set_preforkengine(cmd_rec *cmd) {
+  int engine = -1;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  engine = get_boolean(cmd, 1);
+  if (engine == -1) {
+    CONF_ERROR(cmd, "expected Boolean parameter");
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = pcalloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = engine;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: PreforkSpareWorkers min max */
+MODRET set_preforkspareworkers(cmd_rec *cmd) {
+  long min_spare, max_spare;
+  char *endp = NULL;
+  config_rec *c;
+
+  CHECK_ARGS(cmd, 2);
+  CHECK_CONF(cmd, CONF_ROOT);
+
+  min_spare = strtol(cmd->argv[1], &endp, 10);
+  if ((endp && *endp) ||
+      min_spare < 0) {
+    CONF_ERROR(cmd, "minimum must be a number greater than or equal to 0");
+  }
+
+  max_spare = strtol(cmd->argv[2], &endp, 10);
+  if ((endp && *endp) ||
+      max_spare < 1) {
+    CONF_ERROR(cmd, "maximum must be a number greater than 0");
+  }
+
+  if (min_spare > max_spare) {
+    CONF_ERROR(cmd, "minimum must not be greater than maximum");
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[0]) = (unsigned int) min_spare;
+  c->argv[1] = palloc(c->pool, sizeof(unsigned int));
+  *((unsigned int *) c->argv[1]) = (unsigned int) max_spare;
+
+  return PR_HANDLED(cmd);
+}
+
+/* usage: SessionHibernate secs|"off" */
+MODRET set_sessionhibernate(cmd_rec *cmd) {
+  int timeout = 0;
+  config_rec *c = NULL;
+
+  CHECK_ARGS(cmd, 1);
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL);
+
+  if (strcasecmp(cmd->argv[1], "off") != 0) {
+    if (pr_str_get_duration(cmd->argv[1], &timeout) < 0) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "error parsing timeout value '",
+        cmd->argv[1], "': ", strerror(errno), NULL));
+    }
+  }
+
+  c = add_config_param(cmd->argv[0], 1, NULL);
+  c->argv[0] = pcalloc(c->pool, sizeof(int));
+  *((int *) c->argv[0]) = timeout;
+
+  return PR_HANDLED(cmd);
+}
+
 MODRET set_timeoutidle(cmd_rec *cmd) {
   int timeout = -1;
   config_rec *c = NULL;
@@ -3383,11 +3508,84 @@ MODRET add_virtualhost(cmd_rec *cmd) {
   return PR_HANDLED(cmd);
 }
 
+/* The <VirtualHost> sections parsed so far, grouped by port, so that the
+ * address collision check in end_virtualhost() need only look at the vhosts
+ * which share a port; with thousands of vhosts, checking every server would
+ * dominate the time spent parsing.  Discarded once parsing is done.
+ */
+static pool *vhost_ports_pool = NULL;
+static pr_table_t *vhost_ports = NULL;
+
+static array_header *core_get_port_vhosts(unsigned int port) {
+  array_header *vhosts;
+  char key[32];
+
+  if (vhost_ports_pool == NULL) {
+    vhost_ports_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(vhost_ports_pool, "Core VirtualHost Ports Pool");
+
+    vhost_ports = pr_table_alloc(vhost_ports_pool, 0);
+  }
+
+  memset(key, '\0', sizeof(key));
+  snprintf(key, sizeof(key)-1, "%u", port);
+
+  vhosts = (array_header *) pr_table_get(vhost_ports, key, NULL);
+  if (vhosts == NULL) {
+    vhosts = make_array(vhost_ports_pool, 1, sizeof(server_rec *));
+    (void) pr_table_add(vhost_ports, pstrdup(vhost_ports_pool, key), vhosts,
+      sizeof(array_header *));
+  }
+
+  return vhosts;
+}
+
+/* Returns TRUE, logging a warning, if the given server is already using the
+ * address (and port) of the vhost being configured.
+ */
+static int core_vhost_collides(cmd_rec *cmd, server_rec *s,
+    const pr_netaddr_t *addr, unsigned int addr_flags) {
+  const char *serv_addrstr = NULL;
+  const pr_netaddr_t *serv_addr = NULL;
+
+  /* Have to resort to duplicating some of fixup_servers()'s functionality
+   * here, to do this check The Right Way(tm).
+   */
+  if (s->addr) {
+    serv_addr = s->addr;
+
+  } else {
+    serv_addrstr = s->ServerAddress ? s->ServerAddress :
+      pr_netaddr_get_localaddr_str(cmd->tmp_pool);
+
+    serv_addr = pr_netaddr_get_addr2(cmd->tmp_pool, serv_addrstr, NULL,
+      addr_flags);
+  }
+
+  if (serv_addr == NULL) {
+    pr_log_pri(PR_LOG_WARNING,
+      "warning: unable to determine IP address of '%s'", serv_addrstr);
+    return FALSE;
+  }
+
+  if (pr_netaddr_cmp(addr, serv_addr) != 0) {
+    return FALSE;
+  }
+
+  pr_log_pri(PR_LOG_WARNING,
+    "warning: \"%s\" address/port (%s:%d) already in use by \"%s\"",
+    cmd->server->ServerName ? cmd->server->ServerName : "ProFTPD",
+    pr_netaddr_get_ipstr(addr), cmd->server->ServerPort,
+    s->ServerName ? s->ServerName : "ProFTPD");
+  return TRUE;
+}
+
 MODRET end_virtualhost(cmd_rec *cmd) {
-  server_rec *s = NULL, *next_s = NULL;
   const pr_netaddr_t *addr = NULL;
   const char *address = NULL;
   unsigned int addr_flags = PR_NETADDR_GET_ADDR_FL_INCL_DEVICE;
+  array_header *vhosts;
+  int collides = FALSE;
 
   if (cmd->argc > 1) {
     CONF_ERROR(cmd, "wrong number of parameters");
@@ -3414,58 +3612,43 @@ MODRET end_virtualhost(cmd_rec *cmd) {
       "warning: unable to determine IP address of '%s'", address);
   }
 
-  if (AddressCollisionCheck) {
-    /* Check if this server's address/port combination is already being used. */
-    for (s = (server_rec *) server_list->xas_list; addr && s; s = next_s) {
-      next_s = s->next;
-
-      /* Have to resort to duplicating some of fixup_servers()'s functionality
-       * here, to do this check The Right Way(tm).
-       */
-      if (s != cmd->server) {
-        const char *serv_addrstr = NULL;
-        const pr_netaddr_t *serv_addr = NULL;
-
-        if (s->addr) {
-          serv_addr = s->addr;
-
-        } else {
-          serv_addrstr = s->ServerAddress ? s->ServerAddress :
-            pr_netaddr_get_localaddr_str(cmd->tmp_pool);
-
-          serv_addr = pr_netaddr_get_addr2(cmd->tmp_pool, serv_addrstr, NULL,
-            addr_flags);
-        }
+  /* Every vhost goes into the per-port index, whether or not it is itself
+   * checked, so that later vhosts colliding with it are still detected.
+   */
+  vhosts = core_get_port_vhosts(cmd->server->ServerPort);
 
-        if (serv_addr == NULL) {
-          pr_log_pri(PR_LOG_WARNING,
-            "warning: unable to determine IP address of '%s'", serv_addrstr);
+  /* If this server has a ServerAlias, it means it's a named vhost and can be
+   * used for name-based virtual hosting.  Which, in turn, means that any
+   * collision is expected, even wanted; there is no need to look for one.
+   */
+  if (AddressCollisionCheck &&
+      addr != NULL &&
+      find_config(cmd->server->conf, CONF_PARAM, "ServerAlias",
+        FALSE) == NULL) {
+    server_rec **elts;
+    register unsigned int i;
 
-        } else if (pr_netaddr_cmp(addr, serv_addr) == 0 &&
-            cmd->server->ServerPort == s->ServerPort) {
-          config_rec *c;
+    /* Check if this server's address/port combination is already being used,
+     * by the main server or by any of the vhosts on the same port.
+     */
+    if (main_server != cmd->server &&
+        main_server->ServerPort == cmd->server->ServerPort) {
+      collides = core_vhost_collides(cmd, main_server, addr, addr_flags);
+    }
 
-          /* If this server has a ServerAlias, it means it's a named vhost and
-           * can be used for name-based virtual hosting.  Which, in turn, means
-           * that this collision is expected, even wanted.
-           */
-          c = find_config(cmd->server->conf, CONF_PARAM, "ServerAlias", FALSE);
-          if (c == NULL) {
-            pr_log_pri(PR_LOG_WARNING,
-              "warning: \"%s\" address/port (%s:%d) already in use by \"%s\"",
-              cmd->server->ServerName ? cmd->server->ServerName : "ProFTPD",
-              pr_netaddr_get_ipstr(addr), cmd->server->ServerPort,
-              s->ServerName ? s->ServerName : "ProFTPD");
-
-            if (xaset_remove(server_list, (xasetmember_t *) cmd->server) == 1) {
-              destroy_pool(cmd->server->pool);
-            }
-          }
-        }
+    elts = vhosts->elts;
+    for (i = 0; collides == FALSE && i < vhosts->nelts; i++) {
+      collides = core_vhost_collides(cmd, elts[i], addr, addr_flags);
+    }
+  }
 
-        continue;
-      }
+  if (collides) {
+    if (xaset_remove(server_list, (xasetmember_t *) cmd->server) == 1) {
+      destroy_pool(cmd->server->pool);
     }
+
+  } else {
+    *((server_rec **) push_array(vhosts)) = cmd->server;
   }
 
   if (pr_parser_server_ctxt_close() == NULL) {
@@ -6570,6 +6753,14 @@ static void core_exit_ev(const void *event_data, void *user_data) {
   pr_fs_statcache_free();
 }
 
+static void core_postparse_ev(const void *event_data, void *user_data) {
+  if (vhost_ports_pool != NULL) {
+    destroy_pool(vhost_ports_pool);
+    vhost_ports_pool = NULL;
+    vhost_ports = NULL;
+  }
+}
+
 static void core_restart_ev(const void *event_data, void *user_data) {
   pr_fs_statcache_reset();
   pr_scoreboard_scrub();
@@ -6672,6 +6863,7 @@ static int core_init(void) {
   pr_feat_add(C_SIZE);
   pr_feat_add(C_HOST);
 
+  pr_event_register(&core_module, "core.postparse", core_postparse_ev, NULL);
   pr_event_register(&core_module, "core.restart", core_restart_ev, NULL);
   pr_event_register(&core_module, "core.startup", core_startup_ev, NULL);
 
@@ -6821,6 +7013,17 @@ static int core_sess_init(void) {
       core_idle_timeout_cb, "TimeoutIdle");
   }
 
+  /* Start the hibernation timer, if configured. */
+  c = find_config(main_server->conf, CONF_PARAM, "SessionHibernate", FALSE);
+  if (c != NULL) {
+    int hibernate_secs = *((int *) c->argv[0]);
+
+    if (hibernate_secs > 0) {
+      pr_timer_add(hibernate_secs, PR_TIMER_HIBERNATE, &core_module,
+        core_hibernate_cb, "SessionHibernate");
+    }
+  }
+
   /* Check for a server-specific TimeoutLinger */
   c = find_config(main_server->conf, CONF_PARAM, "TimeoutLinger", FALSE);
   if (c != NULL) {
@@ -7133,6 +7336,7 @@ static conftable core_conftab[] = {
   { "IgnoreHidden",		set_ignorehidden,		NULL },
   { "Include",			set_include,	 		NULL },
   { "IncludeOptions",		set_includeoptions, 		NULL },
+  { "ListenShards",		set_listenshards,		NULL },
   { "MasqueradeAddress",	set_masqueradeaddress,		NULL },
   { "MaxCommandRate",		set_maxcommandrate,		NULL },
   { "MaxConnectionRate",	set_maxconnrate,		NULL },
@@ -7143,6 +7347,8 @@ static conftable core_conftab[] = {
   { "PathAllowFilter",		set_pathallowfilter,		NULL },
   { "PathDenyFilter",		set_pathdenyfilter,		NULL },
   { "PidFile",			set_pidfile,	 		NULL },
+  { "PreforkEngine",		set_preforkengine,		NULL },
+  { "PreforkSpareWorkers",	set_preforkspareworkers,	NULL },
   { "Port",			set_serverport, 		NULL },
   { "ProcessTitles",		set_processtitles,		NULL },
   { "Protocols",		set_protocols,			NULL },
@@ -7156,6 +7362,7 @@ static conftable core_conftab[] = {
   { "ServerIdent",		set_serverident,		NULL },
   { "ServerName",		set_servername, 		NULL },
   { "ServerType",		set_servertype,			NULL },
+  { "SessionHibernate",		set_sessionhibernate,		NULL },
   { "SetEnv",			set_setenv,			NULL },
   { "SocketBindTight",		set_socketbindtight,		NULL },
   { "SocketOptions",		set_socketoptions,		NULL },
@@ -39,6 +39,7 @@
 
 /* Master daemon in standalone mode? (from src/main.c) */
 extern unsigned char is_master;
+extern pid_t mpid;
 
 module ctrls_module;
 static ctrls_acttab_t ctrls_acttab[];
@@ -709,6 +710,13 @@ static int ctrls_setnonblock(int sockfd) {
 static int ctrls_timer_cb(CALLBACK_FRAME) {
   static unsigned char first = TRUE;
 
+  /* Only the daemon process itself services the controls socket, not any
+   * listener shards forked from it.
+   */
+  if (mpid != getpid()) {
+    return 0;
+  }
+
   /* If the ControlsEngine is not to run, do nothing from here on out */
   if (!ctrls_engine) {
     close(ctrls_sockfd);
@@ -1170,8 +1178,11 @@ MODRET set_ctrlssocketowner(cmd_rec *cmd) {
  */
 
 static void ctrls_shutdown_ev(const void *event_data, void *user_data) {
-  if (!is_master || !ctrls_engine)
+  if (!is_master ||
+      mpid != getpid() ||
+      !ctrls_engine) {
     return;
+  }
 
   /* Close any connected clients */
   if (cl_list) {
@@ -1199,6 +1210,13 @@ static void ctrls_postparse_ev(const void *event_data, void *user_data) {
     return;
   }
 
+  /* Listener shards reparse the configuration on restart, but the controls
+   * socket belongs to the daemon process.
+   */
+  if (mpid != getpid()) {
+    return;
+  }
+
   /* Start listening on the ctrl socket */
   PRIVS_ROOT
   ctrls_sockfd = ctrls_listen(ctrls_sock_file);
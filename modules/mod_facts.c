@@ -69,6 +69,7 @@ struct mlinfo {
 
 /* Necessary prototypes */
 static void facts_mlinfobuf_flush(void);
+static void facts_mlinfobuf_write(char *, size_t);
 static int facts_sess_init(void);
 
 /* Support functions
@@ -388,11 +389,12 @@ static void facts_mlinfobuf_add(struct mlinfo *info, int flags) {
  
   buflen = facts_mlinfo_fmt(info, buf, sizeof(buf), flags);
 
-  /* If this buffer will exceed the capacity of mlinfo_buf, then flush
-   * mlinfo_buf.
+  /* If this buffer will exceed the capacity of mlinfo_buf, then send it
+   * along with mlinfo_buf, rather than copying it into the emptied buffer.
    */
   if (buflen >= (mlinfo_bufsz - mlinfo_buflen)) {
-    (void) facts_mlinfobuf_flush();
+    facts_mlinfobuf_write(buf, buflen);
+    return;
   }
 
   sstrcat(mlinfo_bufptr, buf, mlinfo_bufsz - mlinfo_buflen);
@@ -400,8 +402,11 @@ static void facts_mlinfobuf_add(struct mlinfo *info, int flags) {
   mlinfo_buflen += buflen;
 }
 
-static void facts_mlinfobuf_flush(void) {
-  if (mlinfo_buflen > 0) {
+/* Writes out mlinfo_buf, followed by the given data, if any. */
+static void facts_mlinfobuf_write(char *buf, size_t buflen) {
+  if (mlinfo_buflen > 0 ||
+      buflen > 0) {
+    struct iovec iov[2];
     int res;
 
     /* Make sure the ASCII flags are cleared from the session flags,
@@ -410,7 +415,12 @@ static void facts_mlinfobuf_flush(void) {
      */
     session.sf_flags &= ~SF_ASCII_OVERRIDE;
 
-    res = pr_data_xfer(mlinfo_buf, mlinfo_buflen);
+    iov[0].iov_base = mlinfo_buf;
+    iov[0].iov_len = mlinfo_buflen;
+    iov[1].iov_base = buf;
+    iov[1].iov_len = buflen;
+
+    res = pr_data_xferv(iov, buflen > 0 ? 2 : 1);
     if (res < 0 &&
         errno != 0) {
       pr_log_debug(DEBUG3, MOD_FACTS_VERSION
@@ -423,6 +433,10 @@ static void facts_mlinfobuf_flush(void) {
   facts_mlinfobuf_init();
 }
 
+static void facts_mlinfobuf_flush(void) {
+  facts_mlinfobuf_write(NULL, 0);
+}
+
 static int facts_mlinfo_get(struct mlinfo *info, const char *path,
     const char *dent_name, int flags, const char *user, uid_t uid,
     const char *group, gid_t gid, mode_t *mode) {
@@ -1936,11 +1950,25 @@ MODRET set_factsoptions(cmd_rec *cmd) {
 /* Event listeners
  */
 
+static void facts_hibernate_ev(const void *event_data, void *user_data) {
+
+  /* The MLSD buffer is allocated anew when next needed. */
+  if (mlinfo_pool != NULL &&
+      mlinfo_buflen == 0) {
+    destroy_pool(mlinfo_pool);
+    mlinfo_pool = NULL;
+    mlinfo_buf = mlinfo_bufptr = NULL;
+    mlinfo_bufsz = 0;
+  }
+}
+
 static void facts_sess_reinit_ev(const void *event_data, void *user_data) {
   int res;
 
   /* A HOST command changed the main_server pointer, reinitialize ourselves. */
 
+  pr_event_unregister(&facts_module, "core.session-hibernate",
+    facts_hibernate_ev);
   pr_event_unregister(&facts_module, "core.session-reinit",
     facts_sess_reinit_ev);
 
@@ -1973,6 +2001,8 @@ static int facts_sess_init(void) {
   config_rec *c;
   int advertise = TRUE;
 
+  pr_event_register(&facts_module, "core.session-hibernate",
+    facts_hibernate_ev, NULL);
   pr_event_register(&facts_module, "core.session-reinit",
     facts_sess_reinit_ev, NULL);
 
@@ -32,6 +32,8 @@
 #define GLOB_ABORTED GLOB_ABEND
 #endif
 
+module ls_module;
+
 #define MAP_UID(x) \
   (fakeuser ? fakeuser : pr_auth_uid2name(cmd->tmp_pool, (x)))
 
@@ -310,6 +312,7 @@ static int ls_perms(pool *p, cmd_rec *cmd, const char *path, int *hidden) {
  * By using a runtime allocation, we can use pr_config_get_server_xfer_bufsz()
  * to get the optimal buffer size for network transfers.
  */
+static pool *listbuf_pool = NULL;
 static char *listbuf = NULL, *listbuf_ptr = NULL;
 static size_t listbufsz = 0;
 
@@ -322,8 +325,11 @@ static int sendline(int flags, char *fmt, ...) {
   memset(buf, '\0', sizeof(buf));
 
   if (listbuf == NULL) {
+    listbuf_pool = make_sub_pool(session.pool);
+    pr_pool_tag(listbuf_pool, "List Buffer Pool");
+
     listbufsz = pr_config_get_server_xfer_bufsz(PR_NETIO_IO_WR);
-    listbuf = listbuf_ptr = pcalloc(session.pool, listbufsz);
+    listbuf = listbuf_ptr = pcalloc(listbuf_pool, listbufsz);
     pr_trace_msg("data", 8, "allocated list buffer of %lu bytes",
       (unsigned long) listbufsz);
   }
@@ -332,6 +338,7 @@ static int sendline(int flags, char *fmt, ...) {
     listbuflen = (listbuf_ptr - listbuf) + strlen(listbuf_ptr);
 
     if (listbuflen > 0) {
+      struct iovec iov[1];
       int using_ascii = FALSE;
 
       /* Make sure the ASCII flags are cleared from the session flags,
@@ -345,7 +352,10 @@ static int sendline(int flags, char *fmt, ...) {
       session.sf_flags &= ~SF_ASCII;
       session.sf_flags &= ~SF_ASCII_OVERRIDE;
 
-      res = pr_data_xfer(listbuf, listbuflen);
+      iov[0].iov_base = listbuf;
+      iov[0].iov_len = listbuflen;
+
+      res = pr_data_xferv(iov, 1);
       if (res < 0 &&
           errno != 0) {
         int xerrno = errno;
@@ -384,13 +394,23 @@ static int sendline(int flags, char *fmt, ...) {
 
   buflen = strlen(buf);
   if (buflen >= (listbufsz - listbuflen)) {
+    struct iovec iov[2];
+
     /* Make sure the ASCII flags are cleared from the session flags,
      * so that the pr_data_xfer() function does not try to perform
      * ASCII translation on this data.
      */
     session.sf_flags &= ~SF_ASCII_OVERRIDE;
 
-    res = pr_data_xfer(listbuf, listbuflen);
+    /* Send this line along with the full listbuf, rather than copying it
+     * into the emptied listbuf.
+     */
+    iov[0].iov_base = listbuf;
+    iov[0].iov_len = listbuflen;
+    iov[1].iov_base = buf;
+    iov[1].iov_len = buflen;
+
+    res = pr_data_xferv(iov, 2);
     if (res < 0 &&
         errno != 0) {
       int xerrno = errno;
@@ -409,8 +429,8 @@ static int sendline(int flags, char *fmt, ...) {
     memset(listbuf, '\0', listbufsz);
     listbuf_ptr = listbuf;
     pr_trace_msg("data", 8, "flushed %lu bytes of list buffer",
-      (unsigned long) listbuflen);
-    listbuflen = 0;
+      (unsigned long) (listbuflen + buflen));
+    return res;
   }
 
   sstrcat(listbuf_ptr, buf, listbufsz - listbuflen);
@@ -3619,6 +3639,21 @@ MODRET set_useglobbing(cmd_rec *cmd) {
   return PR_HANDLED(cmd);
 }
 
+/* Event listeners
+ */
+
+static void ls_hibernate_ev(const void *event_data, void *user_data) {
+
+  /* The list buffer is allocated anew when next needed. */
+  if (listbuf_pool != NULL &&
+      listbuf_ptr == listbuf) {
+    destroy_pool(listbuf_pool);
+    listbuf_pool = NULL;
+    listbuf = listbuf_ptr = NULL;
+    listbufsz = 0;
+  }
+}
+
 /* Initialization routines
  */
 
@@ -3632,6 +3667,13 @@ static int ls_init(void) {
   return 0;
 }
 
+static int ls_sess_init(void) {
+  pr_event_register(&ls_module, "core.session-hibernate", ls_hibernate_ev,
+    NULL);
+
+  return 0;
+}
+
 /* Module API tables
  */
 
@@ -3679,5 +3721,5 @@ module ls_module = {
   ls_init,
 
   /* Session initialization */
-  NULL
+  ls_sess_init
 };
@@ -49,6 +49,7 @@ extern pid_t mpid;
 
 /* Variables for this module */
 static pr_fh_t *retr_fh = NULL;
+static pr_buffer_t *retr_cache_buf = NULL;
 static pr_fh_t *stor_fh = NULL;
 static pr_fh_t *displayfilexfer_fh = NULL;
 
@@ -59,6 +60,22 @@ static unsigned char use_sendfile = TRUE;
 static off_t use_sendfile_len = 0;
 static float use_sendfile_pct = -1.0;
 
+/* UseDirectIO: downloads read with O_DIRECT, into an aligned buffer.  The
+ * position of the file descriptor is tracked, as it is kept aligned.
+ */
+static int retr_direct_io = FALSE;
+static size_t retr_direct_align = 0;
+static off_t retr_direct_pos = -1;
+
+#define XFER_DIRECT_IO_BUFSZ		(1024 * 1024)
+
+/* UseReadAhead: the read-ahead window grows from the minimum to the maximum
+ * for sequential downloads; sendfile(2) is used a minimum window at a time,
+ * so that the read-ahead keeps up with it.
+ */
+#define XFER_READAHEAD_MIN_WINDOW	(256 * 1024)
+#define XFER_READAHEAD_MAX_WINDOW	(16 * 1024 * 1024)
+
 static int xfer_check_limit(cmd_rec *);
 
 /* TransferOptions */
@@ -484,17 +501,15 @@ static int xfer_parse_cmdlist(const char *name, config_rec *c,
   return 0;
 }
 
-static int transmit_normal(pool *p, char *buf, size_t bufsz) {
+static int transmit_normal(pool *p, char *buf, size_t bufsz, off_t rem_len) {
   int xerrno;
   long nread;
   size_t read_len;
   pr_error_t *err = NULL;
 
   read_len = bufsz;
-  if (session.range_len > 0) {
-    if (((off_t) read_len) > session.range_len) {
-      read_len = session.range_len;
-    }
+  if (((off_t) read_len) > rem_len) {
+    read_len = rem_len;
   }
 
   nread = pr_fsio_read_with_error(p, retr_fh, buf, read_len, &err);
@@ -527,15 +542,245 @@ static int transmit_normal(pool *p, char *buf, size_t bufsz) {
   return pr_data_xfer(buf, nread);
 }
 
+/* Reads the file at the given offset using direct I/O, i.e. with aligned
+ * offsets and lengths into the given aligned buffer, and sends the part of
+ * what was read which starts at the offset, up to rem_len bytes.
+ */
+static int transmit_direct(pool *p, char *buf, size_t bufsz, off_t offset,
+    off_t rem_len) {
+  int xerrno;
+  long nread;
+  off_t aligned_offset, skip_len;
+  size_t send_len;
+
+  skip_len = offset % (off_t) retr_direct_align;
+  aligned_offset = offset - skip_len;
+
+  if (retr_direct_pos != aligned_offset) {
+    if (pr_fsio_lseek(retr_fh, aligned_offset, SEEK_SET) < 0) {
+      xerrno = errno;
+
+      pr_log_debug(DEBUG3, "error seeking to offset %" PR_LU " in '%s': %s",
+        (pr_off_t) aligned_offset, retr_fh->fh_path, strerror(xerrno));
+
+      retr_direct_pos = -1;
+      errno = xerrno;
+      return -1;
+    }
+  }
+
+  nread = pr_fsio_read(retr_fh, buf, bufsz);
+  if (nread < 0) {
+    xerrno = errno;
+
+    (void) pr_trace_msg("fileperms", 1, "RETR, user '%s' (UID %s, GID %s): "
+      "error reading from '%s': %s", session.user,
+      pr_uid2str(p, session.uid), pr_gid2str(p, session.gid),
+      retr_fh->fh_path, strerror(xerrno));
+
+    retr_direct_pos = -1;
+    errno = xerrno;
+    return 0;
+  }
+
+  retr_direct_pos = aligned_offset + nread;
+
+  if (nread <= skip_len) {
+    return 0;
+  }
+
+  send_len = (size_t) (nread - skip_len);
+  if ((off_t) send_len > rem_len) {
+    send_len = rem_len;
+  }
+
+  return pr_data_xfer(buf + skip_len, send_len);
+}
+
+/* Decides whether the file being downloaded should be read using direct
+ * I/O, per UseDirectIO, and if so, switches its descriptor to direct I/O.
+ */
+static int retr_use_direct_io(struct stat *st) {
+  config_rec *c;
+  off_t min_size;
+
+  c = find_config(CURRENT_CONF, CONF_PARAM, "UseDirectIO", FALSE);
+  if (c == NULL ||
+      *((unsigned char *) c->argv[0]) == FALSE) {
+    return FALSE;
+  }
+
+  min_size = *((off_t *) c->argv[1]);
+  if (st->st_size < min_size) {
+    return FALSE;
+  }
+
+  /* We don't use direct I/O if:
+   * - We're transmitting an ASCII file.
+   * - The file is handled by an FS other than the core's, whose reads
+   *   may not map to reads of the descriptor.
+   * - The filesystem does not support it.
+   */
+  if (session.sf_flags & (SF_ASCII|SF_ASCII_OVERRIDE)) {
+    pr_log_debug(DEBUG10, "declining use of direct I/O for ASCII data");
+    return FALSE;
+  }
+
+  if (retr_fh->fh_fs == NULL ||
+      retr_fh->fh_fs->fs_name == NULL ||
+      strcmp(retr_fh->fh_fs->fs_name, "system") != 0) {
+    pr_log_debug(DEBUG10, "declining use of direct I/O for '%s' FS",
+      retr_fh->fh_fs != NULL && retr_fh->fh_fs->fs_name != NULL ?
+        retr_fh->fh_fs->fs_name : "(unknown)");
+    return FALSE;
+  }
+
+  if (pr_fs_set_direct_io(PR_FH_FD(retr_fh), TRUE) < 0) {
+    pr_log_debug(DEBUG10, "declining use of direct I/O for '%s': %s",
+      retr_fh->fh_path, strerror(errno));
+    return FALSE;
+  }
+
+  /* Align to the filesystem's preferred I/O size, if it is a reasonable
+   * power of two, which also satisfies devices with smaller logical blocks.
+   */
+  retr_direct_align = 4096;
+  if (st->st_blksize > 4096 &&
+      st->st_blksize <= 65536 &&
+      (st->st_blksize & (st->st_blksize - 1)) == 0) {
+    retr_direct_align = st->st_blksize;
+  }
+
+  pr_log_debug(DEBUG10, "using direct I/O for transmitting data (%lu byte "
+    "alignment)", (unsigned long) retr_direct_align);
+  return TRUE;
+}
+
+/* Decides whether adaptive read-ahead should be used for the file being
+ * downloaded, per UseReadAhead, and if so, enables it on the handle.
+ */
+static int retr_use_readahead(struct stat *st) {
+  config_rec *c;
+  off_t min_size;
+
+  c = find_config(CURRENT_CONF, CONF_PARAM, "UseReadAhead", FALSE);
+  if (c == NULL ||
+      *((unsigned char *) c->argv[0]) == FALSE) {
+    return FALSE;
+  }
+
+  min_size = *((off_t *) c->argv[1]);
+  if (st->st_size < min_size) {
+    return FALSE;
+  }
+
+  /* ASCII translation changes the number of bytes sent, so the offsets of
+   * the reads are not known.
+   */
+  if (session.sf_flags & (SF_ASCII|SF_ASCII_OVERRIDE)) {
+    pr_log_debug(DEBUG10, "declining use of read-ahead for ASCII data");
+    return FALSE;
+  }
+
+  if (pr_fsio_set_readahead(retr_fh, XFER_READAHEAD_MIN_WINDOW,
+      XFER_READAHEAD_MAX_WINDOW, PR_FSIO_READAHEAD_FL_DROP_BEHIND) < 0) {
+    return FALSE;
+  }
+
+  pr_log_debug(DEBUG10, "using read-ahead for transmitting data");
+  return TRUE;
+}
+
+/* Looks up the file being downloaded in the cache provided by e.g.
+ * mod_filecache, if any.  Returns a buffer holding the entire file, or NULL
+ * if the file is to be read as usual.
+ */
+static pr_buffer_t *retr_get_cached(pool *p) {
+  cmdtable *cmdtab;
+  cmd_rec *cmd;
+  modret_t *res;
+
+  cmdtab = pr_stash_get_symbol2(PR_SYM_HOOK, "filecache_get", NULL, NULL,
+    NULL);
+  if (cmdtab == NULL) {
+    return NULL;
+  }
+
+  cmd = pr_cmd_alloc(p, 1, retr_fh);
+  res = pr_module_call(cmdtab->m, cmdtab->handler, cmd);
+  if (MODRET_ISHANDLED(res) &&
+      MODRET_HASDATA(res)) {
+    return res->data;
+  }
+
+  return NULL;
+}
+
+static int transmit_cached(size_t bufsz, off_t rem_len) {
+  size_t len;
+
+  len = retr_cache_buf->remaining;
+  if (len > bufsz) {
+    len = bufsz;
+  }
+
+  if ((off_t) len > rem_len) {
+    len = rem_len;
+  }
+
+  if (len == 0) {
+    return 0;
+  }
+
+  /* pr_data_xfer() does not modify the given buffer when sending. */
+  retr_cache_buf->current += len;
+  retr_cache_buf->remaining -= len;
+
+  return pr_data_xfer(retr_cache_buf->current - len, len);
+}
+
+/* Returns TRUE if the data channel protection (e.g. by mod_tls) for the
+ * given direction is being done by the kernel (kTLS), in which case
+ * sendfile(2) and splice(2) can still be used.
+ */
+static int xfer_have_ktls(int direction) {
+  pr_netio_stream_t *nstrm;
+  const char *note;
+
+  if (session.d == NULL) {
+    return FALSE;
+  }
+
+  if (direction == PR_NETIO_IO_WR) {
+    nstrm = session.d->outstrm;
+    note = "mod_tls.ktls-send";
+
+  } else {
+    nstrm = session.d->instrm;
+    note = "mod_tls.ktls-recv";
+  }
+
+  if (nstrm == NULL ||
+      pr_table_get(nstrm->notes, note, NULL) == NULL) {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 #ifdef HAVE_SENDFILE
 static int transmit_sendfile(off_t data_len, off_t *data_offset,
-    pr_sendfile_t *sent_len) {
+    off_t rem_len, pr_sendfile_t *sent_len) {
   off_t send_len;
+  int have_ktls;
+
+  have_ktls = (have_rfc2228_data && xfer_have_ktls(PR_NETIO_IO_WR));
 
   /* We don't use sendfile() if:
    * - We're using bandwidth throttling.
    * - We're transmitting an ASCII file.
-   * - We're using RFC2228 data channel protection
+   * - We're using RFC2228 data channel protection, unless the kernel is
+   *   doing that protection for us (kTLS)
    * - We're using MODE Z compression
    * - There's no data left to transmit.
    * - UseSendfile is set to off.
@@ -543,7 +788,7 @@ static int transmit_sendfile(off_t data_len, off_t *data_offset,
   if (pr_throttle_have_rate() ||
      !(session.xfer.file_size - data_len) ||
      (session.sf_flags & (SF_ASCII|SF_ASCII_OVERRIDE)) ||
-     have_rfc2228_data || have_zmode ||
+     (have_rfc2228_data && !have_ktls) || have_zmode ||
      !use_sendfile) {
 
     if (!xfer_logged_sendfile_decline_msg) {
@@ -558,7 +803,8 @@ static int transmit_sendfile(off_t data_len, off_t *data_offset,
       } else if (session.sf_flags & (SF_ASCII|SF_ASCII_OVERRIDE)) {
         pr_log_debug(DEBUG10, "declining use of sendfile for ASCII data");
 
-      } else if (have_rfc2228_data) {
+      } else if (have_rfc2228_data &&
+                 !have_ktls) {
         pr_log_debug(DEBUG10, "declining use of sendfile due to RFC2228 data "
           "channel protections");
 
@@ -577,21 +823,30 @@ static int transmit_sendfile(off_t data_len, off_t *data_offset,
     return 0;
   }
 
-  pr_log_debug(DEBUG10, "using sendfile capability for transmitting data");
+  if (have_ktls) {
+    pr_log_debug(DEBUG10,
+      "using sendfile capability for transmitting data over kTLS");
+
+  } else {
+    pr_log_debug(DEBUG10, "using sendfile capability for transmitting data");
+  }
 
   /* Determine how many bytes to send using sendfile(2).  By default,
-   * we want to send all of the remaining bytes.
+   * we want to send all of the remaining bytes (of the file, or of the
+   * requested range).
    *
    * However, the admin may have configured either a length in bytes, or
    * a percentage, using the UseSendfile directive.  We will send the smaller
    * of the remaining size, or the length/percentage.
    */
+  send_len = rem_len;
 
-  if (session.range_len > 0) {
-    send_len = session.range_len;
-
-  } else {
-    send_len = session.xfer.file_size - data_len;
+  /* With read-ahead, send a window at a time, so that the read-ahead can
+   * be advanced between calls.
+   */
+  if (retr_fh->fh_readahead != NULL &&
+      send_len > XFER_READAHEAD_MIN_WINDOW) {
+    send_len = XFER_READAHEAD_MIN_WINDOW;
   }
 
   if (use_sendfile_len > 0 &&
@@ -666,10 +921,11 @@ static int transmit_sendfile(off_t data_len, off_t *data_offset,
 
 /* Note: the data_len and data_offset arguments are only for the benefit of
  * transmit_sendfile(), if sendfile support is enabled.  The transmit_normal()
- * function only needs/uses buf and bufsz.
+ * function only needs/uses buf and bufsz.  No more than rem_len bytes, the
+ * number of bytes left to send, are sent.
  */
 static long transmit_data(pool *p, off_t data_len, off_t *data_offset,
-    char *buf, size_t bufsz) {
+    off_t rem_len, char *buf, size_t bufsz) {
   long res;
   int xerrno = 0;
 
@@ -683,8 +939,32 @@ static long transmit_data(pool *p, off_t data_len, off_t *data_offset,
       PR_NETIO_FD(session.d->outstrm), strerror(errno));
   }
 
+  if (retr_cache_buf != NULL) {
+    res = transmit_cached(bufsz, rem_len);
+    xerrno = errno;
+
+    if (session.d != NULL) {
+      (void) pr_inet_set_proto_cork(PR_NETIO_FD(session.d->outstrm), 0);
+    }
+
+    errno = xerrno;
+    return res;
+  }
+
+  if (retr_direct_io) {
+    res = transmit_direct(p, buf, bufsz, data_len, rem_len);
+    xerrno = errno;
+
+    if (session.d != NULL) {
+      (void) pr_inet_set_proto_cork(PR_NETIO_FD(session.d->outstrm), 0);
+    }
+
+    errno = xerrno;
+    return res;
+  }
+
 #ifdef HAVE_SENDFILE
-  ret = transmit_sendfile(data_len, data_offset, &sent_len);
+  ret = transmit_sendfile(data_len, data_offset, rem_len, &sent_len);
   if (ret > 0) {
     /* sendfile() was used, so return the value of sent_len. */
     res = (long) sent_len;
@@ -693,7 +973,7 @@ static long transmit_data(pool *p, off_t data_len, off_t *data_offset,
     /* sendfile() should not be used for some reason, fallback to using
      * normal data transmission methods.
      */
-    res = transmit_normal(p, buf, bufsz);
+    res = transmit_normal(p, buf, bufsz, rem_len);
     xerrno = errno;
 
   } else {
@@ -705,7 +985,7 @@ static long transmit_data(pool *p, off_t data_len, off_t *data_offset,
     pr_log_debug(DEBUG10, "use of sendfile(2) failed due to %s (%d), "
       "falling back to normal data transmission", strerror(errno),
       errno);
-    res = transmit_normal(p, buf, bufsz);
+    res = transmit_normal(p, buf, bufsz, rem_len);
     xerrno = errno;
 
 # else
@@ -719,10 +999,14 @@ static long transmit_data(pool *p, off_t data_len, off_t *data_offset,
   }
 
 #else
-  res = transmit_normal(p, buf, bufsz);
+  res = transmit_normal(p, buf, bufsz, rem_len);
   xerrno = errno;
 #endif /* HAVE_SENDFILE */
 
+  if (res > 0) {
+    pr_fsio_readahead(retr_fh, data_len, res);
+  }
+
   if (session.d != NULL) {
     /* The session.d struct can become null after transmit_normal() if the
      * client aborts the transfer, thus we need to check for this.
@@ -739,6 +1023,106 @@ static long transmit_data(pool *p, off_t data_len, off_t *data_offset,
   return res;
 }
 
+/* Decides whether uploaded data can be moved directly from the data
+ * connection into the file, using pr_data_splice(), rather than being read
+ * by pr_data_xfer() and then written by pr_fsio_write().
+ */
+static int receive_use_splice(unsigned char have_limit) {
+  int flags;
+  config_rec *c;
+
+  /* We don't use splice() if:
+   * - We're using bandwidth throttling.
+   * - We're receiving an ASCII file.
+   * - We're using RFC2228 data channel protection, unless the kernel is
+   *   doing that protection for us (kTLS)
+   * - We're using MODE Z compression
+   * - MaxStoreFileSize is in effect, as it must be checked before writing.
+   * - The file is handled by an FS other than the core's, e.g. one which
+   *   enforces quotas on write.
+   * - The file is opened for appending.
+   * - UseSendfile is set to off.
+   */
+  if (pr_throttle_have_rate()) {
+    pr_log_debug(DEBUG10, "declining use of splice due to TransferRate "
+      "restrictions");
+    return FALSE;
+  }
+
+  if (session.sf_flags & (SF_ASCII|SF_ASCII_OVERRIDE)) {
+    pr_log_debug(DEBUG10, "declining use of splice for ASCII data");
+    return FALSE;
+  }
+
+  if (have_rfc2228_data &&
+      !xfer_have_ktls(PR_NETIO_IO_RD)) {
+    pr_log_debug(DEBUG10, "declining use of splice due to RFC2228 data "
+      "channel protections");
+    return FALSE;
+  }
+
+  if (have_zmode) {
+    pr_log_debug(DEBUG10, "declining use of splice due to MODE Z "
+      "restrictions");
+    return FALSE;
+  }
+
+  if (have_limit) {
+    pr_log_debug(DEBUG10, "declining use of splice due to MaxStoreFileSize "
+      "restrictions");
+    return FALSE;
+  }
+
+  if (stor_fh->fh_fs == NULL ||
+      stor_fh->fh_fs->fs_name == NULL ||
+      strcmp(stor_fh->fh_fs->fs_name, "system") != 0) {
+    pr_log_debug(DEBUG10, "declining use of splice for '%s' FS",
+      stor_fh->fh_fs != NULL && stor_fh->fh_fs->fs_name != NULL ?
+        stor_fh->fh_fs->fs_name : "(unknown)");
+    return FALSE;
+  }
+
+  flags = fcntl(PR_FH_FD(stor_fh), F_GETFL);
+  if (flags < 0 ||
+      (flags & O_APPEND)) {
+    pr_log_debug(DEBUG10, "declining use of splice for file opened for "
+      "appending");
+    return FALSE;
+  }
+
+  c = find_config(CURRENT_CONF, CONF_PARAM, "UseSendfile", FALSE);
+  if (c != NULL &&
+      *((unsigned char *) c->argv[0]) == FALSE) {
+    pr_log_debug(DEBUG10, "declining use of splice due to UseSendfile "
+      "configuration setting");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Note: the use_splice argument is cleared if pr_data_splice() finds that
+ * it cannot be used, in which case the data is read into buf, for the
+ * caller to write out.
+ */
+static int receive_data(char *buf, size_t bufsz, int *use_splice) {
+  int res;
+
+  if (*use_splice) {
+    res = pr_data_splice(PR_FH_FD(stor_fh), bufsz);
+    if (res >= 0 ||
+        errno != ENOSYS) {
+      return res;
+    }
+
+    pr_log_debug(DEBUG10, "splice unavailable, falling back to normal data "
+      "transmission");
+    *use_splice = FALSE;
+  }
+
+  return pr_data_xfer(buf, bufsz);
+}
+
 static void stor_chown(pool *p) {
   struct stat st;
   const char *xfer_path = NULL;
@@ -927,12 +1311,16 @@ static void retr_abort(pool *p) {
     retr_fh = NULL;
   }
 
+  retr_cache_buf = NULL;
+  retr_direct_io = FALSE;
   _log_transfer('o', 'i');
 }
 
 static void retr_complete(pool *p) {
   pr_fsio_close(retr_fh);
   retr_fh = NULL;
+  retr_cache_buf = NULL;
+  retr_direct_io = FALSE;
 }
 
 static void stor_abort(pool *p) {
@@ -1766,8 +2154,8 @@ MODRET xfer_pre_appe(cmd_rec *cmd) {
 MODRET xfer_stor(cmd_rec *cmd) {
   const char *path;
   char *lbuf;
-  int bufsz, len, xerrno = 0, res;
-  off_t nbytes_stored, nbytes_max_store = 0;
+  int bufsz, len, xerrno = 0, res, use_splice;
+  off_t nbytes_stored, nbytes_spliced = 0, nbytes_max_store = 0;
   unsigned char have_limit = FALSE;
   struct stat st;
   off_t start_offset = 0, upload_len = 0;
@@ -2064,7 +2452,13 @@ MODRET xfer_stor(cmd_rec *cmd) {
   pr_trace_msg("data", 8, "allocated upload buffer of %lu bytes",
     (unsigned long) bufsz);
 
-  while ((len = pr_data_xfer(lbuf, bufsz)) > 0) {
+  use_splice = receive_use_splice(have_limit);
+  if (use_splice) {
+    pr_log_debug(DEBUG10, "using splice capability for receiving data%s",
+      have_rfc2228_data ? " over kTLS" : "");
+  }
+
+  while ((len = receive_data(lbuf, bufsz, &use_splice)) > 0) {
     pr_signals_handle();
 
     if (XFER_ABORTED) {
@@ -2105,7 +2499,14 @@ MODRET xfer_stor(cmd_rec *cmd) {
      * be doing short writes, and we ideally should be more resilient/graceful
      * in the face of such things.
      */
-    res = pr_fsio_write_with_error(cmd->pool, stor_fh, lbuf, len, &err);
+    if (use_splice) {
+      /* The data has already been written to the file. */
+      res = len;
+      nbytes_spliced += len;
+
+    } else {
+      res = pr_fsio_write_with_error(cmd->pool, stor_fh, lbuf, len, &err);
+    }
     xerrno = errno;
 
     if (res != len) {
@@ -2114,7 +2515,7 @@ MODRET xfer_stor(cmd_rec *cmd) {
       if (res < 0) {
         xerrno = errno;
 
-        pr_error_set_where(err, &xfer_module, __FILE__, __LINE__ - 9);
+        pr_error_set_where(err, &xfer_module, __FILE__, __LINE__ - 10);
         pr_error_set_why(err, pstrcat(cmd->pool, "writing '", stor_fh->fh_path,
           "'", NULL));
       }
@@ -2165,6 +2566,12 @@ MODRET xfer_stor(cmd_rec *cmd) {
     }
   }
 
+  if (nbytes_spliced > 0) {
+    pr_log_debug(DEBUG10, "received %" PR_LU " of %" PR_LU " %s using splice",
+      (pr_off_t) nbytes_spliced, (pr_off_t) nbytes_stored,
+      nbytes_stored != 1 ? "bytes" : "byte");
+  }
+
   if (XFER_ABORTED) {
     stor_abort(cmd->pool);
     pr_data_abort(0, FALSE);
@@ -2888,12 +3295,43 @@ MODRET xfer_retr(cmd_rec *cmd) {
     PR_SCORE_XFER_DONE, (off_t) 0,
     NULL);
 
+  /* Small, whole files may be served from a cache, rather than read. */
+  retr_cache_buf = NULL;
+  if (curr_pos == 0 &&
+      download_len == st.st_size &&
+      download_len > 0) {
+    retr_cache_buf = retr_get_cached(cmd->tmp_pool);
+    if (retr_cache_buf != NULL) {
+      pr_trace_msg(trace_channel, 9, "sending '%s' (%lu bytes) from cache",
+        dir, retr_cache_buf->buflen);
+    }
+  }
+
   if (session.range_len > 0) {
     if (bufsz > session.range_len) {
       bufsz = session.range_len;
     }
   }
 
+  /* Large files may be read using direct I/O, which needs a larger, aligned
+   * buffer, or with adaptive read-ahead.
+   */
+  retr_direct_io = FALSE;
+  retr_direct_pos = -1;
+  if (retr_cache_buf == NULL) {
+    if (retr_use_direct_io(&st)) {
+      retr_direct_io = TRUE;
+
+      bufsz = XFER_DIRECT_IO_BUFSZ;
+      lbuf = palloc(cmd->tmp_pool, bufsz + retr_direct_align);
+      lbuf = (char *) (((unsigned long) lbuf + retr_direct_align - 1) &
+        ~((unsigned long) retr_direct_align - 1));
+
+    } else {
+      (void) retr_use_readahead(&st);
+    }
+  }
+
   while (nbytes_sent != download_len) {
     pr_signals_handle();
 
@@ -2901,7 +3339,8 @@ MODRET xfer_retr(cmd_rec *cmd) {
       break;
     }
 
-    len = transmit_data(cmd->pool, curr_offset, &curr_pos, lbuf, bufsz);
+    len = transmit_data(cmd->pool, curr_offset, &curr_pos,
+      download_len - nbytes_sent, lbuf, bufsz);
     if (len == 0) {
       break;
     }
@@ -4125,6 +4564,78 @@ MODRET set_usesendfile(cmd_rec *cmd) {
   return PR_HANDLED(cmd);
 }
 
+/* usage: UseDirectIO on|off|"size units" */
+MODRET set_usedirectio(cmd_rec *cmd) {
+  int bool = -1;
+  off_t min_size = 0;
+  config_rec *c;
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL|CONF_ANON|CONF_DIR|CONF_DYNDIR);
+
+  if (cmd->argc-1 == 1) {
+    bool = get_boolean(cmd, 1);
+    if (bool == -1) {
+      CONF_ERROR(cmd, "expected Boolean parameter");
+    }
+
+  } else if (cmd->argc-1 == 2) {
+    if (pr_str_get_nbytes(cmd->argv[1], cmd->argv[2], &min_size) < 0) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unable to parse: ",
+        cmd->argv[1], " ", cmd->argv[2], ": ", strerror(errno), NULL));
+    }
+
+    bool = TRUE;
+
+  } else {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = pcalloc(c->pool, sizeof(unsigned char));
+  *((unsigned char *) c->argv[0]) = bool;
+  c->argv[1] = pcalloc(c->pool, sizeof(off_t));
+  *((off_t *) c->argv[1]) = min_size;
+
+  c->flags |= CF_MERGEDOWN;
+  return PR_HANDLED(cmd);
+}
+
+/* usage: UseReadAhead on|off|"size units" */
+MODRET set_usereadahead(cmd_rec *cmd) {
+  int bool = -1;
+  off_t min_size = 0;
+  config_rec *c;
+
+  CHECK_CONF(cmd, CONF_ROOT|CONF_VIRTUAL|CONF_GLOBAL|CONF_ANON|CONF_DIR|CONF_DYNDIR);
+
+  if (cmd->argc-1 == 1) {
+    bool = get_boolean(cmd, 1);
+    if (bool == -1) {
+      CONF_ERROR(cmd, "expected Boolean parameter");
+    }
+
+  } else if (cmd->argc-1 == 2) {
+    if (pr_str_get_nbytes(cmd->argv[1], cmd->argv[2], &min_size) < 0) {
+      CONF_ERROR(cmd, pstrcat(cmd->tmp_pool, "unable to parse: ",
+        cmd->argv[1], " ", cmd->argv[2], ": ", strerror(errno), NULL));
+    }
+
+    bool = TRUE;
+
+  } else {
+    CONF_ERROR(cmd, "wrong number of parameters");
+  }
+
+  c = add_config_param(cmd->argv[0], 2, NULL, NULL);
+  c->argv[0] = pcalloc(c->pool, sizeof(unsigned char));
+  *((unsigned char *) c->argv[0]) = bool;
+  c->argv[1] = pcalloc(c->pool, sizeof(off_t));
+  *((off_t *) c->argv[1]) = min_size;
+
+  c->flags |= CF_MERGEDOWN;
+  return PR_HANDLED(cmd);
+}
+
 /* Event handlers
  */
 
@@ -4350,6 +4861,8 @@ static conftable xfer_conftab[] = {
   { "TimeoutStalled",		set_timeoutstalled,		NULL },
   { "TransferOptions",		set_transferoptions,		NULL },
   { "TransferRate",		set_transferrate,		NULL },
+  { "UseDirectIO",		set_usedirectio,		NULL },
+  { "UseReadAhead",		set_usereadahead,		NULL },
   { "UseSendfile",		set_usesendfile,		NULL },
 
   { NULL }
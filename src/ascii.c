@@ -26,6 +26,13 @@
 
 #include "conf.h"
 
+/* Both directions of translation look for a single character (CR when
+ * reading, LF when writing), and most text has long runs between them.  We
+ * use memchr(3) to find the next interesting character, since the C library
+ * versions are vectorized on most platforms, and copy the plain runs in bulk,
+ * rather than examining and copying the data byte by byte.
+ */
+
 int pr_ascii_ftp_from_crlf(pool *p, char *in, size_t inlen, char **out,
     size_t *outlen) {
   char *src, *dst;
@@ -51,26 +58,44 @@ int pr_ascii_ftp_from_crlf(pool *p, char *in, size_t inlen, char **out,
   dst = *out;
   adj = 0;
 
-  while (rem--) {
-    if (*src != '\r') {
+  while (rem > 0) {
+    char *cr;
+    size_t runlen;
+
+    cr = memchr(src, '\r', rem);
+    runlen = (cr != NULL ? (size_t) (cr - src) : rem);
+
+    if (runlen > 0) {
+      /* The translation may be done in place, with `out' trailing `in'. */
+      if (dst != src) {
+        memmove(dst, src, runlen);
+      }
+
+      dst += runlen;
+      src += runlen;
+      rem -= runlen;
+      (*outlen) += runlen;
+    }
+
+    if (cr == NULL) {
+      break;
+    }
+
+    rem--;
+
+    if (rem == 0) {
+      /* copy, but save it for later */
+      adj++;
       *dst++ = *src++;
-      (*outlen)++;
 
     } else {
-      if (rem == 0) {
-        /* copy, but save it for later */
-        adj++;
-        *dst++ = *src++;
+      if (*(src+1) == '\n') {
+        /* Skip the CR. */
+        src++;
 
       } else {
-        if (*(src+1) == '\n') {
-          /* Skip the CR. */
-          src++;
-
-        } else {
-          *dst++ = *src++;
-          (*outlen)++;
-        }
+        *dst++ = *src++;
+        (*outlen)++;
       }
     }
   }
@@ -80,14 +105,87 @@ int pr_ascii_ftp_from_crlf(pool *p, char *in, size_t inlen, char **out,
 
 static int have_dangling_cr = FALSE;
 
+/* Returns the number of bare LFs, i.e. LFs with no preceding CR, in the
+ * given buffer.
+ */
+static size_t ascii_count_bare_lfs(const char *src, size_t srclen) {
+  const char *ptr, *end, *lf;
+  size_t count = 0;
+
+  ptr = src;
+  end = src + srclen;
+
+  while (ptr < end) {
+    lf = memchr(ptr, '\n', end - ptr);
+    if (lf == NULL) {
+      break;
+    }
+
+    if (lf == src) {
+      if (have_dangling_cr == FALSE) {
+        count++;
+      }
+
+    } else if (*(lf-1) != '\r') {
+      count++;
+    }
+
+    ptr = lf + 1;
+  }
+
+  return count;
+}
+
+/* Copies the given buffer into `dst', adding a CR before each bare LF.  The
+ * caller is responsible for making sure that `dst' has room for the added
+ * CRs.  Returns the number of bytes written.
+ */
+static size_t ascii_add_crs(const char *src, size_t srclen, char *dst) {
+  const char *ptr, *end, *lf;
+  char *dst_ptr;
+
+  ptr = src;
+  end = src + srclen;
+  dst_ptr = dst;
+
+  while (ptr < end) {
+    size_t runlen;
+
+    lf = memchr(ptr, '\n', end - ptr);
+    if (lf == NULL) {
+      lf = end;
+    }
+
+    runlen = lf - ptr;
+    memcpy(dst_ptr, ptr, runlen);
+    dst_ptr += runlen;
+
+    if (lf == end) {
+      break;
+    }
+
+    if (lf == src) {
+      if (have_dangling_cr == FALSE) {
+        *dst_ptr++ = '\r';
+      }
+
+    } else if (*(lf-1) != '\r') {
+      *dst_ptr++ = '\r';
+    }
+
+    *dst_ptr++ = '\n';
+    ptr = lf + 1;
+  }
+
+  return dst_ptr - dst;
+}
+
 /* This function rewrites the contents of the given buffer, making sure that
  * each LF has a preceding CR, as required by RFC959.
  */
 int pr_ascii_ftp_to_crlf(pool *p, char *in, size_t inlen, char **out,
     size_t *outlen) {
-  register unsigned int i = 0, j = 0;
-  char *dst = NULL, *src;
-  size_t src_len, lf_pos;
+  size_t count;
 
   if (p == NULL ||
       in == NULL ||
@@ -102,77 +200,65 @@ int pr_ascii_ftp_to_crlf(pool *p, char *in, size_t inlen, char **out,
     return 0;
   }
 
-  src = in;
-  src_len = lf_pos = inlen;
+  count = ascii_count_bare_lfs(in, inlen);
+  if (count == 0) {
+    /* No translation needed. */
+    have_dangling_cr = (in[inlen-1] == '\r') ? TRUE : FALSE;
 
-  /* First, determine the position of the first bare LF. */
-  if (have_dangling_cr == FALSE &&
-      src[0] == '\n') {
-    lf_pos = 0;
-    goto found_lf;
+    *out = in;
+    *outlen = inlen;
+    return 0;
   }
 
-  for (i = 1; i < src_len; i++) {
-    if (src[i] == '\n' &&
-        src[i-1] != '\r') {
-      lf_pos = i;
-      break;
-    }
-  }
+  /* Knowing the number of CRs to add, we can allocate exactly the space
+   * needed, and write the translated data directly into it.
+   */
+  *out = palloc(p, inlen + count);
+  *outlen = ascii_add_crs(in, inlen, *out);
 
-found_lf:
   /* If the last character in the buffer is CR, then we have a dangling CR.
    * The first character in the next buffer could be an LF, and without
    * this flag, that LF would be treated as a bare LF, thus resulting in
    * an added extraneous CR in the stream.
    */
-  have_dangling_cr = (src[src_len-1] == '\r') ? TRUE : FALSE;
+  have_dangling_cr = (in[inlen-1] == '\r') ? TRUE : FALSE;
+  pr_signals_handle();
 
-  if (lf_pos == src_len) {
-    /* No translation needed. */
-    *out = in;
-    *outlen = inlen;
-    return 0;
-  }
+  return (int) count;
+}
 
-  /* Assume the worst: a block containing only LF characters, needing twice
-   * the size for holding the corresponding CRs.
-   */
-  dst = malloc(src_len * 2);
-  if (dst == NULL) {
-    pr_log_pri(PR_LOG_ALERT, "Out of memory!");
-    exit(1);
-  }
+int pr_ascii_ftp_to_crlf2(const char *in, size_t inlen, char *out,
+    size_t outsz, size_t *outlen) {
+  size_t count;
 
-  if (lf_pos > 0) {
-    memcpy(dst, src, lf_pos);
-    i = j = lf_pos;
+  if (in == NULL ||
+      out == NULL ||
+      outlen == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
 
-  } else {
-    dst[0] = '\r';
-    dst[1] = '\n';
-    i = 2;
-    j = 1;
+  if (inlen == 0) {
+    *outlen = 0;
+    return 0;
   }
 
-  while (j < src_len) {
-    if (src[j] == '\n' &&
-        src[j-1] != '\r') {
-      dst[i++] = '\r';
+  /* Only count the bare LFs up front if the worst case, every character
+   * being an LF, might not fit.
+   */
+  if (outsz / 2 < inlen) {
+    count = ascii_count_bare_lfs(in, inlen);
+    if (inlen + count > outsz) {
+      errno = E2BIG;
+      return -1;
     }
-
-    dst[i++] = src[j++];
   }
-  pr_signals_handle();
-
-  *outlen = i;
-  *out = pcalloc(p, *outlen);
-  memcpy(*out, dst, i);
 
-  free(dst);
-  dst = NULL;
+  *outlen = ascii_add_crs(in, inlen, out);
+  count = *outlen - inlen;
 
-  return i - j;
+  have_dangling_cr = (in[inlen-1] == '\r') ? TRUE : FALSE;
+  return (int) count;
 }
 
 void pr_ascii_ftp_reset(void) {
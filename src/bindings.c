@@ -30,6 +30,9 @@
 extern xaset_t *server_list;
 extern server_rec *main_server;
 
+/* From src/main.c */
+extern unsigned char is_master;
+
 static pr_ipbind_t *ipbind_table[PR_BINDINGS_TABLE_SIZE];
 static pool *binding_pool = NULL;
 static pr_ipbind_t *ipbind_default_server = NULL,
@@ -67,17 +70,193 @@ struct listener_rec {
   struct listener_rec *next, *prev;
 
   pool *pool;
+  server_rec *server;
   const pr_netaddr_t *addr;
   unsigned int port;
   conn_t *conn;
   int claimed;
 };
 
+/* Listening sockets inherited from a previous daemon process, during an
+ * upgrade, which have not (yet) been claimed by a binding.
+ */
+static pool *inherited_pool = NULL;
+static array_header *inherited_list = NULL;
+struct inherited_rec {
+  int fd;
+  const pr_netaddr_t *addr;
+  unsigned int port;
+};
+
+static int ipbind_is_wildcard(const pr_netaddr_t *addr) {
+  const char *ipstr;
+
+  ipstr = pr_netaddr_get_ipstr(addr);
+  if (ipstr == NULL) {
+    return FALSE;
+  }
+
+  if (strcmp(ipstr, "0.0.0.0") == 0 ||
+      strcmp(ipstr, "::") == 0) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Returns the inherited socket listening on the given address and port
+ * (or on the wildcard address, for a NULL address), if any, removing it
+ * from the inherited list.  Returns -1 if there is no such socket.
+ */
+static int ipbind_take_inherited_fd(const pr_netaddr_t *addr,
+    unsigned int port, const pr_netaddr_t **local_addr) {
+  register unsigned int i;
+  struct inherited_rec *recs;
+
+  if (inherited_list == NULL) {
+    return -1;
+  }
+
+  recs = inherited_list->elts;
+  for (i = 0; i < inherited_list->nelts; i++) {
+    int use_elt = FALSE;
+
+    if (recs[i].fd < 0 ||
+        recs[i].port != port) {
+      continue;
+    }
+
+    if (addr != NULL) {
+      if (pr_netaddr_cmp(addr, recs[i].addr) == 0) {
+        use_elt = TRUE;
+      }
+
+    } else if (ipbind_is_wildcard(recs[i].addr)) {
+      use_elt = TRUE;
+    }
+
+    if (use_elt) {
+      int fd;
+
+      fd = recs[i].fd;
+      *local_addr = recs[i].addr;
+      recs[i].fd = -1;
+      return fd;
+    }
+  }
+
+  return -1;
+}
+
+int pr_ipbind_inherit_fds(int fd, int nfds) {
+  register int i;
+  int count = 0;
+
+  if (fd < 0 ||
+      nfds < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (inherited_pool == NULL) {
+    inherited_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(inherited_pool, "Inherited Listening Sockets Pool");
+
+    inherited_list = make_array(inherited_pool, nfds,
+      sizeof(struct inherited_rec));
+  }
+
+  for (i = fd; i < fd + nfds; i++) {
+    struct inherited_rec *rec;
+    pr_netaddr_t *na;
+    struct sockaddr_storage ss;
+    socklen_t sslen;
+    int socktype = 0;
+
+    pr_signals_handle();
+
+    sslen = sizeof(socktype);
+    if (getsockopt(i, SOL_SOCKET, SO_TYPE, (void *) &socktype, &sslen) < 0 ||
+        socktype != SOCK_STREAM) {
+      pr_trace_msg(trace_channel, 3,
+        "ignoring inherited fd %d: not a stream socket", i);
+      (void) close(i);
+      continue;
+    }
+
+    memset(&ss, 0, sizeof(ss));
+    sslen = sizeof(ss);
+    if (getsockname(i, (struct sockaddr *) &ss, &sslen) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "ignoring inherited fd %d: unable to get socket address: %s", i,
+        strerror(errno));
+      (void) close(i);
+      continue;
+    }
+
+    na = pr_netaddr_alloc(inherited_pool);
+    if (pr_netaddr_set_family(na, ss.ss_family) < 0 ||
+        pr_netaddr_set_sockaddr(na, (struct sockaddr *) &ss) < 0) {
+      pr_trace_msg(trace_channel, 3,
+        "ignoring inherited fd %d: unsupported address family %d", i,
+        (int) ss.ss_family);
+      (void) close(i);
+      continue;
+    }
+
+    /* Keep the socket from leaking into any programs we exec. */
+    (void) fcntl(i, F_SETFD, FD_CLOEXEC);
+
+    rec = push_array(inherited_list);
+    rec->fd = i;
+    rec->addr = na;
+    rec->port = ntohs(pr_netaddr_get_port(na));
+
+    pr_trace_msg(trace_channel, 9, "inherited listening socket fd %d for %s#%u",
+      i, pr_netaddr_get_ipstr(na), rec->port);
+    count++;
+  }
+
+  return count;
+}
+
+int pr_ipbind_close_inherited_fds(void) {
+  register unsigned int i;
+  struct inherited_rec *recs;
+  int count = 0;
+
+  if (inherited_list == NULL) {
+    return 0;
+  }
+
+  recs = inherited_list->elts;
+  for (i = 0; i < inherited_list->nelts; i++) {
+    if (recs[i].fd < 0) {
+      continue;
+    }
+
+    pr_trace_msg(trace_channel, 9,
+      "closing unused inherited listening socket fd %d for %s#%u", recs[i].fd,
+      pr_netaddr_get_ipstr(recs[i].addr), recs[i].port);
+    (void) close(recs[i].fd);
+    recs[i].fd = -1;
+    count++;
+  }
+
+  destroy_pool(inherited_pool);
+  inherited_pool = NULL;
+  inherited_list = NULL;
+
+  return count;
+}
+
 conn_t *pr_ipbind_get_listening_conn(server_rec *server,
     const pr_netaddr_t *addr, unsigned int port) {
   conn_t *l;
   pool *p;
   struct listener_rec *lr;
+  const pr_netaddr_t *inherited_addr = NULL;
+  int fd;
 
   if (listening_conn_list) {
     for (lr = (struct listener_rec *) listening_conn_list->xas_list; lr;
@@ -134,17 +313,33 @@ conn_t *pr_ipbind_get_listening_conn(server_rec *server,
   p = make_sub_pool(listening_conn_pool); 
   pr_pool_tag(p, "Listening conn subpool");
 
-  l = pr_inet_create_conn(p, -1, addr, port, FALSE);
-  if (l == NULL) {
-    return NULL;
-  }
+  /* Prefer a socket inherited from the previous daemon process, which may
+   * already have connections queued on it.
+   */
+  fd = ipbind_take_inherited_fd(addr, port, &inherited_addr);
+  if (fd >= 0) {
+    l = pr_inet_create_conn(p, fd, addr, port, FALSE);
+    if (l == NULL) {
+      return NULL;
+    }
 
-  /* Inform any interested listeners that this socket was opened. */
-  pr_inet_generate_socket_event("core.ctrl-listen", server, l->local_addr,
-    l->listen_fd);
+    l->local_addr = pr_netaddr_dup(p, inherited_addr);
+    l->local_port = port;
+
+  } else {
+    l = pr_inet_create_conn(p, -1, addr, port, FALSE);
+    if (l == NULL) {
+      return NULL;
+    }
+
+    /* Inform any interested listeners that this socket was opened. */
+    pr_inet_generate_socket_event("core.ctrl-listen", server, l->local_addr,
+      l->listen_fd);
+  }
 
   lr = pcalloc(p, sizeof(struct listener_rec));
   lr->pool = p;
+  lr->server = server;
   lr->conn = l;
   lr->addr = pr_netaddr_dup(p, addr);
   if (lr->addr == NULL &&
@@ -158,6 +353,103 @@ conn_t *pr_ipbind_get_listening_conn(server_rec *server,
   return l;
 }
 
+int pr_ipbind_reopen_listeners(void) {
+  struct listener_rec *lr;
+  int count = 0;
+
+  if (listening_conn_list == NULL) {
+    return 0;
+  }
+
+  for (lr = (struct listener_rec *) listening_conn_list->xas_list; lr;
+      lr = lr->next) {
+    conn_t *l;
+    pool *tmp_pool;
+    int xerrno;
+
+    pr_signals_handle();
+
+    /* Only sockets which are not yet listening can be replaced; once a
+     * socket is listening, connections may already be queued on it.
+     */
+    if (lr->conn == NULL ||
+        lr->conn->mode != CM_NONE) {
+      continue;
+    }
+
+    tmp_pool = make_sub_pool(lr->pool);
+    pr_pool_tag(tmp_pool, "Listening conn reopen pool");
+
+    l = pr_inet_create_conn(tmp_pool, -1, lr->addr, lr->port, FALSE);
+    if (l == NULL) {
+      xerrno = errno;
+
+      destroy_pool(tmp_pool);
+      errno = xerrno;
+      return -1;
+    }
+
+    /* Swap the new socket in under the existing descriptor number, so that
+     * the conn_t (and anything else referring to that descriptor) need not
+     * change.
+     */
+    if (dup2(l->listen_fd, lr->conn->listen_fd) < 0) {
+      xerrno = errno;
+
+      pr_trace_msg(trace_channel, 1,
+        "error duplicating fd %d onto listening fd %d: %s", l->listen_fd,
+        lr->conn->listen_fd, strerror(xerrno));
+      destroy_pool(tmp_pool);
+      errno = xerrno;
+      return -1;
+    }
+
+    (void) close(l->listen_fd);
+    l->listen_fd = -1;
+    destroy_pool(tmp_pool);
+
+    /* Inform any interested listeners that this socket was opened. */
+    pr_inet_generate_socket_event("core.ctrl-listen",
+      lr->server ? lr->server : main_server, lr->conn->local_addr,
+      lr->conn->listen_fd);
+
+    pr_trace_msg(trace_channel, 9, "reopened listening socket for %s#%u",
+      pr_netaddr_get_ipstr(lr->conn->local_addr), lr->port);
+    count++;
+  }
+
+  return count;
+}
+
+array_header *pr_ipbind_get_listening_fds(pool *p) {
+  array_header *fds;
+  struct listener_rec *lr;
+
+  if (p == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  fds = make_array(p, 1, sizeof(int));
+
+  if (listening_conn_list == NULL) {
+    return fds;
+  }
+
+  for (lr = (struct listener_rec *) listening_conn_list->xas_list; lr;
+      lr = lr->next) {
+    if (lr->conn == NULL ||
+        lr->conn->listen_fd < 0 ||
+        lr->conn->mode != CM_LISTEN) {
+      continue;
+    }
+
+    *((int *) push_array(fds)) = lr->conn->listen_fd;
+  }
+
+  return fds;
+}
+
 /* Slight (clever?) optimization: the loop in server_loop() always
  * calls pr_ipbind_listen(), selects, then pr_ipbind_accept_conn().  Now,
  * rather than having both pr_ipbind_listen() and pr_ipbind_accept_conn()
@@ -169,6 +461,22 @@ conn_t *pr_ipbind_get_listening_conn(server_rec *server,
 
 static array_header *listener_list = NULL;
 
+/* Bumped whenever the set of listening conns may have changed, so that
+ * pr_ipbind_watch_listeners() knows when to rebuild its list.
+ */
+static unsigned int ipbind_generation = 0;
+static unsigned int listener_generation = 0;
+
+/* Stops the daemon's I/O loop from watching the given listener, before it
+ * is closed.
+ */
+static void ipbind_unwatch_listener(conn_t *listener) {
+  if (listener != NULL &&
+      listener->listen_fd != -1) {
+    (void) pr_ioloop_remove_fd(listener->listen_fd);
+  }
+}
+
 conn_t *pr_ipbind_accept_conn(fd_set *readfds, int *listenfd) {
   conn_t **listeners = listener_list->elts;
   register unsigned int i = 0;
@@ -319,6 +627,7 @@ int pr_ipbind_close(const pr_netaddr_t *addr, unsigned int port,
      * can't be shutdown via ftpdctl, anyway.
      */
     if (SocketBindTight && ipbind->ib_listener != NULL) {
+      ipbind_unwatch_listener(ipbind->ib_listener);
       pr_inet_close(ipbind->ib_server->pool, ipbind->ib_listener);
       ipbind->ib_listener = ipbind->ib_server->listen = NULL;
     }
@@ -330,6 +639,7 @@ int pr_ipbind_close(const pr_netaddr_t *addr, unsigned int port,
      * on future lookup requests via pr_ipbind_get_server().
      */
     ipbind->ib_isactive = FALSE;
+    ipbind_generation++;
 
     if (close_namebinds && ipbind->ib_namebinds) {
       register unsigned int j = 0;
@@ -355,6 +665,7 @@ int pr_ipbind_close(const pr_netaddr_t *addr, unsigned int port,
       for (ipbind = ipbind_table[i]; ipbind; ipbind = ipbind->ib_next) {
 
         if (SocketBindTight && ipbind->ib_listener != NULL) {
+          ipbind_unwatch_listener(ipbind->ib_listener);
           pr_inet_close(main_server->pool, ipbind->ib_listener);
           ipbind->ib_listener = ipbind->ib_server->listen = NULL;
         }
@@ -364,6 +675,7 @@ int pr_ipbind_close(const pr_netaddr_t *addr, unsigned int port,
          * regardless of their current state.
          */
         ipbind->ib_isactive = FALSE;
+        ipbind_generation++;
 
         if (close_namebinds && ipbind->ib_namebinds) {
           register unsigned int j = 0;
@@ -393,10 +705,22 @@ int pr_ipbind_close_listeners(void) {
   conn_t **listeners;
   register unsigned int i = 0;
 
+  /* Set once a non-master process has closed its listeners, which it does
+   * without marking each listener as closed (see below).  Closing them
+   * again, e.g. in a prefork worker and then in its session, would close
+   * whatever descriptors have since reused those numbers, such as the
+   * client connection.
+   */
+  static int closed_listeners = FALSE;
+
   if (!listener_list ||
       listener_list->nelts == 0)
     return 0;
 
+  if (closed_listeners) {
+    return 0;
+  }
+
   listeners = listener_list->elts;
   for (i = 0; i < listener_list->nelts; i++) {
     conn_t *listener = listeners[i];
@@ -405,10 +729,23 @@ int pr_ipbind_close_listeners(void) {
 
     if (listener->listen_fd != -1) {
       close(listener->listen_fd);
-      listener->listen_fd = -1;
+
+      /* A forked session process leaves the listener untouched.  Each
+       * listening conn lives in its own pool block; with many listeners,
+       * writing to every one of them would copy most of the daemon's
+       * binding memory into every session process.  Sessions never use
+       * the listeners again.
+       */
+      if (is_master) {
+        listener->listen_fd = -1;
+      }
     }
   }
 
+  if (!is_master) {
+    closed_listeners = TRUE;
+  }
+
   return 0;
 }
 
@@ -744,6 +1081,108 @@ int pr_ipbind_listen(fd_set *readfds) {
   return maxfd;
 }
 
+int pr_ipbind_unwatch_listeners(void) {
+  register unsigned int i;
+  conn_t **listeners;
+
+  if (listener_list == NULL) {
+    return 0;
+  }
+
+  listeners = listener_list->elts;
+  for (i = 0; i < listener_list->nelts; i++) {
+    ipbind_unwatch_listener(listeners[i]);
+  }
+
+  return listener_list->nelts;
+}
+
+int pr_ipbind_watch_listeners(void) {
+  int listen_flags = PR_INET_LISTEN_FL_FATAL_ON_ERROR;
+  register unsigned int i = 0;
+
+  if (listener_list != NULL &&
+      listener_generation == ipbind_generation) {
+    return listener_list->nelts;
+  }
+
+  if (binding_pool == NULL) {
+    binding_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(binding_pool, "Bindings Pool");
+  }
+
+  if (listener_list == NULL) {
+    listener_list = make_array(binding_pool, 1, sizeof(conn_t *));
+
+  } else {
+    listener_list->nelts = 0;
+  }
+
+  for (i = 0; i < PR_BINDINGS_TABLE_SIZE; i++) {
+    pr_ipbind_t *ipbind = NULL;
+
+    for (ipbind = ipbind_table[i]; ipbind; ipbind = ipbind->ib_next) {
+      conn_t *listener;
+
+      pr_signals_handle();
+
+      /* Skip inactive bindings, but only if SocketBindTight is in effect. */
+      if (SocketBindTight &&
+          !ipbind->ib_isactive) {
+        continue;
+      }
+
+      listener = ipbind->ib_listener;
+      if (listener == NULL) {
+        continue;
+      }
+
+      if (listener->mode == CM_NONE) {
+        pr_inet_listen(listener->pool, listener, tcpBackLog, listen_flags);
+      }
+
+      if (listener->mode == CM_ACCEPT ||
+          listener->mode == CM_ERROR) {
+        listener->mode = CM_LISTEN;
+        listener->xerrno = 0;
+      }
+
+      if (listener->mode != CM_LISTEN) {
+        continue;
+      }
+
+      /* Note that several bindings may share the same listener, and that
+       * listeners survive restarts; thus the listener may already be
+       * watched.
+       */
+      if (pr_ioloop_add_fd(listener->listen_fd, PR_IOLOOP_TYPE_LISTENER,
+          listener) < 0 &&
+          errno != EEXIST) {
+        pr_log_pri(PR_LOG_WARNING, "unable to watch %s#%u for connections: %s",
+          pr_netaddr_get_ipstr(ipbind->ib_addr), ipbind->ib_port,
+          strerror(errno));
+        continue;
+      }
+
+      /* Connections are accepted in batches, until accept(2) would block. */
+      if (pr_inet_set_nonblock(listener->pool, listener) < 0) {
+        pr_trace_msg(trace_channel, 3,
+          "error making %s#%u nonblocking: %s",
+          pr_netaddr_get_ipstr(ipbind->ib_addr), ipbind->ib_port,
+          strerror(errno));
+      }
+
+      *((conn_t **) push_array(listener_list)) = listener;
+    }
+  }
+
+  listener_generation = ipbind_generation;
+
+  pr_trace_msg(trace_channel, 9, "watching %u listening %s",
+    listener_list->nelts, listener_list->nelts != 1 ? "sockets" : "socket");
+  return listener_list->nelts;
+}
+
 int pr_ipbind_open(const pr_netaddr_t *addr, unsigned int port,
     conn_t *listen_conn, unsigned char isdefault, unsigned char islocalhost,
     unsigned char open_namebinds) {
@@ -810,6 +1249,7 @@ int pr_ipbind_open(const pr_netaddr_t *addr, unsigned int port,
 
   /* Mark this binding as now being active. */
   ipbind->ib_isactive = TRUE;
+  ipbind_generation++;
 
   return 0;
 }
@@ -1148,6 +1588,8 @@ void free_bindings(void) {
     listener_list = NULL;
   }
 
+  ipbind_generation++;
+
   memset(ipbind_table, 0, sizeof(ipbind_table));
 
   /* Mark all listening conns as "unclaimed"; any that remaining unclaimed
@@ -1410,6 +1852,7 @@ static int init_standalone_bindings(void) {
       lrn = lr->next;
 
       if (!lr->claimed) {
+        ipbind_unwatch_listener(lr->conn);
         xaset_remove(listening_conn_list, (xasetmember_t *) lr);
         destroy_pool(lr->pool);
       }
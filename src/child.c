@@ -62,6 +62,15 @@ int child_add(pid_t pid, int fd) {
   xaset_insert(child_list, (xasetmember_t *) ch);
   child_listlen++;
 
+  /* Have the daemon watch for the child to close its end of the semaphore
+   * pipe, signalling that it has finished starting up.
+   */
+  if (fd != -1 &&
+      pr_ioloop_add_fd(fd, PR_IOLOOP_TYPE_CHILD, ch) < 0) {
+    pr_trace_msg("ioloop", 9, "unable to watch child semaphore fd %d: %s",
+      fd, strerror(errno));
+  }
+
   return 0;
 }
 
@@ -127,6 +136,7 @@ void child_update(void) {
 
     if (ch->ch_dead) {
       if (ch->ch_pipefd != -1) {
+        (void) pr_ioloop_remove_fd(ch->ch_pipefd);
         (void) close(ch->ch_pipefd);
       }
 
@@ -185,7 +185,7 @@ cmd_rec *pr_cmd_alloc(pool *p, unsigned int argc, ...) {
   /* This table will not contain that many entries, so a low number
    * of chains should suffice.
    */
-  cmd->notes = pr_table_nalloc(cmd->pool, 0, 8);
+  cmd->notes = pr_table_nalloc(cmd->pool, PR_TABLE_FL_OPEN_ADDR, 8);
 
   /* Initialize the "errno" note to be zero, so that it is always present. */
   xerrno = palloc(cmd->pool, sizeof(int));
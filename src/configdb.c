@@ -47,6 +47,42 @@ static unsigned int config_id = 0;
 
 static const char *trace_channel = "config";
 
+/* Lookups of a directive by name, in sets with many members (e.g. a
+ * <VirtualHost> or <Directory> with hundreds of directives), use an index
+ * of the set's members, built lazily and kept in the set's xas_index
+ * pointer, rather than walking every member.  The index is rebuilt when
+ * members are added to or removed from the set, or when new child sets are
+ * created, but only once the set has been looked up several times without
+ * changing; while a set is being populated, e.g. during parsing, lookups
+ * simply scan it.
+ */
+#define CONFIG_INDEX_MIN_MEMBERS	16
+#define CONFIG_INDEX_BUILD_LOOKUPS	8
+
+struct config_index_ent {
+  unsigned int config_id;
+  unsigned int pos;
+  config_rec *c;
+};
+
+struct config_index {
+  /* Holds the entries; NULL if the index has not been built. */
+  pool *pool;
+
+  /* The set and set-creation generations the index is current for. */
+  unsigned int generation;
+  unsigned int sets_generation;
+  unsigned int nlookups;
+
+  /* All members of the set, sorted by config ID, then by position. */
+  struct config_index_ent *ents;
+  unsigned int nents;
+
+  /* The members which have child sets, in order. */
+  struct config_index_ent *subs;
+  unsigned int nsubs;
+};
+
 /* Adds a config_rec to the specified set */
 config_rec *pr_config_add_set(xaset_t **set, const char *name, int flags) {
   pool *conf_pool = NULL, *set_pool = NULL;
@@ -455,6 +491,311 @@ void pr_config_merge_down(xaset_t *s, int dynamic) {
   }
 }
 
+static int config_index_ent_cmp(const void *a, const void *b) {
+  const struct config_index_ent *ea = a, *eb = b;
+
+  if (ea->config_id != eb->config_id) {
+    return ea->config_id < eb->config_id ? -1 : 1;
+  }
+
+  if (ea->pos != eb->pos) {
+    return ea->pos < eb->pos ? -1 : 1;
+  }
+
+  return 0;
+}
+
+static void config_index_build(xaset_t *set, struct config_index *idx) {
+  config_rec *c;
+  unsigned int n = 0;
+
+  for (c = (config_rec *) set->xas_list; c; c = c->next) {
+    n++;
+  }
+
+  idx->pool = make_sub_pool(set->pool);
+  pr_pool_tag(idx->pool, "config index pool");
+
+  idx->ents = palloc(idx->pool, n * sizeof(struct config_index_ent));
+  idx->subs = palloc(idx->pool, n * sizeof(struct config_index_ent));
+  idx->nents = idx->nsubs = 0;
+
+  for (c = (config_rec *) set->xas_list; c; c = c->next) {
+    struct config_index_ent *ent;
+
+    ent = &(idx->ents[idx->nents]);
+    ent->config_id = c->config_id;
+    ent->pos = idx->nents++;
+    ent->c = c;
+
+    /* Note that empty child sets are included, as members may be added to
+     * them without changing this set.
+     */
+    if (c->subset != NULL) {
+      idx->subs[idx->nsubs++] = *ent;
+    }
+  }
+
+  qsort(idx->ents, idx->nents, sizeof(struct config_index_ent),
+    config_index_ent_cmp);
+
+  pr_trace_msg(trace_channel, 19,
+    "built index for config set %p (%u members, %u with child sets)",
+    set, idx->nents, idx->nsubs);
+}
+
+/* Returns the index for the given set, or NULL if the set should be scanned
+ * instead.
+ */
+static struct config_index *config_index_get(xaset_t *set) {
+  struct config_index *idx;
+  unsigned int sets_generation;
+
+  idx = set->xas_index;
+  sets_generation = xaset_get_generation();
+
+  if (idx == NULL) {
+    config_rec *c;
+    unsigned int n = 0;
+
+    for (c = (config_rec *) set->xas_list; c; c = c->next) {
+      if (++n >= CONFIG_INDEX_MIN_MEMBERS) {
+        break;
+      }
+    }
+
+    if (n < CONFIG_INDEX_MIN_MEMBERS) {
+      return NULL;
+    }
+
+    idx = pcalloc(set->pool, sizeof(struct config_index));
+    idx->generation = set->xas_generation;
+    idx->sets_generation = sets_generation;
+    set->xas_index = idx;
+  }
+
+  if (idx->generation != set->xas_generation ||
+      idx->sets_generation != sets_generation) {
+    if (idx->pool != NULL) {
+      destroy_pool(idx->pool);
+      idx->pool = NULL;
+      idx->ents = idx->subs = NULL;
+      idx->nents = idx->nsubs = 0;
+    }
+
+    idx->generation = set->xas_generation;
+    idx->sets_generation = sets_generation;
+    idx->nlookups = 0;
+  }
+
+  if (idx->pool == NULL) {
+    if (++idx->nlookups < CONFIG_INDEX_BUILD_LOOKUPS) {
+      return NULL;
+    }
+
+    config_index_build(set, idx);
+  }
+
+  return idx;
+}
+
+/* Finds the first entry, in position order, with the given config ID. */
+static struct config_index_ent *config_index_find_id(struct config_index *idx,
+    unsigned int cid, unsigned int *nents) {
+  unsigned int lo = 0, hi = idx->nents, i;
+
+  while (lo < hi) {
+    unsigned int mid;
+
+    mid = lo + ((hi - lo) / 2);
+    if (idx->ents[mid].config_id < cid) {
+      lo = mid + 1;
+
+    } else {
+      hi = mid;
+    }
+  }
+
+  for (i = lo; i < idx->nents && idx->ents[i].config_id == cid; i++);
+
+  *nents = i - lo;
+  return &(idx->ents[lo]);
+}
+
+static int config_skip_rec(config_rec *c, unsigned long flags) {
+  if (flags == 0) {
+    return FALSE;
+  }
+
+  if ((c->config_type == CONF_ANON &&
+       (flags & PR_CONFIG_FIND_FL_SKIP_ANON)) ||
+      (c->config_type == CONF_DIR &&
+       (flags & PR_CONFIG_FIND_FL_SKIP_DIR)) ||
+      (c->config_type == CONF_LIMIT &&
+       (flags & PR_CONFIG_FIND_FL_SKIP_LIMIT)) ||
+      (c->config_type == CONF_DYNDIR &&
+       (flags & PR_CONFIG_FIND_FL_SKIP_DYNDIR))) {
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+static config_rec *config_find_set(xaset_t *, int, unsigned int,
+  unsigned long);
+
+/* Searches the child sets of the given config_rec, then the config_rec
+ * itself, as find_config_next2() does when recursing.
+ */
+static config_rec *config_find_rec(config_rec *c, int type, unsigned int cid,
+    unsigned long flags) {
+
+  if (c->subset != NULL &&
+      c->subset->xas_list != NULL) {
+    config_rec *res;
+
+    res = config_find_set(c->subset, type, cid, flags);
+    if (res != NULL) {
+      return res;
+    }
+  }
+
+  if (c->config_type == type &&
+      c->config_id == cid) {
+    return c;
+  }
+
+  return NULL;
+}
+
+static config_rec *config_find_set(xaset_t *set, int type, unsigned int cid,
+    unsigned long flags) {
+  struct config_index *idx;
+  struct config_index_ent *ents;
+  unsigned int i, j, nents;
+  config_rec *c, *res;
+
+  idx = config_index_get(set);
+  if (idx == NULL) {
+    for (c = (config_rec *) set->xas_list; c; c = c->next) {
+      pr_signals_handle();
+
+      if (config_skip_rec(c, flags)) {
+        continue;
+      }
+
+      res = config_find_rec(c, type, cid, flags);
+      if (res != NULL) {
+        return res;
+      }
+    }
+
+    return NULL;
+  }
+
+  /* Only members with child sets, or with a matching config ID, need be
+   * searched; walk both lists together, in position order.
+   */
+  ents = config_index_find_id(idx, cid, &nents);
+
+  i = j = 0;
+  while (i < idx->nsubs ||
+         j < nents) {
+    pr_signals_handle();
+
+    if (j >= nents ||
+        (i < idx->nsubs &&
+         idx->subs[i].pos <= ents[j].pos)) {
+      if (j < nents &&
+          ents[j].pos == idx->subs[i].pos) {
+        j++;
+      }
+
+      c = idx->subs[i++].c;
+
+    } else {
+      c = ents[j++].c;
+    }
+
+    if (config_skip_rec(c, flags)) {
+      continue;
+    }
+
+    res = config_find_rec(c, type, cid, flags);
+    if (res != NULL) {
+      return res;
+    }
+  }
+
+  return NULL;
+}
+
+/* Implements find_config2() for lookups by config ID, with the same search
+ * order as find_config_next2().
+ */
+static config_rec *config_find_id(xaset_t *set, int type, unsigned int cid,
+    int recurse, unsigned long flags) {
+  struct config_index *idx;
+  config_rec *c, *res;
+
+  idx = config_index_get(set);
+
+  if (recurse) {
+    /* Search the child sets of all members first. */
+    if (idx != NULL) {
+      unsigned int i;
+
+      for (i = 0; i < idx->nsubs; i++) {
+        c = idx->subs[i].c;
+
+        if (c->subset != NULL &&
+            c->subset->xas_list != NULL) {
+          res = config_find_set(c->subset, type, cid, flags);
+          if (res != NULL) {
+            return res;
+          }
+        }
+      }
+
+    } else {
+      for (c = (config_rec *) set->xas_list; c; c = c->next) {
+        if (c->subset != NULL &&
+            c->subset->xas_list != NULL) {
+          res = config_find_set(c->subset, type, cid, flags);
+          if (res != NULL) {
+            return res;
+          }
+        }
+      }
+    }
+  }
+
+  if (idx != NULL) {
+    struct config_index_ent *ents;
+    unsigned int i, nents;
+
+    ents = config_index_find_id(idx, cid, &nents);
+    for (i = 0; i < nents; i++) {
+      if (ents[i].c->config_type == type) {
+        return ents[i].c;
+      }
+    }
+
+  } else {
+    for (c = (config_rec *) set->xas_list; c; c = c->next) {
+      pr_signals_handle();
+
+      if (c->config_type == type &&
+          c->config_id == cid) {
+        return c;
+      }
+    }
+  }
+
+  errno = ENOENT;
+  return NULL;
+}
+
 config_rec *find_config_next2(config_rec *prev, config_rec *c, int type,
     const char *name, int recurse, unsigned long flags) {
   config_rec *top = c;
@@ -634,6 +975,21 @@ config_rec *find_config2(xaset_t *set, int type, const char *name,
 
   find_config_set_top((config_rec *) set->xas_list);
 
+  /* Lookups of directives, by name, can use the indexes.  Directive
+   * config_recs always have the config ID for their name, so that (unlike
+   * e.g. <Directory> config_recs) they need not be compared by name.
+   */
+  if (type == CONF_PARAM &&
+      name != NULL &&
+      (recurse == 0 || recurse == 1)) {
+    unsigned int cid;
+
+    cid = pr_config_get_id(name);
+    if (cid != 0) {
+      return config_find_id(set, type, cid, recurse, flags);
+    }
+  }
+
   return find_config_next2(NULL, (config_rec *) set->xas_list, type, name,
     recurse, flags);
 }
@@ -527,6 +527,11 @@ int pr_data_open(char *filename, char *reason, int direction, off_t size) {
     return -1;
   }
 
+  /* The client may need the responses to its previous commands, e.g. to
+   * PASV, before it opens the data connection.
+   */
+  (void) pr_response_flush_pending();
+
   if ((session.sf_flags & SF_PASSIVE) ||
       (session.sf_flags & SF_EPSV_ALL)) {
     /* For passive transfers, we expect there to already be an existing
@@ -1326,9 +1331,6 @@ int pr_data_xfer(char *cl_buf, size_t cl_size) {
 
       xferbuflen = buflen;
 
-      /* Fill up our internal buffer. */
-      memcpy(session.xfer.buf, cl_buf, buflen);
-
       /* We use ASCII translation if:
        *
        * - SF_ASCII_OVERRIDE session flag is set (e.g. for LIST/NLST)
@@ -1337,31 +1339,37 @@ int pr_data_xfer(char *cl_buf, size_t cl_size) {
       if ((session.sf_flags & SF_ASCII_OVERRIDE) ||
           ((session.sf_flags & SF_ASCII) &&
            !(data_opts & PR_DATA_OPT_IGNORE_ASCII))) {
-        char *out = NULL;
         size_t outlen = 0;
 
-        /* Use a temporary pool for the CRLF conversion, lest the
-         * session.xfer.p pool grow quite large while downloading a large
-         * file for ASCII conversion (Bug#4277).
+        /* Translate directly from the caller's buffer into our internal
+         * buffer, adding CRs as necessary.  The internal buffer is grown,
+         * once per transfer, to hold the worst case of a block containing
+         * only LF characters; this avoids allocating a new buffer for each
+         * block of a large file downloaded in ASCII mode (Bug#4277).
          */
-        tmp_pool = make_sub_pool(session.xfer.p);
-        pr_pool_tag(tmp_pool, "ASCII upload");
+        if (session.xfer.bufsize < (unsigned int) (buflen * 2)) {
+          session.xfer.bufsize = buflen * 2;
+          session.xfer.buf = pcalloc(session.xfer.p, session.xfer.bufsize + 1);
+          pr_trace_msg(trace_channel, 8,
+            "allocated ASCII data transfer buffer of %lu bytes",
+            (unsigned long) session.xfer.bufsize);
+          session.xfer.buf++;
+        }
 
-        /* Scan the internal buffer, looking for LFs with no preceding CRs.
-         * Add CRs (and expand the internal buffer) as necessary. xferbuflen
-         * will be adjusted so that it contains the length of data in
-         * the internal buffer, including any added CRs.
-         */
-        res = pr_ascii_ftp_to_crlf(tmp_pool, session.xfer.buf, xferbuflen,
-          &out, &outlen);
+        res = pr_ascii_ftp_to_crlf2(cl_buf, buflen, session.xfer.buf,
+          session.xfer.bufsize, &outlen);
         if (res < 0) {
           pr_trace_msg(trace_channel, 1, "error writing ASCII data: %s",
             strerror(errno));
+          memcpy(session.xfer.buf, cl_buf, buflen);
 
         } else {
-          session.xfer.buf = out;
           session.xfer.buflen = xferbuflen = outlen;
         }
+
+      } else {
+        /* Fill up our internal buffer. */
+        memcpy(session.xfer.buf, cl_buf, buflen);
       }
 
       bwrote = pr_netio_write(session.d->outstrm, session.xfer.buf, xferbuflen);
@@ -1436,6 +1444,373 @@ int pr_data_xfer(char *cl_buf, size_t cl_size) {
   return (len < 0 ? -1 : len);
 }
 
+int pr_data_xferv(const struct iovec *iov, int iovcnt) {
+  register int i;
+  int bwrote, total = 0;
+  size_t buflen = 0;
+
+  if (iov == NULL ||
+      iovcnt <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (i = 0; i < iovcnt; i++) {
+    buflen += iov[i].iov_len;
+  }
+
+  if (buflen == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* Data which is to be translated, or which cannot be written as it is,
+   * is handed to pr_data_xfer() one vector at a time.
+   */
+  if (session.d == NULL ||
+      session.xfer.direction != PR_NETIO_IO_WR ||
+      (session.sf_flags & SF_ASCII_OVERRIDE) ||
+      ((session.sf_flags & SF_ASCII) &&
+       !(data_opts & PR_DATA_OPT_IGNORE_ASCII))) {
+    for (i = 0; i < iovcnt; i++) {
+      int res;
+
+      if (iov[i].iov_len == 0) {
+        continue;
+      }
+
+      res = pr_data_xfer(iov[i].iov_base, iov[i].iov_len);
+      if (res < 0) {
+        return -1;
+      }
+
+      total += res;
+    }
+
+    return total;
+  }
+
+  /* Poll the control channel for any commands we should handle, like
+   * QUIT or ABOR.
+   */
+  poll_ctrl();
+
+  if (session.d == NULL) {
+    /* Closed by an ABOR. */
+    errno = ECONNABORTED;
+    return -1;
+  }
+
+  pr_signals_handle();
+
+  bwrote = pr_netio_writev(session.d->outstrm, iov, iovcnt);
+  while (bwrote < 0) {
+    int xerrno = errno;
+
+    if (xerrno == EAGAIN || xerrno == EINTR) {
+      /* As for pr_data_xfer(), delay temporarily, then try again. */
+      errno = EINTR;
+      pr_signals_handle();
+
+      bwrote = pr_netio_writev(session.d->outstrm, iov, iovcnt);
+      continue;
+    }
+
+    errno = xerrno;
+    return -1;
+  }
+
+  pr_trace_msg(trace_channel, 19, "wrote %d %s (%d %s) to network", bwrote,
+    bwrote != 1 ? "bytes" : "byte", iovcnt, iovcnt != 1 ? "vectors" : "vector");
+
+  if (bwrote > 0) {
+    if (data_first_byte_written == FALSE) {
+      if (pr_trace_get_level(timing_channel)) {
+        unsigned long elapsed_ms;
+        uint64_t write_ms;
+
+        pr_gettimeofday_millis(&write_ms);
+        elapsed_ms = (unsigned long) (write_ms - data_start_ms);
+
+        pr_trace_msg(timing_channel, 7,
+          "Time for first data byte written: %lu ms", elapsed_ms);
+      }
+
+      data_first_byte_written = TRUE;
+    }
+
+    if (timeout_stalled) {
+      pr_timer_reset(PR_TIMER_STALLED, ANY_MODULE);
+    }
+
+    if (timeout_idle) {
+      pr_timer_reset(PR_TIMER_IDLE, ANY_MODULE);
+    }
+  }
+
+  session.xfer.total_bytes += bwrote;
+  session.total_bytes += bwrote;
+  session.total_bytes_out += bwrote;
+
+  return bwrote;
+}
+
+#if defined(HAVE_SPLICE) && defined(SPLICE_F_MOVE)
+/* The pipe through which pr_data_splice() moves data; it lives as long as
+ * the transfer's pool.
+ */
+static int *data_splice_pipe = NULL;
+
+static void data_splice_pipe_cleanup(void *data) {
+  int *fds;
+
+  fds = data;
+  (void) close(fds[0]);
+  (void) close(fds[1]);
+
+  if (data_splice_pipe == fds) {
+    data_splice_pipe = NULL;
+  }
+}
+
+static int *data_splice_get_pipe(size_t count) {
+  int *fds;
+
+  if (data_splice_pipe != NULL) {
+    return data_splice_pipe;
+  }
+
+  if (session.xfer.p == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  fds = palloc(session.xfer.p, sizeof(int) * 2);
+  if (pipe(fds) < 0) {
+    return NULL;
+  }
+
+# if defined(F_SETPIPE_SZ)
+  /* Try to make the pipe large enough to hold all that the caller asks for
+   * at once; if not, we simply move less per call.
+   */
+  if (fcntl(fds[1], F_SETPIPE_SZ, (int) count) < 0) {
+    pr_trace_msg(trace_channel, 9, "unable to set splice pipe size to %lu: %s",
+      (unsigned long) count, strerror(errno));
+  }
+# endif /* F_SETPIPE_SZ */
+
+  register_cleanup(session.xfer.p, fds, data_splice_pipe_cleanup,
+    data_splice_pipe_cleanup);
+  data_splice_pipe = fds;
+
+  return data_splice_pipe;
+}
+
+/* Writes out the given number of bytes, waiting in the splice pipe, to the
+ * given file.
+ */
+static int data_splice_drain(int *fds, int fd, size_t count) {
+  while (count > 0) {
+    ssize_t res;
+
+    res = splice(fds[0], NULL, fd, NULL, count, SPLICE_F_MOVE);
+    if (res < 0) {
+      int xerrno = errno;
+
+      if (xerrno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      if (xerrno == EINVAL) {
+        char buf[PR_TUNABLE_XFER_BUFFER_SIZE];
+        ssize_t nread;
+
+        /* The file does not support splicing after all, e.g. due to its
+         * filesystem; the data is already in the pipe, so copy it out the
+         * old-fashioned way.
+         */
+        nread = read(fds[0], buf, count > sizeof(buf) ? sizeof(buf) : count);
+        if (nread <= 0) {
+          return -1;
+        }
+
+        res = write(fd, buf, nread);
+        if (res != nread) {
+          if (res >= 0) {
+            errno = EIO;
+          }
+
+          return -1;
+        }
+
+      } else {
+        errno = xerrno;
+        return -1;
+      }
+    }
+
+    count -= res;
+  }
+
+  return 0;
+}
+
+/* pr_data_splice() moves data from the data connection directly into the
+ * given file, without copying it through userspace.  No ASCII translation,
+ * and no NetIO processing, is performed; callers must only use it for
+ * transfers that need neither.
+ *
+ * Returns the number of bytes moved, 0 if the data connection closes, or -1
+ * on error.  An errno of ENOSYS means that no data was moved, and that the
+ * caller should use pr_data_xfer() instead.
+ */
+int pr_data_splice(int stor_fd, size_t count) {
+  int *fds, res, xerrno;
+  ssize_t len;
+
+  if (stor_fd < 0 ||
+      count == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (session.xfer.direction != PR_NETIO_IO_RD) {
+    errno = EPERM;
+    return -1;
+  }
+
+  /* Poll the control channel for any commands we should handle, like
+   * QUIT or ABOR.
+   */
+  poll_ctrl();
+
+  if (session.d == NULL ||
+      session.d->instrm == NULL) {
+    errno = ECONNABORTED;
+    return -1;
+  }
+
+  /* Any registered data NetIO, e.g. for TLS or MODE Z, needs to see the
+   * data, as do any listeners for the data read event.  The exception is
+   * TLS which the kernel is decrypting for us (kTLS); there, any non-data
+   * TLS record (e.g. the client's close_notify) makes splice(2) fail with
+   * EINVAL, handing the stream back to the NetIO.
+   */
+  if ((pr_get_netio(PR_NETIO_STRM_DATA) != NULL &&
+       pr_table_get(session.d->instrm->notes, "mod_tls.ktls-recv",
+         NULL) == NULL) ||
+      pr_event_listening("core.data-read") > 0) {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  if (count > INT_MAX) {
+    count = INT_MAX;
+  }
+
+  fds = data_splice_get_pipe(count);
+  if (fds == NULL) {
+    xerrno = errno;
+
+    pr_trace_msg(trace_channel, 3, "error creating splice pipe: %s",
+      strerror(xerrno));
+    errno = ENOSYS;
+    return -1;
+  }
+
+  while (TRUE) {
+    res = pr_netio_poll(session.d->instrm);
+    if (res == 1) {
+      /* pr_netio_poll() returns 1 only if the stream has been aborted. */
+      errno = ECONNABORTED;
+      return -1;
+    }
+
+    if (res < 0) {
+      return -1;
+    }
+
+    len = splice(PR_NETIO_FD(session.d->instrm), NULL, fds[1], NULL, count,
+      SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+    if (len >= 0) {
+      break;
+    }
+
+    xerrno = errno;
+    if (xerrno == EINTR ||
+        xerrno == EAGAIN) {
+      pr_signals_handle();
+      continue;
+    }
+
+    if (xerrno == EINVAL ||
+        xerrno == ENOSYS) {
+      pr_trace_msg(trace_channel, 3,
+        "unable to splice from data connection: %s", strerror(xerrno));
+      errno = ENOSYS;
+      return -1;
+    }
+
+    session.d->instrm->strm_errno = xerrno;
+    errno = xerrno;
+    return -1;
+  }
+
+  if (len == 0) {
+    return 0;
+  }
+
+  if (data_first_byte_read == FALSE) {
+    if (pr_trace_get_level(timing_channel)) {
+      unsigned long elapsed_ms;
+      uint64_t read_ms;
+
+      pr_gettimeofday_millis(&read_ms);
+      elapsed_ms = (unsigned long) (read_ms - data_start_ms);
+
+      pr_trace_msg(timing_channel, 7,
+        "Time for first data byte read: %lu ms", elapsed_ms);
+    }
+
+    data_first_byte_read = TRUE;
+  }
+
+  pr_trace_msg(trace_channel, 19, "spliced %ld %s from network", (long) len,
+    len != 1 ? "bytes" : "byte");
+
+  if (data_splice_drain(fds, stor_fd, len) < 0) {
+    xerrno = errno;
+
+    pr_trace_msg(trace_channel, 1, "error writing spliced data to file: %s",
+      strerror(xerrno));
+    errno = xerrno;
+    return -1;
+  }
+
+  if (timeout_stalled) {
+    pr_timer_reset(PR_TIMER_STALLED, ANY_MODULE);
+  }
+
+  if (timeout_idle) {
+    pr_timer_reset(PR_TIMER_IDLE, ANY_MODULE);
+  }
+
+  session.xfer.total_bytes += len;
+  session.total_bytes += len;
+  session.total_bytes_in += len;
+  session.total_raw_in += len;
+
+  return (int) len;
+}
+#else
+int pr_data_splice(int stor_fd, size_t count) {
+  errno = ENOSYS;
+  return -1;
+}
+#endif /* HAVE_SPLICE */
+
 #ifdef HAVE_SENDFILE
 /* pr_data_sendfile() actually transfers the data on the data connection.
  * ASCII translation is not performed.
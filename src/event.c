@@ -26,9 +26,11 @@
 
 #include "conf.h"
 
-/* Note: as more events are added, and as this API grows more and more used
- * by the core code, look into using a different ADT for storage/retrieval
- * of these objects, such as hash tables.
+/* Event names are interned: the first registration (or lookup) of a name
+ * assigns it a small integer ID, which indexes directly into the table of
+ * handler lists.  Callers which generate an event often can look up its ID
+ * once, and then generate it, or check for listeners, without any string
+ * comparisons.
  */
 
 struct event_handler {
@@ -41,16 +43,34 @@ struct event_handler {
 
 struct event_list {
   struct event_list *next;
-  pool *pool;
   const char *event;
   size_t event_len;
+  unsigned int hash;
+  unsigned int id;
+  unsigned long flags;
   struct event_handler *handlers;
 };
 
+/* The handlers are allocated out of event_pool.  The interned names, and
+ * the ID-indexed tables, live in their own pool, so that the IDs handed
+ * out remain valid even if event_pool is destroyed.
+ */
 static pool *event_pool = NULL;
-static struct event_list *events = NULL;
+static pool *event_id_pool = NULL;
+
+#define EVENT_POOL_SZ		256
+#define EVENT_HASH_SIZE		128
+#define EVENT_TABLE_MIN_SIZE	64
+
+static struct event_list *event_buckets[EVENT_HASH_SIZE];
+static struct event_list **event_table = NULL;
+static unsigned int event_tablesz = 0;
+
+/* There are never any listeners for event ID 0. */
+static unsigned int event_no_listeners = 0;
+unsigned int *pr_event_listeners = &event_no_listeners;
+unsigned int pr_event_max_id = 0;
 
-static const char *curr_event = NULL;
 static struct event_list *curr_evl = NULL;
 static struct event_handler *curr_evh = NULL;
 
@@ -71,15 +91,134 @@ static const char *untraced_events[] = {
 
 static const char *trace_channel = "event";
 
-#define EVENT_POOL_SZ	256
+static unsigned int event_hash(const char *event, size_t *event_len) {
+  register const unsigned char *ptr;
+  unsigned int hash = 5381;
+
+  for (ptr = (const unsigned char *) event; *ptr; ptr++) {
+    hash = (hash * 33) + *ptr;
+  }
+
+  *event_len = ptr - (const unsigned char *) event;
+  return hash;
+}
+
+static struct event_list *event_lookup(const char *event) {
+  struct event_list *evl;
+  unsigned int hash;
+  size_t event_len;
+
+  hash = event_hash(event, &event_len);
+
+  for (evl = event_buckets[hash % EVENT_HASH_SIZE]; evl; evl = evl->next) {
+    if (evl->hash == hash &&
+        evl->event_len == event_len &&
+        memcmp(evl->event, event, event_len) == 0) {
+      return evl;
+    }
+  }
+
+  return NULL;
+}
+
+/* Grows the ID-indexed tables, when all of their slots are taken.  Old
+ * tables are left in the pool; as the tables double in size, this is
+ * bounded by the size of the final tables.
+ */
+static void event_table_grow(void) {
+  struct event_list **table;
+  unsigned int *listeners, tablesz;
+
+  tablesz = event_tablesz > 0 ? event_tablesz * 2 : EVENT_TABLE_MIN_SIZE;
+
+  table = pcalloc(event_id_pool, tablesz * sizeof(struct event_list *));
+  listeners = pcalloc(event_id_pool, tablesz * sizeof(unsigned int));
+
+  if (event_tablesz > 0) {
+    memcpy(table, event_table, event_tablesz * sizeof(struct event_list *));
+    memcpy(listeners, pr_event_listeners,
+      event_tablesz * sizeof(unsigned int));
+  }
+
+  event_table = table;
+  event_tablesz = tablesz;
+  pr_event_listeners = listeners;
+}
+
+static struct event_list *event_intern(const char *event) {
+  register unsigned int i;
+  struct event_list *evl;
+
+  evl = event_lookup(event);
+  if (evl != NULL) {
+    return evl;
+  }
+
+  if (event_id_pool == NULL) {
+    event_id_pool = make_sub_pool(NULL);
+    pr_pool_tag(event_id_pool, "Event ID Pool");
+  }
+
+  if (pr_event_max_id + 1 >= event_tablesz) {
+    event_table_grow();
+  }
+
+  evl = pcalloc(event_id_pool, sizeof(struct event_list));
+  evl->event = pstrdup(event_id_pool, event);
+  evl->hash = event_hash(evl->event, &evl->event_len);
+  evl->id = pr_event_max_id + 1;
+
+  /* Is this an untraced event? */
+  for (i = 0; untraced_events[i] != NULL; i++) {
+    if (strcmp(event, untraced_events[i]) == 0) {
+      evl->flags = PR_EVENT_FL_UNTRACED;
+      break;
+    }
+  }
+
+  evl->next = event_buckets[evl->hash % EVENT_HASH_SIZE];
+  event_buckets[evl->hash % EVENT_HASH_SIZE] = evl;
+
+  event_table[evl->id] = evl;
+  pr_event_max_id = evl->id;
+
+  pr_trace_msg(trace_channel, 9, "interned event '%s' as ID %u", evl->event,
+    evl->id);
+  return evl;
+}
+
+/* Called when event_pool, and with it every registered handler, is
+ * destroyed.  The interned IDs are kept.
+ */
+static void event_pool_cleanup(void *data) {
+  register unsigned int i;
+
+  for (i = 1; i <= pr_event_max_id; i++) {
+    event_table[i]->handlers = NULL;
+    pr_event_listeners[i] = 0;
+  }
+
+  event_pool = NULL;
+  curr_evl = NULL;
+  curr_evh = NULL;
+}
+
+int pr_event_get_id(const char *event) {
+  struct event_list *evl;
+
+  if (event == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  evl = event_intern(event);
+  return (int) evl->id;
+}
 
 int pr_event_register(module *m, const char *event,
     void (*cb)(const void *, void *), void *user_data) {
-  register unsigned int i;
-  struct event_handler *evh;
+  struct event_handler *evh, *evhi, *evhl = NULL;
   struct event_list *evl;
-  pool *evl_pool;
-  unsigned long flags = 0;
 
   if (event == NULL ||
       cb == NULL) {
@@ -90,114 +229,105 @@ int pr_event_register(module *m, const char *event,
   if (event_pool == NULL) {
     event_pool = make_sub_pool(permanent_pool);
     pr_pool_tag(event_pool, "Event Pool");
+    register_cleanup(event_pool, NULL, event_pool_cleanup, NULL);
   }
 
   pr_trace_msg(trace_channel, 3,
     "module '%s' (%p) registering handler for event '%s' (at %p)",
     m ? m->name : "(none)", m, event, cb);
 
-  evh = pcalloc(event_pool, sizeof(struct event_handler));
+  evl = event_intern(event);
 
-  evh->module = m;
-  evh->cb = cb;
-  evh->user_data = user_data;
+  /* Make sure this event handler is added to the START of the list, in order
+   * to preserve module load order handling of events (i.e. last module
+   * loaded, first module handled).  The exception to this rule are core
+   * callbacks (i.e. where m == NULL); these will always be invoked last.
+   *
+   * Before that, though, check for duplicate registration/subscription.
+   */
+  for (evhi = evl->handlers; evhi; evhi = evhi->next) {
+    pr_signals_handle();
 
-  /* Is this an untraced event? */
-  for (i = 0; untraced_events[i] != NULL; i++) {
-    if (strcmp(event, untraced_events[i]) == 0) {
-      flags = PR_EVENT_FL_UNTRACED;
-      break;
+    if (evhi->cb == cb) {
+      /* Duplicate callback */
+      errno = EEXIST;
+      return -1;
     }
+
+    evhl = evhi;
   }
 
-  evh->flags = flags;
+  evh = pcalloc(event_pool, sizeof(struct event_handler));
+  evh->module = m;
+  evh->cb = cb;
+  evh->user_data = user_data;
+  evh->flags = evl->flags;
 
-  /* Scan the currently registered lists, looking for where to add this
-   * registration.
-   */
+  if (evl->handlers == NULL) {
+    evl->handlers = evh;
 
-  for (evl = events; evl; evl = evl->next) {
-    if (strncmp(evl->event, event, evl->event_len + 1) == 0) {
-      struct event_handler *evhi, *evhl = NULL;
-
-      evhi = evl->handlers;
-      if (evhi) {
-        /* Make sure this event handler is added to the START of the list,
-         * in order to preserve module load order handling of events (i.e.
-         * last module loaded, first module handled).  The exception to this
-         * rule are core callbacks (i.e. where m == NULL); these will always
-         * be invoked last.
-         *
-         * Before that, though, check for duplicate registration/subscription.
-         */ 
-        while (evhi) {
-          pr_signals_handle();
-
-          if (evhi->cb == evh->cb) {
-            /* Duplicate callback */
-            errno = EEXIST;
-            return -1;
-          }
-
-          evhl = evhi;
-
-          if (evhi->next == NULL) {
-            break;
-          }
-
-          evhi = evhi->next;
-        }
-
-        if (evh->module != NULL) {
-          if (evl->handlers->next != NULL) {
-            evl->handlers->next->prev = evh;
-          }
-
-          evh->next = evl->handlers;
-          evl->handlers = evh;
-
-        } else {
-          /* Core event listeners go at the end. */
-          evhl->next = evh;
-          evh->prev = evhl;
-        }
+  } else if (evh->module != NULL) {
+    evl->handlers->prev = evh;
+    evh->next = evl->handlers;
+    evl->handlers = evh;
 
-      } else {
-        evl->handlers = evh;
-      }
-
-      /* All done */
-      return 0;
-    }
+  } else {
+    /* Core event listeners go at the end. */
+    evhl->next = evh;
+    evh->prev = evhl;
   }
 
-  evl_pool = pr_pool_create_sz(event_pool, EVENT_POOL_SZ);
-  pr_pool_tag(evl_pool, "Event listener list pool");
-
-  evl = pcalloc(evl_pool, sizeof(struct event_list));
-  evl->pool = evl_pool;
-  evl->event = pstrdup(evl->pool, event);
-  evl->event_len = strlen(evl->event);
-  evl->handlers = evh; 
-  evl->next = events;
-
-  events = evl;
+  pr_event_listeners[evl->id]++;
 
   /* Clear any cached data. */
-  curr_event = NULL;
   curr_evl = NULL;
   curr_evh = NULL;
 
   return 0;
 }
 
+static int event_unregister_list(struct event_list *evl, module *m,
+    void (*cb)(const void *, void *)) {
+  struct event_handler *evh;
+  int unregistered = FALSE;
+
+  for (evh = evl->handlers; evh;) {
+    if ((m == NULL || evh->module == m) &&
+        (cb == NULL || evh->cb == cb)) {
+      struct event_handler *tmp = evh->next;
+
+      if (evh->next) {
+        evh->next->prev = evh->prev;
+      }
+
+      if (evh->prev) {
+        evh->prev->next = evh->next;
+
+      } else {
+        /* This is the head of the list. */
+        evl->handlers = evh->next;
+      }
+
+      evh->module = NULL;
+      evh = tmp;
+      pr_event_listeners[evl->id]--;
+      unregistered = TRUE;
+
+    } else {
+      evh = evh->next;
+    }
+  }
+
+  return unregistered;
+}
+
 int pr_event_unregister(module *m, const char *event,
     void (*cb)(const void *, void *)) {
-  struct event_list *evl;
   int unregistered = FALSE;
 
-  if (!events)
+  if (pr_event_max_id == 0) {
     return 0;
+  }
 
   pr_trace_msg(trace_channel, 3,
     "module '%s' (%p) unregistering handler for event '%s'",
@@ -209,51 +339,27 @@ int pr_event_unregister(module *m, const char *event,
    * grow unnecessarily.
    */
 
-  for (evl = events; evl; evl = evl->next) {
-    pr_signals_handle();
-
-    if (event == NULL ||
-        strncmp(evl->event, event, evl->event_len + 1) == 0) {
-      struct event_handler *evh;
-
-      /* If there are no handlers for this event, there is nothing to
-       * unregister.  Skip on to the next list.
-       */
-      if (!evl->handlers) {
-        continue;
-      }
+  if (event != NULL) {
+    struct event_list *evl;
 
-      for (evh = evl->handlers; evh;) {
-
-        if ((m == NULL || evh->module == m) &&
-            (cb == NULL || evh->cb == cb)) { 
-          struct event_handler *tmp = evh->next;
-
-          if (evh->next) {
-            evh->next->prev = evh->prev;
-          }
+    evl = event_lookup(event);
+    if (evl != NULL) {
+      unregistered = event_unregister_list(evl, m, cb);
+    }
 
-          if (evh->prev) {
-            evh->prev->next = evh->next;
+  } else {
+    register unsigned int i;
 
-          } else {
-            /* This is the head of the list. */
-            evl->handlers = evh->next;
-          }
+    for (i = 1; i <= pr_event_max_id; i++) {
+      pr_signals_handle();
 
-          evh->module = NULL;
-          evh = tmp;
-          unregistered = TRUE;
-  
-        } else {
-          evh = evh->next;
-        }
+      if (event_unregister_list(event_table[i], m, cb) == TRUE) {
+        unregistered = TRUE;
       }
     }
   }
 
   /* Clear any cached data. */
-  curr_event = NULL;
   curr_evl = NULL;
   curr_evh = NULL;
 
@@ -267,142 +373,137 @@ int pr_event_unregister(module *m, const char *event,
 
 int pr_event_listening(const char *event) {
   struct event_list *evl;
-  int count = 0;
 
   if (event == NULL) {
     errno = EINVAL;
     return -1;
   }
 
-  if (events == NULL) {
-    /* No registered listeners at all. */
+  evl = event_lookup(event);
+  if (evl == NULL) {
+    /* No registered listeners for this event. */
     return 0;
   }
 
-  /* Lookup callbacks for this event. */
-  for (evl = events; evl; evl = evl->next) {
-
-    if (strncmp(evl->event, event, evl->event_len + 1) == 0) {
-      struct event_handler *evh;
-
-      /* If there are no registered callbacks for this event, be done. */
-      if (evl->handlers == NULL) {
-        return 0;
-      }
- 
-      for (evh = evl->handlers; evh; evh = evh->next) {
-        count++;
-      }
-
-      break;
-    }
-  }
-
-  return count; 
+  return (int) pr_event_listeners[evl->id];
 }
 
-void pr_event_generate(const char *event, const void *event_data) {
+static void event_dispatch(struct event_list *evl, const void *event_data) {
   int use_cache = FALSE;
-  struct event_list *evl;
+  struct event_handler *evh;
 
-  if (!event)
-    return;
+  /* If there are no registered callbacks for this event, be done. */
+  if (evl->handlers == NULL) {
+    if (!(evl->flags & PR_EVENT_FL_UNTRACED)) {
+      pr_trace_msg(trace_channel, 8, "no event handlers registered for '%s'",
+        evl->event);
+    }
 
-  /* If there are no registered callbacks, be done. */
-  if (!events)
     return;
+  }
 
-  /* If there is a cached event, see if the given event matches. */
-  if (curr_event &&
-      strcmp(curr_event, event) == 0) {
+  /* If this event is being generated by one of its own listeners, resume
+   * with the listener after that one.
+   */
+  if (curr_evl == evl) {
     use_cache = TRUE;
   }
 
-  /* Lookup callbacks for this event. */
-  for (evl = use_cache ? curr_evl : events; evl; evl = evl->next) {
+  curr_evl = evl;
 
-    if (strncmp(evl->event, event, evl->event_len + 1) == 0) {  
-      struct event_handler *evh;
+  for (evh = use_cache ? curr_evh : evl->handlers; evh; evh = evh->next) {
+    /* Make sure that if the same event is generated by the current
+     * listener, the next time through we go to the next listener, rather
+     * sending the same event against to the same listener (Bug#3619).
+     */
+    curr_evh = evh->next;
 
-      /* If there are no registered callbacks for this event, be done. */
-      if (!evl->handlers) {
-        pr_trace_msg(trace_channel, 8, "no event handlers registered for '%s'",
-          event);
-        return;
-      }
+    if (!(evh->flags & PR_EVENT_FL_UNTRACED)) {
+      if (evh->module) {
+        pr_trace_msg(trace_channel, 8,
+          "dispatching event '%s' to mod_%s (at %p, use cache = %s)",
+          evl->event, evh->module->name, evh->cb,
+          use_cache ? "true" : "false");
 
-      curr_event = event;
-      curr_evl = evl;
-
-      for (evh = use_cache ? curr_evh : evl->handlers; evh; evh = evh->next) {
-        /* Make sure that if the same event is generated by the current
-         * listener, the next time through we go to the next listener, rather
-         * sending the same event against to the same listener (Bug#3619).
-         */
-        curr_evh = evh->next;
-
-        if (!(evh->flags & PR_EVENT_FL_UNTRACED)) {
-          if (evh->module) {
-            pr_trace_msg(trace_channel, 8,
-              "dispatching event '%s' to mod_%s (at %p, use cache = %s)", event,
-              evh->module->name, evh->cb, use_cache ? "true" : "false");
-
-          } else {
-            pr_trace_msg(trace_channel, 8,
-              "dispatching event '%s' to core (at %p, use cache = %s)", event,
-              evh->cb, use_cache ? "true" : "false");
-          }
-        }
-
-        evh->cb(event_data, evh->user_data);
+      } else {
+        pr_trace_msg(trace_channel, 8,
+          "dispatching event '%s' to core (at %p, use cache = %s)",
+          evl->event, evh->cb, use_cache ? "true" : "false");
       }
-
-      break;
     }
+
+    evh->cb(event_data, evh->user_data);
   }
 
   /* Clear any cached data after publishing the event to all interested
    * listeners.
    */
-  curr_event = NULL;
   curr_evl = NULL;
   curr_evh = NULL;
-
-  return;
 }
 
-void pr_event_dump(void (*dumpf)(const char *, ...)) {
+void pr_event_generate(const char *event, const void *event_data) {
   struct event_list *evl;
 
-  if (!dumpf) {
+  if (event == NULL) {
     return;
   }
 
-  if (!events) {
-    dumpf("%s", "No events registered");
+  /* If there are no registered callbacks, be done. */
+  if (event_pool == NULL) {
+    return;
+  }
+
+  evl = event_lookup(event);
+  if (evl == NULL) {
     return;
   }
 
-  for (evl = events; evl; evl = evl->next) {
+  event_dispatch(evl, event_data);
+}
+
+void pr_event_generate_id(int event_id, const void *event_data) {
+  if (PR_EVENT_LISTENING(event_id) == 0) {
+    return;
+  }
+
+  event_dispatch(event_table[event_id], event_data);
+}
+
+void pr_event_dump(void (*dumpf)(const char *, ...)) {
+  register unsigned int i;
+  int dumped = FALSE;
+
+  if (!dumpf) {
+    return;
+  }
+
+  for (i = 1; i <= pr_event_max_id; i++) {
+    struct event_list *evl;
+    struct event_handler *evh;
+
     pr_signals_handle();
 
+    /* Events which have only been interned are not of interest. */
+    evl = event_table[i];
     if (evl->handlers == NULL) {
-      dumpf("No handlers registered for '%s'", evl->event);
-
-    } else { 
-      struct event_handler *evh;
+      continue;
+    }
 
-      dumpf("Registered for '%s':", evl->event);
-      for (evh = evl->handlers; evh; evh = evh->next) {
-        if (evh->module != NULL) {
-          dumpf("  mod_%s.c", evh->module->name);
+    dumpf("Registered for '%s':", evl->event);
+    for (evh = evl->handlers; evh; evh = evh->next) {
+      if (evh->module != NULL) {
+        dumpf("  mod_%s.c", evh->module->name);
 
-        } else {
-          dumpf("  (core)");
-        }
+      } else {
+        dumpf("  (core)");
       }
     }
+
+    dumped = TRUE;
   }
 
-  return;
+  if (!dumped) {
+    dumpf("%s", "No events registered");
+  }
 }
@@ -63,6 +63,20 @@ static size_t copy_iter_count = 0;
 # define COPY_PROGRESS_NTH_ITER       50000
 #endif
 
+/* How much to ask copy_file_range(2) to copy at a time; small enough that
+ * the progress callback still gets to reset timers during long copies.
+ */
+#ifndef COPY_FILE_RANGE_CHUNK_SIZE
+# define COPY_FILE_RANGE_CHUNK_SIZE   (8 * 1024 * 1024)
+#endif
+
+/* Reflinking a file; from <linux/fs.h>, which cannot be included along with
+ * <sys/mount.h> on some systems.
+ */
+#if defined(__linux__) && defined(HAVE_SYS_IOCTL_H) && !defined(FICLONE)
+# define FICLONE	_IOW(0x94, 9, int)
+#endif
+
 /* For determining whether a file is on an NFS filesystem.  Note that
  * this value is Linux specific.  See Bug#3874 for details.
  */
@@ -1739,13 +1753,154 @@ void pr_fs_clear_cache(void) {
 
 /* FS functions proper */
 
+/* Reports the given number of copied bytes to the progress callback, in
+ * pieces of the size that the read/write loop would have reported.
+ */
+static void copy_report_progress(void (*progress_cb)(int), off_t len,
+    size_t bufsz) {
+  while (len > 0) {
+    int n;
+
+    n = len > (off_t) bufsz ? (int) bufsz : (int) len;
+    if (progress_cb != NULL) {
+      (progress_cb)(n);
+
+    } else {
+      copy_progress_cb(n);
+    }
+
+    len -= n;
+  }
+}
+
+/* Copies the file contents in the kernel, by reflinking (FICLONE) where the
+ * filesystem supports it, else using copy_file_range(2).  This is only done
+ * for regular files handled entirely by the core FS, so that FS modules with
+ * their own read/write callbacks always see the data.
+ *
+ * Returns 1 if the contents were copied, 0 if the caller should copy (the
+ * rest of) the contents itself, or -1 on error.
+ */
+static int copy_file_fast(pr_fh_t *src_fh, pr_fh_t *dst_fh,
+    struct stat *src_st, struct stat *dst_st, size_t bufsz,
+    void (*progress_cb)(int)) {
+#if defined(FICLONE) || defined(HAVE_COPY_FILE_RANGE)
+  int src_fd, dst_fd;
+  off_t copied = 0;
+  pr_fs_t *fs;
+
+  /* Find the read/write handlers that pr_fsio_read()/pr_fsio_write() would
+   * use.
+   */
+  fs = src_fh->fh_fs;
+  while (fs != NULL && fs->fs_next != NULL && fs->read == NULL) {
+    fs = fs->fs_next;
+  }
+
+  if (fs == NULL ||
+      fs->read != sys_read) {
+    return 0;
+  }
+
+  fs = dst_fh->fh_fs;
+  while (fs != NULL && fs->fs_next != NULL && fs->write == NULL) {
+    fs = fs->fs_next;
+  }
+
+  if (fs == NULL ||
+      fs->write != sys_write) {
+    return 0;
+  }
+
+  if (!S_ISREG(src_st->st_mode) ||
+      !S_ISREG(dst_st->st_mode) ||
+      src_st->st_size == 0) {
+    return 0;
+  }
+
+  src_fd = PR_FH_FD(src_fh);
+  dst_fd = PR_FH_FD(dst_fh);
+
+# if defined(FICLONE)
+  if (ioctl(dst_fd, FICLONE, src_fd) == 0) {
+    pr_trace_msg(trace_channel, 14, "reflinked '%s' to '%s' (%" PR_LU
+      " bytes)", src_fh->fh_path, dst_fh->fh_path,
+      (pr_off_t) src_st->st_size);
+    copy_report_progress(progress_cb, src_st->st_size, bufsz);
+    return 1;
+  }
+
+  pr_trace_msg(trace_channel, 19, "unable to reflink '%s' to '%s': %s",
+    src_fh->fh_path, dst_fh->fh_path, strerror(errno));
+# endif /* FICLONE */
+
+# if defined(HAVE_COPY_FILE_RANGE)
+  while (TRUE) {
+    ssize_t res;
+
+    pr_signals_handle();
+
+    res = copy_file_range(src_fd, NULL, dst_fd, NULL,
+      COPY_FILE_RANGE_CHUNK_SIZE, 0);
+    if (res < 0) {
+      int xerrno = errno;
+
+      if (xerrno == EINTR) {
+        continue;
+      }
+
+      if (xerrno == EXDEV ||
+          xerrno == EINVAL ||
+          xerrno == ENOSYS ||
+          xerrno == EOPNOTSUPP ||
+          xerrno == EBADF) {
+        /* Not supported for these files; since copy_file_range(2) advances
+         * the file offsets, the caller's loop picks up where we left off.
+         */
+        pr_trace_msg(trace_channel, 19,
+          "unable to use copy_file_range(2) for '%s': %s", src_fh->fh_path,
+          strerror(xerrno));
+        return 0;
+      }
+
+      errno = xerrno;
+      return -1;
+    }
+
+    if (res == 0) {
+      break;
+    }
+
+    copied += res;
+    copy_report_progress(progress_cb, res, bufsz);
+  }
+
+  /* Some filesystems (e.g. procfs) report EOF without copying anything; let
+   * the caller read whatever there is.
+   */
+  if (copied < src_st->st_size) {
+    return 0;
+  }
+
+  pr_trace_msg(trace_channel, 14, "copied '%s' to '%s' (%" PR_LU
+    " bytes) using copy_file_range(2)", src_fh->fh_path, dst_fh->fh_path,
+    (pr_off_t) copied);
+  return 1;
+# else
+  return 0;
+# endif /* HAVE_COPY_FILE_RANGE */
+#else
+  return 0;
+#endif /* FICLONE or HAVE_COPY_FILE_RANGE */
+}
+
 int pr_fs_copy_file2(const char *src, const char *dst, int flags,
     void (*progress_cb)(int)) {
   pr_fh_t *src_fh, *dst_fh;
   struct stat src_st, dst_st;
   char *buf;
   size_t bufsz;
-  int dst_existed = FALSE, res;
+  int copied, dst_existed = FALSE, res;
 #ifdef PR_USE_XATTR
   array_header *xattrs = NULL;
 #endif /* PR_USE_XATTR */
@@ -1903,7 +2058,34 @@ int pr_fs_copy_file2(const char *src, const char *dst, int flags,
   }
 #endif
 
-  while ((res = pr_fsio_read(src_fh, buf, bufsz)) > 0) {
+  copied = copy_file_fast(src_fh, dst_fh, &src_st, &dst_st, bufsz,
+    progress_cb);
+  if (copied < 0) {
+    int xerrno = errno;
+
+    (void) pr_fsio_close(src_fh);
+    (void) pr_fsio_close(dst_fh);
+
+    /* Don't unlink the destination file if it already existed. */
+    if (!dst_existed) {
+      if (!(flags & PR_FSIO_COPY_FILE_FL_NO_DELETE_ON_FAILURE)) {
+        if (pr_fsio_unlink(dst) < 0) {
+          pr_trace_msg(trace_channel, 12,
+            "error deleting failed copy of '%s': %s", dst, strerror(errno));
+        }
+      }
+    }
+
+    pr_log_pri(PR_LOG_WARNING, "error copying to '%s': %s", dst,
+      strerror(xerrno));
+    free(buf);
+
+    errno = xerrno;
+    return -1;
+  }
+
+  while (copied == 0 &&
+         (res = pr_fsio_read(src_fh, buf, bufsz)) > 0) {
     size_t datalen;
     off_t offset;
 
@@ -6568,11 +6750,19 @@ char *pr_fsio_getline(char *buf, size_t buflen, pr_fh_t *fh,
 #define FSIO_MAX_FD_COUNT		1024
 
 void pr_fs_close_extra_fds(void) {
-  register unsigned int i;
+  pr_fs_close_extra_fds2(STDERR_FILENO + 1);
+}
+
+void pr_fs_close_extra_fds2(int lowfd) {
+  register int i;
   long nfiles = 0;
   struct rlimit rlim;
 
-  /* Close any but the big three open fds.
+  if (lowfd <= STDERR_FILENO) {
+    lowfd = STDERR_FILENO + 1;
+  }
+
+  /* Close any but the big three open fds (and those below lowfd).
    *
    * First, use getrlimit() to obtain the maximum number of open files
    * for this process -- then close that number.
@@ -6613,7 +6803,7 @@ void pr_fs_close_extra_fds(void) {
   }
 
   /* Close the "non-standard" file descriptors. */
-  for (i = 3; i < nfiles; i++) {
+  for (i = lowfd; i < nfiles; i++) {
     /* This is a potentially long-running loop, so handle signals. */
     pr_signals_handle();
     (void) close(i);
@@ -6971,7 +7161,7 @@ int pr_fs_fgetsize(int fd, off_t *fs_size) {
 }
 
 void pr_fs_fadvise(int fd, off_t offset, off_t len, int advice) {
-#if defined(HAVE_POSIX_ADVISE)
+#if defined(HAVE_POSIX_FADVISE)
   int res, posix_advice;
   const char *advice_str;
 
@@ -7015,18 +7205,208 @@ void pr_fs_fadvise(int fd, off_t offset, off_t len, int advice) {
       return;
   }
 
+  /* Note that posix_fadvise(3) returns the error number, rather than
+   * setting errno.
+   */
   res = posix_fadvise(fd, offset, len, posix_advice);
-  if (res < 0) {
+  if (res != 0) {
     pr_trace_msg(trace_channel, 9,
       "posix_fadvise() error on fd %d (off %" PR_LU ", len %" PR_LU ", "
       "advice %s): %s", fd, (pr_off_t) offset, (pr_off_t) len, advice_str,
-      strerror(errno));
+      strerror(res));
   }
 #endif
 
   return;
 }
 
+struct fh_readahead_rec {
+  off_t min_window;
+  off_t max_window;
+  int flags;
+
+  /* The offset at which the next sequential access is expected, or -1 if
+   * there have been no accesses yet.
+   */
+  off_t next_offset;
+
+  /* The current window size, and the end of the range already advised to
+   * be read ahead.
+   */
+  off_t window;
+  off_t ahead_end;
+
+  /* The end of the range already dropped from the page cache. */
+  off_t behind_end;
+};
+
+static off_t fs_get_pagesz(void) {
+  long pagesz = 4096;
+
+#if defined(_SC_PAGESIZE)
+  pagesz = sysconf(_SC_PAGESIZE);
+#elif defined(_SC_PAGE_SIZE)
+  pagesz = sysconf(_SC_PAGE_SIZE);
+#endif /* !_SC_PAGESIZE and !_SC_PAGE_SIZE */
+
+  if (pagesz <= 0) {
+    pagesz = 4096;
+  }
+
+  return (off_t) pagesz;
+}
+
+int pr_fsio_set_readahead(pr_fh_t *fh, off_t min_window, off_t max_window,
+    int flags) {
+  struct fh_readahead_rec *ra;
+
+  if (fh == NULL ||
+      min_window < 0 ||
+      max_window < min_window) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* A zero window disables read-ahead for this handle. */
+  if (min_window == 0) {
+    fh->fh_readahead = NULL;
+    return 0;
+  }
+
+  ra = fh->fh_readahead;
+  if (ra == NULL) {
+    ra = pcalloc(fh->fh_pool, sizeof(struct fh_readahead_rec));
+    fh->fh_readahead = ra;
+  }
+
+  ra->min_window = min_window;
+  ra->max_window = max_window;
+  ra->flags = flags;
+  ra->next_offset = -1;
+  ra->window = min_window;
+  ra->ahead_end = 0;
+  ra->behind_end = 0;
+
+  pr_trace_msg(trace_channel, 15, "enabled read-ahead for '%s' (window "
+    "%" PR_LU "-%" PR_LU " bytes%s)", fh->fh_path, (pr_off_t) min_window,
+    (pr_off_t) max_window,
+    flags & PR_FSIO_READAHEAD_FL_DROP_BEHIND ? ", dropping behind" : "");
+  return 0;
+}
+
+void pr_fsio_readahead(pr_fh_t *fh, off_t offset, off_t len) {
+  struct fh_readahead_rec *ra;
+  off_t pos;
+
+  if (fh == NULL ||
+      fh->fh_readahead == NULL ||
+      offset < 0 ||
+      len <= 0) {
+    return;
+  }
+
+  ra = fh->fh_readahead;
+  pos = offset + len;
+
+  if (ra->next_offset < 0 ||
+      offset != ra->next_offset) {
+    off_t pagesz;
+
+    if (ra->next_offset >= 0) {
+      pr_trace_msg(trace_channel, 17, "non-sequential read of '%s' at offset "
+        "%" PR_LU " (expected %" PR_LU "), resetting read-ahead window",
+        fh->fh_path, (pr_off_t) offset, (pr_off_t) ra->next_offset);
+    }
+
+    /* Start over from this offset.  Nothing before it is dropped, as this
+     * handle has not necessarily read it.
+     */
+    pagesz = fs_get_pagesz();
+    ra->window = ra->min_window;
+    ra->ahead_end = pos;
+    ra->behind_end = offset - (offset % pagesz);
+  }
+
+  ra->next_offset = pos;
+
+  if (ra->ahead_end < pos) {
+    ra->ahead_end = pos;
+  }
+
+  /* Advise the next window once less than half of the current window
+   * remains ahead of the current offset, and grow the window, up to its
+   * maximum, for as long as the accesses remain sequential.
+   */
+  if (ra->ahead_end - pos < ra->window / 2) {
+    pr_trace_msg(trace_channel, 19, "reading ahead %" PR_LU " bytes of '%s' "
+      "from offset %" PR_LU, (pr_off_t) ra->window, fh->fh_path,
+      (pr_off_t) ra->ahead_end);
+    pr_fs_fadvise(fh->fh_fd, ra->ahead_end, ra->window,
+      PR_FS_FADVISE_WILLNEED);
+    ra->ahead_end += ra->window;
+
+    if (ra->window < ra->max_window) {
+      ra->window *= 2;
+      if (ra->window > ra->max_window) {
+        ra->window = ra->max_window;
+      }
+    }
+  }
+
+  if (ra->flags & PR_FSIO_READAHEAD_FL_DROP_BEHIND) {
+    off_t drop_end, pagesz;
+
+    /* Keep the most recent window's worth, which may still be in flight
+     * (e.g. from sendfile(2)), and only drop whole pages, in batches.
+     */
+    pagesz = fs_get_pagesz();
+    drop_end = pos - ra->window;
+    drop_end -= (drop_end % pagesz);
+
+    if (drop_end - ra->behind_end >= ra->min_window) {
+      pr_trace_msg(trace_channel, 19, "dropping %" PR_LU " bytes of '%s' "
+        "from offset %" PR_LU, (pr_off_t) (drop_end - ra->behind_end),
+        fh->fh_path, (pr_off_t) ra->behind_end);
+      pr_fs_fadvise(fh->fh_fd, ra->behind_end, drop_end - ra->behind_end,
+        PR_FS_FADVISE_DONTNEED);
+      ra->behind_end = drop_end;
+    }
+  }
+}
+
+int pr_fs_set_direct_io(int fd, int use_direct) {
+#if defined(O_DIRECT)
+  int flags;
+
+  flags = fcntl(fd, F_GETFL);
+  if (flags < 0) {
+    return -1;
+  }
+
+  if (use_direct) {
+    flags |= O_DIRECT;
+
+  } else {
+    flags &= ~O_DIRECT;
+  }
+
+  if (fcntl(fd, F_SETFL, flags) < 0) {
+    int xerrno = errno;
+
+    pr_trace_msg(trace_channel, 9, "error %s O_DIRECT on fd %d: %s",
+      use_direct ? "setting" : "clearing", fd, strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  return 0;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif /* O_DIRECT */
+}
+
 int pr_fs_have_access(struct stat *st, int mode, uid_t uid, gid_t gid,
     array_header *suppl_gids) {
   mode_t mask;
@@ -65,6 +65,19 @@ int pr_event_listening(const char *event) {
   return -1;
 }
 
+static unsigned int no_event_listeners = 0;
+unsigned int *pr_event_listeners = &no_event_listeners;
+unsigned int pr_event_max_id = 0;
+
+int pr_event_get_id(const char *event) {
+  return -1;
+}
+
+void pr_event_generate_id(int event_id, const void *event_data) {
+  (void) event_id;
+  (void) event_data;
+}
+
 void pr_fs_fadvise(int fd, off_t off, off_t len, int advice) {
 }
 
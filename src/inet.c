@@ -29,6 +29,10 @@
 #include "conf.h"
 #include "privs.h"
 
+#ifdef HAVE_SYS_UIO_H
+# include <sys/uio.h>
+#endif /* !HAVE_SYS_UIO_H */
+
 extern unsigned char is_master;
 extern server_rec *main_server;
 
@@ -48,6 +52,11 @@ static int inet_errno = 0;		/* Holds errno */
  */
 static int inet_family = 0;
 
+/* Whether listening sockets created by the daemon process should use
+ * SO_REUSEPORT, i.e. when the daemon is split into listener shards.
+ */
+static int inet_reuse_port = FALSE;
+
 static const char *trace_channel = "inet";
 
 /* Called by others after running a number of pr_inet_* functions in order
@@ -70,6 +79,17 @@ int pr_inet_set_default_family(pool *p, int family) {
   return old_family;
 }
 
+int pr_inet_set_reuse_port(int reuse_port) {
+#ifdef SO_REUSEPORT
+  int old_reuse_port = inet_reuse_port;
+  inet_reuse_port = reuse_port;
+  return old_reuse_port;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif /* SO_REUSEPORT */
+}
+
 /* Find a service and return its port number. */
 int pr_inet_getservport(pool *p, const char *serv, const char *proto) {
   struct servent *servent;
@@ -324,9 +344,12 @@ static conn_t *init_conn(pool *p, int fd, const pr_netaddr_t *bind_addr,
     /* Note that we only want to use this socket option if we are NOT the
      * master/parent daemon.  Otherwise, we would allow multiple daemon
      * processes to bind to the same socket, causing unexpected terror
-     * and madness (see Issue #622).
+     * and madness (see Issue #622).  The exception is when the daemon has
+     * been explicitly split into listener shards, each of which owns its
+     * own listening socket.
      */
-    if (!is_master) {
+    if (!is_master ||
+        inet_reuse_port) {
       if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (void *) &one,
           sizeof(one)) < 0) {
         pr_log_pri(PR_LOG_NOTICE, "error setting SO_REUSEPORT: %s",
@@ -1467,6 +1490,104 @@ int pr_inet_accept_nowait(pool *p, conn_t *c) {
   return fd;
 }
 
+int pr_inet_accept_batch(pool *p, conn_t *c, int *fds, unsigned int nfds) {
+#ifdef HAVE_ACCEPT4
+  static int use_accept4 = TRUE;
+#endif /* HAVE_ACCEPT4 */
+  unsigned int count = 0;
+
+  (void) p;
+
+  if (c == NULL ||
+      fds == NULL ||
+      nfds == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (c->mode != CM_LISTEN) {
+    errno = EPERM;
+    return -1;
+  }
+
+  while (count < nfds) {
+    int fd, inherits_flags = TRUE;
+
+    pr_signals_handle();
+
+#ifdef HAVE_ACCEPT4
+    /* Unlike accept(2) on some platforms, accept4(2) never lets the new
+     * socket inherit the listening socket's O_NONBLOCK flag, sparing us the
+     * fcntl(2) calls.
+     */
+    if (use_accept4) {
+      fd = accept4(c->listen_fd, NULL, NULL, 0);
+      if (fd < 0 &&
+          errno == ENOSYS) {
+        use_accept4 = FALSE;
+        continue;
+      }
+
+      inherits_flags = FALSE;
+
+    } else {
+      fd = accept(c->listen_fd, NULL, NULL);
+    }
+#else
+    fd = accept(c->listen_fd, NULL, NULL);
+#endif /* HAVE_ACCEPT4 */
+
+    if (fd < 0) {
+      int xerrno = errno;
+
+      if (xerrno == EINTR) {
+        continue;
+      }
+
+      /* Ignore connections which were aborted before we could accept them,
+       * as they tend to be health checks/probes by e.g. load balancers.
+       */
+      if (xerrno == ECONNABORTED
+#ifdef EPROTO
+          || xerrno == EPROTO
+#endif /* EPROTO */
+          ) {
+        continue;
+      }
+
+      if (xerrno == EAGAIN ||
+          xerrno == EWOULDBLOCK) {
+        break;
+      }
+
+      if (count > 0) {
+        /* Hand back what we have; the error will recur on the next call. */
+        break;
+      }
+
+      c->xerrno = xerrno;
+      errno = xerrno;
+      return -1;
+    }
+
+    if (inherits_flags) {
+      int flags;
+
+      flags = fcntl(fd, F_GETFL);
+      if (flags >= 0 &&
+          (flags & O_NONBLOCK)) {
+        (void) fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+      }
+    }
+
+    fds[count++] = fd;
+  }
+
+  pr_trace_msg(trace_channel, 19, "accepted %u %s on fd %d", count,
+    count != 1 ? "connections" : "connection", c->listen_fd);
+  return (int) count;
+}
+
 /* Accepts a new connection, cloning the existing conn_t and returning
  * it, or NULL upon error.
  */
@@ -1814,6 +1935,159 @@ conn_t *pr_inet_openrw(pool *p, conn_t *c, const pr_netaddr_t *addr,
   return res;
 }
 
+/* Passes the given descriptor, along with a small opaque payload, to the
+ * process at the other end of the given Unix domain socket.
+ */
+int pr_inet_send_fd(int sockfd, int fd, const void *data, size_t datasz) {
+  int res;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char zero = '\0';
+  union {
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+
+  if (sockfd < 0 ||
+      fd < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* We always need to send at least one byte of real data along with the
+   * ancillary data.
+   */
+  if (data == NULL ||
+      datasz == 0) {
+    data = &zero;
+    datasz = 1;
+  }
+
+  iov.iov_base = (void *) data;
+  iov.iov_len = datasz;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  memset(&control, 0, sizeof(control));
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+  while (TRUE) {
+#ifdef MSG_NOSIGNAL
+    res = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+#else
+    res = sendmsg(sockfd, &msg, 0);
+#endif /* MSG_NOSIGNAL */
+    if (res < 0) {
+      int xerrno = errno;
+
+      if (xerrno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      pr_trace_msg(trace_channel, 3,
+        "error sending fd %d via socket fd %d: %s", fd, sockfd,
+        strerror(xerrno));
+
+      errno = xerrno;
+      return -1;
+    }
+
+    break;
+  }
+
+  return 0;
+}
+
+/* Receives a descriptor, and its opaque payload, sent via pr_inet_send_fd().
+ * Returns the number of payload bytes read, zero if the peer closed the
+ * socket, or -1 on error.  If no descriptor accompanied the payload, *fd is
+ * set to -1.
+ */
+int pr_inet_recv_fd(int sockfd, int *fd, void *data, size_t datasz) {
+  int res;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char zero = '\0';
+  union {
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE(sizeof(int))];
+  } control;
+
+  if (sockfd < 0 ||
+      fd == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  *fd = -1;
+
+  if (data == NULL ||
+      datasz == 0) {
+    data = &zero;
+    datasz = 1;
+  }
+
+  iov.iov_base = data;
+  iov.iov_len = datasz;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  memset(&control, 0, sizeof(control));
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  while (TRUE) {
+    res = recvmsg(sockfd, &msg, 0);
+    if (res < 0) {
+      int xerrno = errno;
+
+      if (xerrno == EINTR) {
+        pr_signals_handle();
+        continue;
+      }
+
+      pr_trace_msg(trace_channel, 3,
+        "error receiving fd via socket fd %d: %s", sockfd, strerror(xerrno));
+
+      errno = xerrno;
+      return -1;
+    }
+
+    break;
+  }
+
+  for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET &&
+        cmsg->cmsg_type == SCM_RIGHTS &&
+        cmsg->cmsg_len >= CMSG_LEN(sizeof(int))) {
+      memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+      break;
+    }
+  }
+
+  if (msg.msg_flags & MSG_CTRUNC) {
+    pr_trace_msg(trace_channel, 3,
+      "control data received via socket fd %d was truncated", sockfd);
+  }
+
+  return res;
+}
+
 int pr_inet_generate_socket_event(const char *event, server_rec *s,
     const pr_netaddr_t *addr, int fd) {
   pool *p;
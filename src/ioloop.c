@@ -0,0 +1,500 @@
+/*
+ * ProFTPD - FTP server daemon
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* Daemon I/O readiness loop
+ *
+ * The daemon process waits on its listening sockets and on the semaphore
+ * pipes of its children.  Using select(2) for this limits the daemon to
+ * FD_SETSIZE descriptors, and costs time proportional to the number of
+ * descriptors on every wakeup.  Descriptors registered here stay
+ * registered until removed, so that, with epoll(7), each wakeup costs time
+ * proportional only to the number of ready descriptors.
+ */
+
+#include "conf.h"
+
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif /* HAVE_SYS_EPOLL_H */
+
+/* The poll(2) backend is also used where epoll(7) is supported by the
+ * headers, but not by the running system, e.g. when epoll_create(2) is
+ * blocked by a seccomp filter.
+ */
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#else
+/* poll(2) is not available; emulate it using select(2). */
+struct pollfd {
+  int fd;
+  short events;
+  short revents;
+};
+
+# define POLLIN		0x0001
+# define POLLERR	0x0008
+# define POLLHUP	0x0010
+# define POLLNVAL	0x0020
+#endif /* HAVE_POLL_H */
+
+/* Per-descriptor state, indexed by descriptor number. */
+struct ioloop_fd {
+  int type;
+  void *data;
+  unsigned char registered;
+
+  /* Index of this descriptor in the pollfd array. */
+  int slot;
+};
+
+static pool *ioloop_pool = NULL;
+
+/* The descriptor table lives in its own pool, which is replaced whenever
+ * the table grows, so that the old tables are freed.
+ */
+static pool *ioloop_fds_pool = NULL;
+static struct ioloop_fd *ioloop_fds = NULL;
+static int ioloop_fdsz = 0;
+static unsigned int ioloop_count = 0;
+
+#ifdef HAVE_SYS_EPOLL_H
+static int ioloop_epfd = -1;
+# define ioloop_use_epoll()	(ioloop_epfd >= 0)
+#else
+# define ioloop_use_epoll()	FALSE
+#endif /* HAVE_SYS_EPOLL_H */
+
+/* Used only when not using epoll(7). */
+static array_header *ioloop_pollfds = NULL;
+
+/* Where the next scan of the pollfd array starts, so that a busy
+ * descriptor early in the array cannot starve the others.
+ */
+static unsigned int ioloop_next_slot = 0;
+
+static const char *trace_channel = "ioloop";
+
+static int ioloop_grow(int fd) {
+  pool *fds_pool;
+  struct ioloop_fd *fds;
+  int i, fdsz;
+
+  if (fd < ioloop_fdsz) {
+    return 0;
+  }
+
+  fdsz = ioloop_fdsz > 0 ? ioloop_fdsz : 64;
+  while (fdsz <= fd) {
+    fdsz *= 2;
+  }
+
+  fds_pool = make_sub_pool(ioloop_pool);
+  pr_pool_tag(fds_pool, "I/O Loop Descriptors Pool");
+
+  fds = palloc(fds_pool, fdsz * sizeof(struct ioloop_fd));
+  if (ioloop_fdsz > 0) {
+    memcpy(fds, ioloop_fds, ioloop_fdsz * sizeof(struct ioloop_fd));
+  }
+
+  for (i = ioloop_fdsz; i < fdsz; i++) {
+    fds[i].type = 0;
+    fds[i].data = NULL;
+    fds[i].registered = FALSE;
+    fds[i].slot = -1;
+  }
+
+  if (ioloop_fds_pool != NULL) {
+    destroy_pool(ioloop_fds_pool);
+  }
+
+  ioloop_fds_pool = fds_pool;
+  ioloop_fds = fds;
+  ioloop_fdsz = fdsz;
+  return 0;
+}
+
+#ifndef HAVE_POLL_H
+static int ioloop_poll(struct pollfd *pfds, unsigned int npfds, int timeout) {
+  fd_set rfds;
+  struct timeval tv, *tvp = NULL;
+  register unsigned int i;
+  int maxfd = -1, res;
+
+  FD_ZERO(&rfds);
+  for (i = 0; i < npfds; i++) {
+    FD_SET(pfds[i].fd, &rfds);
+    if (pfds[i].fd > maxfd) {
+      maxfd = pfds[i].fd;
+    }
+  }
+
+  if (timeout >= 0) {
+    tv.tv_sec = timeout / 1000;
+    tv.tv_usec = (timeout % 1000) * 1000;
+    tvp = &tv;
+  }
+
+  res = select(maxfd + 1, &rfds, NULL, NULL, tvp);
+  if (res <= 0) {
+    return res;
+  }
+
+  for (i = 0; i < npfds; i++) {
+    pfds[i].revents = FD_ISSET(pfds[i].fd, &rfds) ? POLLIN : 0;
+  }
+
+  return res;
+}
+#else
+# define ioloop_poll(pfds, npfds, timeout)	poll((pfds), (npfds), (timeout))
+#endif /* !HAVE_POLL_H */
+
+int pr_ioloop_open(void) {
+  if (ioloop_pool != NULL) {
+    return 0;
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  ioloop_epfd = epoll_create(PR_TUNABLE_IOLOOP_MAX_EVENTS);
+  if (ioloop_epfd >= 0) {
+    /* Session processes have no use for the daemon's epoll instance. */
+    (void) fcntl(ioloop_epfd, F_SETFD, FD_CLOEXEC);
+
+  } else {
+    /* Not fatal; fall back to poll(2), which needs no descriptor of its
+     * own.
+     */
+    pr_log_pri(PR_LOG_NOTICE, "unable to create epoll instance (%s), "
+      "using poll(2) instead", strerror(errno));
+  }
+#endif /* HAVE_SYS_EPOLL_H */
+
+  ioloop_pool = make_sub_pool(permanent_pool);
+  pr_pool_tag(ioloop_pool, "I/O Loop Pool");
+
+  if (!ioloop_use_epoll()) {
+    ioloop_pollfds = make_array(ioloop_pool, 16, sizeof(struct pollfd));
+    ioloop_next_slot = 0;
+  }
+
+  ioloop_fds_pool = NULL;
+  ioloop_fds = NULL;
+  ioloop_fdsz = 0;
+  ioloop_count = 0;
+
+  pr_trace_msg(trace_channel, 9, "opened I/O loop using %s",
+    pr_ioloop_get_backend());
+  return 0;
+}
+
+void pr_ioloop_close(void) {
+  if (ioloop_pool == NULL) {
+    return;
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (ioloop_epfd >= 0) {
+    (void) close(ioloop_epfd);
+    ioloop_epfd = -1;
+  }
+#endif /* HAVE_SYS_EPOLL_H */
+
+  destroy_pool(ioloop_pool);
+  ioloop_pool = NULL;
+  ioloop_pollfds = NULL;
+  ioloop_fds_pool = NULL;
+  ioloop_fds = NULL;
+  ioloop_fdsz = 0;
+  ioloop_count = 0;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static int ioloop_epoll_add_fd(int fd) {
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+
+  if (epoll_ctl(ioloop_epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+    int xerrno = errno;
+
+    if (xerrno != EEXIST) {
+      pr_trace_msg(trace_channel, 3, "error adding fd %d to epoll: %s", fd,
+        strerror(xerrno));
+      errno = xerrno;
+      return -1;
+    }
+
+    /* The kernel still knows this descriptor from a previous registration;
+     * simply update it.
+     */
+    if (epoll_ctl(ioloop_epfd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+      xerrno = errno;
+      pr_trace_msg(trace_channel, 3, "error modifying fd %d in epoll: %s", fd,
+        strerror(xerrno));
+      errno = xerrno;
+      return -1;
+    }
+  }
+
+  return 0;
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
+static int ioloop_poll_add_fd(int fd) {
+  struct pollfd *pfd;
+
+#ifndef HAVE_POLL_H
+  if (fd >= FD_SETSIZE) {
+    errno = EMFILE;
+    return -1;
+  }
+#endif /* !HAVE_POLL_H */
+
+  pfd = push_array(ioloop_pollfds);
+  pfd->fd = fd;
+  pfd->events = POLLIN;
+  pfd->revents = 0;
+  ioloop_fds[fd].slot = ioloop_pollfds->nelts - 1;
+
+  return 0;
+}
+
+int pr_ioloop_add_fd(int fd, int type, void *data) {
+  int res;
+
+  if (fd < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (ioloop_pool == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+  ioloop_grow(fd);
+
+  if (ioloop_fds[fd].registered) {
+    errno = EEXIST;
+    return -1;
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (ioloop_use_epoll()) {
+    res = ioloop_epoll_add_fd(fd);
+
+  } else {
+    res = ioloop_poll_add_fd(fd);
+  }
+#else
+  res = ioloop_poll_add_fd(fd);
+#endif /* HAVE_SYS_EPOLL_H */
+
+  if (res < 0) {
+    return -1;
+  }
+
+  ioloop_fds[fd].type = type;
+  ioloop_fds[fd].data = data;
+  ioloop_fds[fd].registered = TRUE;
+  ioloop_count++;
+
+  pr_trace_msg(trace_channel, 19, "watching fd %d (%u fds total)", fd,
+    ioloop_count);
+  return 0;
+}
+
+static void ioloop_poll_remove_fd(int fd) {
+  struct pollfd *pfds;
+  int slot, last;
+
+  /* Move the last pollfd into the vacated slot. */
+  pfds = ioloop_pollfds->elts;
+  slot = ioloop_fds[fd].slot;
+  last = ioloop_pollfds->nelts - 1;
+
+  if (slot != last) {
+    pfds[slot] = pfds[last];
+    ioloop_fds[pfds[slot].fd].slot = slot;
+  }
+
+  ioloop_pollfds->nelts--;
+  ioloop_fds[fd].slot = -1;
+}
+
+int pr_ioloop_remove_fd(int fd) {
+  if (fd < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (ioloop_pool == NULL ||
+      fd >= ioloop_fdsz ||
+      ioloop_fds[fd].registered == FALSE) {
+    errno = ENOENT;
+    return -1;
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (ioloop_use_epoll()) {
+    if (epoll_ctl(ioloop_epfd, EPOLL_CTL_DEL, fd, NULL) < 0) {
+      /* If the descriptor has already been closed, and this was the last
+       * reference to its file, the kernel has already forgotten it.
+       */
+      if (errno != EBADF &&
+          errno != ENOENT) {
+        pr_trace_msg(trace_channel, 3, "error removing fd %d from epoll: %s",
+          fd, strerror(errno));
+      }
+    }
+
+  } else {
+    ioloop_poll_remove_fd(fd);
+  }
+#else
+  ioloop_poll_remove_fd(fd);
+#endif /* HAVE_SYS_EPOLL_H */
+
+  ioloop_fds[fd].type = 0;
+  ioloop_fds[fd].data = NULL;
+  ioloop_fds[fd].registered = FALSE;
+  ioloop_count--;
+
+  pr_trace_msg(trace_channel, 19, "no longer watching fd %d (%u fds total)",
+    fd, ioloop_count);
+  return 0;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+static int ioloop_epoll_wait(pr_ioloop_event_t *events, int nevents,
+    int timeout) {
+  register int i;
+  int count = 0, res;
+  struct epoll_event evs[PR_TUNABLE_IOLOOP_MAX_EVENTS];
+
+  if (nevents > PR_TUNABLE_IOLOOP_MAX_EVENTS) {
+    nevents = PR_TUNABLE_IOLOOP_MAX_EVENTS;
+  }
+
+  res = epoll_wait(ioloop_epfd, evs, nevents, timeout);
+  if (res <= 0) {
+    return res;
+  }
+
+  for (i = 0; i < res; i++) {
+    int fd = evs[i].data.fd;
+
+    if (fd >= ioloop_fdsz ||
+        ioloop_fds[fd].registered == FALSE) {
+      /* A stale registration, for a file which was closed here but is
+       * still open in another process.
+       */
+      pr_trace_msg(trace_channel, 9, "ignoring event for unwatched fd %d",
+        fd);
+      (void) epoll_ctl(ioloop_epfd, EPOLL_CTL_DEL, fd, NULL);
+      continue;
+    }
+
+    events[count].fd = fd;
+    events[count].type = ioloop_fds[fd].type;
+    events[count].data = ioloop_fds[fd].data;
+    count++;
+  }
+
+  return count;
+}
+#endif /* HAVE_SYS_EPOLL_H */
+
+static int ioloop_poll_wait(pr_ioloop_event_t *events, int nevents,
+    int timeout) {
+  struct pollfd *pfds;
+  unsigned int npfds, j;
+  int count = 0, res;
+
+  pfds = ioloop_pollfds->elts;
+  npfds = ioloop_pollfds->nelts;
+
+  res = ioloop_poll(pfds, npfds, timeout);
+  if (res <= 0) {
+    return res;
+  }
+
+  if (ioloop_next_slot >= npfds) {
+    ioloop_next_slot = 0;
+  }
+
+  for (j = 0; j < npfds && count < nevents; j++) {
+    struct pollfd *pfd;
+
+    pfd = &(pfds[(ioloop_next_slot + j) % npfds]);
+    if (pfd->revents & (POLLIN|POLLERR|POLLHUP|POLLNVAL)) {
+      events[count].fd = pfd->fd;
+      events[count].type = ioloop_fds[pfd->fd].type;
+      events[count].data = ioloop_fds[pfd->fd].data;
+      count++;
+    }
+  }
+
+  ioloop_next_slot = (ioloop_next_slot + j) % npfds;
+  return count;
+}
+
+int pr_ioloop_wait(pr_ioloop_event_t *events, int nevents, int timeout) {
+  if (events == NULL ||
+      nevents <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (ioloop_pool == NULL) {
+    errno = EPERM;
+    return -1;
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  if (ioloop_use_epoll()) {
+    return ioloop_epoll_wait(events, nevents, timeout);
+  }
+#endif /* HAVE_SYS_EPOLL_H */
+
+  return ioloop_poll_wait(events, nevents, timeout);
+}
+
+unsigned int pr_ioloop_get_count(void) {
+  return ioloop_count;
+}
+
+const char *pr_ioloop_get_backend(void) {
+  if (ioloop_use_epoll()) {
+    return "epoll";
+  }
+
+#ifdef HAVE_POLL_H
+  return "poll";
+#else
+  return "select";
+#endif /* HAVE_POLL_H */
+}
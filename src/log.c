@@ -842,9 +842,26 @@ static const char *get_log_event_name(unsigned int log_type) {
   return event_name;
 }
 
+/* Logging happens often, so look up the ID of each log event only once. */
+static int get_log_event_id(unsigned int log_type) {
+  static int event_ids[PR_LOG_TYPE_TRACELOG + 1];
+  const char *event_name;
+
+  event_name = get_log_event_name(log_type);
+  if (event_name == NULL) {
+    return -1;
+  }
+
+  if (event_ids[log_type] == 0) {
+    event_ids[log_type] = pr_event_get_id(event_name);
+  }
+
+  return event_ids[log_type];
+}
+
 int pr_log_event_generate(unsigned int log_type, int log_fd, int log_level,
     const char *log_msg, size_t log_msglen) {
-  const char *event_name;
+  int event_id;
   pr_log_event_t le;
 
   if (log_msg == NULL ||
@@ -853,13 +870,12 @@ int pr_log_event_generate(unsigned int log_type, int log_fd, int log_level,
     return -1;
   }
 
-  if (pr_log_event_listening(log_type) <= 0) {
+  event_id = get_log_event_id(log_type);
+  if (PR_EVENT_LISTENING(event_id) == 0) {
     errno = ENOENT;
     return -1;
   }
 
-  event_name = get_log_event_name(log_type);
-
   memset(&le, 0, sizeof(le));
   le.log_type = log_type;
   le.log_fd = log_fd;
@@ -867,21 +883,15 @@ int pr_log_event_generate(unsigned int log_type, int log_fd, int log_level,
   le.log_msg = log_msg;
   le.log_msglen = log_msglen;
 
-  pr_event_generate(event_name, &le);
+  pr_event_generate_id(event_id, &le);
   return 0;
 }
 
 int pr_log_event_listening(unsigned int log_type) {
-  const char *event_name;
-  int res;
-
-  event_name = get_log_event_name(log_type);
-  if (event_name == NULL) {
-    return FALSE;
-  }
+  int event_id;
 
-  res = pr_event_listening(event_name);
-  if (res <= 0) {
+  event_id = get_log_event_id(log_type);
+  if (PR_EVENT_LISTENING(event_id) == 0) {
     return FALSE;
   }
 
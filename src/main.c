@@ -91,24 +91,74 @@ static cmd_rec *make_ftp_cmd(pool *p, char *buf, size_t buflen, int flags);
 
 static const char *config_filename = PR_CONFIG_FILE_PATH;
 
-/* Add child semaphore fds into the rfd for selecting */
-static int semaphore_fds(fd_set *rfd, int maxfd) {
+/* Listener shards.  If ListenShards is configured, the daemon process does
+ * not accept connections itself; instead, it forks that many shard
+ * processes, each of which has its own SO_REUSEPORT listening sockets and
+ * its own children, and lets the kernel spread connections across them.
+ */
+static unsigned int listen_shards = 0;
+static unsigned int startup_shards = 1;	/* As configured at startup */
+static unsigned int shard_id = 0;	/* Non-zero only in a shard process */
+static pid_t *shard_pids = NULL;
+
+/* Zero-downtime upgrades.  On SIGWINCH, the daemon process re-executes
+ * itself, handing its listening sockets to the new daemon process using
+ * the LISTEN_PID/LISTEN_FDS environment variables (as used for socket
+ * activation), starting at the first descriptor after stderr.  The new
+ * process takes over the scoreboard, and reports that it is ready on the
+ * pipe named by PR_UPGRADE_READY_FD_ENV; the old process then stops
+ * accepting connections, and exits once its existing sessions have ended.
+ */
+#define PR_UPGRADE_READY_FD_ENV		"PROFTPD_UPGRADE_READY_FD"
+
+static char **upgrade_argv = NULL;
+static int upgrade_nfds = 0;		/* Inherited listening sockets */
+static int upgrade_notify_fd = -1;	/* New process: write end of pipe */
+static int upgrade_pipe_fd = -1;	/* Old process: read end of pipe */
+static int upgrade_handed_off = FALSE;
+
+/* Returns TRUE if any child has yet to close its semaphore pipe. */
+static int semaphore_pending(void) {
   if (child_count()) {
     pr_child_t *ch;
 
     for (ch = child_get(NULL); ch; ch = child_get(ch)) {
-      pr_signals_handle();
-
       if (ch->ch_pipefd != -1) {
-        FD_SET(ch->ch_pipefd, rfd);
-        if (ch->ch_pipefd > maxfd) {
-          maxfd = ch->ch_pipefd;
-        }
+        return TRUE;
       }
     }
   }
 
-  return maxfd;
+  return FALSE;
+}
+
+/* The child has closed its end of the semaphore pipe; close ours. */
+static void semaphore_close(pr_child_t *ch) {
+  if (ch->ch_pipefd != -1) {
+    (void) pr_ioloop_remove_fd(ch->ch_pipefd);
+    (void) close(ch->ch_pipefd);
+    ch->ch_pipefd = -1;
+  }
+}
+
+/* Connections accepted by the daemon, but not yet handed off.  Newly forked
+ * session processes must close all of these except their own.
+ */
+static int *pending_fds = NULL;
+static unsigned int pending_nfds = 0;
+
+static void close_pending_conns(int fd) {
+  register unsigned int i;
+
+  for (i = 0; i < pending_nfds; i++) {
+    if (pending_fds[i] != fd &&
+        pending_fds[i] != -1) {
+      (void) close(pending_fds[i]);
+    }
+  }
+
+  pending_fds = NULL;
+  pending_nfds = 0;
 }
 
 void set_auth_check(int (*chk)(cmd_rec*)) {
@@ -205,11 +255,120 @@ void shutdown_end_session(void *d1, void *d2, void *d3, void *d4) {
   }
 }
 
-static int get_command_class(const char *name) {
+/* The handlers, for each phase, of a command, in the order in which they
+ * are dispatched.  These chains are kept for each known command ID, and for
+ * the C_ANY wildcard (at index 0); they are built the first time they are
+ * needed, and discarded whenever the stash changes, e.g. when a module is
+ * loaded or unloaded.  This saves walking, and comparing the names of, all of
+ * a command's symbols in the stash for every phase of every command.
+ */
+struct dispatch_chain {
+  const char *name;
+  int has_syms;
+  cmdtable **handlers[LOG_CMD_ERR + 1];
+};
+
+static pool *dispatch_pool = NULL;
+static struct dispatch_chain *dispatch_chains[PR_CMD_MAX_ID + 1];
+static unsigned int dispatch_generation = 0;
+
+static struct dispatch_chain *get_dispatch_chain(cmd_rec *cmd,
+    const char *match) {
+  struct dispatch_chain *chain;
+  array_header *handlers[LOG_CMD_ERR + 1];
+  unsigned int generation, hash = 0;
+  int idx, stash_idx = -1;
+  register unsigned int i;
+  cmdtable *c;
+
+  if (match == NULL) {
+    match = cmd->argv[0];
+    idx = cmd->cmd_id;
+
+    if (idx <= 0 ||
+        idx > PR_CMD_MAX_ID) {
+      return NULL;
+    }
+
+  } else if (strcmp(match, C_ANY) == 0) {
+    idx = 0;
+
+  } else {
+    return NULL;
+  }
+
+  generation = pr_stash_get_generation();
+  if (generation != dispatch_generation) {
+    if (dispatch_pool != NULL) {
+      destroy_pool(dispatch_pool);
+    }
+
+    dispatch_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(dispatch_pool, "Dispatch Chain Pool");
+
+    memset(dispatch_chains, 0, sizeof(dispatch_chains));
+    dispatch_generation = generation;
+  }
+
+  chain = dispatch_chains[idx];
+  if (chain != NULL) {
+    /* Make sure that the command name was not changed without its ID
+     * being updated as well.
+     */
+    if (strcmp(chain->name, match) != 0) {
+      return NULL;
+    }
+
+    return chain;
+  }
+
+  if (idx > 0 &&
+      pr_cmd_get_id(match) != idx) {
+    return NULL;
+  }
+
+  chain = pcalloc(dispatch_pool, sizeof(struct dispatch_chain));
+  chain->name = pstrdup(dispatch_pool, match);
+
+  for (i = PRE_CMD; i <= LOG_CMD_ERR; i++) {
+    handlers[i] = make_array(dispatch_pool, 1, sizeof(cmdtable *));
+  }
+
+  c = pr_stash_get_symbol2(PR_SYM_CMD, match, NULL, &stash_idx, &hash);
+  while (c != NULL) {
+    chain->has_syms = TRUE;
+
+    if (c->cmd_type >= PRE_CMD &&
+        c->cmd_type <= LOG_CMD_ERR) {
+      *((cmdtable **) push_array(handlers[c->cmd_type])) = c;
+    }
+
+    c = pr_stash_get_symbol2(PR_SYM_CMD, match, c, &stash_idx, &hash);
+  }
+
+  for (i = PRE_CMD; i <= LOG_CMD_ERR; i++) {
+    *((cmdtable **) push_array(handlers[i])) = NULL;
+    chain->handlers[i] = handlers[i]->elts;
+  }
+
+  dispatch_chains[idx] = chain;
+  return chain;
+}
+
+static int get_command_class(cmd_rec *cmd) {
   int idx = -1;
   unsigned int hash = 0;
+  const char *name;
+  struct dispatch_chain *chain;
   cmdtable *c;
 
+  chain = get_dispatch_chain(cmd, NULL);
+  if (chain != NULL) {
+    c = chain->handlers[CMD][0];
+    return (c ? c->cmd_class : CL_ALL);
+  }
+
+  name = cmd->argv[0];
   c = pr_stash_get_symbol2(PR_SYM_CMD, name, NULL, &idx, &hash);
   while (c && c->cmd_type != CMD) {
     pr_signals_handle();
@@ -233,10 +392,17 @@ static int _dispatch(cmd_rec *cmd, int cmd_type, int validate, char *match) {
   static char *last_match = NULL;
   int *index_cache = NULL;
   unsigned int *hash_cache = NULL;
+  struct dispatch_chain *chain = NULL;
+  unsigned int chain_idx = 0;
 
   send_error = (cmd_type == PRE_CMD || cmd_type == CMD ||
     cmd_type == POST_CMD_ERR);
 
+  if (cmd_type >= PRE_CMD &&
+      cmd_type <= LOG_CMD_ERR) {
+    chain = get_dispatch_chain(cmd, match);
+  }
+
   if (!match) {
     match = cmd->argv[0];
     index_cache = &cmd->stash_index;
@@ -252,7 +418,20 @@ static int _dispatch(cmd_rec *cmd, int cmd_type, int validate, char *match) {
     hash_cache = &match_hash_cache;
   }
 
-  c = pr_stash_get_symbol2(PR_SYM_CMD, match, NULL, index_cache, hash_cache);
+  if (chain != NULL) {
+    if (chain->has_syms) {
+      session.curr_cmd = cmd->argv[0];
+      session.curr_cmd_id = cmd->cmd_id;
+      session.curr_cmd_rec = cmd;
+      session.curr_phase = cmd_type;
+    }
+
+    c = chain->handlers[cmd_type][0];
+
+  } else {
+    c = pr_stash_get_symbol2(PR_SYM_CMD, match, NULL, index_cache,
+      hash_cache);
+  }
 
   while (c && !success) {
     size_t cmdargstrlen = 0;
@@ -407,7 +586,18 @@ static int _dispatch(cmd_rec *cmd, int cmd_type, int validate, char *match) {
     }
 
     if (!success) {
-      c = pr_stash_get_symbol2(PR_SYM_CMD, match, c, index_cache, hash_cache);
+      if (chain != NULL &&
+          dispatch_generation == pr_stash_get_generation()) {
+        c = chain->handlers[cmd_type][++chain_idx];
+
+      } else {
+        /* The stash may have changed while dispatching (and the chain
+         * discarded); continue from the stash itself.
+         */
+        chain = NULL;
+        c = pr_stash_get_symbol2(PR_SYM_CMD, match, c, index_cache,
+          hash_cache);
+      }
     }
   }
 
@@ -641,14 +831,14 @@ int pr_cmd_dispatch_phase(cmd_rec *cmd, int phase, int flags) {
     *cp = toupper(*cp);
   }
 
-  if (cmd->cmd_class == 0) {
-    cmd->cmd_class = get_command_class(cmd->argv[0]);
-  }
-
   if (cmd->cmd_id == 0) {
     cmd->cmd_id = pr_cmd_get_id(cmd->argv[0]);
   }
 
+  if (cmd->cmd_class == 0) {
+    cmd->cmd_class = get_command_class(cmd);
+  }
+
   set_cmd_start_ms(cmd);
 
   if (phase == 0) {
@@ -870,7 +1060,7 @@ static cmd_rec *make_ftp_cmd(pool *p, char *buf, size_t buflen, int flags) {
   /* This table will not contain that many entries, so a low number
    * of chains should suffice.
    */
-  cmd->notes = pr_table_nalloc(cmd->pool, 0, 8);
+  cmd->notes = pr_table_nalloc(cmd->pool, PR_TABLE_FL_OPEN_ADDR, 8);
   return cmd;
 }
 
@@ -902,6 +1092,9 @@ static void cmd_loop(server_rec *server, conn_t *c) {
       pr_timer_reset(PR_TIMER_IDLE, ANY_MODULE);
     }
 
+    /* Likewise for the SessionHibernate timer, if any. */
+    pr_timer_reset(PR_TIMER_HIBERNATE, ANY_MODULE);
+
     if (cmd) {
 
       /* Detect known commands for other protocols; if found, drop the
@@ -930,10 +1123,88 @@ static void cmd_loop(server_rec *server, conn_t *c) {
   }
 }
 
+static void fork_server(int fd, conn_t *l, unsigned char no_fork);
+
+/* Called in a prefork worker, for the connection handed to it by the
+ * daemon process.
+ */
+static void prefork_session(int fd, conn_t *l) {
+
+  /* The worker may have been forked before the shutdown message file
+   * appeared, so check again.
+   */
+  if (check_shutmsg(PR_SHUTMSG_PATH, &shut, &deny, &disc, shutmsg,
+      sizeof(shutmsg)) == 1) {
+    shutting_down = TRUE;
+
+  } else {
+    shutting_down = FALSE;
+  }
+
+  fork_server(fd, l, TRUE);
+  pr_session_end(0);
+}
+
+static void set_prefork_workers(void) {
+  unsigned int min_spare = 0, max_spare = 0;
+
+#ifndef PR_DEVEL_NO_FORK
+  int *engine;
+
+  engine = get_param_ptr(main_server->conf, "PreforkEngine", FALSE);
+  if (engine != NULL &&
+      *engine == TRUE &&
+      no_forking == FALSE) {
+    config_rec *c;
+
+    min_spare = PR_PREFORK_DEFAULT_MIN_SPARE;
+    max_spare = PR_PREFORK_DEFAULT_MAX_SPARE;
+
+    c = find_config(main_server->conf, CONF_PARAM, "PreforkSpareWorkers",
+      FALSE);
+    if (c != NULL) {
+      min_spare = *((unsigned int *) c->argv[0]);
+      max_spare = *((unsigned int *) c->argv[1]);
+    }
+
+    pr_log_debug(DEBUG2, "using prefork workers (%u-%u spare)", min_spare,
+      max_spare);
+  }
+#endif /* PR_DEVEL_NO_FORK */
+
+  if (pr_prefork_set_workers(min_spare, max_spare, prefork_session) < 0) {
+    pr_log_pri(PR_LOG_WARNING, "unable to configure prefork workers: %s",
+      strerror(errno));
+  }
+}
+
+/* MaxInstances and MaxConnectionRate apply to the server as a whole, but a
+ * shard only knows about its own children; divide the limits among the
+ * shards, rounding up.
+ */
+static void set_shard_limits(void) {
+  if (shard_id == 0) {
+    return;
+  }
+
+  if (ServerMaxInstances > 0) {
+    ServerMaxInstances = (ServerMaxInstances + listen_shards - 1) /
+      listen_shards;
+  }
+
+  if (max_connects > 0) {
+    max_connects = (max_connects + listen_shards - 1) / listen_shards;
+  }
+}
+
 void restart_daemon(void *d1, void *d2, void *d3, void *d4) {
+  if (upgrade_handed_off) {
+    pr_log_pri(PR_LOG_NOTICE, "received SIGHUP, ignoring: this daemon process "
+      "has been replaced");
+    return;
+  }
+
   if (is_master && mpid) {
-    int maxfd;
-    fd_set childfds;
     struct timeval restart_start, restart_finish;
     long restart_elapsed = 0;
 
@@ -943,37 +1214,36 @@ void restart_daemon(void *d1, void *d2, void *d3, void *d4) {
     gettimeofday(&restart_start, NULL);
 
     /* Make sure none of our children haven't completed start up */
-    FD_ZERO(&childfds);
-    maxfd = -1;
-
-    maxfd = semaphore_fds(&childfds, maxfd);
-    if (maxfd > -1) {
+    if (semaphore_pending()) {
       pr_log_pri(PR_LOG_NOTICE, "waiting for child processes to complete "
         "initialization");
 
-      while (maxfd != -1) {
-	int i;
-	
-	i = select(maxfd + 1, &childfds, NULL, NULL, NULL);
+      while (semaphore_pending()) {
+        pr_ioloop_event_t events[PR_TUNABLE_IOLOOP_MAX_EVENTS];
+        int i, nevents;
 
-        if (i > 0) {
-          pr_child_t *ch;
-
-          for (ch = child_get(NULL); ch; ch = child_get(ch)) {
-            if (ch->ch_pipefd != -1 &&
-               FD_ISSET(ch->ch_pipefd, &childfds)) {
-              (void) close(ch->ch_pipefd);
-              ch->ch_pipefd = -1;
-            }
+        nevents = pr_ioloop_wait(events, PR_TUNABLE_IOLOOP_MAX_EVENTS, -1);
+        if (nevents < 0) {
+          if (errno == EINTR) {
+            continue;
           }
+
+          pr_log_pri(PR_LOG_WARNING, "error waiting for child processes: %s",
+            strerror(errno));
+          break;
         }
 
-	FD_ZERO(&childfds);
-        maxfd = -1;
-	maxfd = semaphore_fds(&childfds, maxfd);
+        for (i = 0; i < nevents; i++) {
+          if (events[i].type == PR_IOLOOP_TYPE_CHILD) {
+            semaphore_close(events[i].data);
+          }
+        }
       }
     }
 
+    /* Idle prefork workers carry the old configuration; retire them. */
+    pr_prefork_retire();
+
     free_bindings();
 
     /* Run through the list of registered restart callbacks. */
@@ -995,6 +1265,14 @@ void restart_daemon(void *d1, void *d2, void *d3, void *d4) {
 
     pr_event_generate("core.preparse", NULL);
 
+    if (shard_id > 0) {
+      /* These are divided up again once the configuration is parsed; do not
+       * divide the old values, should the directives have been removed.
+       */
+      ServerMaxInstances = 0UL;
+      max_connects = 0UL;
+    }
+
     PRIVS_ROOT
     if (pr_parser_parse_file(NULL, config_filename, NULL, 0) < 0) {
       int xerrno = errno;
@@ -1044,6 +1322,34 @@ void restart_daemon(void *d1, void *d2, void *d3, void *d4) {
      */
     init_bindings();
 
+    if (shard_id == 0) {
+      unsigned int *nshards, configured_shards = 1;
+
+      nshards = get_param_ptr(main_server->conf, "ListenShards", FALSE);
+      if (nshards != NULL) {
+        configured_shards = *nshards;
+      }
+
+      if (configured_shards != startup_shards) {
+        pr_log_pri(PR_LOG_NOTICE, "ListenShards changed; the new number of "
+          "shards takes effect only after a full server restart");
+      }
+    }
+
+    if (listen_shards > 0 &&
+        shard_id == 0) {
+      /* Each shard reparses the configuration, and reopens its own
+       * listening sockets, for itself.
+       */
+      PRIVS_ROOT
+      child_signal(SIGHUP);
+      PRIVS_RELINQUISH
+
+    } else {
+      set_shard_limits();
+      set_prefork_workers();
+    }
+
     gettimeofday(&restart_finish, NULL);
 
     restart_elapsed = ((restart_finish.tv_sec - restart_start.tv_sec) * 1000L) +
@@ -1057,6 +1363,332 @@ void restart_daemon(void *d1, void *d2, void *d3, void *d4) {
   }
 }
 
+/* Runs in the forked child of the daemon process: moves the listening
+ * sockets, and the write end of the readiness pipe, to the descriptors
+ * expected by the new daemon process, and executes it.  Never returns.
+ */
+static void upgrade_exec(pool *p, array_header *listen_fds, int ready_fd) {
+  register int i;
+  int *fds, *tmp_fds, nfds, base_fd, null_fd;
+  char buf[32];
+
+  fds = listen_fds->elts;
+  nfds = listen_fds->nelts;
+
+  /* First move every descriptor out of the way, above both the range of
+   * descriptors being handed off and any of the current descriptors, so
+   * that none of them is clobbered by the dup2(2)s below.
+   */
+  base_fd = ready_fd;
+  for (i = 0; i < nfds; i++) {
+    if (fds[i] > base_fd) {
+      base_fd = fds[i];
+    }
+  }
+
+  base_fd++;
+  if (base_fd < STDERR_FILENO + 2 + nfds) {
+    base_fd = STDERR_FILENO + 2 + nfds;
+  }
+
+  tmp_fds = pcalloc(p, sizeof(int) * (nfds + 1));
+  for (i = 0; i < nfds; i++) {
+    tmp_fds[i] = fcntl(fds[i], F_DUPFD, base_fd);
+  }
+  tmp_fds[nfds] = fcntl(ready_fd, F_DUPFD, base_fd);
+
+  /* Note that dup2(2) clears the close-on-exec flag on the new descriptor. */
+  for (i = 0; i <= nfds; i++) {
+    if (tmp_fds[i] < 0 ||
+        dup2(tmp_fds[i], STDERR_FILENO + 1 + i) < 0) {
+      _exit(1);
+    }
+  }
+
+  /* The daemon process has no stdin/stdout/stderr, and any of the
+   * descriptors it does have may be using those numbers; give the new
+   * process /dev/null instead, lest it mistake them for stdio.
+   */
+  null_fd = open("/dev/null", O_RDWR);
+  if (null_fd < 0) {
+    _exit(1);
+  }
+
+  for (i = 0; i <= STDERR_FILENO; i++) {
+    if (null_fd != i) {
+      (void) dup2(null_fd, i);
+    }
+  }
+
+  if (null_fd > STDERR_FILENO) {
+    (void) close(null_fd);
+  }
+
+  snprintf(buf, sizeof(buf)-1, "%lu", (unsigned long) getpid());
+  pr_env_set(p, "LISTEN_PID", pstrdup(p, buf));
+
+  snprintf(buf, sizeof(buf)-1, "%d", nfds);
+  pr_env_set(p, "LISTEN_FDS", pstrdup(p, buf));
+
+  snprintf(buf, sizeof(buf)-1, "%d", STDERR_FILENO + 1 + nfds);
+  pr_env_set(p, PR_UPGRADE_READY_FD_ENV, pstrdup(p, buf));
+
+  if (strchr(upgrade_argv[0], '/') != NULL) {
+    execv(upgrade_argv[0], upgrade_argv);
+
+  } else {
+    execvp(upgrade_argv[0], upgrade_argv);
+  }
+
+  _exit(1);
+}
+
+void upgrade_daemon(void *d1, void *d2, void *d3, void *d4) {
+  pool *tmp_pool;
+  array_header *listen_fds;
+  int readyfds[2] = { -1, -1 };
+  pid_t pid;
+  sigset_t sig_set;
+
+  if (!is_master ||
+      mpid != getpid()) {
+    if (upgrade_handed_off) {
+      pr_log_pri(PR_LOG_NOTICE, "received SIGWINCH, ignoring: this daemon "
+        "process has already been replaced");
+    }
+
+    /* Session processes, and listener shards, have nothing to upgrade. */
+    return;
+  }
+
+  if (listen_shards > 0) {
+    pr_log_pri(PR_LOG_NOTICE, "received SIGWINCH, ignoring: upgrades are not "
+      "supported when using ListenShards");
+    return;
+  }
+
+  if (upgrade_pipe_fd != -1) {
+    pr_log_pri(PR_LOG_NOTICE, "received SIGWINCH, ignoring: upgrade already "
+      "in progress");
+    return;
+  }
+
+  if (upgrade_argv == NULL) {
+    pr_log_pri(PR_LOG_WARNING, "received SIGWINCH, unable to upgrade: "
+      "command line not available");
+    return;
+  }
+
+  tmp_pool = make_sub_pool(permanent_pool);
+  pr_pool_tag(tmp_pool, "Upgrade pool");
+
+  listen_fds = pr_ipbind_get_listening_fds(tmp_pool);
+
+  pr_log_pri(PR_LOG_NOTICE, "received SIGWINCH -- starting new daemon process "
+    "'%s', handing off %d listening %s", upgrade_argv[0], listen_fds->nelts,
+    listen_fds->nelts != 1 ? "sockets" : "socket");
+
+  if (pipe(readyfds) < 0) {
+    pr_log_pri(PR_LOG_ALERT, "pipe(2) failed: %s", strerror(errno));
+    destroy_pool(tmp_pool);
+    return;
+  }
+
+  (void) fcntl(readyfds[0], F_SETFD, FD_CLOEXEC);
+
+  /* As in fork_server(), block the signals whose handlers would otherwise
+   * run in the child before it executes the new daemon.
+   */
+  sigemptyset(&sig_set);
+  sigaddset(&sig_set, SIGTERM);
+  sigaddset(&sig_set, SIGCHLD);
+  sigaddset(&sig_set, SIGUSR1);
+  sigaddset(&sig_set, SIGUSR2);
+
+  if (sigprocmask(SIG_BLOCK, &sig_set, NULL) < 0) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to block signal set: %s", strerror(errno));
+  }
+
+  pid = fork();
+  switch (pid) {
+    case 0:
+      (void) sigprocmask(SIG_UNBLOCK, &sig_set, NULL);
+
+      /* The new daemon needs root privs, e.g. to bind to new addresses. */
+      PRIVS_ROOT
+      upgrade_exec(tmp_pool, listen_fds, readyfds[1]);
+      break;
+
+    case -1:
+      pr_log_pri(PR_LOG_ALERT, "unable to fork new daemon process: %s",
+        strerror(errno));
+      (void) close(readyfds[0]);
+      readyfds[0] = -1;
+      break;
+
+    default:
+      pr_log_debug(DEBUG2, "started new daemon process (PID %lu), waiting "
+        "for it to become ready", (unsigned long) pid);
+      break;
+  }
+
+  if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to unblock signal set: %s", strerror(errno));
+  }
+
+  (void) close(readyfds[1]);
+  destroy_pool(tmp_pool);
+
+  if (readyfds[0] == -1) {
+    return;
+  }
+
+  /* The new daemon process writes its PID to the pipe once it is ready to
+   * accept connections, or the pipe is closed if it fails to start.
+   */
+  if (pr_ioloop_add_fd(readyfds[0], PR_IOLOOP_TYPE_UPGRADE, NULL) < 0) {
+    pr_log_pri(PR_LOG_WARNING, "unable to watch for new daemon process: %s",
+      strerror(errno));
+  }
+
+  upgrade_pipe_fd = readyfds[0];
+}
+
+/* Called when the new daemon process, started by upgrade_daemon(), reports
+ * that it is ready (or has failed).
+ */
+static void upgrade_handle_ready(void) {
+  pid_t pid = 0;
+  ssize_t res;
+
+  res = read(upgrade_pipe_fd, &pid, sizeof(pid));
+  if (res < 0 &&
+      errno == EINTR) {
+    return;
+  }
+
+  (void) pr_ioloop_remove_fd(upgrade_pipe_fd);
+  (void) close(upgrade_pipe_fd);
+  upgrade_pipe_fd = -1;
+
+  if (res != sizeof(pid)) {
+    pr_log_pri(PR_LOG_WARNING, "new daemon process failed to start; "
+      "continuing to accept connections");
+    return;
+  }
+
+  pr_log_pri(PR_LOG_NOTICE, "new daemon process (PID %lu) ready -- no longer "
+    "accepting connections, waiting for %lu %s to end", (unsigned long) pid,
+    child_count(), child_count() != 1 ? "sessions" : "session");
+
+  pr_prefork_retire();
+  pr_ipbind_unwatch_listeners();
+  pr_ipbind_close_listeners();
+
+  /* The new daemon process now owns the PidFile, the scoreboard, and any
+   * other daemon-wide resources; they must not be cleaned up when this
+   * process exits.
+   */
+  mpid = 0;
+  upgrade_handed_off = TRUE;
+
+  pr_proctitle_set("(replaced; waiting for sessions to end)");
+}
+
+/* Handles the environment set up for us by upgrade_daemon(), if any.
+ * Returns the lowest descriptor which is not an inherited one.
+ */
+static int upgrade_init(int argc, char *argv[]) {
+  const char *env;
+  int lowfd = STDERR_FILENO + 1;
+  register int i;
+
+  /* Keep a copy of the command line, for re-executing ourselves later;
+   * pr_proctitle_init() will overwrite the original.
+   */
+  upgrade_argv = calloc(argc + 1, sizeof(char *));
+  if (upgrade_argv != NULL) {
+    for (i = 0; i < argc; i++) {
+      upgrade_argv[i] = strdup(argv[i]);
+      if (upgrade_argv[i] == NULL) {
+        upgrade_argv = NULL;
+        break;
+      }
+    }
+  }
+
+  /* The daemon process changes its working directory, so a relative path
+   * to the binary must be resolved now.
+   */
+  if (upgrade_argv != NULL &&
+      argc > 0 &&
+      *argv[0] != '/' &&
+      strchr(argv[0], '/') != NULL) {
+    char buf[PR_TUNABLE_PATH_MAX+1];
+
+    if (realpath(argv[0], buf) != NULL) {
+      upgrade_argv[0] = strdup(buf);
+      if (upgrade_argv[0] == NULL) {
+        upgrade_argv = NULL;
+      }
+    }
+  }
+
+  env = getenv("LISTEN_PID");
+  if (env == NULL ||
+      (pid_t) atol(env) != getpid()) {
+    return lowfd;
+  }
+
+  env = getenv("LISTEN_FDS");
+  if (env != NULL) {
+    upgrade_nfds = atoi(env);
+    if (upgrade_nfds < 0 ||
+        upgrade_nfds > FD_SETSIZE) {
+      upgrade_nfds = 0;
+    }
+
+    lowfd += upgrade_nfds;
+  }
+
+  env = getenv(PR_UPGRADE_READY_FD_ENV);
+  if (env != NULL &&
+      atoi(env) == lowfd) {
+    upgrade_notify_fd = lowfd++;
+    (void) fcntl(upgrade_notify_fd, F_SETFD, FD_CLOEXEC);
+  }
+
+  return lowfd;
+}
+
+/* Tells the previous daemon process, if any, that we are ready to accept
+ * connections on the listening sockets it handed to us.
+ */
+static void upgrade_notify_ready(void) {
+  pid_t pid;
+
+  if (upgrade_notify_fd == -1) {
+    return;
+  }
+
+  pid = getpid();
+  while (write(upgrade_notify_fd, &pid, sizeof(pid)) < 0) {
+    if (errno == EINTR) {
+      pr_signals_handle();
+      continue;
+    }
+
+    pr_log_pri(PR_LOG_WARNING, "unable to notify previous daemon process: %s",
+      strerror(errno));
+    break;
+  }
+
+  (void) close(upgrade_notify_fd);
+  upgrade_notify_fd = -1;
+}
+
 static void set_server_privs(void) {
   uid_t server_uid, current_euid = geteuid();
   gid_t server_gid, current_egid = getegid();
@@ -1148,6 +1780,8 @@ static void fork_server(int fd, conn_t *l, unsigned char no_fork) {
     case 0: /* child */
       /* No longer the master process. */
       is_master = FALSE;
+      timers_handle_fork();
+
       if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
         pr_log_pri(PR_LOG_NOTICE,
           "unable to unblock signal set: %s", strerror(errno));
@@ -1193,8 +1827,13 @@ static void fork_server(int fd, conn_t *l, unsigned char no_fork) {
 
   session.pid = getpid();
 
-  /* No longer need any listening fds. */
+  /* No longer need any listening fds, the sockets to prefork workers, nor
+   * any other connections accepted by the daemon.
+   */
   pr_ipbind_close_listeners();
+  pr_prefork_close_workers();
+  pr_ioloop_close();
+  close_pending_conns(fd);
 
   /* There would appear to be no useful purpose behind setting the process
    * group of the newly forked child.  In daemon/inetd mode, we should have no
@@ -1244,6 +1883,14 @@ static void fork_server(int fd, conn_t *l, unsigned char no_fork) {
       strerror(errno));
   }
 
+#ifdef SIGWINCH
+  if (signal(SIGWINCH, SIG_DFL) == SIG_ERR) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to install SIGWINCH (signal %d) handler: %s", SIGWINCH,
+      strerror(errno));
+  }
+#endif /* SIGWINCH */
+
   /* From this point on, syslog stays open. We close it first so that the
    * logger will pick up our new PID.
    *
@@ -1518,28 +2165,69 @@ static void disc_children(void) {
   }
 }
 
+/* Returns the number of children forked within the MaxConnectionRate
+ * interval.
+ */
+static unsigned long count_recent_children(void) {
+  unsigned long count = 0UL;
+
+  if (child_count()) {
+    pr_child_t *ch;
+    time_t now = time(NULL);
+
+    for (ch = child_get(NULL); ch; ch = child_get(ch)) {
+      if (ch->ch_when >= (time_t) (now - (long) max_connect_interval)) {
+        count++;
+      }
+    }
+  }
+
+  return count;
+}
+
 static void daemon_loop(void) {
-  fd_set listenfds;
-  conn_t *listen_conn;
-  int fd, maxfd;
-  int i, err_count = 0, xerrno = 0;
-  unsigned long nconnects = 0UL;
+  pr_ioloop_event_t events[PR_TUNABLE_IOLOOP_MAX_EVENTS];
+  int fds[PR_TUNABLE_ACCEPT_BATCH_SIZE];
+  int i, nevents, timeout, err_count = 0, xerrno = 0;
   time_t last_error;
-  struct timeval tv;
   static int running = 0;
 
   pr_proctitle_set("(accepting connections)");
 
+  if (pr_ioloop_open() < 0) {
+    pr_log_pri(PR_LOG_ERR, "fatal: unable to open I/O loop: %s",
+      strerror(errno));
+    exit(1);
+  }
+
+  pr_log_debug(DEBUG2, "using %s for accepting connections",
+    pr_ioloop_get_backend());
+
   time(&last_error);
 
   while (TRUE) {
+    unsigned long nconnects = 0UL;
+    int counted_connects = FALSE;
+
     run_schedule();
 
-    FD_ZERO(&listenfds);
-    maxfd = pr_ipbind_listen(&listenfds);
+    if (upgrade_handed_off) {
+      /* We have been replaced by a new daemon process (see upgrade_daemon());
+       * once our last session ends, we are done.
+       */
+      if (child_count() == 0) {
+        pr_log_pri(PR_LOG_NOTICE, "all sessions ended, old daemon process "
+          "exiting");
+        pr_session_end(0);
+      }
+
+    } else {
+      /* Keep the pool of idle prefork workers, if any, topped up. */
+      pr_prefork_maintain();
 
-    /* Monitor children pipes */
-    maxfd = semaphore_fds(&listenfds, maxfd);
+      /* Watch any new listening sockets, e.g. after a restart. */
+      pr_ipbind_watch_listeners();
+    }
 
     /* Check for ftp shutdown message file */
     switch (check_shutmsg(PR_SHUTMSG_PATH, &shut, &deny, &disc, shutmsg,
@@ -1558,13 +2246,10 @@ static void daemon_loop(void) {
     }
 
     if (shutting_down) {
-      tv.tv_sec = 5L;
-      tv.tv_usec = 0L;
+      timeout = 5 * 1000;
 
     } else {
-
-      tv.tv_sec = PR_TUNABLE_SELECT_TIMEOUT;
-      tv.tv_usec = 0L;
+      timeout = PR_TUNABLE_SELECT_TIMEOUT * 1000;
     }
 
     /* If running (a flag signaling whether proftpd is just starting up)
@@ -1594,12 +2279,13 @@ static void daemon_loop(void) {
     running = 1;
     xerrno = errno = 0;
 
-    PR_DEVEL_CLOCK(i = select(maxfd + 1, &listenfds, NULL, NULL, &tv));
-    if (i < 0) {
+    PR_DEVEL_CLOCK(nevents = pr_ioloop_wait(events,
+      PR_TUNABLE_IOLOOP_MAX_EVENTS, timeout));
+    if (nevents < 0) {
       xerrno = errno;
     }
 
-    if (i == -1 &&
+    if (nevents == -1 &&
         xerrno == EINTR) {
       errno = xerrno;
       pr_signals_handle();
@@ -1609,6 +2295,15 @@ static void daemon_loop(void) {
       continue;
     }
 
+    /* See if child semaphore pipes have signaled.  This must be done before
+     * any dead children are reaped, as that frees their records.
+     */
+    for (i = 0; i < nevents; i++) {
+      if (events[i].type == PR_IOLOOP_TYPE_CHILD) {
+        semaphore_close(events[i].data);
+      }
+    }
+
     if (have_dead_child) {
       sigset_t sig_set;
 
@@ -1632,14 +2327,14 @@ static void daemon_loop(void) {
       pr_alarms_unblock();
     }
 
-    if (i == -1) {
+    if (nevents == -1) {
       time_t this_error;
 
       time(&this_error);
 
       if ((this_error - last_error) <= 5 && err_count++ > 10) {
-        pr_log_pri(PR_LOG_ERR, "fatal: select(2) failing repeatedly, shutting "
-          "down");
+        pr_log_pri(PR_LOG_ERR, "fatal: %s failing repeatedly, shutting "
+          "down", pr_ioloop_get_backend());
         exit(1);
 
       } else if ((this_error - last_error) > 5) {
@@ -1647,79 +2342,105 @@ static void daemon_loop(void) {
         err_count = 0;
       }
 
-      pr_log_pri(PR_LOG_WARNING, "select(2) failed in daemon_loop(): %s",
-        strerror(xerrno));
+      pr_log_pri(PR_LOG_WARNING, "%s failed in daemon_loop(): %s",
+        pr_ioloop_get_backend(), strerror(xerrno));
     }
 
-    if (i == 0)
+    pr_signals_handle();
+
+    if (nevents <= 0) {
       continue;
+    }
 
-    /* Reset the connection counter.  Take into account this current
-     * connection, which does not (yet) have an entry in the child list.
-     */
-    nconnects = 1UL;
+    for (i = 0; i < nevents; i++) {
+      conn_t *listen_conn;
+      register int j;
+      int nfds;
 
-    /* See if child semaphore pipes have signaled */
-    if (child_count()) {
-      pr_child_t *ch;
-      time_t now = time(NULL);
+      if (events[i].type != PR_IOLOOP_TYPE_LISTENER) {
+        continue;
+      }
+
+      /* Accept all of the pending connections on this listener, up to the
+       * batch size.
+       */
+      listen_conn = events[i].data;
+      nfds = pr_inet_accept_batch(listen_conn->pool, listen_conn, fds,
+        PR_TUNABLE_ACCEPT_BATCH_SIZE);
+      if (nfds < 0) {
+        pr_log_pri(PR_LOG_ERR, "error: unable to accept an incoming "
+          "connection: %s", strerror(errno));
+        listen_conn->xerrno = 0;
+        continue;
+      }
+
+      pending_fds = fds;
+      pending_nfds = nfds;
 
-      for (ch = child_get(NULL); ch; ch = child_get(ch)) {
-	if (ch->ch_pipefd != -1 &&
-            FD_ISSET(ch->ch_pipefd, &listenfds)) {
-	  (void) close(ch->ch_pipefd);
-	  ch->ch_pipefd = -1;
-	}
+      /* Fork off servers to handle each connection our job is to get back
+       * to answering connections asap, so leave the work of determining
+       * which server the connection is for to our child.
+       */
+      for (j = 0; j < nfds; j++) {
+        int fd = fds[j];
+
+        /* This connection is now ours to handle. */
+        fds[j] = -1;
 
-        /* While we're looking, tally up the number of children forked in
-         * the past interval.
+        /* Tally up the number of children forked in the past interval.
+         * Take into account this current connection, which does not (yet)
+         * have an entry in the child list.
          */
-        if (ch->ch_when >= (time_t) (now - (long) max_connect_interval)) {
-          nconnects++;
+        if (max_connects &&
+            !counted_connects) {
+          nconnects = count_recent_children();
+          counted_connects = TRUE;
         }
-      }
-    }
 
-    pr_signals_handle();
+        /* Check for exceeded MaxInstances. */
+        if (ServerMaxInstances > 0 &&
+            child_count() >= ServerMaxInstances) {
+          pr_event_generate("core.max-instances", NULL);
 
-    if (i < 0) {
-      continue;
-    }
+          pr_log_pri(PR_LOG_WARNING,
+            "MaxInstances (%lu) reached, new connection denied",
+            ServerMaxInstances);
+          close(fd);
 
-    /* Accept the connection. */
-    listen_conn = pr_ipbind_accept_conn(&listenfds, &fd);
+        /* Check for exceeded MaxConnectionRate. */
+        } else if (max_connects && (nconnects + 1 > max_connects)) {
+          pr_event_generate("core.max-connection-rate", NULL);
 
-    /* Fork off servers to handle each connection our job is to get back to
-     * answering connections asap, so leave the work of determining which
-     * server the connection is for to our child.
-     */
-
-    if (listen_conn) {
+          pr_log_pri(PR_LOG_WARNING,
+            "MaxConnectionRate (%lu/%u secs) reached, new connection denied",
+            max_connects, max_connect_interval);
+          close(fd);
 
-      /* Check for exceeded MaxInstances. */
-      if (ServerMaxInstances > 0 &&
-          child_count() >= ServerMaxInstances) {
-        pr_event_generate("core.max-instances", NULL);
-        
-        pr_log_pri(PR_LOG_WARNING,
-          "MaxInstances (%lu) reached, new connection denied",
-          ServerMaxInstances);
-        close(fd);
+        /* Hand the connection to an idle prefork worker, if possible;
+         * otherwise, fork off a child to handle the connection.
+         */
+        } else {
+          if (pr_prefork_dispatch(fd, listen_conn) < 0) {
+            PR_DEVEL_CLOCK(fork_server(fd, listen_conn, no_forking));
+          }
 
-      /* Check for exceeded MaxConnectionRate. */
-      } else if (max_connects && (nconnects > max_connects)) {
-        pr_event_generate("core.max-connection-rate", NULL);
+          nconnects++;
+        }
+      }
 
-        pr_log_pri(PR_LOG_WARNING,
-          "MaxConnectionRate (%lu/%u secs) reached, new connection denied",
-          max_connects, max_connect_interval);
-        close(fd);
+      pending_fds = NULL;
+      pending_nfds = 0;
+    }
 
-      /* Fork off a child to handle the connection. */
-      } else {
-        PR_DEVEL_CLOCK(fork_server(fd, listen_conn, no_forking));
+    /* Only hand off the listening sockets once any connections accepted
+     * above have been dealt with.
+     */
+    for (i = 0; i < nevents; i++) {
+      if (events[i].type == PR_IOLOOP_TYPE_UPGRADE) {
+        upgrade_handle_ready();
       }
     }
+
 #ifdef PR_DEVEL_NO_DAEMON
     /* Do not continue the while() loop here if not daemonizing. */
     break;
@@ -1740,6 +2461,7 @@ static void daemonize(void) {
       exit(1);
 
     case 0:
+      timers_handle_fork();
       break;
 
     default: 
@@ -1846,6 +2568,221 @@ static void inetd_main(void) {
   fork_server(STDIN_FILENO, main_server->listen, TRUE);
 }
 
+static void set_listen_shards(void) {
+  unsigned int *nshards;
+
+  nshards = get_param_ptr(main_server->conf, "ListenShards", FALSE);
+  if (nshards == NULL) {
+    return;
+  }
+
+  startup_shards = *nshards;
+  if (startup_shards < 2) {
+    return;
+  }
+
+  if (no_forking) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "ListenShards not used when running without forking");
+    return;
+  }
+
+  /* Each shard needs its own socket for the same address and port. */
+  if (pr_inet_set_reuse_port(TRUE) < 0) {
+    pr_log_pri(PR_LOG_WARNING, "ListenShards not supported: %s",
+      strerror(errno));
+    return;
+  }
+
+  listen_shards = startup_shards;
+  shard_pids = pcalloc(permanent_pool, listen_shards * sizeof(pid_t));
+
+  pr_log_debug(DEBUG2, "using %u listener shards", listen_shards);
+}
+
+static int shard_running(pid_t pid) {
+  pr_child_t *ch;
+
+  if (pid == 0 ||
+      child_count() == 0) {
+    return FALSE;
+  }
+
+  for (ch = child_get(NULL); ch; ch = child_get(ch)) {
+    if (ch->ch_pid == pid &&
+        !ch->ch_dead) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+static void shard_main(unsigned int id) {
+  pr_child_t *ch;
+
+  shard_id = id;
+
+  /* The other shards are our siblings, not our children; forget them, so
+   * that e.g. SIGTERM is only relayed to our own children.
+   */
+  if (child_count()) {
+    for (ch = child_get(NULL); ch; ch = child_get(ch)) {
+      if (!ch->ch_dead) {
+        (void) child_remove(ch->ch_pid);
+      }
+    }
+
+    child_update();
+  }
+  have_dead_child = FALSE;
+
+  /* The supervisor's I/O loop is not ours. */
+  pr_ioloop_close();
+
+  /* Note that mpid still refers to the supervisor, which remains the daemon
+   * process as far as e.g. the PidFile and module cleanup are concerned.
+   */
+  if (pr_ipbind_reopen_listeners() < 0) {
+    pr_log_pri(PR_LOG_ERR, "fatal: listener shard %u unable to open its "
+      "listening sockets: %s", shard_id, strerror(errno));
+    exit(1);
+  }
+
+  set_shard_limits();
+  set_prefork_workers();
+
+  pr_log_debug(DEBUG2, "listener shard %u of %u (PID %lu) accepting "
+    "connections", shard_id, listen_shards, (unsigned long) getpid());
+
+  daemon_loop();
+  exit(0);
+}
+
+static void spawn_shard(unsigned int idx) {
+  pid_t pid;
+  sigset_t sig_set;
+
+  /* As in fork_server(), block the signals which would have us examine the
+   * child list before the new shard has been added to it.
+   */
+  sigemptyset(&sig_set);
+  sigaddset(&sig_set, SIGTERM);
+  sigaddset(&sig_set, SIGCHLD);
+  sigaddset(&sig_set, SIGUSR1);
+  sigaddset(&sig_set, SIGUSR2);
+
+  if (sigprocmask(SIG_BLOCK, &sig_set, NULL) < 0) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to block signal set: %s", strerror(errno));
+  }
+
+  pid = fork();
+  switch (pid) {
+    case 0:
+      timers_handle_fork();
+
+      if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
+        pr_log_pri(PR_LOG_NOTICE,
+          "unable to unblock signal set: %s", strerror(errno));
+      }
+
+      shard_main(idx + 1);
+      break;
+
+    case -1:
+      pr_log_pri(PR_LOG_ALERT, "unable to fork listener shard: %s",
+        strerror(errno));
+      break;
+
+    default:
+      child_add(pid, -1);
+      shard_pids[idx] = pid;
+      break;
+  }
+
+  if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to unblock signal set: %s", strerror(errno));
+  }
+}
+
+/* The daemon process, when using listener shards, only keeps the shards
+ * running; restarts are relayed to them by restart_daemon().
+ */
+static void shard_loop(void) {
+  pr_ioloop_event_t events[1];
+  time_t last_spawn = 0;
+
+  pr_proctitle_set("(supervising %u listener shards)", listen_shards);
+
+  if (pr_ioloop_open() < 0) {
+    pr_log_pri(PR_LOG_ERR, "fatal: unable to open I/O loop: %s",
+      strerror(errno));
+    exit(1);
+  }
+
+  while (TRUE) {
+    register unsigned int i;
+
+    run_schedule();
+
+    if (have_dead_child) {
+      sigset_t sig_set;
+
+      sigemptyset(&sig_set);
+      sigaddset(&sig_set, SIGCHLD);
+      sigaddset(&sig_set, SIGTERM);
+      pr_alarms_block();
+      if (sigprocmask(SIG_BLOCK, &sig_set, NULL) < 0) {
+        pr_log_pri(PR_LOG_NOTICE,
+          "unable to block signal set: %s", strerror(errno));
+      }
+
+      have_dead_child = FALSE;
+      child_update();
+
+      if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
+        pr_log_pri(PR_LOG_NOTICE,
+          "unable to unblock signal set: %s", strerror(errno));
+      }
+
+      pr_alarms_unblock();
+    }
+
+    /* Replace any shards which have exited, but at most once a second, lest
+     * a shard which cannot start have us spinning.
+     */
+    if (child_count() < listen_shards) {
+      time_t now;
+
+      time(&now);
+      if (now != last_spawn) {
+        for (i = 0; i < listen_shards; i++) {
+          if (shard_running(shard_pids[i]) == FALSE) {
+            if (shard_pids[i] != 0) {
+              pr_log_pri(PR_LOG_WARNING, "listener shard %u (PID %lu) "
+                "exited, restarting", i + 1, (unsigned long) shard_pids[i]);
+            }
+
+            spawn_shard(i);
+          }
+        }
+
+        last_spawn = now;
+      }
+    }
+
+    if (pr_ioloop_wait(events, 1, 1000) < 0 &&
+        errno != EINTR) {
+      pr_log_pri(PR_LOG_WARNING, "%s failed in shard_loop(): %s",
+        pr_ioloop_get_backend(), strerror(errno));
+    }
+
+    pr_signals_handle();
+  }
+}
+
 static void standalone_main(void) {
   int res = 0;
 
@@ -1860,8 +2797,27 @@ static void standalone_main(void) {
   }
 
   PRIVS_ROOT
-  pr_delete_scoreboard();
-  res = pr_open_scoreboard(O_RDWR);
+  if (upgrade_notify_fd == -1) {
+    pr_delete_scoreboard();
+    res = pr_open_scoreboard(O_RDWR);
+
+  } else {
+    /* Take over the scoreboard of the previous daemon process, whose
+     * sessions are still running; start afresh if it is not usable.
+     */
+    res = pr_open_scoreboard(O_RDWR);
+    if (res < 0) {
+      pr_log_pri(PR_LOG_NOTICE, "unable to use existing scoreboard (%d), "
+        "recreating it", res);
+      pr_delete_scoreboard();
+      res = pr_open_scoreboard(O_RDWR);
+
+    } else if (pr_scoreboard_set_daemon_pid(getpid()) < 0) {
+      pr_log_pri(PR_LOG_NOTICE, "error updating scoreboard header: %s",
+        strerror(errno));
+    }
+  }
+
   if (res < 0) {
     PRIVS_RELINQUISH
 
@@ -1891,7 +2847,20 @@ static void standalone_main(void) {
 
   pr_event_generate("core.startup", NULL);
 
+  set_listen_shards();
+
+  if (upgrade_nfds > 0 &&
+      pr_ipbind_inherit_fds(STDERR_FILENO + 1, upgrade_nfds) < 0) {
+    pr_log_pri(PR_LOG_WARNING, "unable to use inherited listening sockets: "
+      "%s", strerror(errno));
+  }
+
   init_bindings();
+  (void) pr_ipbind_close_inherited_fds();
+
+  if (listen_shards == 0) {
+    set_prefork_workers();
+  }
 
   pr_log_pri(PR_LOG_NOTICE, "ProFTPD %s (built %s) standalone mode STARTUP",
     PROFTPD_VERSION_TEXT " " PR_STATUS, BUILD_STAMP);
@@ -1902,7 +2871,14 @@ static void standalone_main(void) {
     exit(1);
   }
 
-  daemon_loop();
+  upgrade_notify_ready();
+
+  if (listen_shards > 0) {
+    shard_loop();
+
+  } else {
+    daemon_loop();
+  }
 }
 
 extern char *optarg;
@@ -2124,6 +3100,8 @@ static void show_settings(void) {
 
   /* Tunable settings */
   printf("%s", "\n  Tunable Options:\n");
+  printf("    PR_TUNABLE_ACCEPT_BATCH_SIZE = %u\n",
+    PR_TUNABLE_ACCEPT_BATCH_SIZE);
   printf("    PR_TUNABLE_BUFFER_SIZE = %u\n", PR_TUNABLE_BUFFER_SIZE);
   printf("    PR_TUNABLE_DEFAULT_RCVBUFSZ = %u\n", PR_TUNABLE_DEFAULT_RCVBUFSZ);
   printf("    PR_TUNABLE_DEFAULT_SNDBUFSZ = %u\n", PR_TUNABLE_DEFAULT_SNDBUFSZ);
@@ -2131,6 +3109,8 @@ static void show_settings(void) {
   printf("    PR_TUNABLE_GLOBBING_MAX_MATCHES = %lu\n", PR_TUNABLE_GLOBBING_MAX_MATCHES);
   printf("    PR_TUNABLE_GLOBBING_MAX_RECURSION = %u\n", PR_TUNABLE_GLOBBING_MAX_RECURSION);
   printf("    PR_TUNABLE_HASH_TABLE_SIZE = %u\n", PR_TUNABLE_HASH_TABLE_SIZE);
+  printf("    PR_TUNABLE_IOLOOP_MAX_EVENTS = %u\n",
+    PR_TUNABLE_IOLOOP_MAX_EVENTS);
   printf("    PR_TUNABLE_LOGIN_MAX = %u\n", PR_TUNABLE_LOGIN_MAX);
   printf("    PR_TUNABLE_NEW_POOL_SIZE = %u\n", PR_TUNABLE_NEW_POOL_SIZE);
   printf("    PR_TUNABLE_PATH_MAX = %u\n", PR_TUNABLE_PATH_MAX);
@@ -2242,7 +3222,10 @@ int main(int argc, char *argv[], char **envp) {
 
   memset(&session, 0, sizeof(session));
 
-  pr_fs_close_extra_fds();
+  /* Close any stray descriptors, keeping any listening sockets handed to us
+   * by a previous daemon process.
+   */
+  pr_fs_close_extra_fds2(upgrade_init(argc, argv));
   pr_proctitle_init(argc, argv, envp);
 
   /* Seed rand */
@@ -2260,6 +3243,13 @@ int main(int argc, char *argv[], char **envp) {
   /* Initialize the memory subsystem here */
   init_pools();
 
+  /* The upgrade environment variables are only meant for us; do not pass
+   * them on to any programs we may run.
+   */
+  pr_env_unset(permanent_pool, "LISTEN_PID");
+  pr_env_unset(permanent_pool, "LISTEN_FDS");
+  pr_env_unset(permanent_pool, PR_UPGRADE_READY_FD_ENV);
+
   /* Command line options supported:
    *
    * -D parameter       set run-time configuration parameter
@@ -26,6 +26,11 @@
 
 #include "conf.h"
 
+#if defined(__SSE2__) && defined(__GNUC__)
+# include <emmintrin.h>
+# define PR_NETIO_USE_SSE2
+#endif
+
 /* See RFC 854 for the definition of these Telnet values */
 
 /* Telnet "Interpret As Command" indicator */
@@ -61,6 +66,15 @@
 
 static const char *trace_channel = "netio";
 
+/* The most vectors we hand to writev(2) in one call; any more are written
+ * by subsequent calls.
+ */
+#if defined(IOV_MAX)
+# define PR_NETIO_IOV_MAX		IOV_MAX
+#else
+# define PR_NETIO_IOV_MAX		16
+#endif
+
 static pr_netio_t *default_ctrl_netio = NULL, *ctrl_netio = NULL;
 static pr_netio_t *default_data_netio = NULL, *data_netio = NULL;
 static pr_netio_t *default_othr_netio = NULL, *othr_netio = NULL;
@@ -76,6 +90,46 @@ static pr_netio_t *default_othr_netio = NULL, *othr_netio = NULL;
  */
 static int properly_terminated_prev_command = TRUE;
 
+/* Returns the ID of the core.{ctrl,data,othr}-{read,write} event generated
+ * for each buffer read from, or written to, a stream of the given type.  The IDs are
+ * looked up once, so that checking for listeners per buffer is cheap.
+ */
+static int netio_get_event_id(int strm_type, int io) {
+  static int read_ids[3] = { 0, 0, 0 }, write_ids[3] = { 0, 0, 0 };
+  static const char *read_events[3] = {
+    "core.ctrl-read", "core.data-read", "core.othr-read"
+  };
+  static const char *write_events[3] = {
+    "core.ctrl-write", "core.data-write", "core.othr-write"
+  };
+  int *ids, idx;
+
+  switch (strm_type) {
+    case PR_NETIO_STRM_CTRL:
+      idx = 0;
+      break;
+
+    case PR_NETIO_STRM_DATA:
+      idx = 1;
+      break;
+
+    case PR_NETIO_STRM_OTHR:
+      idx = 2;
+      break;
+
+    default:
+      return 0;
+  }
+
+  ids = (io == PR_NETIO_IO_RD ? read_ids : write_ids);
+  if (ids[idx] == 0) {
+    ids[idx] = pr_event_get_id(io == PR_NETIO_IO_RD ? read_events[idx] :
+      write_events[idx]);
+  }
+
+  return ids[idx];
+}
+
 static pr_netio_stream_t *netio_stream_alloc(pool *parent_pool) {
   pool *netio_pool = NULL;
   pr_netio_stream_t *nstrm = NULL;
@@ -100,7 +154,7 @@ static pr_netio_stream_t *netio_stream_alloc(pool *parent_pool) {
   /* This table will not contain that many entries, so a low number
    * of chains should suffice.
    */
-  nstrm->notes = pr_table_nalloc(nstrm->strm_pool, 0, 4);
+  nstrm->notes = pr_table_nalloc(nstrm->strm_pool, PR_TABLE_FL_OPEN_ADDR, 4);
 
   return nstrm;
 }
@@ -245,6 +299,15 @@ static int core_netio_write_cb(pr_netio_stream_t *nstrm, char *buf,
   return write(nstrm->strm_fd, buf, buflen);
 }
 
+static int core_netio_writev_cb(pr_netio_stream_t *nstrm,
+    const struct iovec *iov, int iovcnt) {
+  if (iovcnt > PR_NETIO_IOV_MAX) {
+    iovcnt = PR_NETIO_IOV_MAX;
+  }
+
+  return writev(nstrm->strm_fd, iov, iovcnt);
+}
+
 static const char *netio_stream_mode(int strm_mode) {
   const char *modestr = "(unknown)";
 
@@ -1031,7 +1094,7 @@ int pr_netio_printf_async(pr_netio_stream_t *nstrm, char *fmt, ...) {
 }
 
 int pr_netio_write(pr_netio_stream_t *nstrm, char *buf, size_t buflen) {
-  int bwritten = 0, total = 0;
+  int bwritten = 0, event_id, total = 0;
   const char *nstrm_mode;
   pr_buffer_t *pbuf;
   pool *tmp_pool;
@@ -1062,32 +1125,23 @@ int pr_netio_write(pr_netio_stream_t *nstrm, char *buf, size_t buflen) {
    * pr_buffer_t out of that.  Then simply destroy the subpool when done.
    */
 
-  tmp_pool = make_sub_pool(nstrm->strm_pool);
-  pbuf = pcalloc(tmp_pool, sizeof(pr_buffer_t));
-  pbuf->buf = buf;
-  pbuf->buflen = buflen;
-  pbuf->current = pbuf->buf;
-  pbuf->remaining = 0;
-
-  switch (nstrm->strm_type) {
-    case PR_NETIO_STRM_CTRL:
-      pr_event_generate("core.ctrl-write", pbuf);
-      break;
+  event_id = netio_get_event_id(nstrm->strm_type, PR_NETIO_IO_WR);
+  if (PR_EVENT_LISTENING(event_id) > 0) {
+    tmp_pool = make_sub_pool(nstrm->strm_pool);
+    pbuf = pcalloc(tmp_pool, sizeof(pr_buffer_t));
+    pbuf->buf = buf;
+    pbuf->buflen = buflen;
+    pbuf->current = pbuf->buf;
+    pbuf->remaining = 0;
 
-    case PR_NETIO_STRM_DATA:
-      pr_event_generate("core.data-write", pbuf);
-      break;
+    pr_event_generate_id(event_id, pbuf);
 
-    case PR_NETIO_STRM_OTHR:
-      pr_event_generate("core.othr-write", pbuf);
-      break;
+    /* The event listeners may have changed the data to write out. */
+    buf = pbuf->buf;
+    buflen = pbuf->buflen - pbuf->remaining;
+    destroy_pool(tmp_pool);
   }
 
-  /* The event listeners may have changed the data to write out. */
-  buf = pbuf->buf;
-  buflen = pbuf->buflen - pbuf->remaining;
-  destroy_pool(tmp_pool);
-
   while (buflen) {
 
     switch (pr_netio_poll(nstrm)) {
@@ -1174,8 +1228,198 @@ int pr_netio_write(pr_netio_stream_t *nstrm, char *buf, size_t buflen) {
   return total;
 }
 
+/* Returns the NetIO whose callbacks handle the given stream. */
+static pr_netio_t *netio_get_stream_netio(pr_netio_stream_t *nstrm) {
+  pr_netio_t *netio = NULL;
+
+  switch (nstrm->strm_type) {
+    case PR_NETIO_STRM_CTRL:
+      netio = ctrl_netio != NULL ? ctrl_netio : default_ctrl_netio;
+      break;
+
+    case PR_NETIO_STRM_DATA:
+      netio = data_netio != NULL ? data_netio : default_data_netio;
+      break;
+
+    case PR_NETIO_STRM_OTHR:
+      netio = othr_netio != NULL ? othr_netio : default_othr_netio;
+      break;
+  }
+
+  return netio;
+}
+
+/* Writes the given vectors by coalescing them into a single buffer, for
+ * NetIOs which do not provide a writev callback, or when there are event
+ * listeners which expect to see the data as one buffer.
+ */
+static int netio_writev_coalesced(pr_netio_stream_t *nstrm,
+    const struct iovec *iov, int iovcnt, size_t buflen) {
+  register int i;
+  int res, xerrno;
+  char *buf, *ptr;
+  pool *tmp_pool;
+
+  tmp_pool = make_sub_pool(nstrm->strm_pool);
+  pr_pool_tag(tmp_pool, "NetIO writev pool");
+
+  buf = ptr = palloc(tmp_pool, buflen);
+  for (i = 0; i < iovcnt; i++) {
+    memcpy(ptr, iov[i].iov_base, iov[i].iov_len);
+    ptr += iov[i].iov_len;
+  }
+
+  res = pr_netio_write(nstrm, buf, buflen);
+  xerrno = errno;
+
+  destroy_pool(tmp_pool);
+  errno = xerrno;
+  return res;
+}
+
+int pr_netio_writev(pr_netio_stream_t *nstrm, const struct iovec *iov,
+    int iovcnt) {
+  register int i;
+  int bwritten = 0, event_id, total = 0;
+  size_t buflen = 0;
+  const char *nstrm_mode;
+  struct iovec *vec;
+  pr_netio_t *netio;
+  pool *tmp_pool;
+
+  /* Sanity check */
+  if (nstrm == NULL ||
+      iov == NULL ||
+      iovcnt <= 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (i = 0; i < iovcnt; i++) {
+    buflen += iov[i].iov_len;
+  }
+
+  if (buflen == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (nstrm->strm_fd == -1) {
+    errno = (nstrm->strm_errno ? nstrm->strm_errno : EBADF);
+    return -1;
+  }
+
+  if (iovcnt == 1) {
+    return pr_netio_write(nstrm, iov[0].iov_base, iov[0].iov_len);
+  }
+
+  netio = netio_get_stream_netio(nstrm);
+  if (netio == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  /* The core writev callback is only usable if the write callback is also
+   * still the core's; a module may have replaced just the write callback of
+   * the NetIO, as e.g. mod_deflate does.
+   */
+  event_id = netio_get_event_id(nstrm->strm_type, PR_NETIO_IO_WR);
+  if (PR_EVENT_LISTENING(event_id) > 0 ||
+      netio->writev == NULL ||
+      (netio->writev == core_netio_writev_cb &&
+       netio->write != core_netio_write_cb)) {
+    return netio_writev_coalesced(nstrm, iov, iovcnt, buflen);
+  }
+
+  nstrm_mode = netio_stream_mode(nstrm->strm_mode);
+
+  /* Partial writes require adjusting the vectors, so work on a copy. */
+  tmp_pool = make_sub_pool(nstrm->strm_pool);
+  pr_pool_tag(tmp_pool, "NetIO writev pool");
+
+  vec = palloc(tmp_pool, sizeof(struct iovec) * iovcnt);
+  memcpy(vec, iov, sizeof(struct iovec) * iovcnt);
+
+  while (buflen) {
+
+    switch (pr_netio_poll(nstrm)) {
+      case 1:
+        /* pr_netio_poll() returns 1 only if the stream has been aborted. */
+        destroy_pool(tmp_pool);
+        errno = ECONNABORTED;
+        return -2;
+
+      case -1: {
+        int xerrno = errno;
+
+        destroy_pool(tmp_pool);
+        errno = xerrno;
+        return -1;
+      }
+
+      default:
+        bwritten = 0;
+
+        /* We have to potentially restart here as well, in case we get EINTR. */
+        do {
+          pr_signals_handle();
+          run_schedule();
+
+          if (nstrm->strm_type == PR_NETIO_STRM_DATA &&
+              XFER_ABORTED) {
+            break;
+          }
+
+          pr_trace_msg(trace_channel, 19,
+            "using %s writev() for %s stream (%d %s)", netio->owner_name,
+            nstrm_mode, iovcnt, iovcnt != 1 ? "vectors" : "vector");
+          bwritten = (netio->writev)(nstrm, vec, iovcnt);
+
+        } while (bwritten == -1 && errno == EINTR);
+        break;
+    }
+
+    if (bwritten == -1) {
+      nstrm->strm_errno = errno;
+      destroy_pool(tmp_pool);
+      errno = nstrm->strm_errno;
+      return -1;
+    }
+
+    total += bwritten;
+    buflen -= bwritten;
+
+    /* Skip past the vectors, and any part of a vector, already written. */
+    while (bwritten > 0) {
+      if ((size_t) bwritten < vec->iov_len) {
+        vec->iov_base = ((char *) vec->iov_base) + bwritten;
+        vec->iov_len -= bwritten;
+        break;
+      }
+
+      bwritten -= vec->iov_len;
+      vec++;
+      iovcnt--;
+    }
+
+    /* Empty vectors left at the front would leave the callback nothing to
+     * write.
+     */
+    while (iovcnt > 0 &&
+           vec->iov_len == 0) {
+      vec++;
+      iovcnt--;
+    }
+  }
+
+  destroy_pool(tmp_pool);
+
+  session.total_raw_out += total;
+  return total;
+}
+
 int pr_netio_write_async(pr_netio_stream_t *nstrm, char *buf, size_t buflen) {
-  int bwritten = 0, flags = 0, total = 0;
+  int bwritten = 0, event_id, flags = 0, total = 0;
   const char *nstrm_mode;
   pr_buffer_t *pbuf;
   pool *tmp_pool;
@@ -1207,32 +1451,23 @@ int pr_netio_write_async(pr_netio_stream_t *nstrm, char *buf, size_t buflen) {
    * for any listeners which may want to examine this data.
    */
 
-  tmp_pool = make_sub_pool(nstrm->strm_pool);
-  pbuf = pcalloc(tmp_pool, sizeof(pr_buffer_t));
-  pbuf->buf = buf;
-  pbuf->buflen = buflen;
-  pbuf->current = pbuf->buf;
-  pbuf->remaining = 0;
+  event_id = netio_get_event_id(nstrm->strm_type, PR_NETIO_IO_WR);
+  if (PR_EVENT_LISTENING(event_id) > 0) {
+    tmp_pool = make_sub_pool(nstrm->strm_pool);
+    pbuf = pcalloc(tmp_pool, sizeof(pr_buffer_t));
+    pbuf->buf = buf;
+    pbuf->buflen = buflen;
+    pbuf->current = pbuf->buf;
+    pbuf->remaining = 0;
 
-  switch (nstrm->strm_type) {
-    case PR_NETIO_STRM_CTRL:
-      pr_event_generate("core.ctrl-write", pbuf);
-      break;
+    pr_event_generate_id(event_id, pbuf);
 
-    case PR_NETIO_STRM_DATA:
-      pr_event_generate("core.data-write", pbuf);
-      break;
-
-    case PR_NETIO_STRM_OTHR:
-      pr_event_generate("core.othr-write", pbuf);
-      break;
+    /* The event listeners may have changed the data to write out. */
+    buf = pbuf->buf;
+    buflen = pbuf->buflen - pbuf->remaining;
+    destroy_pool(tmp_pool);
   }
 
-  /* The event listeners may have changed the data to write out. */
-  buf = pbuf->buf;
-  buflen = pbuf->buflen - pbuf->remaining;
-  destroy_pool(tmp_pool);
-
   while (buflen) {
     do {
 
@@ -1317,7 +1552,7 @@ int pr_netio_write_async(pr_netio_stream_t *nstrm, char *buf, size_t buflen) {
 
 int pr_netio_read(pr_netio_stream_t *nstrm, char *buf, size_t buflen,
     int bufmin) {
-  int bread = 0, total = 0;
+  int bread = 0, event_id, total = 0;
   const char *nstrm_mode;
   pr_buffer_t *pbuf;
   pool *tmp_pool;
@@ -1466,32 +1701,23 @@ int pr_netio_read(pr_netio_stream_t *nstrm, char *buf, size_t buflen,
      * pr_buffer_t out of that.  Then simply destroy the subpool when done.
      */
 
-    tmp_pool = make_sub_pool(nstrm->strm_pool);
-    pbuf = pcalloc(tmp_pool, sizeof(pr_buffer_t));
-    pbuf->buf = buf;
-    pbuf->buflen = bread;
-    pbuf->current = pbuf->buf;
-    pbuf->remaining = 0;
-
-    switch (nstrm->strm_type) {
-      case PR_NETIO_STRM_CTRL:
-        pr_event_generate("core.ctrl-read", pbuf);
-        break;
+    event_id = netio_get_event_id(nstrm->strm_type, PR_NETIO_IO_RD);
+    if (PR_EVENT_LISTENING(event_id) > 0) {
+      tmp_pool = make_sub_pool(nstrm->strm_pool);
+      pbuf = pcalloc(tmp_pool, sizeof(pr_buffer_t));
+      pbuf->buf = buf;
+      pbuf->buflen = bread;
+      pbuf->current = pbuf->buf;
+      pbuf->remaining = 0;
 
-      case PR_NETIO_STRM_DATA:
-        pr_event_generate("core.data-read", pbuf);
-        break;
+      pr_event_generate_id(event_id, pbuf);
 
-      case PR_NETIO_STRM_OTHR:
-        pr_event_generate("core.othr-read", pbuf);
-        break;
+      /* The event listeners may have changed the data read in out. */
+      buf = pbuf->buf;
+      bread = pbuf->buflen - pbuf->remaining;
+      destroy_pool(tmp_pool);
     }
 
-    /* The event listeners may have changed the data read in out. */
-    buf = pbuf->buf;
-    bread = pbuf->buflen - pbuf->remaining;
-    destroy_pool(tmp_pool);
-
     buf += bread;
     total += bread;
     bufmin -= bread;
@@ -1613,7 +1839,8 @@ char *pr_netio_gets(char *buf, size_t buflen, pr_netio_stream_t *nstrm) {
        * network, generate an event for any listeners which may want to
        * examine this data as well.
        */
-      pr_event_generate("core.othr-read", pbuf);
+      pr_event_generate_id(netio_get_event_id(PR_NETIO_STRM_OTHR,
+        PR_NETIO_IO_RD), pbuf);
     }
 
     toread = pbuf->buflen - pbuf->remaining;
@@ -1648,6 +1875,73 @@ char *pr_netio_gets(char *buf, size_t buflen, pr_netio_stream_t *nstrm) {
 
 static int telnet_mode = 0;
 
+/* Returns the length of the leading run of the given bytes which contains no
+ * LF and, if handle_iac is TRUE, no Telnet IAC; such runs are simply copied
+ * by pr_netio_telnet_gets2().  The bytes are checked 16 at a time using SSE2
+ * where available, otherwise 8 at a time, using word-sized operations.
+ */
+static size_t netio_telnet_scan(const unsigned char *data, size_t datalen,
+    int handle_iac) {
+  size_t len = 0;
+
+#if defined(PR_NETIO_USE_SSE2)
+  const __m128i lfs = _mm_set1_epi8('\n');
+  const __m128i iacs = _mm_set1_epi8((char) TELNET_IAC);
+
+  while (len + 16 <= datalen) {
+    __m128i chunk, matches;
+    int mask;
+
+    chunk = _mm_loadu_si128((const __m128i *) (data + len));
+    matches = _mm_cmpeq_epi8(chunk, lfs);
+    if (handle_iac == TRUE) {
+      matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, iacs));
+    }
+
+    mask = _mm_movemask_epi8(matches);
+    if (mask != 0) {
+      return len + __builtin_ctz(mask);
+    }
+
+    len += 16;
+  }
+#else
+  const uint64_t lsbs = (uint64_t) 0x0101010101010101ULL;
+  const uint64_t msbs = (uint64_t) 0x8080808080808080ULL;
+
+  while (len + 8 <= datalen) {
+    uint64_t chunk, matches, iacs;
+
+    memcpy(&chunk, data + len, sizeof(chunk));
+
+    /* A byte is zero, after XORing with the byte sought, only if it matched;
+     * IAC bytes are those which are zero after inverting.
+     */
+    matches = chunk ^ (lsbs * '\n');
+    matches = (matches - lsbs) & ~matches & msbs;
+
+    if (handle_iac == TRUE) {
+      iacs = ~chunk;
+      matches |= (iacs - lsbs) & ~iacs & msbs;
+    }
+
+    if (matches != 0) {
+      break;
+    }
+
+    len += 8;
+  }
+#endif /* PR_NETIO_USE_SSE2 */
+
+  while (len < datalen &&
+         data[len] != '\n' &&
+         (handle_iac == FALSE || data[len] != TELNET_IAC)) {
+    len++;
+  }
+
+  return len;
+}
+
 int pr_netio_telnet_gets2(char *buf, size_t bufsz,
     pr_netio_stream_t *in_nstrm, pr_netio_stream_t *out_nstrm) {
   char *bp = buf;
@@ -1702,18 +1996,46 @@ int pr_netio_telnet_gets2(char *buf, size_t bufsz,
        * network, handing any Telnet characters and such, generate an event
        * for any listeners which may want to examine this data as well.
        */
-      pr_event_generate("core.ctrl-read", pbuf);
+      pr_event_generate_id(netio_get_event_id(PR_NETIO_STRM_CTRL,
+        PR_NETIO_IO_RD), pbuf);
     }
 
     toread = pbuf->buflen - pbuf->remaining;
 
     while (buflen > 0 &&
-           toread > 0 &&
-           (*pbuf->current != '\n' ||
-            (*pbuf->current == '\n' && *(pbuf->current - 1) != '\r')) &&
-           toread--) {
+           toread > 0) {
       pr_signals_handle();
 
+      /* Outside of a Telnet command sequence, runs of bytes up to the next
+       * LF or IAC need no handling; copy them in bulk.
+       */
+      if (handle_iac == FALSE ||
+          (telnet_mode != TELNET_IAC &&
+           telnet_mode != TELNET_WILL &&
+           telnet_mode != TELNET_WONT &&
+           telnet_mode != TELNET_DO &&
+           telnet_mode != TELNET_DONT)) {
+        size_t len;
+
+        len = netio_telnet_scan((unsigned char *) pbuf->current,
+          (size_t) toread < buflen ? (size_t) toread : buflen, handle_iac);
+        if (len > 0) {
+          memcpy(bp, pbuf->current, len);
+          bp += len;
+          buflen -= len;
+          pbuf->current += len;
+          pbuf->remaining += len;
+          toread -= len;
+          continue;
+        }
+      }
+
+      if (*pbuf->current == '\n' &&
+          *(pbuf->current - 1) == '\r') {
+        break;
+      }
+
+      toread--;
       cp = *pbuf->current++;
       pbuf->remaining++;
 
@@ -1857,6 +2179,48 @@ int pr_netio_telnet_gets2(char *buf, size_t bufsz,
   return (bufsz - buflen - 1);
 }
 
+int pr_netio_telnet_pending(pr_netio_stream_t *nstrm) {
+  pr_buffer_t *pbuf;
+  char *ptr;
+  size_t len;
+
+  if (nstrm == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  pbuf = nstrm->strm_buf;
+  if (pbuf == NULL ||
+      pbuf->current == NULL ||
+      pbuf->remaining >= pbuf->buflen) {
+    return FALSE;
+  }
+
+  /* As for pr_netio_telnet_gets2(), only a CRLF ends the line. */
+  ptr = pbuf->current;
+  len = pbuf->buflen - pbuf->remaining;
+
+  while (len > 0) {
+    char *lf;
+
+    lf = memchr(ptr, '\n', len);
+    if (lf == NULL) {
+      break;
+    }
+
+    /* The CR must be unread data too, not a byte already consumed. */
+    if (lf > ptr &&
+        *(lf - 1) == '\r') {
+      return TRUE;
+    }
+
+    len -= (lf - ptr) + 1;
+    ptr = lf + 1;
+  }
+
+  return FALSE;
+}
+
 char *pr_netio_telnet_gets(char *buf, size_t bufsz,
     pr_netio_stream_t *in_nstrm, pr_netio_stream_t *out_nstrm) {
   int res;
@@ -1892,6 +2256,13 @@ int pr_register_netio(pr_netio_t *netio, int strm_types) {
         (default_netio = pr_alloc_netio2(permanent_pool, NULL, NULL));
     }
 
+    /* NetIOs allocated by modules do not get the core writev callback, as
+     * it would bypass their write callbacks; only the default NetIO does.
+     */
+    if (default_netio != NULL) {
+      default_netio->writev = core_netio_writev_cb;
+    }
+
     return 0;
   }
 
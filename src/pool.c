@@ -28,6 +28,10 @@
 
 #include "conf.h"
 
+#if defined(HAVE_MALLOC_H) && defined(HAVE_MALLOC_TRIM)
+# include <malloc.h>
+#endif
+
 /* Manage free storage blocks */
 
 union align {
@@ -53,14 +57,32 @@ union block_hdr {
     void *endp;
     union block_hdr *next;
     void *first_avail;
+    unsigned int cls;
   } h;
 };
 
-static union block_hdr *block_freelist = NULL;
+/* Free blocks are kept on size-segregated lists.  List i holds the blocks
+ * whose size is at least (1 << (i + BLOCK_CLASS_MIN_SHIFT)) bytes, and less
+ * than twice that; list 0 also holds any smaller blocks, and the last list
+ * holds all larger blocks.  Since non-exact block sizes are BLOCK_MINFREE
+ * times a power of two, nearly any block on their list will do.
+ */
+#define BLOCK_CLASS_MIN_SHIFT	6
+#define BLOCK_NCLASSES		16
+
+/* How many blocks on a list to look at, for a block big enough for an
+ * exact size, before moving on to the next larger list.
+ */
+#define BLOCK_CLASS_MAX_SCAN	8
+
+static union block_hdr *block_freelists[BLOCK_NCLASSES];
+static size_t block_freelist_bytes = 0;
+static size_t block_freelist_max = PR_TUNABLE_POOL_MAX_FREE;
 
 /* Statistics */
 static unsigned int stat_malloc = 0;	/* incr when malloc required */
 static unsigned int stat_freehit = 0;	/* incr when freelist used */
+static unsigned int stat_freetrim = 0;	/* incr when freelist trimmed */
 
 #ifdef PR_USE_DEVEL
 static const char *trace_channel = "pool";
@@ -121,6 +143,19 @@ static void *smalloc(size_t size) {
   return res;
 }
 
+static unsigned int block_class(size_t sz) {
+  unsigned int cls = 0;
+
+  sz >>= (BLOCK_CLASS_MIN_SHIFT + 1);
+  while (sz > 0 &&
+         cls < BLOCK_NCLASSES - 1) {
+    sz >>= 1;
+    cls++;
+  }
+
+  return cls;
+}
+
 /* Grab a completely new block from the system pool.  Relies on malloc()
  * to return truly aligned memory.
  */
@@ -131,6 +166,7 @@ static union block_hdr *malloc_block(size_t size) {
   blok->h.next = NULL;
   blok->h.first_avail = (char *) (blok + 1);
   blok->h.endp = size + (char *) blok->h.first_avail;
+  blok->h.cls = block_class(size);
 
   return blok;
 }
@@ -154,64 +190,145 @@ static void chk_on_blk_list(union block_hdr *blok, union block_hdr *free_blk,
 #endif /* PR_USE_DEVEL */
 }
 
+#define BLOCK_SIZE(blok) \
+  ((size_t) ((char *) (blok)->h.endp - (char *) ((blok) + 1)))
+
+/* Hands free blocks, largest first, back to the system allocator until the
+ * free lists hold at most the given number of bytes.  _Must_ call with
+ * alarms blocked.
+ */
+static size_t trim_free_blocks(size_t max_bytes) {
+  register int i;
+  size_t released = 0;
+
+  for (i = BLOCK_NCLASSES - 1; i >= 0; i--) {
+    while (block_freelists[i] != NULL &&
+           block_freelist_bytes > max_bytes) {
+      union block_hdr *blok;
+      size_t sz;
+
+      blok = block_freelists[i];
+      block_freelists[i] = blok->h.next;
+
+      sz = BLOCK_SIZE(blok);
+      block_freelist_bytes -= sz;
+      released += sz;
+      free(blok);
+    }
+
+    if (block_freelist_bytes <= max_bytes) {
+      break;
+    }
+  }
+
+  return released;
+}
+
 /* Free a chain of blocks -- _must_ call with alarms blocked. */
 
 static void free_blocks(union block_hdr *blok, const char *pool_tag) {
-  /* Puts new blocks at head of block list, point next pointer of
-   * last block in chain to free blocks we already had.
-   */
+  union block_hdr *next;
 
-  union block_hdr *old_free_list = block_freelist;
+  /* Puts each run of blocks of the same size class at the head of the
+   * free list for that class, keeping the blocks in their pool order.
+   */
+  for (; blok; blok = next) {
+    union block_hdr *last;
+    unsigned int cls;
 
-  if (!blok)
-    return;		/* Shouldn't be freeing an empty pool */
+    cls = blok->h.cls;
 
-  block_freelist = blok;
+    for (last = blok; ; last = last->h.next) {
+      chk_on_blk_list(last, block_freelists[cls], pool_tag);
+      last->h.first_avail = (char *) (last + 1);
+      block_freelist_bytes += BLOCK_SIZE(last);
 
-  /* Adjust first_avail pointers */
+      if (last->h.next == NULL ||
+          last->h.next->h.cls != cls) {
+        break;
+      }
+    }
 
-  while (blok->h.next) {
-    chk_on_blk_list(blok, old_free_list, pool_tag);
-    blok->h.first_avail = (char *) (blok + 1);
-    blok = blok->h.next;
+    next = last->h.next;
+    last->h.next = block_freelists[cls];
+    block_freelists[cls] = blok;
   }
 
-  chk_on_blk_list(blok, old_free_list, pool_tag);
-  blok->h.first_avail = (char *) (blok + 1);
-  blok->h.next = old_free_list;
+  if (block_freelist_max > 0 &&
+      block_freelist_bytes > block_freelist_max) {
+    /* Trim down to half of the maximum, so that a process hovering around
+     * the maximum does not trim on every pool destroyed.
+     */
+    (void) trim_free_blocks(block_freelist_max / 2);
+    stat_freetrim++;
+
+#if defined(HAVE_MALLOC_H) && defined(HAVE_MALLOC_TRIM)
+    /* Have the allocator return the now-free pages to the kernel. */
+    (void) malloc_trim(0);
+#endif /* HAVE_MALLOC_H and HAVE_MALLOC_TRIM */
+  }
 }
 
-/* Get a new block, from the free list if possible, otherwise malloc a new
+/* Get a new block, from the free lists if possible, otherwise malloc a new
  * one.  minsz is the requested size of the block to be allocated.
  * If exact is TRUE, then minsz is the exact size of the allocated block;
  * otherwise, the allocated size will be rounded up from minsz to the nearest
- * multiple of BLOCK_MINFREE.
+ * multiple of BLOCK_MINFREE, and then (for all but the largest blocks) to
+ * BLOCK_MINFREE times a power of two.
  *
  * Important: BLOCK ALARMS BEFORE CALLING
  */
 
 static union block_hdr *new_block(int minsz, int exact) {
-  union block_hdr **lastptr = &block_freelist;
-  union block_hdr *blok = block_freelist;
+  register unsigned int i;
+  unsigned int cls;
 
   if (!exact) {
-    minsz = 1 + ((minsz - 1) / BLOCK_MINFREE);
-    minsz *= BLOCK_MINFREE;
-  }
+    if (minsz <= BLOCK_MINFREE) {
+      /* The common case, e.g. for make_sub_pool(). */
+      minsz = BLOCK_MINFREE;
 
-  /* Check if we have anything of the requested size on our free list first...
-   */
-  while (blok) {
-    if (minsz <= ((char *) blok->h.endp - (char *) blok->h.first_avail)) {
-      *lastptr = blok->h.next;
-      blok->h.next = NULL;
+    } else {
+      minsz = 1 + ((minsz - 1) / BLOCK_MINFREE);
+      minsz *= BLOCK_MINFREE;
+
+      if (minsz < (1 << (BLOCK_CLASS_MIN_SHIFT + BLOCK_NCLASSES - 1))) {
+        int sz = BLOCK_MINFREE;
+
+        while (sz < minsz) {
+          sz <<= 1;
+        }
 
-      stat_freehit++;
-      return blok;
+        minsz = sz;
+      }
     }
+  }
 
-    lastptr = &blok->h.next;
-    blok = blok->h.next;
+  /* Check if we have anything of the requested size on our free lists
+   * first.  The blocks on the list for minsz may be smaller than minsz; the
+   * blocks on the larger lists (save the last) are all big enough.
+   */
+  cls = block_class(minsz);
+  for (i = cls; i < BLOCK_NCLASSES; i++) {
+    union block_hdr **lastptr = &block_freelists[i];
+    union block_hdr *blok = block_freelists[i];
+    unsigned int nscanned = 0;
+
+    while (blok != NULL &&
+           nscanned < BLOCK_CLASS_MAX_SCAN) {
+      if ((size_t) minsz <= BLOCK_SIZE(blok)) {
+        *lastptr = blok->h.next;
+        blok->h.next = NULL;
+        block_freelist_bytes -= BLOCK_SIZE(blok);
+
+        stat_freehit++;
+        return blok;
+      }
+
+      lastptr = &blok->h.next;
+      blok = blok->h.next;
+      nscanned++;
+    }
   }
 
   /* Nope...damn.  Have to malloc() a new one. */
@@ -341,16 +458,28 @@ static long walk_pools(pool *p, unsigned long level,
 }
 
 static void debug_pool_info(void (*debugf)(const char *, ...)) {
-  if (block_freelist) {
-    debugf("Free block list: %lu bytes",
-      bytes_in_block_list(block_freelist));
+  register unsigned int i;
+
+  if (block_freelist_bytes > 0) {
+    debugf("Free block lists: %lu bytes",
+      (unsigned long) block_freelist_bytes);
+
+    for (i = 0; i < BLOCK_NCLASSES; i++) {
+      if (block_freelists[i] != NULL) {
+        debugf("  %lu bytes and up: %lu blocks, %lu bytes",
+          1UL << (i + BLOCK_CLASS_MIN_SHIFT),
+          blocks_in_block_list(block_freelists[i]),
+          bytes_in_block_list(block_freelists[i]));
+      }
+    }
 
   } else {
-    debugf("Free block list: empty");
+    debugf("Free block lists: empty");
   }
 
   debugf("%u blocks allocated", stat_malloc);
   debugf("%u blocks reused", stat_freehit);
+  debugf("%u free block list trims", stat_freetrim);
 }
 
 static void pool_printf(const char *fmt, ...) {
@@ -398,18 +527,35 @@ void pr_pool_tag(pool *p, const char *tag) {
 }
 
 /* Release the entire free block list */
-static void pool_release_free_block_list(void) {
-  union block_hdr *blok = NULL, *next = NULL;
+static size_t pool_release_free_block_list(void) {
+  size_t released;
 
   pr_alarms_block();
+  released = trim_free_blocks(0);
+  pr_alarms_unblock();
+
+  return released;
+}
+
+unsigned long pr_pool_release_free_blocks(void) {
+  return (unsigned long) pool_release_free_block_list();
+}
+
+size_t pr_pool_set_max_free(size_t max_free) {
+  size_t prev_max_free;
+
+  pr_alarms_block();
+
+  prev_max_free = block_freelist_max;
+  block_freelist_max = max_free;
 
-  for (blok = block_freelist; blok; blok = next) {
-    next = blok->h.next;
-    free(blok);
+  if (block_freelist_max > 0 &&
+      block_freelist_bytes > block_freelist_max) {
+    (void) trim_free_blocks(block_freelist_max);
   }
-  block_freelist = NULL;
 
   pr_alarms_unblock();
+  return prev_max_free;
 }
 
 struct pool_rec *make_sub_pool(struct pool_rec *p) {
@@ -0,0 +1,473 @@
+/*
+ * ProFTPD - FTP server daemon
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* Prefork session worker pool
+ *
+ * Rather than forking a new process for every accepted control connection,
+ * the daemon process can keep a number of already-forked, idle worker
+ * processes around.  Each accepted connection is then passed, via
+ * SCM_RIGHTS, to an idle worker, which starts the session just as a
+ * newly forked child would.  The fork(2) cost is thus moved out of the
+ * accept path.
+ *
+ * A worker handles exactly one session; sessions chroot and drop their
+ * privileges, so a process cannot be reused for a different session
+ * afterward.
+ */
+
+#include "conf.h"
+
+extern unsigned char is_master;
+
+struct prefork_worker {
+  struct prefork_worker *next, *prev;
+
+  pool *pool;
+  pid_t pid;
+  int sockfd;
+};
+
+/* The payload sent, along with the connection fd, to a worker.  Workers are
+ * forked from the daemon process, and are retired whenever the bindings
+ * are recreated, thus the listening conn_t pointer is valid in the worker's
+ * address space as well.
+ */
+struct prefork_msg {
+  conn_t *listener;
+};
+
+static pool *prefork_pool = NULL;
+static xaset_t *prefork_idle = NULL;
+static unsigned int prefork_nidle = 0;
+
+static unsigned int prefork_min_spare = 0;
+static unsigned int prefork_max_spare = 0;
+static unsigned int prefork_target = 0;
+static void (*prefork_session_cb)(int, conn_t *) = NULL;
+
+/* For tracking the demand for workers over the most recent interval. */
+static time_t prefork_window_start = 0;
+static unsigned int prefork_dispatched = 0;
+
+static const char *trace_channel = "prefork";
+
+static void prefork_remove_worker(struct prefork_worker *w) {
+  xaset_remove(prefork_idle, (xasetmember_t *) w);
+  prefork_nidle--;
+
+  if (w->sockfd >= 0) {
+    (void) close(w->sockfd);
+    w->sockfd = -1;
+  }
+
+  destroy_pool(w->pool);
+}
+
+static void prefork_worker_main(int sockfd) {
+  struct prefork_msg msg;
+  int fd = -1, res;
+
+  /* The worker must not hold the daemon's ends of the sockets to the other
+   * workers, nor the listening sockets, nor the daemon's I/O loop.
+   */
+  pr_prefork_close_workers();
+  pr_ipbind_close_listeners();
+  pr_ioloop_close();
+
+  if (signal(SIGHUP, SIG_IGN) == SIG_ERR) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to install SIGHUP (signal %d) handler: %s", SIGHUP,
+      strerror(errno));
+  }
+
+  pr_proctitle_set("(prefork worker)");
+
+  memset(&msg, 0, sizeof(msg));
+  res = pr_inet_recv_fd(sockfd, &fd, &msg, sizeof(msg));
+  (void) close(sockfd);
+
+  if (res != (int) sizeof(msg) ||
+      fd < 0) {
+    /* A short read here means that the daemon retired this worker, or went
+     * away entirely.
+     */
+    if (fd >= 0) {
+      (void) close(fd);
+    }
+
+    exit(0);
+  }
+
+  pr_trace_msg(trace_channel, 17, "worker PID %lu received connection fd %d",
+    (unsigned long) getpid(), fd);
+
+  prefork_session_cb(fd, msg.listener);
+
+  /* Not reached, normally; the session callback ends the session. */
+  exit(0);
+}
+
+static int prefork_spawn(void) {
+  struct prefork_worker *w;
+  int sockfds[2] = { -1, -1 }, xerrno;
+  pid_t pid;
+  pool *p;
+  sigset_t sig_set;
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockfds) < 0) {
+    xerrno = errno;
+
+    pr_log_pri(PR_LOG_WARNING, "unable to create prefork worker socket: %s",
+      strerror(xerrno));
+
+    errno = xerrno;
+    return -1;
+  }
+
+  (void) fcntl(sockfds[0], F_SETFD, FD_CLOEXEC);
+
+  /* As in fork_server(), block these signals so that the bookkeeping is
+   * not disturbed while the worker is being created.
+   */
+  sigemptyset(&sig_set);
+  sigaddset(&sig_set, SIGTERM);
+  sigaddset(&sig_set, SIGCHLD);
+  sigaddset(&sig_set, SIGUSR1);
+  sigaddset(&sig_set, SIGUSR2);
+
+  if (sigprocmask(SIG_BLOCK, &sig_set, NULL) < 0) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to block signal set: %s", strerror(errno));
+  }
+
+  pid = fork();
+  xerrno = errno;
+
+  switch (pid) {
+    case 0:
+      /* No longer the master process. */
+      is_master = FALSE;
+      timers_handle_fork();
+
+      if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
+        pr_log_pri(PR_LOG_NOTICE,
+          "unable to unblock signal set: %s", strerror(errno));
+      }
+
+      (void) close(sockfds[0]);
+      prefork_worker_main(sockfds[1]);
+
+      /* Not reached. */
+      exit(0);
+
+    case -1:
+      if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
+        pr_log_pri(PR_LOG_NOTICE,
+          "unable to unblock signal set: %s", strerror(errno));
+      }
+
+      pr_log_pri(PR_LOG_ALERT, "unable to fork(): %s", strerror(xerrno));
+
+      (void) close(sockfds[0]);
+      (void) close(sockfds[1]);
+
+      errno = xerrno;
+      return -1;
+
+    default:
+      break;
+  }
+
+  (void) close(sockfds[1]);
+
+  if (prefork_pool == NULL) {
+    prefork_pool = make_sub_pool(permanent_pool);
+    pr_pool_tag(prefork_pool, "Prefork Pool");
+  }
+
+  if (prefork_idle == NULL) {
+    prefork_idle = xaset_create(prefork_pool, NULL);
+  }
+
+  p = make_sub_pool(prefork_pool);
+  pr_pool_tag(p, "prefork worker pool");
+
+  w = pcalloc(p, sizeof(struct prefork_worker));
+  w->pool = p;
+  w->pid = pid;
+  w->sockfd = sockfds[0];
+
+  /* Append, so that the list is ordered from oldest to newest. */
+  xaset_insert_end(prefork_idle, (xasetmember_t *) w);
+  prefork_nidle++;
+
+  if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to unblock signal set: %s", strerror(errno));
+  }
+
+  pr_trace_msg(trace_channel, 15, "spawned prefork worker PID %lu",
+    (unsigned long) pid);
+  return 0;
+}
+
+/* Idle workers never write to their sockets; an EOF on the socket thus
+ * means that the worker has exited.
+ */
+static void prefork_reap_workers(void) {
+  struct prefork_worker *w, *wn;
+
+  if (prefork_idle == NULL) {
+    return;
+  }
+
+  for (w = (struct prefork_worker *) prefork_idle->xas_list; w; w = wn) {
+    char c;
+    int res;
+
+    wn = w->next;
+
+#ifdef MSG_DONTWAIT
+    res = recv(w->sockfd, &c, 1, MSG_PEEK|MSG_DONTWAIT);
+#else
+    res = -1;
+    errno = EAGAIN;
+#endif /* MSG_DONTWAIT */
+    if (res == 0 ||
+        (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+         errno != EINTR)) {
+      pr_trace_msg(trace_channel, 9, "idle prefork worker PID %lu went away",
+        (unsigned long) w->pid);
+      prefork_remove_worker(w);
+    }
+  }
+}
+
+int pr_prefork_set_workers(unsigned int min_spare, unsigned int max_spare,
+    void (*session_cb)(int, conn_t *)) {
+
+  if (max_spare > 0 &&
+      (session_cb == NULL ||
+       min_spare > max_spare)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  prefork_min_spare = min_spare;
+  prefork_max_spare = max_spare;
+  prefork_target = min_spare;
+  prefork_session_cb = session_cb;
+
+  if (max_spare == 0) {
+    pr_prefork_retire();
+  }
+
+  return 0;
+}
+
+int pr_prefork_dispatch(int fd, conn_t *listener) {
+  struct prefork_msg msg;
+
+  if (fd < 0 ||
+      listener == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  memset(&msg, 0, sizeof(msg));
+  msg.listener = listener;
+
+  while (prefork_idle != NULL &&
+         prefork_idle->xas_list != NULL) {
+    struct prefork_worker *w;
+    sigset_t sig_set;
+    int res, xerrno;
+
+    pr_signals_handle();
+
+    /* Use the oldest idle worker first. */
+    w = (struct prefork_worker *) prefork_idle->xas_list;
+
+    /* Block SIGCHLD until the worker is on the child list, lest a quickly
+     * ending session be reaped before we know about it.
+     */
+    sigemptyset(&sig_set);
+    sigaddset(&sig_set, SIGTERM);
+    sigaddset(&sig_set, SIGCHLD);
+
+    if (sigprocmask(SIG_BLOCK, &sig_set, NULL) < 0) {
+      pr_log_pri(PR_LOG_NOTICE,
+        "unable to block signal set: %s", strerror(errno));
+    }
+
+    res = pr_inet_send_fd(w->sockfd, fd, &msg, sizeof(msg));
+    xerrno = errno;
+
+    if (res == 0) {
+      child_add(w->pid, -1);
+    }
+
+    if (sigprocmask(SIG_UNBLOCK, &sig_set, NULL) < 0) {
+      pr_log_pri(PR_LOG_NOTICE,
+        "unable to unblock signal set: %s", strerror(errno));
+    }
+
+    if (res == 0) {
+      pr_trace_msg(trace_channel, 17,
+        "handed connection fd %d to prefork worker PID %lu", fd,
+        (unsigned long) w->pid);
+
+      prefork_remove_worker(w);
+      prefork_dispatched++;
+
+      /* The daemon process does not need the connection any longer. */
+      (void) close(fd);
+      return 0;
+    }
+
+    pr_trace_msg(trace_channel, 9,
+      "unable to use prefork worker PID %lu: %s", (unsigned long) w->pid,
+      strerror(xerrno));
+    prefork_remove_worker(w);
+  }
+
+  /* Account for the unmet demand as well, so that the pool grows. */
+  if (prefork_max_spare > 0) {
+    prefork_dispatched++;
+  }
+
+  errno = ENOENT;
+  return -1;
+}
+
+void pr_prefork_maintain(void) {
+  register unsigned int i;
+  unsigned int nspawn;
+  time_t now;
+
+  if (prefork_max_spare == 0) {
+    return;
+  }
+
+  time(&now);
+  if (now != prefork_window_start) {
+    unsigned int target;
+
+    prefork_reap_workers();
+
+    /* Size the pool after the demand seen in the last interval, within the
+     * configured bounds.
+     */
+    target = prefork_dispatched;
+    if (target < prefork_min_spare) {
+      target = prefork_min_spare;
+    }
+
+    if (target > prefork_max_spare) {
+      target = prefork_max_spare;
+    }
+
+    /* Grow quickly, but shrink slowly: retire at most one surplus worker per
+     * interval, so that bursty load does not cause needless churn.
+     */
+    if (target < prefork_target &&
+        prefork_nidle > target) {
+      struct prefork_worker *w;
+
+      w = (struct prefork_worker *) prefork_idle->xas_list;
+      pr_trace_msg(trace_channel, 15,
+        "retiring surplus prefork worker PID %lu (%u idle, target %u)",
+        (unsigned long) w->pid, prefork_nidle, target);
+      prefork_remove_worker(w);
+    }
+
+    prefork_target = target;
+    prefork_window_start = now;
+    prefork_dispatched = 0;
+  }
+
+  if (prefork_nidle >= prefork_target) {
+    return;
+  }
+
+  nspawn = prefork_target - prefork_nidle;
+  if (nspawn > PR_PREFORK_SPAWN_BATCH) {
+    nspawn = PR_PREFORK_SPAWN_BATCH;
+  }
+
+  for (i = 0; i < nspawn; i++) {
+    if (ServerMaxInstances > 0 &&
+        (child_count() + prefork_nidle) >= ServerMaxInstances) {
+      break;
+    }
+
+    if (prefork_spawn() < 0) {
+      break;
+    }
+  }
+}
+
+void pr_prefork_retire(void) {
+  if (prefork_idle == NULL) {
+    return;
+  }
+
+  pr_trace_msg(trace_channel, 15, "retiring %u idle prefork %s",
+    prefork_nidle, prefork_nidle != 1 ? "workers" : "worker");
+
+  /* Closing our end of its socket tells the worker to exit. */
+  while (prefork_idle->xas_list != NULL) {
+    prefork_remove_worker((struct prefork_worker *) prefork_idle->xas_list);
+  }
+
+  destroy_pool(prefork_pool);
+  prefork_pool = NULL;
+  prefork_idle = NULL;
+  prefork_nidle = 0;
+}
+
+unsigned int pr_prefork_get_idle_count(void) {
+  return prefork_nidle;
+}
+
+void pr_prefork_close_workers(void) {
+  struct prefork_worker *w;
+
+  if (prefork_idle == NULL) {
+    return;
+  }
+
+  for (w = (struct prefork_worker *) prefork_idle->xas_list; w; w = w->next) {
+    if (w->sockfd >= 0) {
+      (void) close(w->sockfd);
+      w->sockfd = -1;
+    }
+  }
+
+  destroy_pool(prefork_pool);
+  prefork_pool = NULL;
+  prefork_idle = NULL;
+  prefork_nidle = 0;
+  prefork_max_spare = 0;
+}
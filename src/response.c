@@ -40,20 +40,28 @@ static char *(*resp_handler_cb)(pool *, const char *, ...) = NULL;
 
 static const char *trace_channel = "response";
 
-#define RESPONSE_WRITE_NUM_STR(strm, fmt, numeric, msg) \
+/* Responses are collected here, then written to the control connection
+ * together: all of the lines of a multiline response, and the responses to
+ * commands pipelined by the client.
+ */
+#define RESP_PENDING_BUFSZ	(PR_RESPONSE_BUFFER_SIZE * 2)
+static char *resp_pending = NULL;
+static size_t resp_pendinglen = 0;
+
+#define RESPONSE_WRITE_NUM_STR(fmt, numeric, msg) \
   pr_trace_msg(trace_channel, 1, (fmt), (numeric), (msg)); \
   if (resp_handler_cb) \
-    pr_netio_printf((strm), "%s", resp_handler_cb(resp_pool, (fmt), (numeric), \
+    resp_pending_printf("%s", resp_handler_cb(resp_pool, (fmt), (numeric), \
       (msg))); \
   else \
-    pr_netio_printf((strm), (fmt), (numeric), (msg));
+    resp_pending_printf((fmt), (numeric), (msg));
 
-#define RESPONSE_WRITE_STR(strm, fmt, msg) \
+#define RESPONSE_WRITE_STR(fmt, msg) \
   pr_trace_msg(trace_channel, 1, (fmt), (msg)); \
   if (resp_handler_cb) \
-    pr_netio_printf((strm), "%s", resp_handler_cb(resp_pool, (fmt), (msg))); \
+    resp_pending_printf("%s", resp_handler_cb(resp_pool, (fmt), (msg))); \
   else \
-    pr_netio_printf((strm), (fmt), (msg));
+    resp_pending_printf((fmt), (msg));
 
 #define RESPONSE_WRITE_STR_ASYNC(strm, fmt, msg) \
   pr_trace_msg(trace_channel, 1, pstrcat(session.pool, "async: ", (fmt), NULL), \
@@ -64,6 +72,125 @@ static const char *trace_channel = "response";
   else \
     pr_netio_printf_async((strm), (fmt), (msg));
 
+/* Writes out the collected responses, followed by the given line, if any,
+ * in a single write.
+ */
+static int resp_pending_writev(char *line, size_t linelen) {
+  struct iovec iov[2];
+  int iovcnt = 0, res;
+
+  if (resp_pendinglen == 0 &&
+      linelen == 0) {
+    return 0;
+  }
+
+  if (session.c == NULL ||
+      session.c->outstrm == NULL) {
+    resp_pendinglen = 0;
+    return 0;
+  }
+
+  if (resp_pendinglen > 0) {
+    iov[iovcnt].iov_base = resp_pending;
+    iov[iovcnt].iov_len = resp_pendinglen;
+    iovcnt++;
+  }
+
+  if (linelen > 0) {
+    iov[iovcnt].iov_base = line;
+    iov[iovcnt].iov_len = linelen;
+    iovcnt++;
+  }
+
+  res = pr_netio_writev(session.c->outstrm, iov, iovcnt);
+  resp_pendinglen = 0;
+
+  return res;
+}
+
+static int resp_pending_write(void) {
+  return resp_pending_writev(NULL, 0);
+}
+
+static void resp_pending_printf(const char *fmt, ...)
+#ifdef __GNUC__
+       __attribute__ ((format (printf, 1, 2)));
+#else
+       ;
+#endif
+
+static void resp_pending_printf(const char *fmt, ...) {
+  va_list msg;
+  size_t bufsz;
+  int res;
+
+  /* The buffer is allocated on first use, and freed by idle sessions. */
+  if (resp_pending == NULL) {
+    resp_pending = malloc(RESP_PENDING_BUFSZ);
+    if (resp_pending == NULL) {
+      pr_log_pri(PR_LOG_ALERT, "Out of memory!");
+      exit(1);
+    }
+  }
+
+  bufsz = RESP_PENDING_BUFSZ - resp_pendinglen;
+
+  va_start(msg, fmt);
+  res = vsnprintf(resp_pending + resp_pendinglen, bufsz, fmt, msg);
+  va_end(msg);
+
+  if (res < 0) {
+    return;
+  }
+
+  if ((size_t) res >= bufsz &&
+      resp_pendinglen > 0) {
+    char line[RESP_PENDING_BUFSZ];
+
+    /* Not enough room left; send what we have, along with this line. */
+    va_start(msg, fmt);
+    res = vsnprintf(line, sizeof(line), fmt, msg);
+    va_end(msg);
+
+    if (res < 0) {
+      (void) resp_pending_write();
+      return;
+    }
+
+    if ((size_t) res >= sizeof(line)) {
+      res = sizeof(line) - 1;
+    }
+
+    (void) resp_pending_writev(line, res);
+    return;
+  }
+
+  if ((size_t) res >= bufsz) {
+    /* Truncated, as pr_netio_printf() would do. */
+    res = bufsz - 1;
+  }
+
+  resp_pendinglen += res;
+}
+
+int pr_response_flush_pending(void) {
+  return resp_pending_write();
+}
+
+int pr_response_free_pending(void) {
+  if (resp_pendinglen > 0) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  if (resp_pending != NULL) {
+    free(resp_pending);
+    resp_pending = NULL;
+  }
+
+  return 0;
+}
+
 pool *pr_response_get_pool(void) {
   return resp_pool;
 }
@@ -175,18 +302,16 @@ void pr_response_flush(pr_response_t **head) {
       if (resp->next == NULL ||
           (resp->num != NULL &&
            strcmp(resp->num, last_numeric) != 0)) {
-        RESPONSE_WRITE_NUM_STR(session.c->outstrm, "%s %s\r\n", last_numeric,
-          resp->msg)
+        RESPONSE_WRITE_NUM_STR("%s %s\r\n", last_numeric, resp->msg)
         ml = FALSE;
 
       } else {
         /* RFC2228's multiline responses are required for protected sessions. */
 	if (session.multiline_rfc2228 || session.sp_flags) {
-          RESPONSE_WRITE_NUM_STR(session.c->outstrm, "%s-%s\r\n", last_numeric,
-            resp->msg)
+          RESPONSE_WRITE_NUM_STR("%s-%s\r\n", last_numeric, resp->msg)
 
 	} else {
-          RESPONSE_WRITE_STR(session.c->outstrm, " %s\r\n" , resp->msg)
+          RESPONSE_WRITE_STR(" %s\r\n" , resp->msg)
         }
       }
 
@@ -195,19 +320,33 @@ void pr_response_flush(pr_response_t **head) {
       if (resp->next &&
           (resp->next->num == NULL ||
            strcmp(resp->num, resp->next->num) == 0)) {
-        RESPONSE_WRITE_NUM_STR(session.c->outstrm, "%s-%s\r\n", resp->num,
-          resp->msg)
+        RESPONSE_WRITE_NUM_STR("%s-%s\r\n", resp->num, resp->msg)
         ml = TRUE;
         last_numeric = resp->num;
 
       } else {
-        RESPONSE_WRITE_NUM_STR(session.c->outstrm, "%s %s\r\n", resp->num,
-          resp->msg)
+        RESPONSE_WRITE_NUM_STR("%s %s\r\n", resp->num, resp->msg)
       }
     }
   }
 
   pr_response_clear(head);
+
+  /* If the client has already sent its next command, hold these responses
+   * back, to be sent along with the responses to that command.  Not while
+   * a data transfer is in progress, though, as commands received then are
+   * handled only as the transfer allows.
+   */
+  if (session.c->instrm != NULL &&
+      !(session.sf_flags & SF_XFER) &&
+      pr_netio_telnet_pending(session.c->instrm) == TRUE) {
+    pr_trace_msg(trace_channel, 19,
+      "holding back responses (%lu bytes) for pipelined commands",
+      (unsigned long) resp_pendinglen);
+    return;
+  }
+
+  (void) resp_pending_write();
 }
 
 void pr_response_add_err(const char *numeric, const char *fmt, ...) {
@@ -351,6 +490,10 @@ void pr_response_send_async(const char *resp_numeric, const char *fmt, ...) {
   resp_last_response_msg = pstrdup(resp_pool, buf + len + 1);
 
   sstrcat(buf + res, "\r\n", sizeof(buf));
+
+  /* Any held-back responses must be sent first. */
+  (void) resp_pending_write();
+
   RESPONSE_WRITE_STR_ASYNC(session.c->outstrm, "%s", buf)
 }
 
@@ -378,8 +521,8 @@ void pr_response_send(const char *resp_numeric, const char *fmt, ...) {
   resp_last_response_code = pstrdup(resp_pool, resp_numeric);
   resp_last_response_msg = pstrdup(resp_pool, resp_buf);
 
-  RESPONSE_WRITE_NUM_STR(session.c->outstrm, "%s %s\r\n", resp_numeric,
-    resp_buf)
+  RESPONSE_WRITE_NUM_STR("%s %s\r\n", resp_numeric, resp_buf)
+  (void) resp_pending_write();
 }
 
 void pr_response_send_raw(const char *fmt, ...) {
@@ -404,5 +547,6 @@ void pr_response_send_raw(const char *fmt, ...) {
 
   resp_buf[sizeof(resp_buf) - 1] = '\0';
 
-  RESPONSE_WRITE_STR(session.c->outstrm, "%s\r\n", resp_buf)
+  RESPONSE_WRITE_STR("%s\r\n", resp_buf)
+  (void) resp_pending_write();
 }
@@ -955,6 +955,54 @@ pid_t pr_scoreboard_get_daemon_pid(void) {
   return header.sch_pid;
 }
 
+int pr_scoreboard_set_daemon_pid(pid_t pid) {
+  int res;
+
+  if (scoreboard_engine == FALSE) {
+    return 0;
+  }
+
+  if (scoreboard_fd < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  header.sch_pid = pid;
+  header.sch_uptime = time(NULL);
+
+  PR_DEVEL_CLOCK(res = wlock_scoreboard());
+  if (res < 0) {
+    return -1;
+  }
+
+  pr_trace_msg(trace_channel, 7, "writing scoreboard header (daemon PID %lu)",
+    (unsigned long) pid);
+
+  if (lseek(scoreboard_fd, (off_t) 0, SEEK_SET) == (off_t) -1) {
+    int xerrno = errno;
+
+    unlock_scoreboard();
+    errno = xerrno;
+    return -1;
+  }
+
+  while (write(scoreboard_fd, &header, sizeof(header)) != sizeof(header)) {
+    int xerrno = errno;
+
+    if (errno == EINTR) {
+      pr_signals_handle();
+      continue;
+    }
+
+    unlock_scoreboard();
+    errno = xerrno;
+    return -1;
+  }
+
+  unlock_scoreboard();
+  return 0;
+}
+
 time_t pr_scoreboard_get_daemon_uptime(void) {
   if (scoreboard_engine == FALSE) {
     return 0;
@@ -24,6 +24,10 @@
 
 #include "conf.h"
 
+#if defined(HAVE_MALLOC_H) && defined(HAVE_MALLOC_TRIM)
+# include <malloc.h>
+#endif
+
 /* From src/main.c */
 extern unsigned char is_master;
 
@@ -122,6 +126,9 @@ void pr_session_disconnect(module *m, int reason_code,
 void pr_session_end(int flags) {
   int exitcode = 0;
 
+  /* Make sure the client sees any responses still held back. */
+  (void) pr_response_flush_pending();
+
   sess_cleanup(flags);
 
   if (flags & PR_SESS_END_FL_NOEXIT) {
@@ -389,6 +396,35 @@ int pr_session_set_idle(void) {
   return 0;
 }
 
+unsigned long pr_session_hibernate(void) {
+  unsigned long released;
+
+  /* Give modules the chance to drop their own caches first. */
+  pr_event_generate("core.session-hibernate", NULL);
+
+  (void) pr_fs_clear_cache2(NULL);
+
+  /* Buffers and indexes which are rebuilt when next needed.  The buffers of
+   * any data transfer are already gone, with the transfer.  The control
+   * connection's read buffer is kept: the session is waiting on it.
+   */
+  (void) pr_response_free_pending();
+  pr_stash_free_indexes();
+
+  released = pr_pool_release_free_blocks();
+
+#if defined(HAVE_MALLOC_H) && defined(HAVE_MALLOC_TRIM)
+  /* Have the allocator return its free pages, not just those at the top of
+   * the heap, to the kernel.
+   */
+  (void) malloc_trim(0);
+#endif /* HAVE_MALLOC_H and HAVE_MALLOC_TRIM */
+
+  pr_trace_msg("timer", 9, "session hibernating, released %lu bytes of "
+    "pool memory", released);
+  return released;
+}
+
 int pr_session_set_protocol(const char *sess_proto) {
   int count, res = 0, xerrno = 0;
 
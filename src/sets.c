@@ -27,6 +27,8 @@
 
 #include "conf.h"
 
+static unsigned int xaset_generation = 0;
+
 /* Create a new set, cmpfunc is a pointer to the function used to to compare
  * members of the set ... it should return 1, 0, or -1 after the fashion of
  * strcmp.  Returns NULL if memory allocation fails.
@@ -51,7 +53,11 @@ xaset_t *xaset_create(pool *p, XASET_COMPARE cmpfunc) {
   new_set->xas_list = NULL;
   new_set->pool = p;
   new_set->xas_compare = cmpfunc;
+  new_set->xas_last = NULL;
+  new_set->xas_generation = 0;
+  new_set->xas_index = NULL;
 
+  xaset_generation++;
   return new_set;
 }
 
@@ -72,7 +78,11 @@ int xaset_insert(xaset_t *set, xasetmember_t *member) {
   if (set->xas_list)
     set->xas_list->prev = member;
 
+  else
+    set->xas_last = member;
+
   set->xas_list = member;
+  set->xas_generation++;
   return 0;
 }
 
@@ -87,7 +97,17 @@ int xaset_insert_end(xaset_t *set, xasetmember_t *member) {
     return -1;
   }
 
-  for (tmp = &set->xas_list; *tmp; prev = *tmp, tmp = &(*tmp)->next)
+  /* Start from the last known member, rather than the head of the list. */
+  if (set->xas_last != NULL &&
+      set->xas_list != NULL) {
+    prev = set->xas_last;
+    tmp = &prev->next;
+
+  } else {
+    tmp = &set->xas_list;
+  }
+
+  for (; *tmp; prev = *tmp, tmp = &(*tmp)->next)
     ;
 
   *tmp = member;
@@ -97,6 +117,8 @@ int xaset_insert_end(xaset_t *set, xasetmember_t *member) {
   if (prev)
     prev->next = member;
 
+  set->xas_last = member;
+  set->xas_generation++;
   return 0;
 }
 
@@ -131,10 +153,14 @@ int xaset_insert_sort(xaset_t *set, xasetmember_t *member, int dups_allowed) {
   if (*setp)
     (*setp)->prev = member;
 
+  else
+    set->xas_last = member;
+
   member->prev = mprev;
   member->next = *setp;
   *setp = member;
 
+  set->xas_generation++;
   return 0;
 }
 
@@ -171,7 +197,11 @@ int xaset_remove(xaset_t *set, xasetmember_t *member) {
   if (member->next)
     member->next->prev = member->prev;
 
+  if (set->xas_last == member)
+    set->xas_last = member->prev;
+
   member->next = member->prev = NULL;
+  set->xas_generation++;
   return 0;
 }
 
@@ -218,7 +248,13 @@ xaset_t *xaset_copy(pool *p, xaset_t *set, size_t msize, XASET_MCOPY copyfunc) {
     if (*pos)
       pos = &(*pos)->next;
     *pos = n;
+
+    new_set->xas_last = n;
   }
 
   return new_set;
 }
+
+unsigned int xaset_get_generation(void) {
+  return xaset_generation;
+}
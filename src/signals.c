@@ -503,6 +503,14 @@ void pr_signals_handle(void) {
       schedule(restart_daemon, 0, NULL, NULL, NULL, NULL);
     }
 
+#ifdef SIGWINCH
+    if (recvd_signal_flags & RECEIVED_SIG_UPGRADE) {
+      recvd_signal_flags &= ~RECEIVED_SIG_UPGRADE;
+      pr_trace_msg("signal", 9, "handling SIGWINCH (signal %d)", SIGWINCH);
+      schedule(upgrade_daemon, 0, NULL, NULL, NULL, NULL);
+    }
+#endif /* SIGWINCH */
+
     if (recvd_signal_flags & RECEIVED_SIG_EXIT) {
       recvd_signal_flags &= ~RECEIVED_SIG_EXIT;
       pr_trace_msg("signal", 9, "handling SIGUSR1 (signal %d)", SIGUSR1);
@@ -536,6 +544,22 @@ static RETSIGTYPE sig_restart(int signo) {
   }
 }
 
+#ifdef SIGWINCH
+/* sig_upgrade occurs in the master daemon when manually "kill -WINCH"
+ * in order to start a new daemon process (e.g. a new binary), handing off
+ * the listening sockets to it.
+ */
+static RETSIGTYPE sig_upgrade(int signo) {
+  recvd_signal_flags |= RECEIVED_SIG_UPGRADE;
+
+  if (signal(SIGWINCH, sig_upgrade) == SIG_ERR) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to install SIGWINCH (signal %d) handler: %s", SIGWINCH,
+      strerror(errno));
+  }
+}
+#endif /* SIGWINCH */
+
 /* pr_signals_handle_disconnect is called in children when the parent daemon
  * detects that shutmsg has been created and that client sessions should be
  * destroyed.  If a file transfer is underway, the process simply dies,
@@ -601,6 +625,9 @@ int init_signals(void) {
   sigaddset(&sig_set, SIGTERM);
   sigaddset(&sig_set, SIGHUP);
   sigaddset(&sig_set, SIGUSR2);
+#ifdef SIGWINCH
+  sigaddset(&sig_set, SIGWINCH);
+#endif /* SIGWINCH */
 #ifdef SIGSTKFLT
   sigaddset(&sig_set, SIGSTKFLT);
 #endif /* SIGSTKFLT */
@@ -708,6 +735,18 @@ int init_signals(void) {
       strerror(errno));
   }
 
+#ifdef SIGWINCH
+  /* When run in the foreground, the terminal sends SIGWINCH whenever its
+   * window is resized, so upgrades are only done for a detached daemon.
+   */
+  if (!nodaemon &&
+      signal(SIGWINCH, sig_upgrade) == SIG_ERR) {
+    pr_log_pri(PR_LOG_NOTICE,
+      "unable to install SIGWINCH (signal %d) handler: %s", SIGWINCH,
+      strerror(errno));
+  }
+#endif /* SIGWINCH */
+
   /* In case our parent left signals blocked (as happens under some
    * poor inetd implementations)
    */
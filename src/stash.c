@@ -64,6 +64,55 @@ static struct stash *auth_curr_sym = NULL;
 static xaset_t *hook_symbol_table[PR_TUNABLE_HASH_TABLE_SIZE];
 static struct stash *hook_curr_sym = NULL;
 
+/* Bumped whenever a symbol is added or removed. */
+static unsigned int stash_generation = 1;
+
+/* The symbols sharing one name, in lookup (i.e. module priority) order. */
+struct stash_name {
+  /* Next name with the same hash value, if any. */
+  struct stash_name *next;
+
+  const char *name;
+  size_t namelen;
+  unsigned int hash;
+
+  struct stash **syms;
+  unsigned int nsyms;
+};
+
+/* An immutable index over all of the symbols of a given type, built on the
+ * first lookup after the symbols change (e.g. once all modules have been
+ * initialized, or after mod_dso has loaded a module).  Each distinct hash
+ * value maps to its own slot via a minimal perfect hash function, using the
+ * "hash, displace, and compress" scheme: the hash selects a displacement,
+ * which in turn selects the slot.  A lookup thus takes a single probe, and a
+ * miss is usually detected without comparing any names.
+ */
+struct stash_index {
+  pool *pool;
+  unsigned int generation;
+
+  /* If TRUE, no perfect hash could be found, and lookups fall back to
+   * scanning the symbol table.
+   */
+  int failed;
+
+  unsigned int *disps;
+  unsigned int ndisps;
+
+  struct stash_name **slots;
+  unsigned int nslots;
+};
+
+#define STASH_INDEX_MAX_DISP		(1 << 20)
+
+static struct stash_index *conf_symbol_index = NULL;
+static struct stash_index *cmd_symbol_index = NULL;
+static struct stash_index *auth_symbol_index = NULL;
+static struct stash_index *hook_symbol_index = NULL;
+
+static const char *trace_channel = "stash";
+
 /* Symbol stash lookup code and management */
 
 static struct stash *sym_alloc(void) {
@@ -181,32 +230,378 @@ static unsigned int symtab_hash(const char *name, size_t namelen) {
 
 static unsigned int sym_type_hash(pr_stash_type_t sym_type, const char *name,
     size_t namelen) {
-  unsigned int hash;
+  register unsigned int i;
+  unsigned int hash = 0;
 
   /* XXX Ugly hack to support mixed cases of directives in config files. */
   if (sym_type != PR_SYM_CONF) {
-    hash = symtab_hash(name, namelen);
+    return symtab_hash(name, namelen);
+  }
+
+  if (name == NULL) {
+    return 0;
+  }
+
+  /* This must yield the same value as symtab_hash() would for the
+   * lowercased name.
+   */
+  for (i = 0; i < namelen; i++) {
+    char c;
+
+    c = tolower((int) name[i]);
+    hash = (hash * 33) + c;
+  }
+
+  return hash;
+}
+
+static xaset_t **stash_get_symbol_table(pr_stash_type_t sym_type) {
+  switch (sym_type) {
+    case PR_SYM_CONF:
+      return conf_symbol_table;
+
+    case PR_SYM_CMD:
+      return cmd_symbol_table;
+
+    case PR_SYM_AUTH:
+      return auth_symbol_table;
+
+    case PR_SYM_HOOK:
+      return hook_symbol_table;
+  }
+
+  return NULL;
+}
+
+static struct stash_index **stash_get_symbol_index(pr_stash_type_t sym_type) {
+  switch (sym_type) {
+    case PR_SYM_CONF:
+      return &conf_symbol_index;
+
+    case PR_SYM_CMD:
+      return &cmd_symbol_index;
+
+    case PR_SYM_AUTH:
+      return &auth_symbol_index;
+
+    case PR_SYM_HOOK:
+      return &hook_symbol_index;
+  }
+
+  return NULL;
+}
+
+/* Symbol index management */
+
+static unsigned int stash_index_mix(unsigned int h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+
+  return h;
+}
+
+static unsigned int stash_index_slot(struct stash_index *idx,
+    unsigned int hash, unsigned int disp) {
+  return stash_index_mix(hash + ((disp + 1) * 0x9e3779b9U)) % idx->nslots;
+}
+
+struct stash_index_bucket {
+  unsigned int disp_idx;
+  unsigned int nkeys;
+  struct stash_name **keys;
+};
+
+static int stash_index_bucket_cmp(const void *a, const void *b) {
+  const struct stash_index_bucket *b1 = a, *b2 = b;
+
+  /* Place the largest buckets first; they are the hardest to fit. */
+  if (b1->nkeys != b2->nkeys) {
+    return b1->nkeys > b2->nkeys ? -1 : 1;
+  }
+
+  return b1->disp_idx < b2->disp_idx ? -1 : 1;
+}
+
+/* Finds a perfect hash for the given distinct-hash names.  Returns -1 if no
+ * displacement could be found for some bucket, which can only happen for
+ * pathological inputs.
+ */
+static int stash_index_place(pool *tmp_pool, struct stash_index *idx,
+    struct stash_name **keys, unsigned int nkeys) {
+  register unsigned int i;
+  struct stash_index_bucket *buckets;
+  unsigned char *used;
+
+  idx->nslots = nkeys;
+  idx->slots = pcalloc(idx->pool, sizeof(struct stash_name *) * nkeys);
+  idx->ndisps = (nkeys / 2) + 1;
+  idx->disps = pcalloc(idx->pool, sizeof(unsigned int) * idx->ndisps);
+
+  buckets = pcalloc(tmp_pool,
+    sizeof(struct stash_index_bucket) * idx->ndisps);
+  for (i = 0; i < idx->ndisps; i++) {
+    buckets[i].disp_idx = i;
+  }
+
+  for (i = 0; i < nkeys; i++) {
+    buckets[stash_index_mix(keys[i]->hash) % idx->ndisps].nkeys++;
+  }
+
+  for (i = 0; i < idx->ndisps; i++) {
+    buckets[i].keys = pcalloc(tmp_pool,
+      sizeof(struct stash_name *) * (buckets[i].nkeys + 1));
+    buckets[i].nkeys = 0;
+  }
+
+  for (i = 0; i < nkeys; i++) {
+    struct stash_index_bucket *b;
+
+    b = &(buckets[stash_index_mix(keys[i]->hash) % idx->ndisps]);
+    b->keys[b->nkeys++] = keys[i];
+  }
+
+  qsort(buckets, idx->ndisps, sizeof(struct stash_index_bucket),
+    stash_index_bucket_cmp);
+
+  used = pcalloc(tmp_pool, nkeys);
+
+  for (i = 0; i < idx->ndisps && buckets[i].nkeys > 0; i++) {
+    register unsigned int j;
+    struct stash_index_bucket *b;
+    unsigned int disp;
+
+    b = &(buckets[i]);
+
+    for (disp = 0; disp < STASH_INDEX_MAX_DISP; disp++) {
+      for (j = 0; j < b->nkeys; j++) {
+        unsigned int slot;
+
+        slot = stash_index_slot(idx, b->keys[j]->hash, disp);
+        if (used[slot]) {
+          break;
+        }
+
+        used[slot] = TRUE;
+      }
+
+      if (j == b->nkeys) {
+        break;
+      }
+
+      /* Undo the partial placement, and try the next displacement. */
+      while (j-- > 0) {
+        used[stash_index_slot(idx, b->keys[j]->hash, disp)] = FALSE;
+      }
+    }
+
+    if (disp == STASH_INDEX_MAX_DISP) {
+      return -1;
+    }
+
+    idx->disps[b->disp_idx] = disp;
+    for (j = 0; j < b->nkeys; j++) {
+      idx->slots[stash_index_slot(idx, b->keys[j]->hash, disp)] = b->keys[j];
+    }
+  }
+
+  return 0;
+}
+
+static struct stash_index *stash_index_build(pr_stash_type_t sym_type) {
+  register unsigned int i;
+  xaset_t **symbol_table;
+  struct stash_index *idx;
+  struct stash_name *names, **keys;
+  unsigned int nsyms = 0, nnames = 0, nkeys = 0, *sym_names, j;
+  pool *idx_pool, *tmp_pool;
+
+  symbol_table = stash_get_symbol_table(sym_type);
+
+  idx_pool = make_sub_pool(symbol_pool);
+  pr_pool_tag(idx_pool, "Stash Index Pool");
+
+  idx = pcalloc(idx_pool, sizeof(struct stash_index));
+  idx->pool = idx_pool;
+  idx->generation = stash_generation;
+
+  for (i = 0; i < PR_TUNABLE_HASH_TABLE_SIZE; i++) {
+    struct stash *sym;
+
+    if (symbol_table[i] == NULL) {
+      continue;
+    }
+
+    for (sym = (struct stash *) symbol_table[i]->xas_list; sym;
+        sym = sym->next) {
+      nsyms++;
+    }
+  }
+
+  if (nsyms == 0) {
+    return idx;
+  }
+
+  tmp_pool = make_sub_pool(idx_pool);
+  names = pcalloc(idx_pool, sizeof(struct stash_name) * nsyms);
+  keys = pcalloc(tmp_pool, sizeof(struct stash_name *) * nsyms);
+  sym_names = pcalloc(tmp_pool, sizeof(unsigned int) * nsyms);
+
+  /* First, group the symbols by name, using the same notion of "same name"
+   * as the table scan does.  The symbols of a given hash value all live in
+   * the same bucket, so only the names of the current bucket need checking.
+   */
+  j = 0;
+  for (i = 0; i < PR_TUNABLE_HASH_TABLE_SIZE; i++) {
+    struct stash *sym;
+    unsigned int first_name;
+
+    if (symbol_table[i] == NULL) {
+      continue;
+    }
+
+    first_name = nnames;
+
+    for (sym = (struct stash *) symbol_table[i]->xas_list; sym;
+        sym = sym->next) {
+      register unsigned int k;
+      struct stash_name *same_hash = NULL;
+
+      for (k = first_name; k < nnames; k++) {
+        if (names[k].hash != sym->sym_hash) {
+          continue;
+        }
+
+        if (names[k].namelen == sym->sym_namelen &&
+            strncasecmp(names[k].name, sym->sym_name,
+              sym->sym_namelen) == 0) {
+          break;
+        }
+
+        same_hash = &(names[k]);
+      }
+
+      if (k == nnames) {
+        names[k].name = sym->sym_name;
+        names[k].namelen = sym->sym_namelen;
+        names[k].hash = sym->sym_hash;
+        nnames++;
+
+        if (same_hash != NULL) {
+          same_hash->next = &(names[k]);
+
+        } else {
+          keys[nkeys++] = &(names[k]);
+        }
+      }
+
+      names[k].nsyms++;
+      sym_names[j++] = k;
+    }
+  }
+
+  /* Next, give each name its contiguous array of symbols. */
+  for (i = 0; i < nnames; i++) {
+    names[i].syms = pcalloc(idx_pool,
+      sizeof(struct stash *) * names[i].nsyms);
+    names[i].nsyms = 0;
+  }
+
+  j = 0;
+  for (i = 0; i < PR_TUNABLE_HASH_TABLE_SIZE; i++) {
+    struct stash *sym;
+
+    if (symbol_table[i] == NULL) {
+      continue;
+    }
+
+    for (sym = (struct stash *) symbol_table[i]->xas_list; sym;
+        sym = sym->next) {
+      struct stash_name *name;
+
+      name = &(names[sym_names[j++]]);
+      name->syms[name->nsyms++] = sym;
+    }
+  }
+
+  if (stash_index_place(tmp_pool, idx, keys, nkeys) < 0) {
+    pr_trace_msg(trace_channel, 3,
+      "unable to build perfect hash for %u symbols, scanning instead", nsyms);
+    idx->failed = TRUE;
 
   } else {
-    register unsigned int i;
-    char *buf;
+    pr_trace_msg(trace_channel, 17,
+      "built index of %u symbols (%u names, %u slots, %u displacements)",
+      nsyms, nnames, idx->nslots, idx->ndisps);
+  }
+
+  destroy_pool(tmp_pool);
+  return idx;
+}
+
+/* Returns the current index for the given symbol type, rebuilding it if the
+ * symbols have changed since it was built.
+ */
+static struct stash_index *stash_index_get(pr_stash_type_t sym_type) {
+  struct stash_index **idxp;
 
-    buf = malloc(namelen+1);
-    if (buf == NULL) {
-      pr_log_pri(PR_LOG_ALERT, "Out of memory!");
-      exit(1);
+  idxp = stash_get_symbol_index(sym_type);
+  if (*idxp != NULL) {
+    if ((*idxp)->generation == stash_generation) {
+      return (*idxp)->failed ? NULL : *idxp;
     }
 
-    buf[namelen] = '\0';
-    for (i = 0; i < namelen; i++) {
-      buf[i] = tolower((int) name[i]);
+    destroy_pool((*idxp)->pool);
+  }
+
+  *idxp = stash_index_build(sym_type);
+  return (*idxp)->failed ? NULL : *idxp;
+}
+
+static struct stash *stash_index_lookup(struct stash_index *idx,
+    const char *name, size_t namelen, unsigned int hash, void *prev) {
+  register unsigned int i;
+  struct stash_name *sn;
+
+  if (idx->nslots == 0 ||
+      name == NULL) {
+    return NULL;
+  }
+
+  sn = idx->slots[stash_index_slot(idx, hash,
+    idx->disps[stash_index_mix(hash) % idx->ndisps])];
+
+  /* Every slot is occupied, so a lookup for an unknown name lands on some
+   * other name; the hash comparison catches that.
+   */
+  if (sn->hash != hash) {
+    return NULL;
+  }
+
+  for (; sn != NULL; sn = sn->next) {
+    if (sn->namelen == namelen &&
+        strncasecmp(sn->name, name, namelen) == 0) {
+      break;
     }
+  }
 
-    hash = symtab_hash(buf, namelen);
-    free(buf);
+  if (sn == NULL) {
+    return NULL;
   }
 
-  return hash;
+  if (prev == NULL) {
+    return sn->syms[0];
+  }
+
+  for (i = 0; i < sn->nsyms; i++) {
+    if (sn->syms[i]->ptr.sym_generic == prev) {
+      return i + 1 < sn->nsyms ? sn->syms[i+1] : NULL;
+    }
+  }
+
+  return NULL;
 }
 
 int pr_stash_add_symbol(pr_stash_type_t sym_type, void *data) {
@@ -289,6 +684,7 @@ int pr_stash_add_symbol(pr_stash_type_t sym_type, void *data) {
   }
 
   xaset_insert_sort(symbol_table[idx], (xasetmember_t *) sym, TRUE);
+  stash_generation++;
   return 0;
 }
 
@@ -482,6 +878,7 @@ void *pr_stash_get_symbol2(pr_stash_type_t sym_type, const char *name,
   int idx;
   unsigned int hash = 0;
   struct stash *sym = NULL;
+  struct stash_index *index;
   size_t namelen = 0;
 
   if (sym_type != PR_SYM_CONF &&
@@ -538,7 +935,18 @@ void *pr_stash_get_symbol2(pr_stash_type_t sym_type, const char *name,
     return NULL;
   }
 
-  if (prev) {
+  /* The index finds symbols by name; listing all of the symbols, using a
+   * NULL name, walks the hash buckets instead.
+   */
+  index = NULL;
+  if (name != NULL) {
+    index = stash_index_get(sym_type);
+  }
+
+  if (index != NULL) {
+    sym = stash_index_lookup(index, name, namelen, hash, prev);
+
+  } else if (prev) {
     sym = stash_lookup_next(sym_type, name, namelen, idx, hash, prev);
 
   } else {
@@ -629,6 +1037,7 @@ int pr_stash_remove_conf(const char *directive_name, module *m) {
       conf_curr_sym = NULL;
       tab = NULL;
       count++;
+      stash_generation++;
     }
 
     tab = pr_stash_get_symbol2(PR_SYM_CONF, directive_name, tab, &prev_idx,
@@ -689,6 +1098,7 @@ int pr_stash_remove_cmd(const char *cmd_name, module *m,
       cmd_curr_sym = NULL;
       tab = NULL;
       count++;
+      stash_generation++;
     }
 
     tab = pr_stash_get_symbol2(PR_SYM_CMD, cmd_name, tab, &prev_idx, &hash);
@@ -733,6 +1143,7 @@ int pr_stash_remove_auth(const char *api_name, module *m) {
       auth_curr_sym = NULL;
       tab = NULL;
       count++;
+      stash_generation++;
     }
 
     tab = pr_stash_get_symbol2(PR_SYM_AUTH, api_name, tab, &prev_idx, &hash);
@@ -777,6 +1188,7 @@ int pr_stash_remove_hook(const char *hook_name, module *m) {
       hook_curr_sym = NULL;
       tab = NULL;
       count++;
+      stash_generation++;
     }
 
     tab = pr_stash_get_symbol2(PR_SYM_HOOK, hook_name, tab, &prev_idx, &hash);
@@ -891,6 +1303,27 @@ void pr_stash_dump(void (*dumpf)(const char *, ...)) {
 #endif /* PR_USE_DEVEL */
 }
 
+unsigned int pr_stash_get_generation(void) {
+  return stash_generation;
+}
+
+void pr_stash_free_indexes(void) {
+  register unsigned int i;
+  pr_stash_type_t sym_types[] = {
+    PR_SYM_CONF, PR_SYM_CMD, PR_SYM_AUTH, PR_SYM_HOOK
+  };
+
+  for (i = 0; i < sizeof(sym_types) / sizeof(sym_types[0]); i++) {
+    struct stash_index **idxp;
+
+    idxp = stash_get_symbol_index(sym_types[i]);
+    if (*idxp != NULL) {
+      destroy_pool((*idxp)->pool);
+      *idxp = NULL;
+    }
+  }
+}
+
 int init_stash(void) {
   if (symbol_pool != NULL) {
     destroy_pool(symbol_pool);
@@ -904,5 +1337,10 @@ int init_stash(void) {
   memset(auth_symbol_table, '\0', sizeof(auth_symbol_table));
   memset(hook_symbol_table, '\0', sizeof(hook_symbol_table));
 
+  /* The indexes were allocated from the old symbol pool. */
+  conf_symbol_index = cmd_symbol_index = NULL;
+  auth_symbol_index = hook_symbol_index = NULL;
+  stash_generation++;
+
   return 0;
 }
@@ -34,6 +34,55 @@
 #define PR_TABLE_DEFAULT_MAX_ENTS	8192
 #define PR_TABLE_ENT_POOL_SIZE		64
 
+/* Open-addressing tables: slots are scanned in groups of this many control
+ * bytes at a time, and keys up to TAB_OA_KEY_INLINE_SIZE bytes are copied
+ * into the slot itself.
+ */
+#define TAB_OA_GROUP_SIZE		8
+#define TAB_OA_KEY_INLINE_SIZE		16
+
+#define TAB_OA_CTRL_EMPTY		0x80
+#define TAB_OA_CTRL_DELETED		0xFE
+#define TAB_OA_CTRL_IS_FULL(c)		(((c) & 0x80) == 0)
+
+#define TAB_OA_LSBS			((uint64_t) 0x0101010101010101ULL)
+#define TAB_OA_MSBS			((uint64_t) 0x8080808080808080ULL)
+
+/* Additional values stored under a key in an open-addressing table; the
+ * first value lives in the slot.
+ */
+struct tab_value {
+  struct tab_value *next;
+  const void *value_data;
+  size_t value_datasz;
+
+  /* Link for the table's free list.  This is kept separate from the next
+   * pointer so that a pr_table_do() callback which removes values does not
+   * break the iteration of the remaining values.
+   */
+  struct tab_value *free_next;
+};
+
+struct tab_slot {
+  const void *key_data;
+  size_t key_datasz;
+  const void *value_data;
+  size_t value_datasz;
+
+  /* Any further values for this key, in insertion order.  Only used if the
+   * PR_TABLE_FL_MULTI_VALUE flag is set.
+   */
+  struct tab_value *values;
+
+  unsigned int hash;
+  unsigned int nents;
+
+  /* Copy of the key data, if small enough, so that key comparisons with the
+   * default comparator need not chase the caller's pointer.
+   */
+  unsigned char key_inline[TAB_OA_KEY_INLINE_SIZE];
+};
+
 struct table_rec {
   pool *pool;
   unsigned long flags;
@@ -85,6 +134,36 @@ struct table_rec {
    */
   pr_table_entry_t *cache_ent;
 
+  /* Storage for open-addressing tables (PR_TABLE_FL_OPEN_ADDR), used instead
+   * of the chains.  There is one control byte per slot: TAB_OA_CTRL_EMPTY,
+   * TAB_OA_CTRL_DELETED, or the top 7 bits of the key's mixed hash for an
+   * occupied slot.  The slots are allocated on the first insertion; nslots
+   * is always a power of two, and at least TAB_OA_GROUP_SIZE.
+   */
+  unsigned char *ctrl;
+  struct tab_slot *slots;
+  unsigned int nslots;
+  unsigned int nused;
+  unsigned int ndeleted;
+
+  /* A previous slot array of the current size, reused when rehashing the
+   * table in place to clear out deleted slots.
+   */
+  unsigned char *spare_ctrl;
+  struct tab_slot *spare_slots;
+  unsigned int spare_nslots;
+
+  struct tab_value *free_vals;
+
+  /* The open-addressing equivalents of tab_iter_ent, val_iter_ent, and
+   * cache_ent.  A NULL value record denotes the value stored in the slot.
+   */
+  unsigned int slot_iter_idx;
+  struct tab_slot *val_iter_slot;
+  struct tab_value *val_iter_val;
+  struct tab_slot *cache_slot;
+  struct tab_value *cache_val;
+
   /* Table callbacks. */
   int (*keycmp)(const void *, size_t, const void *, size_t);
   unsigned int (*keyhash)(const void *, size_t);
@@ -388,6 +467,627 @@ static unsigned int tab_get_seed(void) {
   return seed;
 }
 
+/* Open-addressing table management
+ *
+ * Open-addressing tables keep every key in a single flat array of slots,
+ * rather than in chains of individually allocated entries and keys.  A
+ * parallel array of control bytes is probed a group of TAB_OA_GROUP_SIZE
+ * slots at a time: the bytes of a group are loaded into a single word, and
+ * compared against the wanted hash bits all at once, so that only slots whose
+ * control byte matches need be looked at.
+ */
+
+static unsigned int tab_oa_hash_mix(unsigned int h) {
+  /* The default key hash function leaves its low bits poorly distributed,
+   * and we use those to pick the group to probe; scramble them.
+   */
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+
+  return h;
+}
+
+static uint64_t tab_oa_group_load(const unsigned char *ctrl) {
+  register unsigned int i;
+  uint64_t group = 0;
+
+  /* Byte i of the group always lands in bits 8i..8i+7, regardless of the
+   * host byte order; most compilers turn this into a single load.
+   */
+  for (i = 0; i < TAB_OA_GROUP_SIZE; i++) {
+    group |= ((uint64_t) ctrl[i]) << (i * 8);
+  }
+
+  return group;
+}
+
+/* Returns a mask with the high bit set of each byte in the group equal to
+ * the given hash bits.  This may produce false positives (which the caller
+ * weeds out by comparing hashes and keys), but never for empty or deleted
+ * slots, and never false negatives.
+ */
+static uint64_t tab_oa_group_match(uint64_t group, unsigned char h2) {
+  uint64_t x;
+
+  x = group ^ (TAB_OA_LSBS * h2);
+  return (x - TAB_OA_LSBS) & ~x & TAB_OA_MSBS;
+}
+
+static uint64_t tab_oa_group_match_empty(uint64_t group) {
+  /* Only TAB_OA_CTRL_EMPTY has its high bit set and the next bit clear. */
+  return group & ~(group << 1) & TAB_OA_MSBS;
+}
+
+static uint64_t tab_oa_group_match_free(uint64_t group) {
+  return group & TAB_OA_MSBS;
+}
+
+static unsigned int tab_oa_group_first(uint64_t mask) {
+#if defined(__GNUC__)
+  return ((unsigned int) __builtin_ctzll(mask)) / 8;
+#else
+  register unsigned int i;
+
+  for (i = 0; (mask & 0x80) == 0; i++) {
+    mask >>= 8;
+  }
+
+  return i;
+#endif
+}
+
+static int tab_oa_key_cmp(pr_table_t *tab, struct tab_slot *s,
+    const void *key_data, size_t key_datasz) {
+
+  if (tab->keycmp == key_cmp &&
+      s->key_datasz > 0 &&
+      s->key_datasz <= TAB_OA_KEY_INLINE_SIZE) {
+    return key_cmp(s->key_inline, s->key_datasz, key_data, key_datasz);
+  }
+
+  return tab->keycmp(s->key_data, s->key_datasz, key_data, key_datasz);
+}
+
+static struct tab_slot *tab_oa_find(pr_table_t *tab, const void *key_data,
+    size_t key_datasz, unsigned int h) {
+  unsigned int mix, group_mask, gidx, step = 0;
+  unsigned char h2;
+
+  if (tab->nslots == 0) {
+    return NULL;
+  }
+
+  mix = tab_oa_hash_mix(h);
+  h2 = (unsigned char) (mix >> 25);
+  group_mask = (tab->nslots / TAB_OA_GROUP_SIZE) - 1;
+  gidx = mix & group_mask;
+
+  while (TRUE) {
+    const unsigned char *ctrl;
+    uint64_t group, mask;
+
+    ctrl = tab->ctrl + (gidx * TAB_OA_GROUP_SIZE);
+    group = tab_oa_group_load(ctrl);
+
+    for (mask = tab_oa_group_match(group, h2); mask; mask &= (mask - 1)) {
+      struct tab_slot *s;
+
+      s = &(tab->slots[(gidx * TAB_OA_GROUP_SIZE) + tab_oa_group_first(mask)]);
+      if (s->hash == h &&
+          tab_oa_key_cmp(tab, s, key_data, key_datasz) == 0) {
+        return s;
+      }
+    }
+
+    /* Keys are only ever placed past a group which was full at the time,
+     * so an empty slot here ends the search.
+     */
+    if (tab_oa_group_match_empty(group)) {
+      return NULL;
+    }
+
+    /* Triangular probing visits every group, given a power-of-two number of
+     * groups.
+     */
+    step++;
+    gidx = (gidx + step) & group_mask;
+  }
+}
+
+/* Claims a free slot for a new key with the given hash; the caller must have
+ * ensured that there is room.
+ */
+static struct tab_slot *tab_oa_claim(pr_table_t *tab, unsigned int h) {
+  unsigned int mix, group_mask, gidx, step = 0;
+
+  mix = tab_oa_hash_mix(h);
+  group_mask = (tab->nslots / TAB_OA_GROUP_SIZE) - 1;
+  gidx = mix & group_mask;
+
+  while (TRUE) {
+    uint64_t mask;
+
+    mask = tab_oa_group_match_free(tab_oa_group_load(tab->ctrl +
+      (gidx * TAB_OA_GROUP_SIZE)));
+    if (mask) {
+      unsigned int idx;
+
+      idx = (gidx * TAB_OA_GROUP_SIZE) + tab_oa_group_first(mask);
+      if (tab->ctrl[idx] == TAB_OA_CTRL_DELETED) {
+        tab->ndeleted--;
+      }
+
+      tab->ctrl[idx] = (unsigned char) (mix >> 25);
+      tab->nused++;
+      return &(tab->slots[idx]);
+    }
+
+    step++;
+    gidx = (gidx + step) & group_mask;
+  }
+}
+
+static void tab_oa_resize(pr_table_t *tab, unsigned int nslots) {
+  register unsigned int i;
+  unsigned char *old_ctrl;
+  struct tab_slot *old_slots;
+  unsigned int old_nslots;
+
+  old_ctrl = tab->ctrl;
+  old_slots = tab->slots;
+  old_nslots = tab->nslots;
+
+  if (tab->spare_nslots == nslots) {
+    tab->ctrl = tab->spare_ctrl;
+    tab->slots = tab->spare_slots;
+
+  } else {
+    tab->ctrl = palloc(tab->pool, nslots);
+    tab->slots = palloc(tab->pool, sizeof(struct tab_slot) * nslots);
+  }
+
+  memset(tab->ctrl, TAB_OA_CTRL_EMPTY, nslots);
+  tab->nslots = nslots;
+  tab->nused = tab->ndeleted = 0;
+
+  for (i = 0; i < old_nslots; i++) {
+    struct tab_slot *s, *old_s;
+
+    if (!TAB_OA_CTRL_IS_FULL(old_ctrl[i])) {
+      continue;
+    }
+
+    old_s = &(old_slots[i]);
+    s = tab_oa_claim(tab, old_s->hash);
+    memcpy(s, old_s, sizeof(struct tab_slot));
+
+    /* Keep any in-progress lookups pointing at the moved slot. */
+    if (tab->val_iter_slot == old_s) {
+      tab->val_iter_slot = s;
+    }
+
+    if (tab->cache_slot == old_s) {
+      tab->cache_slot = s;
+    }
+  }
+
+  /* Note: previous slot arrays of other sizes are left to the table's pool,
+   * much as with PR_TABLE_CTL_SET_NCHAINS.
+   */
+  tab->spare_ctrl = old_ctrl;
+  tab->spare_slots = old_slots;
+  tab->spare_nslots = old_nslots;
+}
+
+/* Makes sure there is room for one more key, keeping at least 1/8 of the
+ * slots empty so that unsuccessful lookups terminate quickly.
+ */
+static void tab_oa_reserve(pr_table_t *tab) {
+  unsigned int nslots;
+
+  if (tab->nslots == 0) {
+    /* Allocate the slots on first use, treating the requested number of
+     * chains as a hint for the expected number of keys.
+     */
+    nslots = TAB_OA_GROUP_SIZE;
+    while (nslots < tab->nchains) {
+      nslots *= 2;
+    }
+
+    tab->ctrl = palloc(tab->pool, nslots);
+    memset(tab->ctrl, TAB_OA_CTRL_EMPTY, nslots);
+    tab->slots = palloc(tab->pool, sizeof(struct tab_slot) * nslots);
+    tab->nslots = nslots;
+    return;
+  }
+
+  if ((tab->nused + tab->ndeleted + 1) * 8 <= tab->nslots * 7) {
+    return;
+  }
+
+  /* If deleted slots account for much of the load, rehashing at the current
+   * size is enough.
+   */
+  nslots = tab->nslots;
+  if ((tab->nused + 1) * 16 > tab->nslots * 7) {
+    nslots *= 2;
+  }
+
+  tab_oa_resize(tab, nslots);
+}
+
+static struct tab_value *tab_oa_value_alloc(pr_table_t *tab) {
+  struct tab_value *v;
+
+  if (tab->free_vals != NULL) {
+    v = tab->free_vals;
+    tab->free_vals = v->free_next;
+
+  } else {
+    v = palloc(tab->pool, sizeof(struct tab_value));
+  }
+
+  memset(v, 0, sizeof(struct tab_value));
+  return v;
+}
+
+static void tab_oa_value_free(pr_table_t *tab, struct tab_value *v) {
+  v->free_next = tab->free_vals;
+  tab->free_vals = v;
+}
+
+/* Removes the given value (NULL being the value in the slot itself) from the
+ * given slot, freeing the slot if it was the key's last value.
+ */
+static void tab_oa_remove(pr_table_t *tab, struct tab_slot *s,
+    struct tab_value *v) {
+
+  if (v == NULL) {
+    v = s->values;
+
+    if (v != NULL) {
+      /* Promote the next value into the slot. */
+      s->value_data = v->value_data;
+      s->value_datasz = v->value_datasz;
+      s->values = v->next;
+      tab_oa_value_free(tab, v);
+    }
+
+  } else {
+    struct tab_value **vp;
+
+    for (vp = &(s->values); *vp != v; vp = &((*vp)->next));
+    *vp = v->next;
+    tab_oa_value_free(tab, v);
+  }
+
+  if (tab->val_iter_slot == s) {
+    tab->val_iter_slot = NULL;
+    tab->val_iter_val = NULL;
+  }
+
+  if (tab->cache_slot == s) {
+    tab->cache_slot = NULL;
+    tab->cache_val = NULL;
+  }
+
+  s->nents--;
+  tab->nents--;
+
+  if (s->nents == 0) {
+    unsigned int idx, gidx;
+
+    idx = (unsigned int) (s - tab->slots);
+    gidx = idx - (idx % TAB_OA_GROUP_SIZE);
+
+    /* A group with an empty slot has never been full, so no probe sequence
+     * continues past it; such a slot can simply become empty again.
+     */
+    if (tab_oa_group_match_empty(tab_oa_group_load(tab->ctrl + gidx))) {
+      tab->ctrl[idx] = TAB_OA_CTRL_EMPTY;
+
+    } else {
+      tab->ctrl[idx] = TAB_OA_CTRL_DELETED;
+      tab->ndeleted++;
+    }
+
+    tab->nused--;
+  }
+}
+
+static int tab_oa_add(pr_table_t *tab, const void *key_data,
+    size_t key_datasz, const void *value_data, size_t value_datasz) {
+  unsigned int h;
+  struct tab_slot *s;
+
+  /* Don't forget to add in the random seed data. */
+  h = tab->keyhash(key_data, key_datasz) + tab->seed;
+
+  s = tab_oa_find(tab, key_data, key_datasz, h);
+  if (s != NULL) {
+    struct tab_value *v, **vp;
+
+    /* Check if this table allows multivalues. */
+    if (!(tab->flags & PR_TABLE_FL_MULTI_VALUE)) {
+      errno = EEXIST;
+      return -1;
+    }
+
+    v = tab_oa_value_alloc(tab);
+    v->value_data = value_data;
+    v->value_datasz = value_datasz;
+
+    for (vp = &(s->values); *vp != NULL; vp = &((*vp)->next));
+    *vp = v;
+
+    s->nents++;
+    tab->nents++;
+    return 0;
+  }
+
+  tab_oa_reserve(tab);
+
+  s = tab_oa_claim(tab, h);
+  s->key_data = key_data;
+  s->key_datasz = key_datasz;
+  s->value_data = value_data;
+  s->value_datasz = value_datasz;
+  s->values = NULL;
+  s->hash = h;
+  s->nents = 1;
+
+  if (key_datasz > 0 &&
+      key_datasz <= TAB_OA_KEY_INLINE_SIZE) {
+    memcpy(s->key_inline, key_data, key_datasz);
+  }
+
+  tab->nents++;
+  return 0;
+}
+
+/* Finds the next value to be returned for the given key, continuing where a
+ * previous lookup of the same key pointer left off, if any.  Returns -1 if
+ * there is no such value.
+ */
+static int tab_oa_lookup(pr_table_t *tab, const void *key_data,
+    size_t key_datasz, struct tab_slot **slot, struct tab_value **val) {
+  struct tab_slot *s;
+  struct tab_value *v = NULL;
+
+  if (tab->val_iter_slot != NULL &&
+      tab->val_iter_slot->key_data == key_data) {
+    s = tab->val_iter_slot;
+    v = tab->val_iter_val != NULL ? tab->val_iter_val->next : s->values;
+    if (v == NULL) {
+      s = NULL;
+    }
+
+  } else if ((tab->flags & PR_TABLE_FL_USE_CACHE) &&
+             tab->cache_slot != NULL &&
+             tab->cache_slot->key_data == key_data) {
+    s = tab->cache_slot;
+    v = tab->cache_val != NULL ? tab->cache_val->next : s->values;
+    if (v == NULL) {
+      s = NULL;
+    }
+
+  } else {
+    unsigned int h;
+
+    /* Don't forget to add in the random seed data. */
+    h = tab->keyhash(key_data, key_datasz) + tab->seed;
+    s = tab_oa_find(tab, key_data, key_datasz, h);
+  }
+
+  if (s == NULL) {
+    tab->cache_slot = tab->val_iter_slot = NULL;
+    tab->cache_val = tab->val_iter_val = NULL;
+    return -1;
+  }
+
+  if (tab->flags & PR_TABLE_FL_USE_CACHE) {
+    tab->cache_slot = s;
+    tab->cache_val = v;
+  }
+
+  if (tab->flags & PR_TABLE_FL_MULTI_VALUE) {
+    tab->val_iter_slot = s;
+    tab->val_iter_val = v;
+  }
+
+  *slot = s;
+  *val = v;
+  return 0;
+}
+
+static int tab_oa_exists(pr_table_t *tab, const void *key_data,
+    size_t key_datasz) {
+  unsigned int h;
+  struct tab_slot *s;
+
+  if ((tab->flags & PR_TABLE_FL_USE_CACHE) &&
+      tab->cache_slot != NULL &&
+      tab->cache_slot->key_data == key_data) {
+    return tab->cache_slot->nents;
+  }
+
+  /* Don't forget to add in the random seed data. */
+  h = tab->keyhash(key_data, key_datasz) + tab->seed;
+
+  s = tab_oa_find(tab, key_data, key_datasz, h);
+  if (s == NULL) {
+    tab->cache_slot = NULL;
+    tab->cache_val = NULL;
+
+    errno = ENOENT;
+    return 0;
+  }
+
+  if (tab->flags & PR_TABLE_FL_USE_CACHE) {
+    tab->cache_slot = s;
+    tab->cache_val = NULL;
+  }
+
+  return s->nents;
+}
+
+static const void *tab_oa_kremove(pr_table_t *tab, const void *key_data,
+    size_t key_datasz, size_t *value_datasz) {
+  struct tab_slot *s;
+  struct tab_value *v = NULL;
+  const void *value_data;
+
+  if ((tab->flags & PR_TABLE_FL_USE_CACHE) &&
+      tab->cache_slot != NULL &&
+      tab->cache_slot->key_data == key_data) {
+    s = tab->cache_slot;
+    v = tab->cache_val;
+
+  } else {
+    unsigned int h;
+
+    /* Don't forget to add in the random seed data. */
+    h = tab->keyhash(key_data, key_datasz) + tab->seed;
+
+    s = tab_oa_find(tab, key_data, key_datasz, h);
+    if (s == NULL) {
+      tab->cache_slot = NULL;
+      tab->cache_val = NULL;
+
+      errno = ENOENT;
+      return NULL;
+    }
+  }
+
+  value_data = v != NULL ? v->value_data : s->value_data;
+  if (value_datasz) {
+    *value_datasz = v != NULL ? v->value_datasz : s->value_datasz;
+  }
+
+  tab_oa_remove(tab, s, v);
+  tab->cache_slot = NULL;
+  tab->cache_val = NULL;
+
+  return value_data;
+}
+
+static const void *tab_oa_knext(pr_table_t *tab, size_t *key_datasz) {
+  register unsigned int i;
+
+  for (i = tab->slot_iter_idx; i < tab->nslots; i++) {
+    if (TAB_OA_CTRL_IS_FULL(tab->ctrl[i])) {
+      struct tab_slot *s;
+
+      s = &(tab->slots[i]);
+      tab->slot_iter_idx = i + 1;
+
+      if (key_datasz != NULL) {
+        *key_datasz = s->key_datasz;
+      }
+
+      return s->key_data;
+    }
+  }
+
+  tab->slot_iter_idx = tab->nslots;
+
+  errno = EPERM;
+  return NULL;
+}
+
+static int tab_oa_do(pr_table_t *tab, int (*cb)(const void *key_data,
+    size_t key_datasz, const void *value_data, size_t value_datasz,
+    void *user_data), void *user_data, int flags) {
+  register unsigned int i;
+
+  for (i = 0; i < tab->nslots; i++) {
+    struct tab_slot *s;
+    struct tab_value *v, *next_v;
+    int res;
+
+    if (!TAB_OA_CTRL_IS_FULL(tab->ctrl[i])) {
+      continue;
+    }
+
+    s = &(tab->slots[i]);
+    next_v = s->values;
+
+    if (!handling_signal) {
+      pr_signals_handle();
+    }
+
+    res = cb(s->key_data, s->key_datasz, s->value_data, s->value_datasz,
+      user_data);
+    if (res < 0 &&
+        !(flags & PR_TABLE_DO_FL_ALL)) {
+      errno = EPERM;
+      return -1;
+    }
+
+    /* If the callback removed the value in the slot, the next value will
+     * have been promoted into the slot; its (freed) record remains intact,
+     * so iterating from it still visits every value exactly once.
+     */
+    for (v = next_v; v != NULL && TAB_OA_CTRL_IS_FULL(tab->ctrl[i]);
+        v = next_v) {
+      next_v = v->next;
+
+      if (!handling_signal) {
+        pr_signals_handle();
+      }
+
+      res = cb(s->key_data, s->key_datasz, v->value_data, v->value_datasz,
+        user_data);
+      if (res < 0 &&
+          !(flags & PR_TABLE_DO_FL_ALL)) {
+        errno = EPERM;
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+static void tab_oa_empty(pr_table_t *tab) {
+  register unsigned int i;
+
+  for (i = 0; i < tab->nslots; i++) {
+    struct tab_value *v, *next_v;
+
+    if (!TAB_OA_CTRL_IS_FULL(tab->ctrl[i])) {
+      continue;
+    }
+
+    for (v = tab->slots[i].values; v != NULL; v = next_v) {
+      next_v = v->next;
+      tab_oa_value_free(tab, v);
+    }
+  }
+
+  if (tab->nslots > 0) {
+    memset(tab->ctrl, TAB_OA_CTRL_EMPTY, tab->nslots);
+  }
+
+  tab->nents = tab->nused = tab->ndeleted = 0;
+  tab->slot_iter_idx = 0;
+  tab->cache_slot = tab->val_iter_slot = NULL;
+  tab->cache_val = tab->val_iter_val = NULL;
+}
+
+static void tab_oa_reset(pr_table_t *tab) {
+  tab->ctrl = tab->spare_ctrl = NULL;
+  tab->slots = tab->spare_slots = NULL;
+  tab->nslots = tab->spare_nslots = 0;
+  tab->nused = tab->ndeleted = 0;
+  tab->slot_iter_idx = 0;
+  tab->cache_slot = tab->val_iter_slot = NULL;
+  tab->cache_val = tab->val_iter_val = NULL;
+}
+
 /* Public Table API
  */
 
@@ -409,6 +1109,10 @@ int pr_table_kadd(pr_table_t *tab, const void *key_data, size_t key_datasz,
     return -1;
   }
 
+  if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+    return tab_oa_add(tab, key_data, key_datasz, value_data, value_datasz);
+  }
+
   /* Don't forget to add in the random seed data. */
   h = tab->keyhash(key_data, key_datasz) + tab->seed;
 
@@ -494,6 +1198,10 @@ int pr_table_kexists(pr_table_t *tab, const void *key_data, size_t key_datasz) {
     return -1;
   }
 
+  if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+    return tab_oa_exists(tab, key_data, key_datasz);
+  }
+
   if (tab->flags & PR_TABLE_FL_USE_CACHE) {
     /* Has the caller already wanted to lookup this same key previously?
      * If so, reuse that lookup if we can.  In this case, "same key" means
@@ -549,20 +1257,31 @@ const void *pr_table_kget(pr_table_t *tab, const void *key_data,
   }
 
   /* Use a NULL key as a way of rewinding the per-key lookup. */
-  if (key_data == NULL) {
+  if (key_data == NULL ||
+      tab->nents == 0) {
     tab->cache_ent = NULL;
     tab->val_iter_ent = NULL;
+    tab->cache_slot = tab->val_iter_slot = NULL;
+    tab->cache_val = tab->val_iter_val = NULL;
 
     errno = ENOENT;
     return NULL;
   }
 
-  if (tab->nents == 0) {
-    tab->cache_ent = NULL;
-    tab->val_iter_ent = NULL;
+  if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+    struct tab_slot *s;
+    struct tab_value *v;
 
-    errno = ENOENT;
-    return NULL;
+    if (tab_oa_lookup(tab, key_data, key_datasz, &s, &v) < 0) {
+      errno = ENOENT;
+      return NULL;
+    }
+
+    if (value_datasz) {
+      *value_datasz = v != NULL ? v->value_datasz : s->value_datasz;
+    }
+
+    return v != NULL ? v->value_data : s->value_data;
   }
 
   /* Don't forget to add in the random seed data. */
@@ -645,6 +1364,10 @@ const void *pr_table_kremove(pr_table_t *tab, const void *key_data,
     return NULL;
   }
 
+  if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+    return tab_oa_kremove(tab, key_data, key_datasz, value_datasz);
+  }
+
   /* Has the caller already wanted to lookup this same key previously?
    * If so, reuse that lookup if we can.  In this case, "same key" means
    * the _exact same pointer_, not identical data.
@@ -727,6 +1450,37 @@ int pr_table_kset(pr_table_t *tab, const void *key_data, size_t key_datasz,
     return -1;
   }
 
+  if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+    struct tab_slot *s;
+    struct tab_value *v;
+
+    if (tab_oa_lookup(tab, key_data, key_datasz, &s, &v) < 0) {
+      errno = ENOENT;
+      return -1;
+    }
+
+    if (v != NULL) {
+      if (v->value_data == value_data) {
+        errno = EEXIST;
+        return -1;
+      }
+
+      v->value_data = value_data;
+      v->value_datasz = value_datasz;
+
+    } else {
+      if (s->value_data == value_data) {
+        errno = EEXIST;
+        return -1;
+      }
+
+      s->value_data = value_data;
+      s->value_datasz = value_datasz;
+    }
+
+    return 0;
+  }
+
   /* Don't forget to add in the random seed data. */
   h = tab->keyhash(key_data, key_datasz) + tab->seed;
 
@@ -857,8 +1611,12 @@ pr_table_t *pr_table_nalloc(pool *p, int flags, unsigned int nchains) {
   tab->pool = tab_pool;
   tab->flags = flags;
   tab->nchains = nchains;
-  tab->chains = pcalloc(tab_pool,
-    sizeof(pr_table_entry_t *) * tab->nchains);
+
+  /* Open-addressing tables allocate their slots on first use. */
+  if (!(flags & PR_TABLE_FL_OPEN_ADDR)) {
+    tab->chains = pcalloc(tab_pool,
+      sizeof(pr_table_entry_t *) * tab->nchains);
+  }
 
   tab->keycmp = key_cmp;
   tab->keyhash = key_hash;
@@ -872,6 +1630,10 @@ pr_table_t *pr_table_nalloc(pool *p, int flags, unsigned int nchains) {
 }
 
 pr_table_t *pr_table_alloc(pool *p, int flags) {
+  if (flags & PR_TABLE_FL_OPEN_ADDR) {
+    return pr_table_nalloc(p, flags, TAB_OA_GROUP_SIZE);
+  }
+
   return pr_table_nalloc(p, flags, PR_TABLE_DEFAULT_NCHAINS);
 }
 
@@ -899,6 +1661,10 @@ int pr_table_do(pr_table_t *tab, int (*cb)(const void *key_data,
     return 0;
   }
 
+  if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+    return tab_oa_do(tab, cb, user_data, flags);
+  }
+
   for (i = 0; i < tab->nchains; i++) {
     pr_table_entry_t *ent;
 
@@ -940,6 +1706,11 @@ int pr_table_empty(pr_table_t *tab) {
     return 0;
   }
 
+  if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+    tab_oa_empty(tab);
+    return 0;
+  }
+
   for (i = 0; i < tab->nchains; i++) {
     pr_table_entry_t *e;
 
@@ -1011,6 +1782,10 @@ const void *pr_table_knext(pr_table_t *tab, size_t *key_datasz) {
     return NULL;
   }
 
+  if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+    return tab_oa_knext(tab, key_datasz);
+  }
+
   prev = tab->tab_iter_ent;
 
   ent = tab_entry_next(tab);
@@ -1063,6 +1838,7 @@ int pr_table_rewind(pr_table_t *tab) {
   }
 
   tab->tab_iter_ent = NULL;
+  tab->slot_iter_idx = 0;
   return 0;
 }
 
@@ -1085,6 +1861,7 @@ int pr_table_set(pr_table_t *tab, const char *key_data, const void *value_data,
 }
 
 int pr_table_ctl(pr_table_t *tab, int cmd, void *arg) {
+  unsigned long flags;
 
   if (tab == NULL) {
     errno = EINVAL;
@@ -1110,7 +1887,21 @@ int pr_table_ctl(pr_table_t *tab, int cmd, void *arg) {
         return -1;
       }
 
-      tab->flags = *((unsigned long *) arg);
+      flags = *((unsigned long *) arg);
+
+      if ((flags & PR_TABLE_FL_OPEN_ADDR) !=
+          (tab->flags & PR_TABLE_FL_OPEN_ADDR)) {
+        /* Switch the table's storage. */
+        if (flags & PR_TABLE_FL_OPEN_ADDR) {
+          tab_oa_reset(tab);
+
+        } else if (tab->chains == NULL) {
+          tab->chains = pcalloc(tab->pool,
+            sizeof(pr_table_entry_t *) * tab->nchains);
+        }
+      }
+
+      tab->flags = flags;
       return 0;
 
     case PR_TABLE_CTL_SET_KEY_CMP:
@@ -1120,12 +1911,23 @@ int pr_table_ctl(pr_table_t *tab, int cmd, void *arg) {
       return 0;
 
     case PR_TABLE_CTL_SET_ENT_INSERT:
+      /* Open-addressing tables have no chains. */
+      if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+        errno = EPERM;
+        return -1;
+      }
+
       tab->entinsert = arg ?
         (void (*)(pr_table_entry_t **, pr_table_entry_t *)) arg :
         (void (*)(pr_table_entry_t **, pr_table_entry_t *)) entry_insert;
       return 0;
 
     case PR_TABLE_CTL_SET_ENT_REMOVE:
+      if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+        errno = EPERM;
+        return -1;
+      }
+
       tab->entremove = arg ?
         (void (*)(pr_table_entry_t **, pr_table_entry_t *)) arg :
         (void (*)(pr_table_entry_t **, pr_table_entry_t *)) entry_remove;
@@ -1146,7 +1948,15 @@ int pr_table_ctl(pr_table_t *tab, int cmd, void *arg) {
       }
 
       tab->nchains = new_nchains;
-      
+
+      if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+        /* The slots will be reallocated, using the new size hint, on the
+         * next insertion.
+         */
+        tab_oa_reset(tab);
+        return 0;
+      }
+
       /* Note: by not freeing the memory of the previously allocated
        * chains, this constitutes a minor leak of the table's memory pool.
        */
@@ -1216,6 +2026,15 @@ float pr_table_load(pr_table_t *tab) {
     return -1.0;
   }
 
+  if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+    if (tab->nslots == 0) {
+      return 0.0;
+    }
+
+    load_factor = ((float) tab->nents / tab->nslots);
+    return load_factor;
+  }
+
   load_factor = (tab->nents / tab->nchains);
   return load_factor;
 }
@@ -1248,6 +2067,10 @@ void pr_table_dump(void (*dumpf)(const char *fmt, ...), pr_table_t *tab) {
         dumpf("%s", "[table flags]: UseCache");
       }
     }
+
+    if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+      dumpf("%s", "[table flags]: OpenAddr");
+    }
   }
 
   if (tab->nents == 0) {
@@ -1256,6 +2079,32 @@ void pr_table_dump(void (*dumpf)(const char *fmt, ...), pr_table_t *tab) {
   }
 
   dumpf("[table count]: %u", tab->nents);
+
+  if (tab->flags & PR_TABLE_FL_OPEN_ADDR) {
+    for (i = 0; i < tab->nslots; i++) {
+      register unsigned int j = 0;
+      struct tab_slot *s;
+      struct tab_value *v;
+
+      if (!TAB_OA_CTRL_IS_FULL(tab->ctrl[i])) {
+        continue;
+      }
+
+      s = &(tab->slots[i]);
+      dumpf("[hash %u (%u slots) slot %u#%u] '%s' => '%s' (%u)",
+        s->hash, tab->nslots, i, j++, s->key_data, s->value_data,
+        s->value_datasz);
+
+      for (v = s->values; v != NULL; v = v->next) {
+        dumpf("[hash %u (%u slots) slot %u#%u] '%s' => '%s' (%u)",
+          s->hash, tab->nslots, i, j++, s->key_data, v->value_data,
+          v->value_datasz);
+      }
+    }
+
+    return;
+  }
+
   for (i = 0; i < tab->nchains; i++) {
     register unsigned int j = 0;
     pr_table_entry_t *ent = tab->chains[i];
@@ -23,7 +23,7 @@
  * the source code for OpenSSL in the source distribution.
  */
 
-/* Timer system, based on alarm() and SIGALRM. */
+/* Timer system, based on a hashed timing wheel, driven by SIGALRM. */
 
 #include "conf.h"
 
@@ -31,10 +31,12 @@
 extern volatile unsigned int recvd_signal_flags;
 
 struct timer {
-  struct timer *next, *prev;
+  struct timer *next, *prev;    /* Wheel slot chain */
+  struct timer *hash_next;      /* Timer ID lookup chain */
 
-  long count;                   /* Amount of time remaining */
+  uint64_t expires;             /* Monotonic time (millisecs) of expiry */
   long interval;                /* Original length of timer */
+  unsigned int slot;            /* Wheel slot holding this timer */
 
   int timerno;                  /* Caller dependent timer number */
   module *mod;                  /* Module owning this timer */
@@ -46,151 +48,332 @@ struct timer {
 
 #define PR_TIMER_DYNAMIC_TIMERNO	1024
 
-static int _current_timeout = 0;
-static int _total_time = 0;
+/* The wheel has one slot per tick; a timer lives in the slot for the tick
+ * in which it expires, modulo the size of the wheel.  Timers further out
+ * than one revolution simply stay in their slot until their tick comes
+ * around.
+ *
+ * Resetting a timer only moves its expiry later, and does not move it to
+ * another slot, nor touch the pending alarm: when its old slot is reached,
+ * the timer is moved to the slot for its new expiry.  This keeps resetting
+ * a timer, as is done for every buffer of a data transfer, cheap.
+ */
+#define PR_TIMER_WHEEL_SIZE		64
+#define PR_TIMER_WHEEL_TICK_MS		1000
+#define PR_TIMER_HASH_SIZE		32
+
+static struct timer *wheel[PR_TIMER_WHEEL_SIZE];
+static uint64_t wheel_tick = 0;
+static struct timer *timer_hash[PR_TIMER_HASH_SIZE];
+static struct timer *free_timers = NULL;
+static unsigned int ntimers = 0;
+static int have_timers = FALSE;
+static unsigned int npending_removals = 0;
+
 static int _sleep_sem = 0;
 static int alarms_blocked = 0, alarm_pending = 0;
-static xaset_t *timers = NULL;
-static xaset_t *recycled = NULL;
-static xaset_t *free_timers = NULL;
 static int _indispatch = 0;
 static int dynamic_timerno = PR_TIMER_DYNAMIC_TIMERNO;
-static unsigned int nalarms = 0;
-static time_t _alarmed_time = 0;
+static volatile unsigned int nalarms = 0;
+
+/* The expiry of the alarm currently scheduled, if any. */
+static volatile sig_atomic_t alarm_scheduled = FALSE;
+static uint64_t alarm_expires = 0;
+
+/* Pending alarms are not inherited across fork(2).  Processes which keep
+ * their parent's timers schedule their own alarm via timers_handle_fork();
+ * remembering which process scheduled the alarm also catches children
+ * forked elsewhere, once they add a timer.
+ */
+static pid_t alarm_pid = 0;
 
 static pool *timer_pool = NULL;
 
 static const char *trace_channel = "timer";
 
-static int timer_cmp(struct timer *t1, struct timer *t2) {
-  if (t1->count < t2->count) {
-    return -1;
+static uint64_t timer_now(void) {
+  uint64_t now = 0;
+
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+    return 0;
+  }
+
+  now = ((uint64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#else
+  (void) pr_gettimeofday_millis(&now);
+#endif /* HAVE_CLOCK_GETTIME and CLOCK_MONOTONIC */
+
+  return now;
+}
+
+static unsigned int timer_hash_index(int timerno) {
+  return ((unsigned int) timerno) % PR_TIMER_HASH_SIZE;
+}
+
+static void wheel_insert(struct timer *t) {
+  t->slot = (unsigned int) ((t->expires / PR_TIMER_WHEEL_TICK_MS) %
+    PR_TIMER_WHEEL_SIZE);
+
+  t->prev = NULL;
+  t->next = wheel[t->slot];
+  if (t->next != NULL) {
+    t->next->prev = t;
   }
+  wheel[t->slot] = t;
+}
+
+static void wheel_remove(struct timer *t) {
+  if (t->prev != NULL) {
+    t->prev->next = t->next;
 
-  if (t1->count > t2->count) {
-    return 1;
+  } else {
+    wheel[t->slot] = t->next;
   }
 
-  return 0;
+  if (t->next != NULL) {
+    t->next->prev = t->prev;
+  }
+
+  t->next = t->prev = NULL;
 }
 
-/* This function does the work of iterating through the list of registered
- * timers, checking to see if their callbacks should be invoked and whether
- * they should be removed from the registration list. Its return value is
- * the amount of time remaining on the first timer in the list.
+static struct timer *timer_lookup(int timerno, module *mod) {
+  struct timer *t;
+
+  for (t = timer_hash[timer_hash_index(timerno)]; t; t = t->hash_next) {
+    if (t->timerno == timerno &&
+        t->remove == 0 &&
+        (t->mod == mod || mod == ANY_MODULE)) {
+      return t;
+    }
+  }
+
+  return NULL;
+}
+
+/* Unlinks the timer from the lookup table, and puts it on the free_timers
+ * chain, for later reuse.  The caller must have removed it from the wheel.
  */
-static int process_timers(int elapsed) {
-  struct timer *t = NULL, *next = NULL;
-  int res = 0;
+static void timer_free(struct timer *t) {
+  struct timer **tp;
 
-  if (recycled == NULL) {
-    recycled = xaset_create(timer_pool, NULL);
+  for (tp = &timer_hash[timer_hash_index(t->timerno)]; *tp;
+      tp = &((*tp)->hash_next)) {
+    if (*tp == t) {
+      *tp = t->hash_next;
+      break;
+    }
   }
 
-  if (elapsed == 0 &&
-      recycled->xas_list == NULL) {
-    if (timers == NULL) {
-      return 0;
+  t->hash_next = NULL;
+  t->next = free_timers;
+  free_timers = t;
+  ntimers--;
+}
+
+/* Frees any timers which were removed while their callbacks were being
+ * dispatched, and so could not be unlinked at the time.
+ */
+static void sweep_timers(void) {
+  register unsigned int i;
+
+  for (i = 0; i < PR_TIMER_WHEEL_SIZE; i++) {
+    struct timer *t, *next;
+
+    for (t = wheel[i]; t; t = next) {
+      next = t->next;
+
+      if (t->remove) {
+        wheel_remove(t);
+        timer_free(t);
+      }
     }
+  }
 
-    if (timers->xas_list != NULL) {
-      /* The value we return is a proposed timeout, for the next call to
-       * alarm(3).  We start with the simple count of timers in our list.
-       *
-       * But then we reduce the number; some of the timers' intervals may
-       * less than the number of total timers.
-       */
-      res = ((struct timer *) timers->xas_list)->count;
-      if (res > 5) {
-        res = 5;
+  npending_removals = 0;
+}
+
+/* Returns the earliest time at which any timer might expire, or zero if
+ * there are no timers.  This may be earlier than any actual expiry, e.g.
+ * for a timer which has been reset; waking up early merely means moving
+ * such timers along the wheel.
+ */
+static uint64_t next_expiry(void) {
+  register unsigned int i;
+
+  for (i = 0; i < PR_TIMER_WHEEL_SIZE; i++) {
+    uint64_t tick, expires;
+    struct timer *t;
+    int found = FALSE;
+
+    tick = wheel_tick + i;
+    expires = (tick + 1) * PR_TIMER_WHEEL_TICK_MS;
+
+    for (t = wheel[tick % PR_TIMER_WHEEL_SIZE]; t; t = t->next) {
+      if (t->remove) {
+        continue;
+      }
+
+      found = TRUE;
+      if (t->expires < expires) {
+        expires = t->expires;
       }
     }
 
-    return res;
+    if (found) {
+      return expires;
+    }
   }
 
+  return 0;
+}
+
+static void schedule_alarm(uint64_t now) {
+  uint64_t expires;
+
+  expires = next_expiry();
+  if (expires == 0) {
+    alarm_scheduled = FALSE;
+    alarm(0);
+    return;
+  }
+
+  if (expires <= now) {
+    expires = now + 1;
+  }
+
+  alarm_expires = expires;
+  alarm_scheduled = TRUE;
+  alarm_pid = getpid();
+
+#ifdef HAVE_SETITIMER
+  {
+    struct itimerval itv;
+    uint64_t delay;
+
+    delay = expires - now;
+
+    memset(&itv, 0, sizeof(itv));
+    itv.it_value.tv_sec = (time_t) (delay / 1000);
+    itv.it_value.tv_usec = (suseconds_t) ((delay % 1000) * 1000);
+
+    if (setitimer(ITIMER_REAL, &itv, NULL) == 0) {
+      return;
+    }
+  }
+#endif /* HAVE_SETITIMER */
+
+  /* alarm(2) has only second resolution; round up, rather than fire
+   * before the timer expires.
+   */
+  alarm((unsigned int) ((expires - now + 999) / 1000));
+}
+
+/* This function does the work of walking the wheel up to the current time,
+ * invoking the callbacks of expired timers, and moving timers whose
+ * expiry has been pushed back, by pr_timer_reset(), to their new slots.
+ */
+static void process_timers(uint64_t now) {
+  uint64_t now_tick;
+  unsigned int nslots = 0;
+
   /* Critical code, no interruptions please */
   if (_indispatch) {
-    return 0;
+    return;
   }
 
   pr_alarms_block();
   _indispatch++;
 
-  if (elapsed) {
-    for (t = (struct timer *) timers->xas_list; t; t = next) {
-      /* If this timer has already been handled, skip */
+  now_tick = now / PR_TIMER_WHEEL_TICK_MS;
+  if (wheel_tick > now_tick) {
+    wheel_tick = now_tick;
+  }
+
+  while (wheel_tick <= now_tick &&
+         nslots < PR_TIMER_WHEEL_SIZE) {
+    unsigned int slot;
+    struct timer *t, *next;
+
+    /* Detach this slot's chain, so that timers moved or restarted below,
+     * even into this same slot, are not seen again during this walk.
+     */
+    slot = (unsigned int) (wheel_tick % PR_TIMER_WHEEL_SIZE);
+    t = wheel[slot];
+    wheel[slot] = NULL;
+
+    for (; t; t = next) {
+      long elapsed;
+
       next = t->next;
+      if (next != NULL) {
+        next->prev = NULL;
+      }
+
+      t->next = t->prev = NULL;
 
       if (t->remove) {
-        /* Move the timer onto the free_timers chain, for later reuse. */
-        xaset_remove(timers, (xasetmember_t *) t);
-        xaset_insert(free_timers, (xasetmember_t *) t);
-
-      } else if ((t->count -= elapsed) <= 0) {
-        /* This timer's interval has elapsed, so trigger its callback. */
-
-        pr_trace_msg(trace_channel, 4,
-          "%ld %s for timer ID %d ('%s', for module '%s') elapsed, invoking "
-          "callback (%p)", t->interval,
-          t->interval != 1 ? "seconds" : "second", t->timerno,
-          t->desc ? t->desc : "<unknown>",
-          t->mod ? t->mod->name : "<none>", t->callback);
-
-        if (t->callback(t->interval, t->timerno, t->interval - t->count,
-            t->mod) == 0) {
-
-          /* A return value of zero means this timer is done, and can be
-           * removed.
-           */
-          xaset_remove(timers, (xasetmember_t *) t);
-          xaset_insert(free_timers, (xasetmember_t *) t);
-
-        } else {
-          /* A non-zero return value from a timer callback signals that
-           * the timer should be reused/restarted.
-           */
-          pr_trace_msg(trace_channel, 6,
-            "restarting timer ID %d ('%s'), as per callback", t->timerno,
-            t->desc ? t->desc : "<unknown>");
-
-          xaset_remove(timers, (xasetmember_t *) t);
-          t->count = t->interval;
-          xaset_insert(recycled, (xasetmember_t *) t);
-        }
+        timer_free(t);
+        continue;
+      }
+
+      if (t->expires > now) {
+        /* Not yet expired; either the timer was reset, or it is due in a
+         * later revolution of the wheel.
+         */
+        wheel_insert(t);
+        continue;
+      }
+
+      /* This timer's interval has elapsed, so trigger its callback. */
+      elapsed = t->interval + (long) ((now - t->expires) / 1000);
+
+      pr_trace_msg(trace_channel, 4,
+        "%ld %s for timer ID %d ('%s', for module '%s') elapsed, invoking "
+        "callback (%p)", t->interval,
+        t->interval != 1 ? "seconds" : "second", t->timerno,
+        t->desc ? t->desc : "<unknown>",
+        t->mod ? t->mod->name : "<none>", t->callback);
+
+      if (t->callback(t->interval, t->timerno, elapsed, t->mod) == 0 ||
+          t->remove) {
+
+        /* A return value of zero means this timer is done, and can be
+         * removed.
+         */
+        timer_free(t);
+
+      } else {
+        /* A non-zero return value from a timer callback signals that
+         * the timer should be reused/restarted.
+         */
+        pr_trace_msg(trace_channel, 6,
+          "restarting timer ID %d ('%s'), as per callback", t->timerno,
+          t->desc ? t->desc : "<unknown>");
+
+        t->expires = now + (t->interval * 1000);
+        wheel_insert(t);
       }
     }
-  }
 
-  /* Put the recycled timers back into the main timer list. */
-  t = (struct timer *) recycled->xas_list;
-  while (t != NULL) {
-    xaset_remove(recycled, (xasetmember_t *) t);
-    xaset_insert_sort(timers, (xasetmember_t *) t, TRUE);
-    t = (struct timer *) recycled->xas_list;
+    wheel_tick++;
+    nslots++;
   }
 
-  _indispatch--;
-  pr_alarms_unblock();
-
-  /* If no active timers remain in the list, there is no reason to set the
-   * SIGALRM handle.
+  /* If the whole wheel was walked, any remaining ticks up to now would
+   * only visit the same slots again.
    */
+  wheel_tick = now_tick;
 
-  if (timers->xas_list != NULL) {
-    /* The value we return is a proposed timeout, for the next call to
-     * alarm(3).  We start with the simple count of timers in our list.
-     *
-     * But then we reduce the number; some of the timers' intervals may
-     * less than the number of total timers.
-     */
-    res = ((struct timer *) timers->xas_list)->count;
-    if (res > 5) {
-      res = 5;
-    }
+  if (npending_removals > 0) {
+    sweep_timers();
   }
 
-  return res;
+  _indispatch--;
+  pr_alarms_unblock();
 }
 
 static RETSIGTYPE sig_alarm(int signo) {
@@ -221,12 +404,11 @@ static RETSIGTYPE sig_alarm(int signo) {
   recvd_signal_flags |= RECEIVED_SIG_ALRM;
   nalarms++;
 
-  /* Reset the alarm */
-  _total_time += _current_timeout;
-  if (_current_timeout) {
-    _alarmed_time = time(NULL);
-    alarm(_current_timeout);
-  }
+  /* The alarm is rescheduled, for the next expiry, by handle_alarm().  Until
+   * then, keep the alarm going, in case this signal is not handled promptly.
+   */
+  alarm_scheduled = FALSE;
+  alarm(1);
 }
 
 static void set_sig_alarm(void) {
@@ -255,15 +437,6 @@ static void set_sig_alarm(void) {
 }
 
 void handle_alarm(void) {
-  int new_timeout = 0;
-
-  /* We need to adjust for any time that might be remaining on the alarm,
-   * in case we were called in order to change alarm durations.  Note
-   * that rapid-fire calling of this function will probably screw
-   * up the already poor resolution of alarm() _horribly_.  Oh well,
-   * this shouldn't be used for any precise work anyway, it's only
-   * for modules to perform approximate timing.
-   */
 
   /* It's possible that alarms are blocked when this function is
    * called, if so, increment alarm_pending and exit swiftly.
@@ -272,22 +445,11 @@ void handle_alarm(void) {
     nalarms = 0;
 
     if (!alarms_blocked) {
-      int alarm_elapsed;
-      time_t now;
+      uint64_t now;
 
-      /* Clear any pending ALRM signals. */
-      alarm(0);
-
-      /* Determine how much time has elapsed since we last processed timers. */
-      time(&now);
-      alarm_elapsed = _alarmed_time > 0 ? (int) (now - _alarmed_time) : 0;
-
-      new_timeout = _total_time + alarm_elapsed;
-      _total_time = 0;
-      new_timeout = process_timers(new_timeout);
-
-      _alarmed_time = now;
-      alarm(_current_timeout = new_timeout);
+      now = timer_now();
+      process_timers(now);
+      schedule_alarm(now);
 
     } else {
       alarm_pending++;
@@ -298,7 +460,7 @@ void handle_alarm(void) {
 int pr_timer_reset(int timerno, module *mod) {
   struct timer *t = NULL;
 
-  if (timers == NULL) {
+  if (have_timers == FALSE) {
     errno = EPERM;
     return -1;
   }
@@ -308,80 +470,74 @@ int pr_timer_reset(int timerno, module *mod) {
     return -1;
   }
 
-  pr_alarms_block();
-
-  if (recycled == NULL) {
-    recycled = xaset_create(timer_pool, NULL);
-  }
-
-  for (t = (struct timer *) timers->xas_list; t; t = t->next) {
-    if (t->timerno == timerno &&
-        (t->mod == mod || mod == ANY_MODULE)) {
-      t->count = t->interval;
-      xaset_remove(timers, (xasetmember_t *) t);
-      xaset_insert(recycled, (xasetmember_t *) t);
-      nalarms++;
-
-      /* The handle_alarm() function also readjusts the timers lists
-       * as part of its processing, so it needs to be called when a timer
-       * is reset.
-       */
-      handle_alarm();
-      break;
-    }
+  t = timer_lookup(timerno, mod);
+  if (t == NULL) {
+    return 0;
   }
 
-  pr_alarms_unblock();
-
-  if (t != NULL) {
-    pr_trace_msg(trace_channel, 7, "reset timer ID %d ('%s', for module '%s')",
-      t->timerno, t->desc, t->mod ? t->mod->name : "[none]");
-    return t->timerno;
-  }
+  /* Only the expiry changes; the timer is moved along the wheel, if need
+   * be, when its current slot is reached.  Since the expiry only ever moves
+   * later, the scheduled alarm will not be too late, either.
+   */
+  t->expires = timer_now() + (t->interval * 1000);
 
-  return 0;
+  pr_trace_msg(trace_channel, 7, "reset timer ID %d ('%s', for module '%s')",
+    t->timerno, t->desc, t->mod ? t->mod->name : "[none]");
+  return t->timerno;
 }
 
 int pr_timer_remove(int timerno, module *mod) {
-  struct timer *t = NULL, *tnext = NULL;
   int nremoved = 0;
+  register unsigned int i;
 
   /* If there are no timers currently registered, do nothing. */
-  if (!timers)
+  if (have_timers == FALSE) {
     return 0;
+  }
 
   pr_alarms_block();
 
-  for (t = (struct timer *) timers->xas_list; t; t = tnext) {
-    tnext = t->next;
+  for (i = 0; i < PR_TIMER_HASH_SIZE; i++) {
+    struct timer *t, *tnext;
+
+    /* A specific timer can only be in one lookup chain. */
+    if (timerno >= 0 &&
+        timer_hash_index(timerno) != i) {
+      continue;
+    }
+
+    for (t = timer_hash[i]; t; t = tnext) {
+      tnext = t->hash_next;
+
+      if (t->remove ||
+          (timerno >= 0 && t->timerno != timerno) ||
+          (mod != ANY_MODULE && t->mod != mod)) {
+        continue;
+      }
 
-    if ((timerno < 0 || t->timerno == timerno) &&
-        (mod == ANY_MODULE || t->mod == mod)) {
       nremoved++;
 
+      pr_trace_msg(trace_channel, 7,
+        "removed timer ID %d ('%s', for module '%s')", t->timerno, t->desc,
+        t->mod ? t->mod->name : "[none]");
+
       if (_indispatch) {
         t->remove++;
+        npending_removals++;
 
       } else {
-        xaset_remove(timers, (xasetmember_t *) t);
-        xaset_insert(free_timers, (xasetmember_t *) t);
-	nalarms++;
-
-        /* The handle_alarm() function also readjusts the timers lists
-         * as part of its processing, so it needs to be called when a timer
-         * is removed.
-         */
-        handle_alarm();
+        wheel_remove(t);
+        timer_free(t);
       }
 
-      pr_trace_msg(trace_channel, 7,
-        "removed timer ID %d ('%s', for module '%s')", t->timerno, t->desc,
-        t->mod ? t->mod->name : "[none]");
+      /* If we are removing a specific timer, stop now.  Otherwise, keep
+       * removing any matching timers.
+       */
+      if (timerno >= 0) {
+        break;
+      }
     }
 
-    /* If we are removing a specific timer, break out of the loop now.
-     * Otherwise, keep removing any matching timers.
-     */
     if (nremoved > 0 &&
         timerno >= 0) {
       break;
@@ -408,6 +564,7 @@ int pr_timer_remove(int timerno, module *mod) {
 int pr_timer_add(int seconds, int timerno, module *mod, callback_t cb,
     const char *desc) {
   struct timer *t = NULL;
+  uint64_t now;
 
   if (seconds <= 0 ||
       cb == NULL ||
@@ -416,27 +573,19 @@ int pr_timer_add(int seconds, int timerno, module *mod, callback_t cb,
     return -1;
   }
 
-  if (!timers)
-    timers = xaset_create(timer_pool, (XASET_COMPARE) timer_cmp);
-
   /* Check to see that, if specified, the timerno is not already in use. */
-  if (timerno >= 0) {
-    for (t = (struct timer *) timers->xas_list; t; t = t->next) {
-      if (t->timerno == timerno) {
-        errno = EPERM;
-        return -1;
-      }
-    }
+  if (timerno >= 0 &&
+      have_timers == TRUE &&
+      timer_lookup(timerno, ANY_MODULE) != NULL) {
+    errno = EPERM;
+    return -1;
   }
 
-  if (!free_timers)
-    free_timers = xaset_create(timer_pool, NULL);
-
   /* Try to use an old timer first */
   pr_alarms_block();
-  t = (struct timer *) free_timers->xas_list;
+  t = free_timers;
   if (t != NULL) {
-    xaset_remove(free_timers, (xasetmember_t *) t);
+    free_timers = t->next;
 
   } else {
     if (timer_pool == NULL) {
@@ -457,32 +606,42 @@ int pr_timer_add(int seconds, int timerno, module *mod, callback_t cb,
     timerno = dynamic_timerno++;
   }
 
+  now = timer_now();
+
+  /* If the wheel is empty, it may not have been walked in a while; there
+   * is no need to walk the intervening slots now.
+   */
+  if (ntimers == 0) {
+    wheel_tick = now / PR_TIMER_WHEEL_TICK_MS;
+  }
+
   t->timerno = timerno;
-  t->count = t->interval = seconds;
+  t->interval = seconds;
+  t->expires = now + (seconds * 1000);
   t->callback = cb;
   t->mod = mod;
   t->remove = 0;
   t->desc = desc;
 
-  /* If called while _indispatch, add to the recycled list to prevent
-   * list corruption
-   */
+  wheel_insert(t);
+  t->hash_next = timer_hash[timer_hash_index(timerno)];
+  timer_hash[timer_hash_index(timerno)] = t;
+  ntimers++;
 
-  if (_indispatch) {
-    if (!recycled)
-      recycled = xaset_create(timer_pool, NULL);
-    xaset_insert(recycled, (xasetmember_t *) t);
-
-  } else {
-    xaset_insert_sort(timers, (xasetmember_t *) t, TRUE);
-    nalarms++;
+  if (have_timers == FALSE) {
+    have_timers = TRUE;
     set_sig_alarm();
+  }
 
-    /* The handle_alarm() function also readjusts the timers lists
-     * as part of its processing, so it needs to be called when a timer
-     * is added.
-     */
-    handle_alarm();
+  /* If called while _indispatch, the alarm is scheduled once all of the
+   * expired timers have been handled.  Otherwise, bring the alarm forward,
+   * if this timer expires before it.
+   */
+  if (!_indispatch &&
+      (!alarm_scheduled ||
+       alarm_pid != getpid() ||
+       t->expires < alarm_expires)) {
+    schedule_alarm(now);
   }
 
   pr_alarms_unblock();
@@ -560,18 +719,34 @@ int pr_timer_usleep(unsigned long usecs) {
   return 0;
 }
 
+void timers_handle_fork(void) {
+  pr_alarms_block();
+
+  alarm_scheduled = FALSE;
+  if (ntimers > 0 &&
+      !_indispatch) {
+    schedule_alarm(timer_now());
+  }
+
+  pr_alarms_unblock();
+}
+
 void timers_init(void) {
 
   /* Reset some of the key static variables. */
-  _current_timeout = 0;
-  _total_time = 0;
   nalarms = 0;
-  _alarmed_time = 0;
+  alarm_scheduled = FALSE;
+  alarm_expires = 0;
+  alarm_pid = 0;
   dynamic_timerno = PR_TIMER_DYNAMIC_TIMERNO;
 
-  /* Don't inherit the parent's timer lists. */
-  timers = NULL;
-  recycled = NULL;
+  /* Don't inherit the parent's timers. */
+  memset(wheel, 0, sizeof(wheel));
+  memset(timer_hash, 0, sizeof(timer_hash));
+  wheel_tick = 0;
+  ntimers = 0;
+  npending_removals = 0;
+  have_timers = FALSE;
   free_timers = NULL;
 
   /* Reset the timer pool. */
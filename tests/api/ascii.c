@@ -332,6 +332,307 @@ START_TEST (ascii_ftp_to_crlf_test) {
 }
 END_TEST
 
+START_TEST (ascii_ftp_to_crlf2_test) {
+  int res;
+  char *src, *expected, dst[32];
+  size_t src_len, dst_len, expected_len;
+
+  pr_ascii_ftp_reset();
+  res = pr_ascii_ftp_to_crlf2(NULL, 0, NULL, 0, NULL);
+  fail_unless(res == -1, "Failed to handle null arguments");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got '%s' (%d)", EINVAL,
+    strerror(errno), errno);
+
+  /* Handle empty input buffer. */
+  pr_ascii_ftp_reset();
+  src = "";
+  src_len = 0;
+  dst_len = 1;
+  res = pr_ascii_ftp_to_crlf2(src, src_len, dst, sizeof(dst), &dst_len);
+  fail_unless(res == 0, "Failed to handle empty input buffer");
+  fail_unless(dst_len == 0, "Failed to set output buffer length");
+
+  /* Handle input buffer with LFs, no CRs. */
+  pr_ascii_ftp_reset();
+  src = "he\nl\nlo";
+  src_len = 7;
+  dst_len = 0;
+  res = pr_ascii_ftp_to_crlf2(src, src_len, dst, sizeof(dst), &dst_len);
+  fail_unless(res == 2, "Expected 2, got %d", res);
+  expected = "he\r\nl\r\nlo";
+  expected_len = 9;
+  fail_unless(dst_len == expected_len,
+    "Expected output buffer length %lu, got %lu", (unsigned long) expected_len,
+    (unsigned long) dst_len);
+  fail_unless(strncmp(dst, expected, dst_len) == 0,
+    "Expected output buffer '%s', got '%.*s'", expected, (int) dst_len, dst);
+
+  /* Handle an output buffer too small for the translated data. */
+  pr_ascii_ftp_reset();
+  res = pr_ascii_ftp_to_crlf2(src, src_len, dst, 8, &dst_len);
+  fail_unless(res == -1, "Failed to handle too-small output buffer");
+  fail_unless(errno == E2BIG, "Expected E2BIG (%d), got '%s' (%d)", E2BIG,
+    strerror(errno), errno);
+
+  /* An output buffer smaller than twice the input is fine, as long as the
+   * translated data fits.
+   */
+  pr_ascii_ftp_reset();
+  dst_len = 0;
+  res = pr_ascii_ftp_to_crlf2(src, src_len, dst, 9, &dst_len);
+  fail_unless(res == 2, "Expected 2, got %d", res);
+  fail_unless(dst_len == expected_len,
+    "Expected output buffer length %lu, got %lu", (unsigned long) expected_len,
+    (unsigned long) dst_len);
+
+  /* Handle a trailing CR, followed by a buffer with a leading LF. */
+  pr_ascii_ftp_reset();
+  src = "hel\r";
+  src_len = 4;
+  dst_len = 0;
+  res = pr_ascii_ftp_to_crlf2(src, src_len, dst, sizeof(dst), &dst_len);
+  fail_unless(res == 0, "Expected 0, got %d", res);
+  fail_unless(dst_len == src_len,
+    "Expected output buffer length %lu, got %lu", (unsigned long) src_len,
+    (unsigned long) dst_len);
+
+  src = "\nlo\n";
+  src_len = 4;
+  dst_len = 0;
+  res = pr_ascii_ftp_to_crlf2(src, src_len, dst, sizeof(dst), &dst_len);
+  fail_unless(res == 1, "Expected 1, got %d", res);
+  expected = "\nlo\r\n";
+  expected_len = 5;
+  fail_unless(dst_len == expected_len,
+    "Expected output buffer length %lu, got %lu", (unsigned long) expected_len,
+    (unsigned long) dst_len);
+  fail_unless(strncmp(dst, expected, dst_len) == 0,
+    "Expected output buffer '%s', got '%.*s'", expected, (int) dst_len, dst);
+}
+END_TEST
+
+/* Reference implementations of the CRLF translations, processing one byte
+ * at a time, against which to check the library versions.
+ */
+static int ref_dangling_cr = FALSE;
+
+static int ref_from_crlf(char *in, size_t inlen, char *out, size_t *outlen) {
+  char *src = in, *dst = out;
+  size_t rem = inlen;
+  int adj = 0;
+
+  while (rem--) {
+    if (*src != '\r') {
+      *dst++ = *src++;
+      (*outlen)++;
+
+    } else if (rem == 0) {
+      adj++;
+      *dst++ = *src++;
+
+    } else if (*(src+1) == '\n') {
+      src++;
+
+    } else {
+      *dst++ = *src++;
+      (*outlen)++;
+    }
+  }
+
+  return adj;
+}
+
+static int ref_to_crlf(char *in, size_t inlen, char *out, size_t *outlen) {
+  register unsigned int i, j = 0;
+
+  for (i = 0; i < inlen; i++) {
+    if (in[i] == '\n') {
+      if ((i == 0 && ref_dangling_cr == FALSE) ||
+          (i > 0 && in[i-1] != '\r')) {
+        out[j++] = '\r';
+      }
+    }
+
+    out[j++] = in[i];
+  }
+
+  ref_dangling_cr = (in[inlen-1] == '\r') ? TRUE : FALSE;
+  *outlen = j;
+  return j - i;
+}
+
+static size_t ascii_fuzz_input(char *data, size_t maxlen) {
+  register unsigned int i;
+  size_t len;
+
+  len = 1 + (random() % maxlen);
+
+  for (i = 0; i < len; i++) {
+    long r;
+
+    r = random() % 100;
+    if (r < 80) {
+      data[i] = 'a' + (random() % 26);
+
+    } else if (r < 90) {
+      data[i] = '\n';
+
+    } else {
+      data[i] = '\r';
+    }
+  }
+
+  return len;
+}
+
+START_TEST (ascii_ftp_crlf_fuzz_test) {
+  register unsigned int i;
+  char in[512], out[1024], expected[1024];
+
+  srandom(4277);
+
+  for (i = 0; i < 5000; i++) {
+    int res, expected_res;
+    size_t inlen, outlen, expected_len;
+    char *ptr;
+
+    /* CRLF -> LF, both in place and into a separate buffer. */
+    inlen = ascii_fuzz_input(in, sizeof(in));
+
+    expected_len = 0;
+    expected_res = ref_from_crlf(in, inlen, expected, &expected_len);
+
+    outlen = 0;
+    ptr = out;
+    res = pr_ascii_ftp_from_crlf(p, in, inlen, &ptr, &outlen);
+    fail_unless(res == expected_res, "Input %u: expected %d, got %d", i,
+      expected_res, res);
+    fail_unless(outlen == expected_len,
+      "Input %u: expected length %lu, got %lu", i,
+      (unsigned long) expected_len, (unsigned long) outlen);
+    fail_unless(memcmp(out, expected, outlen + res) == 0,
+      "Input %u: output differs", i);
+
+    outlen = 0;
+    ptr = in;
+    res = pr_ascii_ftp_from_crlf(p, in, inlen, &ptr, &outlen);
+    fail_unless(res == expected_res, "Input %u: expected %d, got %d", i,
+      expected_res, res);
+    fail_unless(outlen == expected_len,
+      "Input %u: expected length %lu, got %lu", i,
+      (unsigned long) expected_len, (unsigned long) outlen);
+    fail_unless(memcmp(in, expected, outlen + res) == 0,
+      "Input %u: in-place output differs", i);
+
+    /* LF -> CRLF, as consecutive chunks of a stream, so that the dangling
+     * CR state is carried from one input to the next.
+     */
+    if (i % 50 == 0) {
+      pr_ascii_ftp_reset();
+      ref_dangling_cr = FALSE;
+    }
+
+    inlen = ascii_fuzz_input(in, sizeof(in));
+    expected_res = ref_to_crlf(in, inlen, expected, &expected_len);
+
+    if (i % 2 == 0) {
+      ptr = NULL;
+      outlen = 0;
+      res = pr_ascii_ftp_to_crlf(p, in, inlen, &ptr, &outlen);
+
+    } else {
+      ptr = out;
+      outlen = 0;
+      res = pr_ascii_ftp_to_crlf2(in, inlen, out, sizeof(out), &outlen);
+    }
+
+    fail_unless(res == expected_res, "Input %u: expected %d, got %d", i,
+      expected_res, res);
+    fail_unless(outlen == expected_len,
+      "Input %u: expected length %lu, got %lu", i,
+      (unsigned long) expected_len, (unsigned long) outlen);
+    fail_unless(memcmp(ptr, expected, outlen) == 0,
+      "Input %u: output differs", i);
+  }
+}
+END_TEST
+
+START_TEST (ascii_ftp_crlf_bench_test) {
+  register unsigned int i;
+  char *text, *crlf_text, *buf;
+  size_t textlen = 0, crlf_textlen = 0, bufsz = 128 * 1024;
+  double elapsed[4];
+
+  /* A typical text file, of lines of varying lengths. */
+  text = palloc(p, bufsz);
+  crlf_text = palloc(p, bufsz * 2);
+  buf = palloc(p, bufsz * 2);
+
+  while (textlen + 128 < bufsz) {
+    size_t linelen;
+
+    linelen = 10 + ((textlen * 7) % 70);
+    memset(text + textlen, 'x', linelen);
+    memcpy(crlf_text + crlf_textlen, text + textlen, linelen);
+    textlen += linelen;
+    crlf_textlen += linelen;
+
+    text[textlen++] = '\n';
+    crlf_text[crlf_textlen++] = '\r';
+    crlf_text[crlf_textlen++] = '\n';
+  }
+
+  for (i = 0; i < 4; i++) {
+    register unsigned int j;
+    struct timeval start, end;
+    size_t buflen = 0;
+
+    gettimeofday(&start, NULL);
+    for (j = 0; j < 200; j++) {
+      buflen = 0;
+
+      switch (i) {
+        case 0:
+          ref_to_crlf(text, textlen, buf, &buflen);
+          break;
+
+        case 1:
+          pr_ascii_ftp_to_crlf2(text, textlen, buf, bufsz * 2, &buflen);
+          break;
+
+        case 2:
+          memcpy(buf, crlf_text, crlf_textlen);
+          ref_from_crlf(buf, crlf_textlen, buf, &buflen);
+          break;
+
+        case 3: {
+          char *ptr = buf;
+
+          memcpy(buf, crlf_text, crlf_textlen);
+          pr_ascii_ftp_from_crlf(p, buf, crlf_textlen, &ptr, &buflen);
+          break;
+        }
+      }
+    }
+    gettimeofday(&end, NULL);
+
+    fail_unless(buflen == (i < 2 ? crlf_textlen : textlen),
+      "Unexpected translated length %lu", (unsigned long) buflen);
+
+    elapsed[i] = (((end.tv_sec - start.tv_sec) * 1000000.0) +
+      (end.tv_usec - start.tv_usec)) / 1000000.0;
+    elapsed[i] = (textlen * 200.0) / (1024.0 * 1024.0) / elapsed[i];
+  }
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    fprintf(stdout, "LF -> CRLF: bytewise %.1f MB/s, bulk %.1f MB/s\n",
+      elapsed[0], elapsed[1]);
+    fprintf(stdout, "CRLF -> LF: bytewise %.1f MB/s, bulk %.1f MB/s\n",
+      elapsed[2], elapsed[3]);
+  }
+}
+END_TEST
+
 Suite *tests_get_ascii_suite(void) {
   Suite *suite;
   TCase *testcase;
@@ -344,6 +645,9 @@ Suite *tests_get_ascii_suite(void) {
 
   tcase_add_test(testcase, ascii_ftp_from_crlf_test);
   tcase_add_test(testcase, ascii_ftp_to_crlf_test);
+  tcase_add_test(testcase, ascii_ftp_to_crlf2_test);
+  tcase_add_test(testcase, ascii_ftp_crlf_fuzz_test);
+  tcase_add_test(testcase, ascii_ftp_crlf_bench_test);
 
   suite_add_tcase(suite, testcase);
 
@@ -689,6 +689,222 @@ START_TEST (config_merge_down_test) {
 }
 END_TEST
 
+/* Builds a server-like config set: ndirectives directives at the top level,
+ * with ndirs <Directory> contexts among them, each of which also has
+ * ndirectives directives, and a <Limit> with a few more.  Some directive
+ * names are used more than once, at each level.
+ */
+static xaset_t *config_index_make_set(unsigned int ndirectives,
+    unsigned int ndirs) {
+  register unsigned int i;
+  xaset_t *set = NULL;
+
+  for (i = 0; i < ndirectives; i++) {
+    char name[64];
+
+    snprintf(name, sizeof(name), "Directive%u", i % (ndirectives / 2));
+    (void) add_config_param_set(&set, name, 1, "top");
+
+    if (ndirs > 0 &&
+        i % (ndirectives / ndirs) == 0) {
+      register unsigned int j;
+      config_rec *dir, *limit;
+
+      dir = add_config_param_set(&set, "/tmp", 0);
+      dir->config_type = CONF_DIR;
+
+      for (j = 0; j < ndirectives; j++) {
+        snprintf(name, sizeof(name), "Directive%u", (i + (j * 7)) %
+          (ndirectives / 2));
+        (void) add_config_param_set(&(dir->subset), name, 1, "dir");
+      }
+
+      limit = add_config_param_set(&(dir->subset), "LIST", 0);
+      limit->config_type = CONF_LIMIT;
+
+      for (j = 0; j < 4; j++) {
+        snprintf(name, sizeof(name), "Directive%u", i + j);
+        (void) add_config_param_set(&(limit->subset), name, 1, "limit");
+      }
+
+      /* A non-directive config_rec, with a directive's name. */
+      limit = add_config_param_set(&(dir->subset), name, 0);
+      limit->config_type = CONF_LIMIT;
+    }
+  }
+
+  return set;
+}
+
+/* Checks that find_config2() finds the same config_recs as scanning the
+ * set does, for repeated lookups (so that the set is indexed).
+ */
+static void config_index_check_set(xaset_t *set, unsigned int ndirectives) {
+  register unsigned int i;
+  unsigned long flags[] = {
+    0,
+    PR_CONFIG_FIND_FL_SKIP_DIR,
+    PR_CONFIG_FIND_FL_SKIP_LIMIT|PR_CONFIG_FIND_FL_SKIP_ANON,
+  };
+
+  for (i = 0; i < (ndirectives / 2) + 2; i++) {
+    register unsigned int j;
+    char name[64];
+
+    snprintf(name, sizeof(name), "Directive%u", i);
+
+    for (j = 0; j < 12; j++) {
+      int recurse;
+      unsigned long flag;
+      config_rec *expected, *c;
+
+      recurse = (j % 2 == 0);
+      flag = flags[j % 3];
+
+      find_config_set_top((config_rec *) set->xas_list);
+      expected = find_config_next2(NULL, (config_rec *) set->xas_list,
+        CONF_PARAM, name, recurse, flag);
+
+      c = find_config2(set, CONF_PARAM, name, recurse, flag);
+      fail_unless(c == expected,
+        "Expected %p for '%s' (recurse %d, flags %lu), got %p", expected,
+        name, recurse, flag, c);
+
+      if (c == NULL) {
+        fail_unless(errno == ENOENT,
+          "Expected ENOENT (%d), got %s (%d)", ENOENT, strerror(errno), errno);
+      }
+    }
+  }
+}
+
+START_TEST (config_find_config_index_test) {
+  xaset_t *set;
+  config_rec *c;
+  const char *name;
+  unsigned int ndirectives = 200;
+
+  set = config_index_make_set(ndirectives, 3);
+
+  /* Registers the ID for a name not used in the set. */
+  (void) pr_config_set_id("Directive101");
+
+  mark_point();
+  config_index_check_set(set, ndirectives);
+
+  /* Add a directive at the head of the set. */
+  name = "Directive5";
+  c = pr_config_add_set(&set, name, PR_CONFIG_FL_INSERT_HEAD);
+  fail_unless(c != NULL, "Failed to add config '%s': %s", name,
+    strerror(errno));
+  c->config_type = CONF_PARAM;
+
+  c = find_config2(set, CONF_PARAM, name, FALSE, 0);
+  fail_unless(c == (config_rec *) set->xas_list,
+    "Failed to find newly added config '%s'", name);
+
+  mark_point();
+  config_index_check_set(set, ndirectives);
+
+  /* Remove a directive. */
+  name = "Directive7";
+  fail_unless(remove_config(set, name, FALSE) > 0,
+    "Failed to remove config '%s': %s", name, strerror(errno));
+
+  c = find_config2(set, CONF_PARAM, name, FALSE, 0);
+  fail_unless(c == NULL, "Found removed config '%s' unexpectedly", name);
+
+  mark_point();
+  config_index_check_set(set, ndirectives);
+
+  /* Give a top-level directive a child set. */
+  name = "Directive9";
+  c = find_config2(set, CONF_PARAM, name, FALSE, 0);
+  fail_unless(c != NULL, "Failed to find config '%s': %s", name,
+    strerror(errno));
+  c->config_type = CONF_ANON;
+
+  c = add_config_param_set(&(c->subset), name, 1, "anon");
+  fail_unless(c != NULL, "Failed to add config '%s': %s", name,
+    strerror(errno));
+
+  mark_point();
+  config_index_check_set(set, ndirectives);
+}
+END_TEST
+
+START_TEST (config_find_config_index_bench_test) {
+  register unsigned int i;
+  unsigned int ndirectives[] = { 20, 200, 800, 0 };
+
+  /* Each command looks up a few dozen directives, a few of which are
+   * configured; most are not, and so are looked up in every config set.
+   */
+  for (i = 0; ndirectives[i] != 0; i++) {
+    register unsigned int j;
+    xaset_t *set;
+    struct timeval start, end;
+    unsigned int nlookups = 0, nfound[2] = { 0, 0 };
+    double elapsed[2];
+
+    set = config_index_make_set(ndirectives[i], 4);
+    (void) pr_config_set_id("ServerIdent");
+
+    for (j = 0; j < 2; j++) {
+      register unsigned int k;
+
+      gettimeofday(&start, NULL);
+      for (k = 0; k < 2000; k++) {
+        register unsigned int l;
+
+        for (l = 0; l < 32; l++) {
+          char name[64];
+          config_rec *c;
+
+          if (l % 4 == 0) {
+            snprintf(name, sizeof(name), "Directive%u", (k + l) %
+              (ndirectives[i] / 2));
+
+          } else {
+            sstrncpy(name, "ServerIdent", sizeof(name));
+          }
+
+          if (j == 0) {
+            find_config_set_top((config_rec *) set->xas_list);
+            c = find_config_next2(NULL, (config_rec *) set->xas_list,
+              CONF_PARAM, name, TRUE, 0);
+
+          } else {
+            c = find_config2(set, CONF_PARAM, name, TRUE, 0);
+          }
+
+          if (c != NULL) {
+            nfound[j]++;
+          }
+
+          if (j == 0) {
+            nlookups++;
+          }
+        }
+      }
+      gettimeofday(&end, NULL);
+
+      elapsed[j] = (((end.tv_sec - start.tv_sec) * 1000000.0) +
+        (end.tv_usec - start.tv_usec)) / nlookups;
+    }
+
+    fail_unless(nfound[0] == nfound[1],
+      "Expected %u configs to be found, got %u", nfound[0], nfound[1]);
+
+    if (getenv("TEST_VERBOSE") != NULL) {
+      fprintf(stdout, "config lookups, %u directives per context: "
+        "scanned %.3f us, indexed %.3f us\n", ndirectives[i], elapsed[0],
+        elapsed[1]);
+    }
+  }
+}
+END_TEST
+
 Suite *tests_get_config_suite(void) {
   Suite *suite;
   TCase *testcase;
@@ -711,6 +927,8 @@ Suite *tests_get_config_suite(void) {
   tcase_add_test(testcase, config_get_param_ptr_test);
   tcase_add_test(testcase, config_set_get_id_test);
   tcase_add_test(testcase, config_merge_down_test);
+  tcase_add_test(testcase, config_find_config_index_test);
+  tcase_add_test(testcase, config_find_config_index_bench_test);
 
   suite_add_tcase(suite, testcase);
   return suite;
@@ -215,6 +215,38 @@ static int data_write_cb(pr_netio_stream_t *nstrm, char *buf, size_t buflen) {
   return buflen;
 }
 
+static int data_use_writev = FALSE;
+static int data_writev_eagain = FALSE;
+static unsigned int data_nwritevs = 0;
+static char data_writev_buf[1024];
+static size_t data_writev_buflen = 0;
+
+static int data_writev_cb(pr_netio_stream_t *nstrm, const struct iovec *iov,
+    int iovcnt) {
+  register int i;
+  int total = 0;
+
+  if (data_writev_eagain) {
+    data_writev_eagain = FALSE;
+    errno = EAGAIN;
+    return -1;
+  }
+
+  data_nwritevs++;
+
+  for (i = 0; i < iovcnt; i++) {
+    if (data_writev_buflen + iov[i].iov_len < sizeof(data_writev_buf)) {
+      memcpy(data_writev_buf + data_writev_buflen, iov[i].iov_base,
+        iov[i].iov_len);
+      data_writev_buflen += iov[i].iov_len;
+    }
+
+    total += iov[i].iov_len;
+  }
+
+  return total;
+}
+
 static int data_open_streams(conn_t *conn, int strm_type) {
   int fd = 2, res;
   pr_netio_t *netio;
@@ -226,6 +258,10 @@ static int data_open_streams(conn_t *conn, int strm_type) {
   netio->read = data_read_cb;
   netio->write = data_write_cb;
 
+  if (data_use_writev) {
+    netio->writev = data_writev_cb;
+  }
+
   res = pr_register_netio(netio, strm_type);
   if (res < 0) {
     return -1;
@@ -328,6 +364,103 @@ START_TEST (data_sendfile_test) {
 }
 END_TEST
 
+START_TEST (data_splice_test) {
+  int fd = -1, res, sockfds[2];
+  char buf[64];
+  const char *text;
+
+  res = pr_data_splice(fd, 0);
+  fail_unless(res < 0, "Failed to handle invalid arguments");
+  fail_unless(errno == EINVAL || errno == ENOSYS,
+    "Expected EINVAL (%d), got %s (%d)", EINVAL, strerror(errno), errno);
+  if (errno == ENOSYS) {
+    return;
+  }
+
+  fd = open(data_test_path, O_CREAT|O_EXCL|O_RDWR, 0600);
+  fail_unless(fd >= 0, "Failed to open '%s': %s", data_test_path,
+    strerror(errno));
+
+  session.xfer.direction = PR_NETIO_IO_WR;
+  res = pr_data_splice(fd, 1);
+  fail_unless(res < 0, "Failed to handle invalid transfer direction");
+  fail_unless(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  session.xfer.direction = PR_NETIO_IO_RD;
+  res = pr_data_splice(fd, 1);
+  fail_unless(res < 0, "Failed to handle lack of data connection");
+  fail_unless(errno == ECONNABORTED, "Expected ECONNABORTED (%d), got %s (%d)",
+    ECONNABORTED, strerror(errno), errno);
+
+  /* A registered data NetIO needs to see the data. */
+  mark_point();
+  session.d = pr_inet_create_conn(p, -1, NULL, INPORT_ANY, FALSE);
+  fail_unless(session.d != NULL, "Failed to create conn: %s", strerror(errno));
+
+  res = data_open_streams(session.d, PR_NETIO_STRM_DATA);
+  fail_unless(res == 0, "Failed to open streams: %s", strerror(errno));
+
+  res = pr_data_splice(fd, 1);
+  fail_unless(res < 0, "Failed to handle registered data NetIO");
+  fail_unless(errno == ENOSYS, "Expected ENOSYS (%d), got %s (%d)", ENOSYS,
+    strerror(errno), errno);
+
+  /* Now splice some data from a socket into the file; the registered data
+   * NetIO is bypassed when the kernel is decrypting the stream (kTLS).
+   */
+  res = socketpair(AF_UNIX, SOCK_STREAM, 0, sockfds);
+  fail_unless(res == 0, "Failed to create socket pair: %s", strerror(errno));
+
+  session.xfer.p = make_sub_pool(p);
+  session.d->instrm = pr_netio_open(p, PR_NETIO_STRM_DATA, sockfds[0],
+    PR_NETIO_IO_RD);
+  fail_unless(session.d->instrm != NULL, "Failed to open stream: %s",
+    strerror(errno));
+
+  res = pr_table_add(session.d->instrm->notes, "mod_tls.ktls-recv", "true", 0);
+  fail_unless(res == 0, "Failed to add note: %s", strerror(errno));
+
+  text = "Hello, World!\n";
+  res = write(sockfds[1], text, strlen(text));
+  fail_unless(res == (int) strlen(text), "Failed to write to socket: %s",
+    strerror(errno));
+
+  session.xfer.total_bytes = 0;
+  mark_point();
+  res = pr_data_splice(fd, sizeof(buf));
+  fail_unless(res == (int) strlen(text), "Expected %lu, got %d (%s)",
+    (unsigned long) strlen(text), res, strerror(errno));
+  fail_unless(session.xfer.total_bytes == (off_t) strlen(text),
+    "Expected total bytes %lu, got %lu", (unsigned long) strlen(text),
+    (unsigned long) session.xfer.total_bytes);
+
+  memset(buf, '\0', sizeof(buf));
+  res = pread(fd, buf, sizeof(buf)-1, 0);
+  fail_unless(res == (int) strlen(text), "Expected %lu, got %d",
+    (unsigned long) strlen(text), res);
+  fail_unless(strcmp(buf, text) == 0, "Expected '%s', got '%s'", text, buf);
+
+  /* Once the peer closes the connection, there is no more data. */
+  (void) close(sockfds[1]);
+  res = pr_data_splice(fd, sizeof(buf));
+  fail_unless(res == 0, "Expected 0, got %d (%s)", res, strerror(errno));
+
+  (void) close(fd);
+  (void) pr_netio_close(session.d->instrm);
+  session.d->instrm = NULL;
+  (void) close(sockfds[0]);
+  (void) pr_netio_close(session.d->outstrm);
+  session.d->outstrm = NULL;
+  (void) pr_inet_close(p, session.d);
+  session.d = NULL;
+
+  pr_unregister_netio(PR_NETIO_STRM_DATA);
+  destroy_pool(session.xfer.p);
+  session.xfer.p = NULL;
+}
+END_TEST
+
 START_TEST (data_init_test) {
   int rd = PR_NETIO_IO_RD, wr = PR_NETIO_IO_WR;
   char *filename = NULL;
@@ -1066,6 +1199,93 @@ START_TEST (data_xfer_write_ascii_test) {
 }
 END_TEST
 
+START_TEST (data_xferv_test) {
+  int res;
+  struct iovec iov[2];
+  char *ascii_buf;
+  size_t buflen, ascii_buflen;
+
+  pr_data_clear_xfer_pool();
+  pr_data_reset();
+
+  res = pr_data_xferv(NULL, 0);
+  fail_unless(res < 0, "Failed to handle null arguments");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  iov[0].iov_base = "Hello,\n";
+  iov[0].iov_len = 0;
+  iov[1].iov_base = " World\n";
+  iov[1].iov_len = 0;
+
+  res = pr_data_xferv(iov, 2);
+  fail_unless(res < 0, "Failed to handle zero buffer length");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  iov[0].iov_len = strlen(iov[0].iov_base);
+  iov[1].iov_len = strlen(iov[1].iov_base);
+  buflen = iov[0].iov_len + iov[1].iov_len;
+
+  mark_point();
+  res = pr_data_xferv(iov, 2);
+  fail_unless(res < 0, "Transfered data unexpectedly");
+  fail_unless(errno == ECONNABORTED,
+    "Expected ECONNABORTED (%d), got %s (%d)", ECONNABORTED,
+    strerror(errno), errno);
+
+  session.d = pr_inet_create_conn(p, -1, NULL, INPORT_ANY, FALSE);
+  fail_unless(session.d != NULL, "Failed to create conn: %s", strerror(errno));
+
+  session.xfer.direction = PR_NETIO_IO_WR;
+  session.xfer.p = make_sub_pool(p);
+  session.xfer.buflen = 1024;
+  session.xfer.buf = pcalloc(p, session.xfer.buflen);
+
+  data_use_writev = TRUE;
+  res = data_open_streams(session.d, PR_NETIO_STRM_DATA);
+  data_use_writev = FALSE;
+  fail_unless(res == 0, "Failed to open streams on session.d: %s",
+    strerror(errno));
+
+  /* Binary data is written as the given vectors, in one call. */
+  mark_point();
+  data_nwritevs = 0;
+  data_writev_buflen = 0;
+  data_writev_eagain = TRUE;
+  res = pr_data_xferv(iov, 2);
+  fail_unless(res == (int) buflen, "Expected %lu, got %d",
+    (unsigned long) buflen, res);
+  fail_unless(data_nwritevs == 1, "Expected 1 writev, got %u", data_nwritevs);
+  fail_unless(data_writev_buflen == buflen, "Expected %lu bytes, got %lu",
+    (unsigned long) buflen, (unsigned long) data_writev_buflen);
+  fail_unless(strncmp(data_writev_buf, "Hello,\n World\n", buflen) == 0,
+    "Expected 'Hello,\n World\n', got '%.*s'", (int) data_writev_buflen,
+    data_writev_buf);
+
+  /* ASCII data is translated, one vector at a time. */
+  mark_point();
+  ascii_buf = " World\r\n";
+  ascii_buflen = strlen(ascii_buf);
+
+  data_nwritevs = 0;
+  pr_ascii_ftp_reset();
+  session.sf_flags |= SF_ASCII;
+  res = pr_data_xferv(iov, 2);
+  session.sf_flags &= ~SF_ASCII;
+
+  fail_unless(res == (int) buflen, "Expected %lu, got %d",
+    (unsigned long) buflen, res);
+  fail_unless(data_nwritevs == 0, "Expected no writevs, got %u",
+    data_nwritevs);
+  fail_unless(session.xfer.buflen == ascii_buflen,
+    "Expected session.xfer.buflen %lu, got %lu", (unsigned long) ascii_buflen,
+    (unsigned long) session.xfer.buflen);
+  fail_unless(strncmp(session.xfer.buf, ascii_buf, ascii_buflen) == 0,
+    "Expected '%s', got '%.100s'", ascii_buf, session.xfer.buf);
+}
+END_TEST
+
 Suite *tests_get_data_suite(void) {
   Suite *suite;
   TCase *testcase;
@@ -1079,6 +1299,7 @@ Suite *tests_get_data_suite(void) {
   tcase_add_test(testcase, data_set_timeout_test);
   tcase_add_test(testcase, data_ignore_ascii_test);
   tcase_add_test(testcase, data_sendfile_test);
+  tcase_add_test(testcase, data_splice_test);
 
   tcase_add_test(testcase, data_init_test);
   tcase_add_test(testcase, data_open_active_test);
@@ -1092,6 +1313,7 @@ Suite *tests_get_data_suite(void) {
   tcase_add_test(testcase, data_xfer_write_binary_test);
   tcase_add_test(testcase, data_xfer_read_ascii_test);
   tcase_add_test(testcase, data_xfer_write_ascii_test);
+  tcase_add_test(testcase, data_xferv_test);
 
   suite_add_tcase(suite, testcase);
   return suite;
@@ -235,6 +235,135 @@ START_TEST (event_generate_test) {
 }
 END_TEST
 
+START_TEST (event_get_id_test) {
+  int id, id2, res;
+  const char *event = "foo", *event2 = "bar";
+
+  id = pr_event_get_id(NULL);
+  fail_unless(id == -1, "Failed to handle null event");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  id = pr_event_get_id(event);
+  fail_unless(id > 0, "Failed to get ID for event '%s': %s", event,
+    strerror(errno));
+
+  res = pr_event_get_id(event);
+  fail_unless(res == id, "Expected ID %d for event '%s', got %d", id, event,
+    res);
+
+  id2 = pr_event_get_id(event2);
+  fail_unless(id2 > 0, "Failed to get ID for event '%s': %s", event2,
+    strerror(errno));
+  fail_unless(id2 != id, "Expected different IDs for '%s' and '%s', got %d",
+    event, event2, id);
+
+  /* Registering a handler does not change an event's ID. */
+  res = pr_event_register(NULL, event, event_cb, NULL);
+  fail_unless(res == 0, "Failed to register event: %s", strerror(errno));
+
+  res = pr_event_get_id(event);
+  fail_unless(res == id, "Expected ID %d for event '%s', got %d", id, event,
+    res);
+
+  (void) pr_event_unregister(NULL, NULL, NULL);
+}
+END_TEST
+
+START_TEST (event_listening_id_test) {
+  int id, res;
+  const char *event = "foo";
+
+  fail_unless(PR_EVENT_LISTENING(-1) == 0, "Expected no listeners for ID -1");
+  fail_unless(PR_EVENT_LISTENING(0) == 0, "Expected no listeners for ID 0");
+  fail_unless(PR_EVENT_LISTENING(INT_MAX) == 0,
+    "Expected no listeners for ID INT_MAX");
+
+  id = pr_event_get_id(event);
+  fail_unless(id > 0, "Failed to get ID for event '%s': %s", event,
+    strerror(errno));
+  fail_unless(PR_EVENT_LISTENING(id) == 0, "Expected no listeners for '%s'",
+    event);
+
+  res = pr_event_register(NULL, event, event_cb2, NULL);
+  fail_unless(res == 0, "Failed to register event '%s': %s", event,
+    strerror(errno));
+
+  res = pr_event_register(NULL, event, event_cb3, NULL);
+  fail_unless(res == 0, "Failed to register event '%s': %s", event,
+    strerror(errno));
+
+  fail_unless(PR_EVENT_LISTENING(id) == 2, "Expected 2 listeners, got %u",
+    PR_EVENT_LISTENING(id));
+
+  res = pr_event_unregister(NULL, event, event_cb2);
+  fail_unless(res == 0, "Failed to unregister event '%s': %s", event,
+    strerror(errno));
+
+  fail_unless(PR_EVENT_LISTENING(id) == 1, "Expected 1 listener, got %u",
+    PR_EVENT_LISTENING(id));
+
+  res = pr_event_unregister(NULL, NULL, NULL);
+  fail_unless(res == 0, "Failed to unregister events: %s", strerror(errno));
+
+  fail_unless(PR_EVENT_LISTENING(id) == 0, "Expected no listeners, got %u",
+    PR_EVENT_LISTENING(id));
+}
+END_TEST
+
+START_TEST (event_generate_id_test) {
+  register unsigned int i;
+  int id, res;
+  const char *event = "foo";
+  char name[32];
+
+  event_triggered = 0;
+
+  pr_event_generate_id(-1, NULL);
+  pr_event_generate_id(0, NULL);
+  fail_unless(event_triggered == 0, "Expected triggered count %u, got %u",
+    0, event_triggered);
+
+  id = pr_event_get_id(event);
+  fail_unless(id > 0, "Failed to get ID for event '%s': %s", event,
+    strerror(errno));
+
+  pr_event_generate_id(id, NULL);
+  fail_unless(event_triggered == 0, "Expected triggered count %u, got %u",
+    0, event_triggered);
+
+  res = pr_event_register(NULL, event, event_cb, NULL);
+  fail_unless(res == 0, "Failed to register event: %s", strerror(errno));
+
+  pr_event_generate_id(id, NULL);
+  fail_unless(event_triggered == 1, "Expected triggered count %u, got %u",
+    1, event_triggered);
+
+  /* Intern enough other events to grow the ID tables. */
+  for (i = 0; i < 500; i++) {
+    snprintf(name, sizeof(name), "event.%u", i);
+    res = pr_event_get_id(name);
+    fail_unless(res > 0, "Failed to get ID for event '%s': %s", name,
+      strerror(errno));
+  }
+
+  pr_event_generate_id(id, NULL);
+  fail_unless(event_triggered == 2, "Expected triggered count %u, got %u",
+    2, event_triggered);
+
+  pr_event_generate(event, NULL);
+  fail_unless(event_triggered == 3, "Expected triggered count %u, got %u",
+    3, event_triggered);
+
+  res = pr_event_unregister(NULL, NULL, NULL);
+  fail_unless(res == 0, "Failed to unregister events: %s", strerror(errno));
+
+  pr_event_generate_id(id, NULL);
+  fail_unless(event_triggered == 3, "Expected triggered count %u, got %u",
+    3, event_triggered);
+}
+END_TEST
+
 START_TEST (event_dump_test) {
   int res;
   const char *event = "foo";
@@ -287,6 +416,9 @@ Suite *tests_get_event_suite(void) {
   tcase_add_test(testcase, event_unregister_test);
   tcase_add_test(testcase, event_listening_test);
   tcase_add_test(testcase, event_generate_test);
+  tcase_add_test(testcase, event_get_id_test);
+  tcase_add_test(testcase, event_listening_id_test);
+  tcase_add_test(testcase, event_generate_id_test);
   tcase_add_test(testcase, event_dump_test);
 
   suite_add_tcase(suite, testcase);
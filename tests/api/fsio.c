@@ -3904,6 +3904,128 @@ START_TEST (fs_copy_file2_test) {
 }
 END_TEST
 
+static off_t copy_progress_bytes = 0;
+static void copy_progress_bytes_cb(int nwritten) {
+  copy_progress_bytes += nwritten;
+}
+
+static unsigned int copy_read_count = 0;
+static int copy_read_cb(pr_fh_t *fh, int fd, char *buf, size_t size) {
+  copy_read_count++;
+  return read(fd, buf, size);
+}
+
+static int copy_file_cmp(const char *path1, const char *path2) {
+  int fd1, fd2, res = 0;
+  char buf1[8192], buf2[8192];
+
+  fd1 = open(path1, O_RDONLY);
+  fd2 = open(path2, O_RDONLY);
+
+  while (TRUE) {
+    ssize_t len1, len2;
+
+    len1 = read(fd1, buf1, sizeof(buf1));
+    len2 = read(fd2, buf2, sizeof(buf2));
+    if (len1 != len2 ||
+        len1 < 0) {
+      res = -1;
+      break;
+    }
+
+    if (len1 == 0) {
+      break;
+    }
+
+    if (memcmp(buf1, buf2, len1) != 0) {
+      res = -1;
+      break;
+    }
+  }
+
+  (void) close(fd1);
+  (void) close(fd2);
+  return res;
+}
+
+START_TEST (fs_copy_file2_large_test) {
+  int fd, res, flags;
+  char *src_path, *dst_path, buf[4096];
+  off_t src_len = 0;
+  register unsigned int i;
+  pr_fs_t *fs;
+
+  src_path = (char *) fsio_copy_src_path;
+  dst_path = (char *) fsio_copy_dst_path;
+  flags = PR_FSIO_COPY_FILE_FL_NO_DELETE_ON_FAILURE;
+
+  (void) unlink(src_path);
+  (void) unlink(dst_path);
+
+  /* Large enough to need several calls to copy it, in whichever way the
+   * copy is done, and not a multiple of any block size.
+   */
+  fd = open(src_path, O_CREAT|O_EXCL|O_WRONLY, 0600);
+  fail_unless(fd >= 0, "Failed to open '%s': %s", src_path, strerror(errno));
+
+  for (i = 0; i < 2600; i++) {
+    register unsigned int j;
+
+    for (j = 0; j < sizeof(buf); j++) {
+      buf[j] = (char) ((i * 31) + (j * 7));
+    }
+
+    res = write(fd, buf, i == 0 ? 17 : sizeof(buf));
+    fail_unless(res > 0, "Failed to write to '%s': %s", src_path,
+      strerror(errno));
+    src_len += res;
+  }
+
+  (void) close(fd);
+
+  copy_progress_bytes = 0;
+
+  mark_point();
+  res = pr_fs_copy_file2(src_path, dst_path, flags, copy_progress_bytes_cb);
+  fail_unless(res == 0, "Failed to copy file: %s", strerror(errno));
+  fail_unless(copy_file_cmp(src_path, dst_path) == 0,
+    "Copy of '%s' differs from original", src_path);
+  fail_unless(copy_progress_bytes == src_len,
+    "Expected %lu bytes of progress, got %lu", (unsigned long) src_len,
+    (unsigned long) copy_progress_bytes);
+
+  /* Copying over an existing, larger file truncates it. */
+  res = truncate(src_path, 1024);
+  fail_unless(res == 0, "Failed to truncate '%s': %s", src_path,
+    strerror(errno));
+
+  mark_point();
+  res = pr_fs_copy_file2(src_path, dst_path, flags, NULL);
+  fail_unless(res == 0, "Failed to copy file: %s", strerror(errno));
+  fail_unless(copy_file_cmp(src_path, dst_path) == 0,
+    "Copy of '%s' differs from original", src_path);
+
+  /* An FS with its own read callback must see all of the data. */
+  fs = pr_register_fs(p, "testsuite", "/tmp/");
+  fail_unless(fs != NULL, "Failed to register FS: %s", strerror(errno));
+  fs->read = copy_read_cb;
+
+  copy_read_count = 0;
+  (void) unlink(dst_path);
+
+  mark_point();
+  res = pr_fs_copy_file2(src_path, dst_path, flags, NULL);
+  fail_unless(res == 0, "Failed to copy file: %s", strerror(errno));
+  fail_unless(copy_read_count > 0, "Custom FS read callback not used");
+  fail_unless(copy_file_cmp(src_path, dst_path) == 0,
+    "Copy of '%s' differs from original", src_path);
+
+  (void) pr_unregister_fs("/tmp/");
+  (void) unlink(src_path);
+  (void) unlink(dst_path);
+}
+END_TEST
+
 START_TEST (fs_interpolate_test) {
   int res;
   char buf[PR_TUNABLE_PATH_MAX], *path;
@@ -4403,6 +4525,32 @@ START_TEST (fs_close_extra_fds_test) {
 }
 END_TEST
 
+START_TEST (fs_close_extra_fds2_test) {
+  int keep_fd, close_fd, res;
+
+  keep_fd = dup(STDERR_FILENO);
+  fail_unless(keep_fd > STDERR_FILENO, "Failed to dup stderr: %s",
+    strerror(errno));
+
+  close_fd = fcntl(STDERR_FILENO, F_DUPFD, keep_fd + 1);
+  fail_unless(close_fd > keep_fd, "Failed to dup stderr: %s",
+    strerror(errno));
+
+  pr_fs_close_extra_fds2(keep_fd + 1);
+
+  res = fcntl(keep_fd, F_GETFD);
+  fail_unless(res >= 0, "Expected fd %d to remain open, got %s (%d)",
+    keep_fd, strerror(errno), errno);
+
+  res = fcntl(close_fd, F_GETFD);
+  fail_unless(res < 0, "Expected fd %d to be closed", close_fd);
+  fail_unless(errno == EBADF, "Expected EBADF (%d), got %s (%d)", EBADF,
+    strerror(errno), errno);
+
+  (void) close(keep_fd);
+}
+END_TEST
+
 START_TEST (fs_get_usable_fd_test) {
   int fd, res;
 
@@ -4547,6 +4695,110 @@ START_TEST (fs_fadvise_test) {
 }
 END_TEST
 
+START_TEST (fsio_readahead_test) {
+  int res;
+  pr_fh_t *fh;
+  off_t offset;
+
+  mark_point();
+  res = pr_fsio_set_readahead(NULL, 0, 0, 0);
+  fail_unless(res < 0, "Failed to handle null handle");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  fh = pr_fsio_open(fsio_test_path, O_CREAT|O_EXCL|O_WRONLY);
+  fail_unless(fh != NULL, "Failed to open '%s': %s", fsio_test_path,
+    strerror(errno));
+
+  mark_point();
+  res = pr_fsio_set_readahead(fh, -1, 0, 0);
+  fail_unless(res < 0, "Failed to handle negative window");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  mark_point();
+  res = pr_fsio_set_readahead(fh, 8192, 4096, 0);
+  fail_unless(res < 0, "Failed to handle max window smaller than min");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  /* Without read-ahead enabled, this does nothing. */
+  mark_point();
+  pr_fsio_readahead(NULL, 0, 1);
+  pr_fsio_readahead(fh, 0, 1);
+  fail_unless(fh->fh_readahead == NULL, "Expected no read-ahead state");
+
+  res = pr_fsio_set_readahead(fh, 4096, 65536,
+    PR_FSIO_READAHEAD_FL_DROP_BEHIND);
+  fail_unless(res == 0, "Failed to enable read-ahead: %s", strerror(errno));
+  fail_unless(fh->fh_readahead != NULL, "Expected read-ahead state");
+
+  /* We make these calls to exercise the sequential, and non-sequential, code
+   * paths, even though there's no good way to verify the advice given.
+   */
+  mark_point();
+  for (offset = 0; offset < 1024 * 1024; offset += 8192) {
+    pr_fsio_readahead(fh, offset, 8192);
+  }
+
+  mark_point();
+  pr_fsio_readahead(fh, 0, 8192);
+  pr_fsio_readahead(fh, 8192, 8192);
+  pr_fsio_readahead(fh, -1, 8192);
+  pr_fsio_readahead(fh, 16384, 0);
+
+  res = pr_fsio_set_readahead(fh, 0, 0, 0);
+  fail_unless(res == 0, "Failed to disable read-ahead: %s", strerror(errno));
+  fail_unless(fh->fh_readahead == NULL, "Expected no read-ahead state");
+
+  (void) pr_fsio_close(fh);
+  (void) pr_fsio_unlink(fsio_test_path);
+}
+END_TEST
+
+START_TEST (fs_set_direct_io_test) {
+  int fd, res;
+
+  mark_point();
+  res = pr_fs_set_direct_io(-1, TRUE);
+  fail_unless(res < 0, "Failed to handle invalid fd");
+#if defined(O_DIRECT)
+  fail_unless(errno == EBADF, "Expected EBADF (%d), got %s (%d)", EBADF,
+    strerror(errno), errno);
+#else
+  fail_unless(errno == ENOSYS, "Expected ENOSYS (%d), got %s (%d)", ENOSYS,
+    strerror(errno), errno);
+#endif /* O_DIRECT */
+
+  fd = open(fsio_test_path, O_CREAT|O_EXCL|O_RDWR, 0600);
+  fail_unless(fd >= 0, "Failed to open '%s': %s", fsio_test_path,
+    strerror(errno));
+
+  /* Not all filesystems (e.g. tmpfs) support direct I/O. */
+  mark_point();
+  res = pr_fs_set_direct_io(fd, TRUE);
+  if (res == 0) {
+#if defined(O_DIRECT)
+    fail_unless(fcntl(fd, F_GETFL) & O_DIRECT, "Expected O_DIRECT set");
+#endif /* O_DIRECT */
+
+    res = pr_fs_set_direct_io(fd, FALSE);
+    fail_unless(res == 0, "Failed to clear direct I/O: %s", strerror(errno));
+#if defined(O_DIRECT)
+    fail_unless(!(fcntl(fd, F_GETFL) & O_DIRECT), "Expected O_DIRECT clear");
+#endif /* O_DIRECT */
+
+  } else {
+    fail_unless(errno == EINVAL || errno == ENOSYS,
+      "Expected EINVAL (%d) or ENOSYS (%d), got %s (%d)", EINVAL, ENOSYS,
+      strerror(errno), errno);
+  }
+
+  (void) close(fd);
+  (void) unlink(fsio_test_path);
+}
+END_TEST
+
 START_TEST (fs_have_access_test) {
   int res;
   struct stat st;
@@ -5144,6 +5396,7 @@ Suite *tests_get_fsio_suite(void) {
   tcase_add_test(testcase, fs_glob_test);
   tcase_add_test(testcase, fs_copy_file_test);
   tcase_add_test(testcase, fs_copy_file2_test);
+  tcase_add_test(testcase, fs_copy_file2_large_test);
   tcase_add_test(testcase, fs_interpolate_test);
   tcase_add_test(testcase, fs_resolve_partial_test);
   tcase_add_test(testcase, fs_resolve_path_test);
@@ -5154,12 +5407,15 @@ Suite *tests_get_fsio_suite(void) {
   tcase_add_test(testcase, fs_join_path_test);
   tcase_add_test(testcase, fs_virtual_path_test);
   tcase_add_test(testcase, fs_close_extra_fds_test);
+  tcase_add_test(testcase, fs_close_extra_fds2_test);
   tcase_add_test(testcase, fs_get_usable_fd_test);
   tcase_add_test(testcase, fs_get_usable_fd2_test);
   tcase_add_test(testcase, fs_getsize_test);
   tcase_add_test(testcase, fs_getsize2_test);
   tcase_add_test(testcase, fs_fgetsize_test);
   tcase_add_test(testcase, fs_fadvise_test);
+  tcase_add_test(testcase, fsio_readahead_test);
+  tcase_add_test(testcase, fs_set_direct_io_test);
   tcase_add_test(testcase, fs_have_access_test);
   tcase_add_test(testcase, fs_is_nfs_test);
   tcase_add_test(testcase, fs_valid_path_test);
@@ -26,6 +26,8 @@
 
 #include "tests.h"
 
+extern unsigned char is_master;
+
 static pool *p = NULL;
 
 static void set_up(void) {
@@ -132,6 +134,47 @@ START_TEST (inet_create_conn_portrange_test) {
 }
 END_TEST
 
+START_TEST (inet_set_reuse_port_test) {
+#ifdef SO_REUSEPORT
+  int res;
+  conn_t *conn, *conn2;
+
+  /* Only the daemon process is affected by this setting. */
+  is_master = TRUE;
+
+  res = pr_inet_set_reuse_port(TRUE);
+  fail_unless(res == FALSE, "Expected previous setting FALSE, got %d", res);
+
+  conn = pr_inet_create_conn(p, -1, NULL, INPORT_ANY, FALSE);
+  fail_unless(conn != NULL, "Failed to create conn: %s", strerror(errno));
+
+  res = pr_inet_listen(p, conn, 5, 0);
+  fail_unless(res == 0, "Failed to listen on conn: %s", strerror(errno));
+
+  /* Another socket, for the same port, as used by listener shards. */
+  conn2 = pr_inet_create_conn(p, -1, NULL, conn->local_port, FALSE);
+  fail_unless(conn2 != NULL, "Failed to create conn for port %d: %s",
+    conn->local_port, strerror(errno));
+
+  res = pr_inet_listen(p, conn2, 5, 0);
+  fail_unless(res == 0, "Failed to listen on conn: %s", strerror(errno));
+  pr_inet_close(p, conn2);
+
+  res = pr_inet_set_reuse_port(FALSE);
+  fail_unless(res == TRUE, "Expected previous setting TRUE, got %d", res);
+
+  conn2 = pr_inet_create_conn(p, -1, NULL, conn->local_port, FALSE);
+  fail_unless(conn2 == NULL, "Created conn for port %d unexpectedly",
+    conn->local_port);
+  fail_unless(errno == EADDRINUSE, "Expected EADDRINUSE (%d), got %s (%d)",
+    EADDRINUSE, strerror(errno), errno);
+
+  pr_inet_close(p, conn);
+  is_master = FALSE;
+#endif /* SO_REUSEPORT */
+}
+END_TEST
+
 START_TEST (inet_copy_conn_test) {
   int fd = -1, sockfd = -1, port = INPORT_ANY;
   conn_t *conn, *conn2;
@@ -707,6 +750,78 @@ START_TEST (inet_accept_nowait_test) {
 }
 END_TEST
 
+START_TEST (inet_accept_batch_test) {
+  int fds[4], flags, sockfd = -1, port = INPORT_ANY, res;
+  register unsigned int i;
+  conn_t *conn;
+  struct sockaddr_in sin;
+  socklen_t sinlen;
+  int clients[3] = { -1, -1, -1 };
+
+  res = pr_inet_accept_batch(NULL, NULL, NULL, 0);
+  fail_unless(res < 0, "Failed to handle null arguments");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  conn = pr_inet_create_conn(p, sockfd, NULL, port, FALSE);
+  fail_unless(conn != NULL, "Failed to create conn: %s", strerror(errno));
+
+  res = pr_inet_accept_batch(p, conn, fds, 4);
+  fail_unless(res < 0, "Accepted connection unexpectedly");
+  fail_unless(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  res = pr_inet_listen(p, conn, 5, 0);
+  fail_unless(res == 0, "Failed to listen on conn: %s", strerror(errno));
+
+  res = pr_inet_set_nonblock(p, conn);
+  fail_unless(res == 0, "Failed to make conn nonblocking: %s",
+    strerror(errno));
+
+  /* No pending connections yet. */
+  res = pr_inet_accept_batch(p, conn, fds, 4);
+  fail_unless(res == 0, "Expected 0, got %d (%s)", res, strerror(errno));
+
+  memset(&sin, 0, sizeof(sin));
+  sinlen = sizeof(sin);
+  res = getsockname(conn->listen_fd, (struct sockaddr *) &sin, &sinlen);
+  fail_unless(res == 0, "Failed to get listening address: %s",
+    strerror(errno));
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  for (i = 0; i < 3; i++) {
+    clients[i] = socket(AF_INET, SOCK_STREAM, 0);
+    fail_unless(clients[i] >= 0, "Failed to create socket: %s",
+      strerror(errno));
+
+    res = connect(clients[i], (struct sockaddr *) &sin, sizeof(sin));
+    fail_unless(res == 0, "Failed to connect: %s", strerror(errno));
+  }
+
+  /* Only accept as many as requested... */
+  res = pr_inet_accept_batch(p, conn, fds, 2);
+  fail_unless(res == 2, "Expected 2, got %d (%s)", res, strerror(errno));
+
+  /* ...then the rest. */
+  res = pr_inet_accept_batch(p, conn, &(fds[2]), 2);
+  fail_unless(res == 1, "Expected 1, got %d (%s)", res, strerror(errno));
+
+  for (i = 0; i < 3; i++) {
+    /* Accepted sockets should be in blocking mode. */
+    flags = fcntl(fds[i], F_GETFL);
+    fail_unless(flags >= 0, "Failed to get flags for fd %d: %s", fds[i],
+      strerror(errno));
+    fail_unless(!(flags & O_NONBLOCK), "Expected fd %d to be blocking",
+      fds[i]);
+
+    (void) close(fds[i]);
+    (void) close(clients[i]);
+  }
+
+  pr_inet_close(p, conn);
+}
+END_TEST
+
 START_TEST (inet_conn_info_test) {
   int sockfd = -1, port = INPORT_ANY, res;
   conn_t *conn;
@@ -787,6 +902,65 @@ START_TEST (inet_generate_socket_event_test) {
 }
 END_TEST
 
+START_TEST (inet_send_recv_fd_test) {
+  int fd = -1, res, sockfds[2];
+  char buf[8];
+  struct stat fst, rst;
+
+  res = pr_inet_send_fd(-1, -1, NULL, 0);
+  fail_unless(res < 0, "Failed to handle invalid socket");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_inet_recv_fd(-1, NULL, NULL, 0);
+  fail_unless(res < 0, "Failed to handle invalid socket");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = socketpair(AF_UNIX, SOCK_STREAM, 0, sockfds);
+  fail_unless(res == 0, "Failed to create socket pair: %s", strerror(errno));
+
+  res = pr_inet_send_fd(sockfds[0], -1, NULL, 0);
+  fail_unless(res < 0, "Failed to handle invalid descriptor");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_inet_recv_fd(sockfds[1], NULL, NULL, 0);
+  fail_unless(res < 0, "Failed to handle null descriptor");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_inet_send_fd(sockfds[0], STDERR_FILENO, "foo", 4);
+  fail_unless(res == 0, "Failed to send descriptor: %s", strerror(errno));
+
+  memset(buf, '\0', sizeof(buf));
+  res = pr_inet_recv_fd(sockfds[1], &fd, buf, sizeof(buf));
+  fail_unless(res == 4, "Expected 4, got %d (%s)", res, strerror(errno));
+  fail_unless(fd >= 0, "Failed to receive descriptor");
+  fail_unless(fd != STDERR_FILENO, "Expected new descriptor, got %d", fd);
+  fail_unless(strcmp(buf, "foo") == 0, "Expected 'foo', got '%s'", buf);
+
+  /* The received descriptor should refer to the same open file. */
+  fail_unless(fstat(STDERR_FILENO, &fst) == 0, "Failed to stat stderr: %s",
+    strerror(errno));
+  fail_unless(fstat(fd, &rst) == 0, "Failed to stat fd %d: %s", fd,
+    strerror(errno));
+  fail_unless(fst.st_dev == rst.st_dev && fst.st_ino == rst.st_ino,
+    "Received descriptor does not match sent descriptor");
+  (void) close(fd);
+
+  /* Once the sender closes its end, the receiver should see EOF, and no
+   * descriptor.
+   */
+  (void) close(sockfds[0]);
+  res = pr_inet_recv_fd(sockfds[1], &fd, buf, sizeof(buf));
+  fail_unless(res == 0, "Expected EOF, got %d (%s)", res, strerror(errno));
+  fail_unless(fd == -1, "Expected no descriptor, got %d", fd);
+
+  (void) close(sockfds[1]);
+}
+END_TEST
+
 Suite *tests_get_inet_suite(void) {
   Suite *suite;
   TCase *testcase;
@@ -799,6 +973,7 @@ Suite *tests_get_inet_suite(void) {
   tcase_add_test(testcase, inet_family_test);
   tcase_add_test(testcase, inet_create_conn_test);
   tcase_add_test(testcase, inet_create_conn_portrange_test);
+  tcase_add_test(testcase, inet_set_reuse_port_test);
   tcase_add_test(testcase, inet_copy_conn_test);
   tcase_add_test(testcase, inet_set_async_test);
   tcase_add_test(testcase, inet_set_block_test);
@@ -813,9 +988,11 @@ Suite *tests_get_inet_suite(void) {
   tcase_add_test(testcase, inet_connect_nowait_test);
   tcase_add_test(testcase, inet_accept_test);
   tcase_add_test(testcase, inet_accept_nowait_test);
+  tcase_add_test(testcase, inet_accept_batch_test);
   tcase_add_test(testcase, inet_conn_info_test);
   tcase_add_test(testcase, inet_openrw_test);
   tcase_add_test(testcase, inet_generate_socket_event_test);
+  tcase_add_test(testcase, inet_send_recv_fd_test);
 
   suite_add_tcase(suite, testcase);
   return suite;
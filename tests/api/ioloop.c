@@ -0,0 +1,345 @@
+/*
+ * ProFTPD - FTP server testsuite
+ * Copyright (c) 2026 The ProFTPD Project team
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA.
+ *
+ * As a special exemption, The ProFTPD Project team and other respective
+ * copyright holders give permission to link this program with OpenSSL, and
+ * distribute the resulting executable, without including the source code for
+ * OpenSSL in the source distribution.
+ */
+
+/* I/O loop API tests. */
+
+#include "tests.h"
+
+static pool *p = NULL;
+
+static void set_up(void) {
+  if (p == NULL) {
+    p = permanent_pool = make_sub_pool(NULL);
+  }
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    pr_trace_set_levels("ioloop", 1, 20);
+  }
+}
+
+static void tear_down(void) {
+  pr_ioloop_close();
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    pr_trace_set_levels("ioloop", 0, 0);
+  }
+
+  if (p) {
+    destroy_pool(p);
+    p = permanent_pool = NULL;
+  }
+}
+
+/* Tests */
+
+START_TEST (ioloop_open_close_test) {
+  int res;
+
+  res = pr_ioloop_add_fd(0, PR_IOLOOP_TYPE_CHILD, NULL);
+  fail_unless(res < 0, "Failed to handle unopened loop");
+  fail_unless(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  res = pr_ioloop_open();
+  fail_unless(res == 0, "Failed to open loop: %s", strerror(errno));
+
+  /* Opening an already-open loop is a no-op. */
+  res = pr_ioloop_open();
+  fail_unless(res == 0, "Failed to reopen loop: %s", strerror(errno));
+
+  fail_unless(pr_ioloop_get_backend() != NULL, "Expected backend name");
+  fail_unless(pr_ioloop_get_count() == 0, "Expected no fds, got %u",
+    pr_ioloop_get_count());
+
+  pr_ioloop_close();
+  pr_ioloop_close();
+}
+END_TEST
+
+START_TEST (ioloop_add_remove_fd_test) {
+  int res, fds[2];
+
+  res = pr_ioloop_open();
+  fail_unless(res == 0, "Failed to open loop: %s", strerror(errno));
+
+  res = pr_ioloop_add_fd(-1, PR_IOLOOP_TYPE_CHILD, NULL);
+  fail_unless(res < 0, "Failed to handle invalid fd");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_ioloop_remove_fd(-1);
+  fail_unless(res < 0, "Failed to handle invalid fd");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pipe(fds);
+  fail_unless(res == 0, "Failed to create pipe: %s", strerror(errno));
+
+  res = pr_ioloop_remove_fd(fds[0]);
+  fail_unless(res < 0, "Failed to handle unwatched fd");
+  fail_unless(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  res = pr_ioloop_add_fd(fds[0], PR_IOLOOP_TYPE_CHILD, NULL);
+  fail_unless(res == 0, "Failed to watch fd %d: %s", fds[0], strerror(errno));
+  fail_unless(pr_ioloop_get_count() == 1, "Expected 1 fd, got %u",
+    pr_ioloop_get_count());
+
+  res = pr_ioloop_add_fd(fds[0], PR_IOLOOP_TYPE_CHILD, NULL);
+  fail_unless(res < 0, "Failed to handle already-watched fd");
+  fail_unless(errno == EEXIST, "Expected EEXIST (%d), got %s (%d)", EEXIST,
+    strerror(errno), errno);
+
+  res = pr_ioloop_remove_fd(fds[0]);
+  fail_unless(res == 0, "Failed to unwatch fd %d: %s", fds[0],
+    strerror(errno));
+  fail_unless(pr_ioloop_get_count() == 0, "Expected no fds, got %u",
+    pr_ioloop_get_count());
+
+  (void) close(fds[0]);
+  (void) close(fds[1]);
+}
+END_TEST
+
+START_TEST (ioloop_wait_test) {
+  int res, fds[2], other_fds[2];
+  pr_ioloop_event_t events[4];
+
+  res = pr_ioloop_wait(NULL, 0, 0);
+  fail_unless(res < 0, "Failed to handle null events");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_ioloop_wait(events, 4, 0);
+  fail_unless(res < 0, "Failed to handle unopened loop");
+  fail_unless(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  res = pr_ioloop_open();
+  fail_unless(res == 0, "Failed to open loop: %s", strerror(errno));
+
+  res = pipe(fds);
+  fail_unless(res == 0, "Failed to create pipe: %s", strerror(errno));
+
+  res = pipe(other_fds);
+  fail_unless(res == 0, "Failed to create pipe: %s", strerror(errno));
+
+  res = pr_ioloop_add_fd(fds[0], PR_IOLOOP_TYPE_CHILD, fds);
+  fail_unless(res == 0, "Failed to watch fd %d: %s", fds[0], strerror(errno));
+
+  res = pr_ioloop_add_fd(other_fds[0], PR_IOLOOP_TYPE_LISTENER, other_fds);
+  fail_unless(res == 0, "Failed to watch fd %d: %s", other_fds[0],
+    strerror(errno));
+
+  /* Nothing is ready yet. */
+  res = pr_ioloop_wait(events, 4, 0);
+  fail_unless(res == 0, "Expected no events, got %d", res);
+
+  /* Closing the write end of a pipe makes the read end ready (EOF). */
+  (void) close(fds[1]);
+
+  res = pr_ioloop_wait(events, 4, 1000);
+  fail_unless(res == 1, "Expected 1 event, got %d (%s)", res, strerror(errno));
+  fail_unless(events[0].fd == fds[0], "Expected fd %d, got %d", fds[0],
+    events[0].fd);
+  fail_unless(events[0].type == PR_IOLOOP_TYPE_CHILD,
+    "Expected type %d, got %d", PR_IOLOOP_TYPE_CHILD, events[0].type);
+  fail_unless(events[0].data == fds, "Expected data %p, got %p", fds,
+    events[0].data);
+
+  res = pr_ioloop_remove_fd(fds[0]);
+  fail_unless(res == 0, "Failed to unwatch fd %d: %s", fds[0],
+    strerror(errno));
+  (void) close(fds[0]);
+
+  res = write(other_fds[1], "a", 1);
+  fail_unless(res == 1, "Failed to write to pipe: %s", strerror(errno));
+
+  res = pr_ioloop_wait(events, 4, 1000);
+  fail_unless(res == 1, "Expected 1 event, got %d (%s)", res, strerror(errno));
+  fail_unless(events[0].fd == other_fds[0], "Expected fd %d, got %d",
+    other_fds[0], events[0].fd);
+  fail_unless(events[0].type == PR_IOLOOP_TYPE_LISTENER,
+    "Expected type %d, got %d", PR_IOLOOP_TYPE_LISTENER, events[0].type);
+
+  (void) pr_ioloop_remove_fd(other_fds[0]);
+  (void) close(other_fds[0]);
+  (void) close(other_fds[1]);
+}
+END_TEST
+
+START_TEST (ioloop_open_fallback_test) {
+  register unsigned int i;
+  int res, fds[2], nevents, *dups;
+  unsigned int ndups = 0;
+  struct rlimit rlim, orig_rlim;
+  pr_ioloop_event_t events[4];
+
+  /* Use up every descriptor, so that no epoll instance can be created. */
+  res = getrlimit(RLIMIT_NOFILE, &orig_rlim);
+  fail_unless(res == 0, "Failed to get RLIMIT_NOFILE: %s", strerror(errno));
+
+  rlim = orig_rlim;
+  if (rlim.rlim_cur > 256) {
+    rlim.rlim_cur = 256;
+  }
+  res = setrlimit(RLIMIT_NOFILE, &rlim);
+  fail_unless(res == 0, "Failed to set RLIMIT_NOFILE: %s", strerror(errno));
+
+  dups = pcalloc(p, rlim.rlim_cur * sizeof(int));
+  while (ndups < rlim.rlim_cur) {
+    int fd;
+
+    fd = dup(0);
+    if (fd < 0) {
+      break;
+    }
+
+    dups[ndups++] = fd;
+  }
+
+  res = pr_ioloop_open();
+  fail_unless(res == 0, "Failed to open loop: %s", strerror(errno));
+  fail_unless(strcmp(pr_ioloop_get_backend(), "epoll") != 0,
+    "Expected poll or select backend, got %s", pr_ioloop_get_backend());
+
+  for (i = 0; i < ndups; i++) {
+    (void) close(dups[i]);
+  }
+  (void) setrlimit(RLIMIT_NOFILE, &orig_rlim);
+
+  /* The fallback backend must work as usual. */
+  res = pipe(fds);
+  fail_unless(res == 0, "Failed to create pipe: %s", strerror(errno));
+
+  res = pr_ioloop_add_fd(fds[0], PR_IOLOOP_TYPE_CHILD, NULL);
+  fail_unless(res == 0, "Failed to watch fd %d: %s", fds[0], strerror(errno));
+
+  (void) close(fds[1]);
+
+  nevents = pr_ioloop_wait(events, 4, 1000);
+  fail_unless(nevents == 1, "Expected 1 event, got %d (%s)", nevents,
+    strerror(errno));
+  fail_unless(events[0].fd == fds[0], "Expected fd %d, got %d", fds[0],
+    events[0].fd);
+
+  res = pr_ioloop_remove_fd(fds[0]);
+  fail_unless(res == 0, "Failed to unwatch fd %d: %s", fds[0],
+    strerror(errno));
+  (void) close(fds[0]);
+}
+END_TEST
+
+START_TEST (ioloop_wait_many_test) {
+  register unsigned int i;
+  int res, nevents, *fds;
+  unsigned int nfds = 2048, nready = 0;
+  struct rlimit rlim;
+  pr_ioloop_event_t events[16];
+
+  /* Use more descriptors than select(2) could handle, if we may. */
+  if (getrlimit(RLIMIT_NOFILE, &rlim) == 0 &&
+      rlim.rlim_cur < (nfds * 2) + 32) {
+    rlim.rlim_cur = rlim.rlim_max;
+    (void) setrlimit(RLIMIT_NOFILE, &rlim);
+
+    if (rlim.rlim_cur < (nfds * 2) + 32) {
+      nfds = (rlim.rlim_cur - 32) / 2;
+    }
+  }
+
+  if (strcmp(pr_ioloop_get_backend(), "select") == 0 &&
+      nfds > (FD_SETSIZE / 2) - 16) {
+    nfds = (FD_SETSIZE / 2) - 16;
+  }
+
+  res = pr_ioloop_open();
+  fail_unless(res == 0, "Failed to open loop: %s", strerror(errno));
+
+  fds = pcalloc(p, nfds * 2 * sizeof(int));
+  for (i = 0; i < nfds; i++) {
+    res = pipe(&(fds[i * 2]));
+    fail_unless(res == 0, "Failed to create pipe #%u: %s", i,
+      strerror(errno));
+
+    res = pr_ioloop_add_fd(fds[i * 2], PR_IOLOOP_TYPE_CHILD, NULL);
+    fail_unless(res == 0, "Failed to watch fd %d: %s", fds[i * 2],
+      strerror(errno));
+  }
+
+  fail_unless(pr_ioloop_get_count() == nfds, "Expected %u fds, got %u", nfds,
+    pr_ioloop_get_count());
+
+  /* Make only the last pipe ready. */
+  (void) close(fds[(nfds * 2) - 1]);
+
+  nevents = pr_ioloop_wait(events, 16, 1000);
+  fail_unless(nevents == 1, "Expected 1 event, got %d (%s)", nevents,
+    strerror(errno));
+  fail_unless(events[0].fd == fds[(nfds - 1) * 2], "Expected fd %d, got %d",
+    fds[(nfds - 1) * 2], events[0].fd);
+
+  /* Now make every pipe ready; each should be reported, in batches. */
+  for (i = 0; i < nfds - 1; i++) {
+    (void) close(fds[(i * 2) + 1]);
+  }
+
+  while (pr_ioloop_get_count() > 0) {
+    register int j;
+
+    nevents = pr_ioloop_wait(events, 16, 1000);
+    fail_unless(nevents > 0, "Expected events, got %d (%s)", nevents,
+      strerror(errno));
+
+    for (j = 0; j < nevents; j++) {
+      res = pr_ioloop_remove_fd(events[j].fd);
+      fail_unless(res == 0, "Failed to unwatch fd %d: %s", events[j].fd,
+        strerror(errno));
+      (void) close(events[j].fd);
+      nready++;
+    }
+  }
+
+  fail_unless(nready == nfds, "Expected %u ready fds, got %u", nfds, nready);
+}
+END_TEST
+
+Suite *tests_get_ioloop_suite(void) {
+  Suite *suite;
+  TCase *testcase;
+
+  suite = suite_create("ioloop");
+
+  testcase = tcase_create("base");
+  tcase_add_checked_fixture(testcase, set_up, tear_down);
+
+  tcase_add_test(testcase, ioloop_open_close_test);
+  tcase_add_test(testcase, ioloop_add_remove_fd_test);
+  tcase_add_test(testcase, ioloop_wait_test);
+  tcase_add_test(testcase, ioloop_open_fallback_test);
+  tcase_add_test(testcase, ioloop_wait_many_test);
+
+  suite_add_tcase(suite, testcase);
+  return suite;
+}
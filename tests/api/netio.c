@@ -1314,6 +1314,437 @@ START_TEST (netio_telnet_gets2_single_line_lf_test) {
 }
 END_TEST
 
+START_TEST (netio_telnet_pending_test) {
+  int res;
+  char buf[256], *cmd;
+  size_t cmd_len;
+  pr_netio_stream_t *in, *out;
+  pr_buffer_t *pbuf;
+
+  res = pr_netio_telnet_pending(NULL);
+  fail_unless(res < 0, "Failed to handle null stream");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  in = pr_netio_open(p, PR_NETIO_STRM_CTRL, -1, PR_NETIO_IO_RD);
+  out = pr_netio_open(p, PR_NETIO_STRM_CTRL, -1, PR_NETIO_IO_WR);
+
+  res = pr_netio_telnet_pending(in);
+  fail_unless(res == FALSE, "Expected FALSE for unbuffered stream, got %d",
+    res);
+
+  /* Only a CRLF terminates a line; the last line here is incomplete. */
+  cmd = "TYPE I\r\nSIZE a\nb\r\nMDTM c";
+  cmd_len = strlen(cmd);
+
+  pr_netio_buffer_alloc(in);
+  pbuf = in->strm_buf;
+  memcpy(pbuf->buf, cmd, cmd_len);
+  pbuf->remaining = pbuf->buflen - cmd_len;
+  pbuf->current = pbuf->buf;
+
+  res = pr_netio_telnet_pending(in);
+  fail_unless(res == TRUE, "Expected TRUE, got %d", res);
+
+  res = pr_netio_telnet_gets2(buf, sizeof(buf)-1, in, out);
+  fail_unless(res > 0, "Failed to get string from stream: %s",
+    strerror(errno));
+
+  res = pr_netio_telnet_pending(in);
+  fail_unless(res == TRUE, "Expected TRUE, got %d", res);
+
+  res = pr_netio_telnet_gets2(buf, sizeof(buf)-1, in, out);
+  fail_unless(res > 0, "Failed to get string from stream: %s",
+    strerror(errno));
+  fail_unless(strcmp(buf, "SIZE a\nb\n") == 0,
+    "Expected 'SIZE a\\nb\\n', got '%s'", buf);
+
+  res = pr_netio_telnet_pending(in);
+  fail_unless(res == FALSE, "Expected FALSE for incomplete line, got %d",
+    res);
+
+  /* A CR which has already been read does not complete a line with an LF
+   * which has not.
+   */
+  cmd = "NOOP\r\nQUIT";
+  cmd_len = strlen(cmd);
+
+  memcpy(pbuf->buf, cmd, cmd_len);
+  pbuf->current = pbuf->buf + 5;
+  pbuf->remaining = pbuf->buflen - (cmd_len - 5);
+
+  res = pr_netio_telnet_pending(in);
+  fail_unless(res == FALSE, "Expected FALSE for LF after consumed CR, got %d",
+    res);
+
+  pr_netio_close(in);
+  pr_netio_close(out);
+}
+END_TEST
+
+/* The byte-at-a-time handling of pr_netio_telnet_gets2(), from before runs
+ * of plain bytes were copied in bulk, for checking that both produce the
+ * same results.  The input is a single buffer, as read from the client.
+ */
+struct telnet_ref {
+  const unsigned char *data;
+  size_t datalen, pos;
+  int handle_iac, mode, terminated;
+  unsigned char *out;
+  size_t outlen;
+};
+
+static int telnet_ref_gets(struct telnet_ref *ref, char *buf, size_t bufsz) {
+  char *bp = buf;
+  size_t buflen = bufsz;
+  int saw_newline = FALSE;
+
+  buflen--;
+
+  while (buflen > 0) {
+    size_t toread;
+
+    if (ref->pos == ref->datalen) {
+      /* End of input. */
+      if (bp != buf) {
+        *bp = '\0';
+        return (bufsz - buflen - 1);
+      }
+
+      return -1;
+    }
+
+    toread = ref->datalen - ref->pos;
+
+    while (buflen > 0 &&
+           toread > 0 &&
+           (ref->data[ref->pos] != '\n' ||
+            ref->data[ref->pos - 1] != '\r')) {
+      unsigned char cp;
+
+      toread--;
+      cp = ref->data[ref->pos++];
+
+      if (ref->handle_iac == TRUE) {
+        switch (ref->mode) {
+          case TELNET_IAC:
+            switch (cp) {
+              case TELNET_WILL:
+              case TELNET_WONT:
+              case TELNET_DO:
+              case TELNET_DONT:
+              case TELNET_IP:
+              case TELNET_DM:
+                ref->mode = cp;
+                continue;
+
+              case TELNET_IAC:
+                ref->mode = 0;
+                break;
+
+              default:
+                *bp++ = TELNET_IAC;
+                buflen--;
+                ref->mode = 0;
+                break;
+            }
+            break;
+
+          case TELNET_WILL:
+          case TELNET_WONT:
+            ref->out[ref->outlen++] = TELNET_IAC;
+            ref->out[ref->outlen++] = TELNET_DONT;
+            if (cp != 0) {
+              /* Written using "%c", so a NUL ends the response early. */
+              ref->out[ref->outlen++] = cp;
+            }
+            ref->mode = 0;
+            continue;
+
+          case TELNET_DO:
+          case TELNET_DONT:
+            ref->out[ref->outlen++] = TELNET_IAC;
+            ref->out[ref->outlen++] = TELNET_WONT;
+            if (cp != 0) {
+              /* Written using "%c", so a NUL ends the response early. */
+              ref->out[ref->outlen++] = cp;
+            }
+            ref->mode = 0;
+            continue;
+
+          default:
+            if (cp == TELNET_IAC) {
+              ref->mode = cp;
+              continue;
+            }
+            break;
+        }
+      }
+
+      if (buflen == 0) {
+        break;
+      }
+
+      *bp++ = cp;
+      buflen--;
+    }
+
+    if (buflen > 0 &&
+        toread > 0 &&
+        ref->data[ref->pos] == '\n') {
+      if (*(bp-1) == '\r') {
+        *(bp-1) = ref->data[ref->pos++];
+
+      } else {
+        *bp++ = ref->data[ref->pos++];
+        buflen--;
+      }
+
+      saw_newline = TRUE;
+      break;
+    }
+  }
+
+  if (!saw_newline) {
+    ref->terminated = FALSE;
+    errno = E2BIG;
+    return -1;
+  }
+
+  if (!ref->terminated) {
+    ref->terminated = TRUE;
+    errno = E2BIG;
+    return -1;
+  }
+
+  ref->terminated = TRUE;
+  *bp = '\0';
+  return (bufsz - buflen - 1);
+}
+
+static size_t telnet_fuzz_input(unsigned char *data, size_t maxlen) {
+  register unsigned int i;
+  size_t len;
+  const unsigned char specials[] = {
+    '\r', '\n', '\r', '\n', ' ', TELNET_IAC, TELNET_IAC, TELNET_WILL,
+    TELNET_WONT, TELNET_DO, TELNET_DONT, TELNET_IP, TELNET_DM, 7, 0
+  };
+
+  len = 1 + (random() % maxlen);
+
+  for (i = 0; i < len; i++) {
+    long r;
+
+    r = random() % 100;
+    if (r < 75) {
+      /* Mostly plain text, in runs. */
+      data[i] = 'A' + (random() % 26);
+
+    } else if (r < 97) {
+      data[i] = specials[random() % sizeof(specials)];
+
+    } else {
+      data[i] = random() % 256;
+    }
+  }
+
+  /* The byte before a leading LF is not part of the input. */
+  if (data[0] == '\n') {
+    data[0] = 'A';
+  }
+
+  return len;
+}
+
+START_TEST (netio_telnet_gets2_fuzz_test) {
+  register unsigned int i;
+  pr_netio_stream_t *in, *out;
+  pr_buffer_t *pbuf;
+  struct telnet_ref ref;
+  char area[2][1026], *buf[2];
+  unsigned char *out_data;
+  size_t out_datasz = 256 * 1024;
+  int len, out_fd;
+
+  in = pr_netio_open(p, PR_NETIO_STRM_CTRL, -1, PR_NETIO_IO_RD);
+
+  out_fd = open_tmpfile();
+  out = pr_netio_open(p, PR_NETIO_STRM_CTRL, out_fd, PR_NETIO_IO_WR);
+
+  pr_netio_buffer_alloc(in);
+  pbuf = in->strm_buf;
+
+  memset(&ref, 0, sizeof(ref));
+  ref.handle_iac = TRUE;
+#ifdef PR_USE_NLS
+  ref.handle_iac = pr_encode_supports_telnet_iac();
+#endif /* PR_USE_NLS */
+  ref.terminated = TRUE;
+  ref.out = pcalloc(p, out_datasz);
+
+  /* Both implementations read the byte before the output buffer, in some
+   * cases; make sure it is the same one.
+   */
+  for (i = 0; i < 2; i++) {
+    area[i][0] = 'x';
+    buf[i] = &(area[i][1]);
+  }
+
+  /* Start from the same state: complete lines reset the state of both. */
+  for (i = 0; i < 2; i++) {
+    const char *cmd = "SYNC\r\n";
+
+    len = strlen(cmd);
+    memcpy(pbuf->buf, cmd, len);
+    pbuf->remaining = pbuf->buflen - len;
+    pbuf->current = pbuf->buf;
+    (void) pr_netio_telnet_gets2(buf[0], 64, in, out);
+  }
+
+  srandom(4307);
+
+  for (i = 0; i < 5000; i++) {
+    register unsigned int j;
+    size_t bufsz;
+
+    bufsz = (i % 3 == 0) ? sizeof(area[0]) - 1 : 2 + (random() % 40);
+
+    len = telnet_fuzz_input((unsigned char *) pbuf->buf, 600);
+    pbuf->remaining = pbuf->buflen - len;
+    pbuf->current = pbuf->buf;
+
+    ref.data = (const unsigned char *) pbuf->buf;
+    ref.datalen = len;
+    ref.pos = 0;
+
+    for (j = 0; j < 1000; j++) {
+      int res[2], xerrno[2];
+
+      memset(area[0] + 1, '\0', sizeof(area[0]) - 1);
+      memset(area[1] + 1, '\0', sizeof(area[1]) - 1);
+
+      errno = 0;
+      res[0] = pr_netio_telnet_gets2(buf[0], bufsz, in, out);
+      xerrno[0] = errno;
+
+      errno = 0;
+      res[1] = telnet_ref_gets(&ref, buf[1], bufsz);
+      xerrno[1] = errno;
+
+      fail_unless(res[0] == res[1],
+        "Input %u, read %u: expected %d, got %d", i, j, res[1], res[0]);
+
+      if (res[0] < 0) {
+        fail_unless((xerrno[0] == E2BIG) == (xerrno[1] == E2BIG),
+          "Input %u, read %u: expected errno %d, got %d", i, j, xerrno[1],
+          xerrno[0]);
+
+        if (xerrno[0] != E2BIG) {
+          /* End of input. */
+          break;
+        }
+
+      } else {
+        fail_unless(memcmp(buf[0], buf[1], res[0] + 1) == 0,
+          "Input %u, read %u: expected '%s', got '%s'", i, j, buf[1], buf[0]);
+      }
+
+      if (pbuf->current != NULL) {
+        fail_unless((size_t) (pbuf->current - pbuf->buf) == ref.pos,
+          "Input %u, read %u: expected %lu bytes consumed, got %lu", i, j,
+          (unsigned long) ref.pos,
+          (unsigned long) (pbuf->current - pbuf->buf));
+      }
+    }
+
+    fail_unless(ref.outlen < out_datasz - 2048,
+      "Too much Telnet output (%lu bytes)", (unsigned long) ref.outlen);
+  }
+
+  pr_netio_close(in);
+
+  /* The Telnet responses must be the same, too. */
+  out_data = pcalloc(p, out_datasz);
+  lseek(out_fd, 0, SEEK_SET);
+  len = read(out_fd, out_data, out_datasz);
+  pr_netio_close(out);
+
+  fail_unless(len == (int) ref.outlen, "Expected %lu Telnet bytes, got %d",
+    (unsigned long) ref.outlen, len);
+  fail_unless(memcmp(out_data, ref.out, ref.outlen) == 0,
+    "Telnet responses differ");
+
+  test_cleanup();
+}
+END_TEST
+
+START_TEST (netio_telnet_gets2_bench_test) {
+  register unsigned int i;
+  pr_netio_stream_t *in, *out;
+  pr_buffer_t *pbuf;
+  struct telnet_ref ref;
+  char buf[1024];
+  int len = 0;
+  double elapsed[2];
+
+  in = pr_netio_open(p, PR_NETIO_STRM_CTRL, -1, PR_NETIO_IO_RD);
+  out = pr_netio_open(p, PR_NETIO_STRM_CTRL, -1, PR_NETIO_IO_WR);
+
+  pr_netio_buffer_alloc(in);
+  pbuf = in->strm_buf;
+
+  /* A pipelined batch of commands, some with long arguments. */
+  while ((size_t) len + 256 < pbuf->buflen) {
+    len += snprintf(pbuf->buf + len, pbuf->buflen - len,
+      "SIZE /pub/releases/%u/some-long-file-name-for-a-release.tar.gz\r\n"
+      "MDTM file-%u.txt\r\nNOOP\r\n", len, len);
+  }
+
+  memset(&ref, 0, sizeof(ref));
+  ref.handle_iac = TRUE;
+  ref.terminated = TRUE;
+  ref.data = (const unsigned char *) pbuf->buf;
+  ref.datalen = len;
+
+  for (i = 0; i < 2; i++) {
+    register unsigned int j;
+    struct timeval start, end;
+    unsigned int nlines = 0;
+
+    gettimeofday(&start, NULL);
+    for (j = 0; j < 200; j++) {
+      if (i == 0) {
+        ref.pos = 0;
+        while (telnet_ref_gets(&ref, buf, sizeof(buf)) > 0) {
+          nlines++;
+        }
+
+      } else {
+        pbuf->remaining = pbuf->buflen - len;
+        pbuf->current = pbuf->buf;
+        while (pr_netio_telnet_gets2(buf, sizeof(buf), in, out) > 0) {
+          nlines++;
+        }
+      }
+    }
+    gettimeofday(&end, NULL);
+
+    fail_unless(nlines > 0, "Expected lines to be read");
+
+    elapsed[i] = (((end.tv_sec - start.tv_sec) * 1000000.0) +
+      (end.tv_usec - start.tv_usec)) / nlines;
+  }
+
+  pr_netio_close(in);
+  pr_netio_close(out);
+
+  if (getenv("TEST_VERBOSE") != NULL) {
+    fprintf(stdout, "telnet line scanning: bytewise %.3f us/line, "
+      "bulk %.3f us/line\n", elapsed[0], elapsed[1]);
+  }
+}
+END_TEST
+
 static int netio_poll_cb(pr_netio_stream_t *nstrm) {
   /* Always return >0, to indicate that we haven't timed out, AND that there
    * is a writable fd available.
@@ -1718,6 +2149,148 @@ START_TEST (netio_write_async_test) {
 }
 END_TEST
 
+static char netio_writev_buf[256];
+static size_t netio_writev_buflen = 0;
+static unsigned int netio_writev_ncalls = 0;
+
+static int netio_writev_write_cb(pr_netio_stream_t *nstrm, char *buf,
+    size_t buflen) {
+  memcpy(netio_writev_buf + netio_writev_buflen, buf, buflen);
+  netio_writev_buflen += buflen;
+  netio_writev_ncalls++;
+  return (int) buflen;
+}
+
+/* Writes at most 3 bytes per call, to exercise the handling of partial
+ * writes.
+ */
+static int netio_writev_writev_cb(pr_netio_stream_t *nstrm,
+    const struct iovec *iov, int iovcnt) {
+  register int i;
+  int total = 0;
+
+  for (i = 0; i < iovcnt && total < 3; i++) {
+    size_t len;
+
+    len = iov[i].iov_len;
+    if (len > (size_t) (3 - total)) {
+      len = 3 - total;
+    }
+
+    memcpy(netio_writev_buf + netio_writev_buflen, iov[i].iov_base, len);
+    netio_writev_buflen += len;
+    total += len;
+  }
+
+  netio_writev_ncalls++;
+  return total;
+}
+
+START_TEST (netio_writev_test) {
+  int fds[2], res;
+  pr_netio_t *netio;
+  pr_netio_stream_t *nstrm;
+  struct iovec iov[4];
+  char buf[64], *expected;
+  size_t expected_len;
+
+  res = pr_netio_writev(NULL, NULL, 0);
+  fail_unless(res < 0, "Failed to handle null arguments");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  iov[0].iov_base = "Hello, ";
+  iov[0].iov_len = 7;
+  iov[1].iov_base = "";
+  iov[1].iov_len = 0;
+  iov[2].iov_base = "World";
+  iov[2].iov_len = 5;
+  iov[3].iov_base = "!\r\n";
+  iov[3].iov_len = 3;
+
+  expected = "Hello, World!\r\n";
+  expected_len = strlen(expected);
+
+  /* A custom NetIO with a writev callback, which writes partially. */
+  netio = pr_alloc_netio2(p, NULL, "testsuite");
+  fail_unless(netio->writev == NULL,
+    "Expected no writev callback for allocated NetIO");
+  netio->poll = netio_poll_cb;
+  netio->write = netio_writev_write_cb;
+  netio->writev = netio_writev_writev_cb;
+
+  res = pr_register_netio(netio, PR_NETIO_STRM_CTRL);
+  fail_unless(res == 0, "Failed to register custom ctrl NetIO: %s",
+    strerror(errno));
+
+  nstrm = pr_netio_open(p, PR_NETIO_STRM_CTRL, 2, PR_NETIO_IO_WR);
+  fail_unless(nstrm != NULL, "Failed to open stream: %s", strerror(errno));
+
+  res = pr_netio_writev(nstrm, NULL, 4);
+  fail_unless(res < 0, "Failed to handle null iovec");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  res = pr_netio_writev(nstrm, &(iov[1]), 1);
+  fail_unless(res < 0, "Failed to handle empty iovec");
+  fail_unless(errno == EINVAL, "Expected EINVAL (%d), got %s (%d)", EINVAL,
+    strerror(errno), errno);
+
+  netio_writev_buflen = 0;
+  netio_writev_ncalls = 0;
+  res = pr_netio_writev(nstrm, iov, 4);
+  fail_unless(res == (int) expected_len, "Expected %lu, got %d",
+    (unsigned long) expected_len, res);
+  fail_unless(netio_writev_buflen == expected_len &&
+    memcmp(netio_writev_buf, expected, expected_len) == 0,
+    "Expected '%s', got '%.*s'", expected, (int) netio_writev_buflen,
+    netio_writev_buf);
+  fail_unless(netio_writev_ncalls == 5, "Expected 5 writev calls, got %u",
+    netio_writev_ncalls);
+
+  /* Without a writev callback, the vectors are coalesced for one write. */
+  netio->writev = NULL;
+
+  netio_writev_buflen = 0;
+  netio_writev_ncalls = 0;
+  res = pr_netio_writev(nstrm, iov, 4);
+  fail_unless(res == (int) expected_len, "Expected %lu, got %d",
+    (unsigned long) expected_len, res);
+  fail_unless(netio_writev_buflen == expected_len &&
+    memcmp(netio_writev_buf, expected, expected_len) == 0,
+    "Expected '%s', got '%.*s'", expected, (int) netio_writev_buflen,
+    netio_writev_buf);
+  fail_unless(netio_writev_ncalls == 1, "Expected 1 write call, got %u",
+    netio_writev_ncalls);
+
+  nstrm->strm_fd = -1;
+  (void) pr_netio_close(nstrm);
+  pr_unregister_netio(PR_NETIO_STRM_CTRL);
+
+  /* The default NetIO uses writev(2). */
+  res = pipe(fds);
+  fail_unless(res == 0, "Failed to create pipe: %s", strerror(errno));
+
+  nstrm = pr_netio_open(p, PR_NETIO_STRM_OTHR, fds[1], PR_NETIO_IO_WR);
+  fail_unless(nstrm != NULL, "Failed to open stream: %s", strerror(errno));
+
+  res = pr_netio_writev(nstrm, iov, 4);
+  fail_unless(res == (int) expected_len, "Expected %lu, got %d",
+    (unsigned long) expected_len, res);
+
+  memset(buf, '\0', sizeof(buf));
+  res = read(fds[0], buf, sizeof(buf)-1);
+  fail_unless(res == (int) expected_len, "Expected %lu, got %d",
+    (unsigned long) expected_len, res);
+  fail_unless(strcmp(buf, expected) == 0, "Expected '%s', got '%s'",
+    expected, buf);
+
+  (void) pr_netio_close(nstrm);
+  (void) close(fds[0]);
+
+}
+END_TEST
+
 static int netio_print_to_stream(int strm_type, int use_async) {
   int fd = 2, res;
   char *buf;
@@ -2060,11 +2633,15 @@ Suite *tests_get_netio_suite(void) {
   tcase_add_test(testcase, netio_telnet_gets2_single_line_test);
   tcase_add_test(testcase, netio_telnet_gets2_single_line_crnul_test);
   tcase_add_test(testcase, netio_telnet_gets2_single_line_lf_test);
+  tcase_add_test(testcase, netio_telnet_pending_test);
+  tcase_add_test(testcase, netio_telnet_gets2_fuzz_test);
+  tcase_add_test(testcase, netio_telnet_gets2_bench_test);
 
   tcase_add_test(testcase, netio_read_test);
   tcase_add_test(testcase, netio_gets_test);
   tcase_add_test(testcase, netio_write_test);
   tcase_add_test(testcase, netio_write_async_test);
+  tcase_add_test(testcase, netio_writev_test);
   tcase_add_test(testcase, netio_printf_test);
   tcase_add_test(testcase, netio_printf_async_test);
   tcase_add_test(testcase, netio_abort_test);
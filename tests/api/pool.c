@@ -301,6 +301,208 @@ START_TEST (pool_tag_test) {
 }
 END_TEST
 
+START_TEST (pool_release_free_blocks_test) {
+  pool *p;
+  unsigned long released;
+
+  /* Start with an empty free list. */
+  (void) pr_pool_release_free_blocks();
+
+  p = make_sub_pool(permanent_pool);
+  (void) palloc(p, 8192);
+  destroy_pool(p);
+
+  released = pr_pool_release_free_blocks();
+  fail_unless(released >= 8192, "Expected at least 8192 bytes released, got %lu",
+    released);
+
+  released = pr_pool_release_free_blocks();
+  fail_unless(released == 0, "Expected 0 bytes released, got %lu", released);
+
+  /* The pools must still work afterwards. */
+  p = make_sub_pool(permanent_pool);
+  fail_unless(palloc(p, 64) != NULL, "Failed to allocate memory");
+  destroy_pool(p);
+}
+END_TEST
+
+START_TEST (pool_set_max_free_test) {
+  register unsigned int i;
+  pool *p;
+  size_t prev_max_free;
+  unsigned long released;
+
+  (void) pr_pool_release_free_blocks();
+
+  prev_max_free = pr_pool_set_max_free(16384);
+
+  p = make_sub_pool(permanent_pool);
+  for (i = 0; i < 16; i++) {
+    (void) palloc(p, 4096);
+  }
+  destroy_pool(p);
+
+  released = pr_pool_release_free_blocks();
+  fail_unless(released <= 16384, "Expected at most 16384 bytes released, "
+    "got %lu", released);
+
+  /* Lowering the maximum trims the free list right away. */
+  pr_pool_set_max_free(0);
+
+  p = make_sub_pool(permanent_pool);
+  for (i = 0; i < 16; i++) {
+    (void) palloc(p, 4096);
+  }
+  destroy_pool(p);
+
+  (void) pr_pool_set_max_free(8192);
+  released = pr_pool_release_free_blocks();
+  fail_unless(released <= 8192, "Expected at most 8192 bytes released, "
+    "got %lu", released);
+
+  (void) pr_pool_set_max_free(prev_max_free);
+}
+END_TEST
+
+/* Allocation traces, modelled on what a session does when logging in, when
+ * listing a large directory, and when answering SFTP READDIR requests.  The
+ * sizes come from a fixed pseudo-random sequence, so every replay of a trace
+ * allocates the same way.
+ */
+
+static unsigned int trace_seed = 0;
+
+static size_t trace_size(size_t min, size_t max) {
+  trace_seed = (trace_seed * 1103515245) + 12345;
+  return min + ((trace_seed >> 16) % (max - min + 1));
+}
+
+static void replay_login_trace(pool *parent) {
+  register unsigned int i;
+  pool *sess_pool, *cmd_pool;
+
+  sess_pool = make_sub_pool(parent);
+
+  /* Connection setup: netio buffers, the peer's address and name. */
+  (void) palloc(sess_pool, PR_TUNABLE_BUFFER_SIZE);
+  (void) pallocsz(sess_pool, 1024);
+  (void) pstrdup(sess_pool, "127.0.0.1");
+
+  /* USER, PASS, and friends; each command gets its own pool. */
+  for (i = 0; i < 8; i++) {
+    register unsigned int j;
+
+    cmd_pool = pr_pool_create_sz(sess_pool, 64);
+    for (j = 0; j < 12; j++) {
+      (void) palloc(cmd_pool, trace_size(8, 200));
+    }
+
+    destroy_pool(cmd_pool);
+  }
+
+  /* Session state kept for the life of the session. */
+  for (i = 0; i < 60; i++) {
+    (void) palloc(sess_pool, trace_size(8, 300));
+  }
+
+  destroy_pool(sess_pool);
+}
+
+static void replay_list_trace(pool *parent) {
+  register unsigned int i;
+  pool *list_pool, *tmp_pool = NULL;
+
+  list_pool = make_sub_pool(parent);
+  (void) palloc(list_pool, PR_TUNABLE_BUFFER_SIZE);
+
+  for (i = 0; i < 2000; i++) {
+    if (i % 64 == 0) {
+      if (tmp_pool != NULL) {
+        destroy_pool(tmp_pool);
+      }
+
+      tmp_pool = make_sub_pool(list_pool);
+    }
+
+    /* The entry's name, its stat(2) data, and the formatted line. */
+    (void) palloc(list_pool, trace_size(8, 64));
+    (void) palloc(tmp_pool, 144);
+    (void) palloc(tmp_pool, trace_size(60, 120));
+  }
+
+  destroy_pool(list_pool);
+}
+
+static void replay_readdir_trace(pool *parent) {
+  register unsigned int i;
+
+  for (i = 0; i < 20; i++) {
+    register unsigned int j;
+    pool *pkt_pool;
+
+    pkt_pool = make_sub_pool(parent);
+
+    /* Each response holds up to 100 entries: name, longname, attributes. */
+    for (j = 0; j < 100; j++) {
+      (void) palloc(pkt_pool, trace_size(8, 64));
+      (void) palloc(pkt_pool, trace_size(60, 120));
+      (void) palloc(pkt_pool, 96);
+    }
+
+    (void) pallocsz(pkt_pool, trace_size(8192, 32768));
+    destroy_pool(pkt_pool);
+  }
+}
+
+START_TEST (pool_alloc_trace_test) {
+  register unsigned int i;
+  struct {
+    const char *name;
+    void (*replay)(pool *);
+  } traces[] = {
+    { "login", replay_login_trace },
+    { "LIST", replay_list_trace },
+    { "SFTP READDIR", replay_readdir_trace },
+    { NULL, NULL }
+  };
+  unsigned int nreplays = 200;
+
+  for (i = 0; traces[i].name != NULL; i++) {
+    register unsigned int j;
+    unsigned long released, steady_released;
+    struct timeval start, end;
+
+    (void) pr_pool_release_free_blocks();
+
+    trace_seed = 0;
+    traces[i].replay(permanent_pool);
+    released = pr_pool_release_free_blocks();
+
+    gettimeofday(&start, NULL);
+    for (j = 0; j < nreplays; j++) {
+      trace_seed = 0;
+      traces[i].replay(permanent_pool);
+    }
+    gettimeofday(&end, NULL);
+
+    /* Once warmed up, replaying a trace must reuse the freed blocks, rather
+     * than growing the free list.
+     */
+    steady_released = pr_pool_release_free_blocks();
+    fail_unless(steady_released == released,
+      "Trace '%s': expected %lu bytes on the free list, got %lu",
+      traces[i].name, released, steady_released);
+
+    if (getenv("TEST_VERBOSE") != NULL) {
+      fprintf(stdout, "pool trace '%s': %lu free bytes, %.1f us/replay\n",
+        traces[i].name, steady_released,
+        (((end.tv_sec - start.tv_sec) * 1000000.0) +
+          (end.tv_usec - start.tv_usec)) / nreplays);
+    }
+  }
+}
+END_TEST
+
 #if defined(PR_USE_DEVEL)
 START_TEST (pool_debug_memory_test) {
   pool *p, *sub_pool;
@@ -429,6 +631,9 @@ Suite *tests_get_pool_suite(void) {
   tcase_add_test(testcase, pool_pcalloc_test);
   tcase_add_test(testcase, pool_pcallocsz_test);
   tcase_add_test(testcase, pool_tag_test);
+  tcase_add_test(testcase, pool_release_free_blocks_test);
+  tcase_add_test(testcase, pool_set_max_free_test);
+  tcase_add_test(testcase, pool_alloc_trace_test);
 #if defined(PR_USE_DEVEL)
   tcase_add_test(testcase, pool_debug_memory_test);
   tcase_add_test(testcase, pool_debug_flags_test);
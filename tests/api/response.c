@@ -261,6 +261,216 @@ START_TEST (response_flush_test) {
 }
 END_TEST
 
+static unsigned int resp_nwrites = 0;
+static char resp_written[1024];
+
+static int response_netio_write_record_cb(pr_netio_stream_t *nstrm,
+    char *buf, size_t buflen) {
+  resp_nwrites++;
+  sstrncpy(resp_written, buf, buflen < sizeof(resp_written) ?
+    buflen + 1 : sizeof(resp_written));
+  return buflen;
+}
+
+START_TEST (response_flush_pipelined_test) {
+  int res, sockfd = -2;
+  conn_t *conn;
+  pr_netio_t *netio;
+  pr_buffer_t *pbuf;
+  const char *cmd, *expected;
+
+  netio = pr_alloc_netio2(p, NULL, "testsuite");
+  netio->poll = response_netio_poll_cb;
+  netio->write = response_netio_write_record_cb;
+
+  res = pr_register_netio(netio, PR_NETIO_STRM_CTRL);
+  fail_unless(res == 0, "Failed to register custom ctrl NetIO: %s",
+    strerror(errno));
+
+  conn = pr_inet_create_conn(p, sockfd, NULL, INPORT_ANY, FALSE);
+  conn->instrm = pr_netio_open(p, PR_NETIO_STRM_CTRL, sockfd,
+    PR_NETIO_IO_RD);
+  conn->outstrm = pr_netio_open(p, PR_NETIO_STRM_CTRL, sockfd,
+    PR_NETIO_IO_WR);
+  session.c = conn;
+
+  /* The client has already sent its next command. */
+  cmd = "SIZE file.txt\r\n";
+  pbuf = pr_netio_buffer_alloc(conn->instrm);
+  memcpy(pbuf->buf, cmd, strlen(cmd));
+  pbuf->remaining = pbuf->buflen - strlen(cmd);
+  pbuf->current = pbuf->buf;
+
+  resp_nwrites = 0;
+  memset(resp_written, '\0', sizeof(resp_written));
+  pr_response_set_pool(p);
+
+  pr_response_add(R_200, "%s", "Type set to I");
+  pr_response_flush(&resp_list);
+  fail_unless(resp_nwrites == 0, "Expected no writes, got %u", resp_nwrites);
+
+  /* Once no more commands are buffered, all responses are sent at once. */
+  pbuf->remaining = pbuf->buflen;
+
+  pr_response_add(R_213, "%s", "1024");
+  pr_response_add(R_DUP, "%s", "and more");
+  pr_response_flush(&resp_list);
+  fail_unless(resp_nwrites == 1, "Expected 1 write, got %u", resp_nwrites);
+
+  expected = "200 Type set to I\r\n213-1024\r\n213 and more\r\n";
+  fail_unless(strcmp(resp_written, expected) == 0,
+    "Expected '%s', got '%s'", expected, resp_written);
+
+  /* Responses sent immediately include any held back. */
+  pbuf->remaining = pbuf->buflen - strlen(cmd);
+  resp_nwrites = 0;
+
+  pr_response_add(R_250, "%s", "CWD command successful");
+  pr_response_flush(&resp_list);
+  pr_response_send(R_150, "%s", "Opening data connection");
+  fail_unless(resp_nwrites == 1, "Expected 1 write, got %u", resp_nwrites);
+
+  expected = "250 CWD command successful\r\n150 Opening data connection\r\n";
+  fail_unless(strcmp(resp_written, expected) == 0,
+    "Expected '%s', got '%s'", expected, resp_written);
+
+  /* Held-back responses can also be sent explicitly, e.g. before waiting
+   * on a data connection.
+   */
+  resp_nwrites = 0;
+
+  pr_response_add(R_200, "%s", "NOOP command successful");
+  pr_response_flush(&resp_list);
+  fail_unless(resp_nwrites == 0, "Expected no writes, got %u", resp_nwrites);
+
+  res = pr_response_flush_pending();
+  fail_unless(res > 0, "Failed to flush pending responses: %s",
+    strerror(errno));
+  fail_unless(resp_nwrites == 1, "Expected 1 write, got %u", resp_nwrites);
+
+  res = pr_response_flush_pending();
+  fail_unless(res == 0, "Expected 0, got %d", res);
+
+  pr_inet_close(p, session.c);
+  session.c = NULL;
+  pr_unregister_netio(PR_NETIO_STRM_CTRL);
+}
+END_TEST
+
+static unsigned int resp_nwritevs = 0;
+static int resp_writev_iovcnt = 0;
+static size_t resp_writev_len = 0;
+
+static int response_netio_writev_record_cb(pr_netio_stream_t *nstrm,
+    const struct iovec *iov, int iovcnt) {
+  register int i;
+
+  resp_nwritevs++;
+  resp_writev_iovcnt = iovcnt;
+  resp_writev_len = 0;
+
+  for (i = 0; i < iovcnt; i++) {
+    resp_writev_len += iov[i].iov_len;
+  }
+
+  return (int) resp_writev_len;
+}
+
+START_TEST (response_flush_pipelined_writev_test) {
+  register unsigned int i;
+  int res, sockfd = -2;
+  conn_t *conn;
+  pr_netio_t *netio;
+  pr_buffer_t *pbuf;
+  const char *cmd;
+  char msg[1001];
+  size_t total = 0;
+
+  netio = pr_alloc_netio2(p, NULL, "testsuite");
+  netio->poll = response_netio_poll_cb;
+  netio->write = response_netio_write_record_cb;
+  netio->writev = response_netio_writev_record_cb;
+
+  res = pr_register_netio(netio, PR_NETIO_STRM_CTRL);
+  fail_unless(res == 0, "Failed to register custom ctrl NetIO: %s",
+    strerror(errno));
+
+  conn = pr_inet_create_conn(p, sockfd, NULL, INPORT_ANY, FALSE);
+  conn->instrm = pr_netio_open(p, PR_NETIO_STRM_CTRL, sockfd,
+    PR_NETIO_IO_RD);
+  conn->outstrm = pr_netio_open(p, PR_NETIO_STRM_CTRL, sockfd,
+    PR_NETIO_IO_WR);
+  session.c = conn;
+
+  /* The client has already sent its next command. */
+  cmd = "NOOP\r\n";
+  pbuf = pr_netio_buffer_alloc(conn->instrm);
+  memcpy(pbuf->buf, cmd, strlen(cmd));
+  pbuf->remaining = pbuf->buflen - strlen(cmd);
+  pbuf->current = pbuf->buf;
+
+  resp_nwrites = resp_nwritevs = 0;
+  pr_response_set_pool(p);
+
+  memset(msg, 'A', sizeof(msg) - 1);
+  msg[sizeof(msg)-1] = '\0';
+
+  /* Once the held-back responses no longer fit, they are written along with
+   * the next one, in a single write.
+   */
+  for (i = 0; resp_nwrites == 0 && resp_nwritevs == 0 && i < 64; i++) {
+    pr_response_add(R_200, "%s", msg);
+    pr_response_flush(&resp_list);
+
+    /* "200 " + msg + "\r\n" */
+    total += sizeof(msg) - 1 + 6;
+  }
+
+  fail_unless(resp_nwrites == 0, "Expected no writes, got %u", resp_nwrites);
+  fail_unless(resp_nwritevs == 1, "Expected 1 writev, got %u", resp_nwritevs);
+  fail_unless(resp_writev_iovcnt == 2, "Expected 2 vectors, got %d",
+    resp_writev_iovcnt);
+  fail_unless(resp_writev_len == total, "Expected %lu bytes, got %lu",
+    (unsigned long) total, (unsigned long) resp_writev_len);
+
+  /* Nothing is left held back. */
+  res = pr_response_flush_pending();
+  fail_unless(res == 0, "Expected 0, got %d", res);
+
+  /* The buffer can only be freed when nothing is held back. */
+  pr_response_add(R_200, "%s", msg);
+  pr_response_flush(&resp_list);
+
+  res = pr_response_free_pending();
+  fail_unless(res < 0, "Freed pending responses unexpectedly");
+  fail_unless(errno == EAGAIN, "Expected EAGAIN (%d), got %s (%d)", EAGAIN,
+    strerror(errno), errno);
+
+  res = pr_response_flush_pending();
+  fail_unless(res > 0, "Failed to flush pending responses: %s",
+    strerror(errno));
+
+  res = pr_response_free_pending();
+  fail_unless(res == 0, "Failed to free pending responses buffer: %s",
+    strerror(errno));
+
+  /* It is allocated again when needed. */
+  resp_nwrites = 0;
+  pr_response_add(R_200, "%s", "NOOP command successful");
+  pr_response_flush(&resp_list);
+  fail_unless(resp_nwrites == 0, "Expected no writes, got %u", resp_nwrites);
+
+  res = pr_response_flush_pending();
+  fail_unless(res > 0, "Failed to flush pending responses: %s",
+    strerror(errno));
+  fail_unless(resp_nwrites == 1, "Expected 1 write, got %u", resp_nwrites);
+
+  pr_inet_close(p, session.c);
+  session.c = NULL;
+  pr_unregister_netio(PR_NETIO_STRM_CTRL);
+}
+END_TEST
+
 START_TEST (response_send_test) {
   int res, sockfd = -2;
   conn_t *conn;
@@ -432,6 +642,8 @@ Suite *tests_get_response_suite(void) {
   tcase_add_test(testcase, response_block_test);
   tcase_add_test(testcase, response_clear_test);
   tcase_add_test(testcase, response_flush_test);
+  tcase_add_test(testcase, response_flush_pipelined_test);
+  tcase_add_test(testcase, response_flush_pipelined_writev_test);
   tcase_add_test(testcase, response_send_test);
   tcase_add_test(testcase, response_send_async_test);
   tcase_add_test(testcase, response_send_raw_test);
@@ -219,6 +219,61 @@ START_TEST (set_insert_end_test) {
 }
 END_TEST
 
+START_TEST (set_insert_end_after_remove_test) {
+  int res;
+  xaset_t *set;
+  struct test_item *item1, *item2, *item3;
+  xasetmember_t *member;
+
+  set = xaset_create(p, NULL);
+  fail_unless(set != NULL, "Failed to create set: %s", strerror(errno));
+
+  item1 = pcalloc(p, sizeof(struct test_item));
+  item2 = pcalloc(p, sizeof(struct test_item));
+  item3 = pcalloc(p, sizeof(struct test_item));
+
+  res = xaset_insert_end(set, (xasetmember_t *) item1);
+  fail_unless(res == 0, "Failed to insert item to set: %s", strerror(errno));
+
+  res = xaset_insert_end(set, (xasetmember_t *) item2);
+  fail_unless(res == 0, "Failed to insert item to set: %s", strerror(errno));
+
+  /* Removing the last member must not leave a stale tail behind. */
+  res = xaset_remove(set, (xasetmember_t *) item2);
+  fail_unless(res == 0, "Failed to remove item from set: %s", strerror(errno));
+
+  res = xaset_insert_end(set, (xasetmember_t *) item3);
+  fail_unless(res == 0, "Failed to insert item to set: %s", strerror(errno));
+
+  member = set->xas_list;
+  fail_unless(member == (xasetmember_t *) item1, "Expected %p, got %p", item1,
+    member);
+  fail_unless(member->next == (xasetmember_t *) item3,
+    "Next item in list does not point to item3");
+  fail_unless(item3->prev == item1,
+    "Previous item in list does not point to item1");
+  fail_unless(item2->next == NULL, "Removed item still linked");
+
+  /* Likewise when the set is emptied, and when members are prepended. */
+  (void) xaset_remove(set, (xasetmember_t *) item1);
+  (void) xaset_remove(set, (xasetmember_t *) item3);
+  fail_unless(set->xas_list == NULL, "Expected empty list");
+
+  res = xaset_insert(set, (xasetmember_t *) item2);
+  fail_unless(res == 0, "Failed to insert item to set: %s", strerror(errno));
+
+  res = xaset_insert_end(set, (xasetmember_t *) item1);
+  fail_unless(res == 0, "Failed to insert item to set: %s", strerror(errno));
+
+  member = set->xas_list;
+  fail_unless(member == (xasetmember_t *) item2, "Expected %p, got %p", item2,
+    member);
+  fail_unless(member->next == (xasetmember_t *) item1,
+    "Next item in list does not point to item1");
+  fail_unless(item1->next == NULL, "Last item has a next item");
+}
+END_TEST
+
 START_TEST (set_insert_sort_test) {
   int res;
   xaset_t *set;
@@ -454,6 +509,7 @@ Suite *tests_get_sets_suite(void) {
   tcase_add_test(testcase, set_create_test);
   tcase_add_test(testcase, set_insert_test);
   tcase_add_test(testcase, set_insert_end_test);
+  tcase_add_test(testcase, set_insert_end_after_remove_test);
   tcase_add_test(testcase, set_insert_sort_test);
   tcase_add_test(testcase, set_remove_test);
   tcase_add_test(testcase, set_copy_test);
@@ -583,6 +583,244 @@ START_TEST (stash_remove_hook_test) {
 }
 END_TEST
 
+START_TEST (stash_get_generation_test) {
+  int res;
+  unsigned int generation;
+  cmdtable cmdtab;
+
+  generation = pr_stash_get_generation();
+
+  memset(&cmdtab, 0, sizeof(cmdtab));
+  cmdtab.command = pstrdup(p, "foo");
+  res = pr_stash_add_symbol(PR_SYM_CMD, &cmdtab);
+  fail_unless(res == 0, "Failed to add CMD symbol: %s", strerror(errno));
+  fail_unless(pr_stash_get_generation() != generation,
+    "Expected generation to change after adding symbol");
+
+  generation = pr_stash_get_generation();
+  (void) pr_stash_get_symbol2(PR_SYM_CMD, "foo", NULL, NULL, NULL);
+  res = pr_stash_remove_cmd("bar", NULL, 0, NULL, -1);
+  fail_unless(res == 0, "Expected %d, got %d", 0, res);
+  fail_unless(pr_stash_get_generation() == generation,
+    "Expected generation to remain unchanged after lookups");
+
+  res = pr_stash_remove_cmd("foo", NULL, 0, NULL, -1);
+  fail_unless(res == 1, "Expected %d, got %d", 1, res);
+  fail_unless(pr_stash_get_generation() != generation,
+    "Expected generation to change after removing symbol");
+}
+END_TEST
+
+START_TEST (stash_get_symbol_index_test) {
+  register unsigned int i;
+  int res;
+  void *sym;
+  module m1, m2;
+  conftable *conftabs, *overrides;
+  cmdtable cmdtab1, cmdtab2;
+  unsigned int nsyms = 400;
+
+  memset(&m1, 0, sizeof(m1));
+  m1.name = "one";
+  m1.priority = 1;
+
+  memset(&m2, 0, sizeof(m2));
+  m2.name = "two";
+  m2.priority = 2;
+
+  conftabs = pcalloc(p, sizeof(conftable) * nsyms);
+  overrides = pcalloc(p, sizeof(conftable) * nsyms);
+
+  for (i = 0; i < nsyms; i++) {
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), "Directive%u", i);
+    conftabs[i].directive = pstrdup(p, buf);
+    conftabs[i].m = &m1;
+
+    res = pr_stash_add_symbol(PR_SYM_CONF, &(conftabs[i]));
+    fail_unless(res == 0, "Failed to add CONF symbol '%s': %s", buf,
+      strerror(errno));
+
+    /* Every tenth directive is also provided by a higher priority module. */
+    if (i % 10 == 0) {
+      overrides[i].directive = conftabs[i].directive;
+      overrides[i].m = &m2;
+
+      res = pr_stash_add_symbol(PR_SYM_CONF, &(overrides[i]));
+      fail_unless(res == 0, "Failed to add CONF symbol '%s': %s", buf,
+        strerror(errno));
+    }
+  }
+
+  for (i = 0; i < nsyms; i++) {
+    char buf[64];
+
+    /* Directive lookups are case-insensitive. */
+    snprintf(buf, sizeof(buf), "DIRECTIVE%u", i);
+
+    sym = pr_stash_get_symbol2(PR_SYM_CONF, buf, NULL, NULL, NULL);
+    if (i % 10 == 0) {
+      fail_unless(sym == &(overrides[i]), "Expected %p for '%s', got %p",
+        &(overrides[i]), buf, sym);
+
+      sym = pr_stash_get_symbol2(PR_SYM_CONF, buf, sym, NULL, NULL);
+    }
+
+    fail_unless(sym == &(conftabs[i]), "Expected %p for '%s', got %p",
+      &(conftabs[i]), buf, sym);
+
+    sym = pr_stash_get_symbol2(PR_SYM_CONF, buf, sym, NULL, NULL);
+    fail_unless(sym == NULL, "Unexpectedly found another '%s' symbol", buf);
+    fail_unless(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+      strerror(errno), errno);
+  }
+
+  sym = pr_stash_get_symbol2(PR_SYM_CONF, "Directive400", NULL, NULL, NULL);
+  fail_unless(sym == NULL, "Unexpectedly found unknown symbol");
+  fail_unless(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  /* These two command names have the same hash value. */
+  memset(&cmdtab1, 0, sizeof(cmdtab1));
+  cmdtab1.command = pstrdup(p, "aB");
+  res = pr_stash_add_symbol(PR_SYM_CMD, &cmdtab1);
+  fail_unless(res == 0, "Failed to add CMD symbol: %s", strerror(errno));
+
+  memset(&cmdtab2, 0, sizeof(cmdtab2));
+  cmdtab2.command = pstrdup(p, "b!");
+  res = pr_stash_add_symbol(PR_SYM_CMD, &cmdtab2);
+  fail_unless(res == 0, "Failed to add CMD symbol: %s", strerror(errno));
+
+  sym = pr_stash_get_symbol2(PR_SYM_CMD, "aB", NULL, NULL, NULL);
+  fail_unless(sym == &cmdtab1, "Expected %p, got %p", &cmdtab1, sym);
+
+  sym = pr_stash_get_symbol2(PR_SYM_CMD, "b!", NULL, NULL, NULL);
+  fail_unless(sym == &cmdtab2, "Expected %p, got %p", &cmdtab2, sym);
+
+  /* Symbols removed after the index was built must no longer be found. */
+  res = pr_stash_remove_conf("Directive10", &m2);
+  fail_unless(res == 1, "Expected %d, got %d", 1, res);
+
+  sym = pr_stash_get_symbol2(PR_SYM_CONF, "Directive10", NULL, NULL, NULL);
+  fail_unless(sym == &(conftabs[10]), "Expected %p, got %p", &(conftabs[10]),
+    sym);
+
+  res = pr_stash_remove_cmd("aB", NULL, 0, NULL, -1);
+  fail_unless(res == 1, "Expected %d, got %d", 1, res);
+
+  sym = pr_stash_get_symbol2(PR_SYM_CMD, "aB", NULL, NULL, NULL);
+  fail_unless(sym == NULL, "Unexpectedly found removed symbol");
+
+  sym = pr_stash_get_symbol2(PR_SYM_CMD, "b!", NULL, NULL, NULL);
+  fail_unless(sym == &cmdtab2, "Expected %p, got %p", &cmdtab2, sym);
+}
+END_TEST
+
+START_TEST (stash_get_symbol2_all_test) {
+  register unsigned int i;
+  int res, idx;
+  unsigned int hash, nseen = 0, nsyms = 50;
+  conftable *conftabs, *tab;
+  unsigned char *seen;
+
+  conftabs = pcalloc(p, sizeof(conftable) * nsyms);
+  seen = pcalloc(p, nsyms);
+
+  for (i = 0; i < nsyms; i++) {
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), "Directive%u", i);
+    conftabs[i].directive = pstrdup(p, buf);
+
+    res = pr_stash_add_symbol(PR_SYM_CONF, &(conftabs[i]));
+    fail_unless(res == 0, "Failed to add CONF symbol '%s': %s", buf,
+      strerror(errno));
+  }
+
+  /* Make sure that the index has been built. */
+  tab = pr_stash_get_symbol2(PR_SYM_CONF, "Directive0", NULL, NULL, NULL);
+  fail_unless(tab == &(conftabs[0]), "Expected %p, got %p", &(conftabs[0]),
+    tab);
+
+  /* A NULL name lists every symbol, bucket by bucket, as the parser does
+   * for its "Did you mean" suggestions.
+   */
+  idx = -1;
+  hash = 0;
+  tab = pr_stash_get_symbol2(PR_SYM_CONF, NULL, NULL, &idx, &hash);
+  while (idx != -1) {
+    if (tab != NULL) {
+      i = tab - conftabs;
+      fail_unless(i < nsyms, "Unexpected symbol %p", tab);
+      fail_unless(seen[i] == FALSE, "Symbol '%s' listed twice",
+        tab->directive);
+
+      seen[i] = TRUE;
+      nseen++;
+
+    } else {
+      idx++;
+    }
+
+    tab = pr_stash_get_symbol2(PR_SYM_CONF, NULL, tab, &idx, &hash);
+  }
+
+  fail_unless(nseen == nsyms, "Expected %u symbols, got %u", nsyms, nseen);
+}
+END_TEST
+
+START_TEST (stash_free_indexes_test) {
+  int res;
+  void *sym;
+  module m1, m2;
+  conftable conftab1, conftab2;
+  unsigned int generation;
+
+  mark_point();
+  pr_stash_free_indexes();
+
+  memset(&m1, 0, sizeof(m1));
+  m1.name = "one";
+  m1.priority = 1;
+
+  memset(&m2, 0, sizeof(m2));
+  m2.name = "two";
+  m2.priority = 2;
+
+  memset(&conftab1, 0, sizeof(conftab1));
+  conftab1.directive = pstrdup(p, "Foo");
+  conftab1.m = &m1;
+  res = pr_stash_add_symbol(PR_SYM_CONF, &conftab1);
+  fail_unless(res == 0, "Failed to add CONF symbol: %s", strerror(errno));
+
+  memset(&conftab2, 0, sizeof(conftab2));
+  conftab2.directive = pstrdup(p, "Foo");
+  conftab2.m = &m2;
+  res = pr_stash_add_symbol(PR_SYM_CONF, &conftab2);
+  fail_unless(res == 0, "Failed to add CONF symbol: %s", strerror(errno));
+
+  sym = pr_stash_get_symbol2(PR_SYM_CONF, "Foo", NULL, NULL, NULL);
+  fail_unless(sym == &conftab2, "Expected %p, got %p", &conftab2, sym);
+
+  /* Freeing the indexes does not change the symbols, nor interrupt a lookup
+   * of all of the symbols of a name.
+   */
+  generation = pr_stash_get_generation();
+  pr_stash_free_indexes();
+  fail_unless(pr_stash_get_generation() == generation,
+    "Expected generation %u, got %u", generation, pr_stash_get_generation());
+
+  sym = pr_stash_get_symbol2(PR_SYM_CONF, "Foo", sym, NULL, NULL);
+  fail_unless(sym == &conftab1, "Expected %p, got %p", &conftab1, sym);
+
+  pr_stash_free_indexes();
+
+  sym = pr_stash_get_symbol2(PR_SYM_CONF, "foo", NULL, NULL, NULL);
+  fail_unless(sym == &conftab2, "Expected %p, got %p", &conftab2, sym);
+}
+END_TEST
+
 Suite *tests_get_stash_suite(void) {
   Suite *suite;
   TCase *testcase;
@@ -604,6 +842,10 @@ Suite *tests_get_stash_suite(void) {
   tcase_add_test(testcase, stash_remove_cmd_test);
   tcase_add_test(testcase, stash_remove_auth_test);
   tcase_add_test(testcase, stash_remove_hook_test);
+  tcase_add_test(testcase, stash_get_generation_test);
+  tcase_add_test(testcase, stash_get_symbol_index_test);
+  tcase_add_test(testcase, stash_get_symbol2_all_test);
+  tcase_add_test(testcase, stash_free_indexes_test);
 
   suite_add_tcase(suite, testcase);
   return suite;
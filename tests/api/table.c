@@ -787,6 +787,274 @@ START_TEST (table_pcalloc_test) {
 }
 END_TEST
 
+START_TEST (table_open_addr_test) {
+  register unsigned int i;
+  int res;
+  pr_table_t *tab;
+  const char *key, **keys;
+  const void *v;
+  unsigned int nkeys = 500, count;
+  size_t sz;
+
+  tab = pr_table_alloc(p, PR_TABLE_FL_OPEN_ADDR);
+  fail_unless(tab != NULL, "Failed to allocate table: %s", strerror(errno));
+
+  key = pr_table_next(tab);
+  fail_unless(key == NULL, "Failed to handle empty table");
+  fail_unless(errno == EPERM, "Failed to set errno to EPERM");
+
+  mark_point();
+  res = pr_table_ctl(tab, PR_TABLE_CTL_SET_ENT_INSERT, NULL);
+  fail_unless(res < 0, "Failed to reject SET_ENT_INSERT");
+  fail_unless(errno == EPERM, "Expected EPERM (%d), got %s (%d)", EPERM,
+    strerror(errno), errno);
+
+  /* Enough keys, both short (stored inline) and long, to force the table
+   * to grow several times.
+   */
+  keys = pcalloc(p, sizeof(char *) * nkeys);
+  for (i = 0; i < nkeys; i++) {
+    char buf[64];
+
+    if (i % 2 == 0) {
+      snprintf(buf, sizeof(buf), "k%u", i);
+
+    } else {
+      snprintf(buf, sizeof(buf), "a-rather-longer-key-number-%u", i);
+    }
+
+    keys[i] = pstrdup(p, buf);
+    res = pr_table_add(tab, keys[i], keys[i], 0);
+    fail_unless(res == 0, "Failed to add '%s': %s", keys[i], strerror(errno));
+  }
+
+  res = pr_table_count(tab);
+  fail_unless(res == (int) nkeys, "Expected count %u, got %d", nkeys, res);
+
+  res = pr_table_add(tab, "k0", "dup", 0);
+  fail_unless(res < 0, "Added duplicate key unexpectedly");
+  fail_unless(errno == EEXIST, "Expected EEXIST (%d), got %s (%d)", EEXIST,
+    strerror(errno), errno);
+
+  for (i = 0; i < nkeys; i++) {
+    char buf[64];
+
+    /* Look up using a different pointer to the same key data. */
+    sstrncpy(buf, keys[i], sizeof(buf));
+    v = pr_table_get(tab, buf, &sz);
+    fail_unless(v == keys[i], "Failed to get '%s': %s", buf, strerror(errno));
+    fail_unless(sz == strlen(keys[i]) + 1, "Expected len %lu, got %lu",
+      (unsigned long) strlen(keys[i]) + 1, (unsigned long) sz);
+
+    res = pr_table_exists(tab, buf);
+    fail_unless(res == 1, "Expected count 1 for '%s', got %d", buf, res);
+  }
+
+  v = pr_table_get(tab, "nosuchkey", NULL);
+  fail_unless(v == NULL, "Found missing key unexpectedly");
+  fail_unless(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  res = pr_table_set(tab, "k2", "new", 0);
+  fail_unless(res == 0, "Failed to set 'k2': %s", strerror(errno));
+
+  v = pr_table_get(tab, "k2", NULL);
+  fail_unless(v != NULL && strcmp(v, "new") == 0, "Failed to get new value");
+
+  /* Every key is visited exactly once. */
+  count = 0;
+  pr_table_rewind(tab);
+  for (key = pr_table_next(tab); key != NULL; key = pr_table_next(tab)) {
+    count++;
+  }
+  fail_unless(count == nkeys, "Expected %u keys, iterated %u", nkeys, count);
+
+  /* Remove and re-add half of the keys, repeatedly, leaving deleted slots
+   * for the table to reclaim.
+   */
+  for (count = 0; count < 10; count++) {
+    for (i = 0; i < nkeys; i += 2) {
+      v = pr_table_remove(tab, keys[i], NULL);
+      fail_unless(v != NULL, "Failed to remove '%s': %s", keys[i],
+        strerror(errno));
+    }
+
+    for (i = 0; i < nkeys; i += 2) {
+      res = pr_table_add(tab, keys[i], keys[i], 0);
+      fail_unless(res == 0, "Failed to re-add '%s': %s", keys[i],
+        strerror(errno));
+    }
+  }
+
+  for (i = 0; i < nkeys; i++) {
+    v = pr_table_get(tab, keys[i], NULL);
+    fail_unless(v == keys[i], "Failed to get '%s': %s", keys[i],
+      strerror(errno));
+  }
+
+  b_val_count = 0;
+  res = pr_table_add(tab, "bkey", "b", 0);
+  fail_unless(res == 0, "Failed to add 'bkey': %s", strerror(errno));
+
+  res = pr_table_do(tab, do_with_remove_cb, tab, PR_TABLE_DO_FL_ALL);
+  fail_unless(res == 0, "Failed to do table: %s", strerror(errno));
+  fail_unless(b_val_count == 1, "Expected count %u, got %u", 1, b_val_count);
+
+  res = pr_table_count(tab);
+  fail_unless(res == 0, "Expected count 0, got %d", res);
+
+  res = pr_table_free(tab);
+  fail_unless(res == 0, "Failed to free table: %s", strerror(errno));
+}
+END_TEST
+
+START_TEST (table_open_addr_multi_value_test) {
+  int res;
+  pr_table_t *tab;
+  const char *key = "foo";
+  const void *v;
+  unsigned int nchains = 1;
+
+  tab = pr_table_nalloc(p, PR_TABLE_FL_OPEN_ADDR|PR_TABLE_FL_MULTI_VALUE, 1);
+  fail_unless(tab != NULL, "Failed to allocate table: %s", strerror(errno));
+
+  /* Force every key into the same probe sequence. */
+  res = pr_table_ctl(tab, PR_TABLE_CTL_SET_KEY_HASH, cache_key_hash);
+  fail_unless(res == 0, "Failed to set key hash function for table: %s",
+    strerror(errno));
+
+  res = pr_table_ctl(tab, PR_TABLE_CTL_SET_NCHAINS, &nchains);
+  fail_unless(res == 0, "Failed to handle SET_NCHAINS: %s", strerror(errno));
+
+  res = pr_table_add(tab, key, "a", 0);
+  fail_unless(res == 0, "Failed to add value: %s", strerror(errno));
+  res = pr_table_add(tab, "bar", "x", 0);
+  fail_unless(res == 0, "Failed to add value: %s", strerror(errno));
+  res = pr_table_add(tab, key, "b", 0);
+  fail_unless(res == 0, "Failed to add value: %s", strerror(errno));
+  res = pr_table_add(tab, key, "c", 0);
+  fail_unless(res == 0, "Failed to add value: %s", strerror(errno));
+
+  res = pr_table_exists(tab, key);
+  fail_unless(res == 3, "Expected count 3, got %d", res);
+
+  /* Repeated lookups of the same key pointer return the values in order. */
+  v = pr_table_get(tab, key, NULL);
+  fail_unless(v != NULL && strcmp(v, "a") == 0, "Expected 'a'");
+  v = pr_table_get(tab, key, NULL);
+  fail_unless(v != NULL && strcmp(v, "b") == 0, "Expected 'b'");
+  v = pr_table_get(tab, key, NULL);
+  fail_unless(v != NULL && strcmp(v, "c") == 0, "Expected 'c'");
+  v = pr_table_get(tab, key, NULL);
+  fail_unless(v == NULL, "Expected no more values");
+  fail_unless(errno == ENOENT, "Expected ENOENT (%d), got %s (%d)", ENOENT,
+    strerror(errno), errno);
+
+  /* Removal takes the first value. */
+  v = pr_table_remove(tab, key, NULL);
+  fail_unless(v != NULL && strcmp(v, "a") == 0, "Expected to remove 'a'");
+
+  pr_table_get(tab, NULL, NULL);
+  v = pr_table_get(tab, key, NULL);
+  fail_unless(v != NULL && strcmp(v, "b") == 0, "Expected 'b'");
+
+  res = pr_table_count(tab);
+  fail_unless(res == 3, "Expected count 3, got %d", res);
+
+  /* Removing every value during iteration still visits each one. */
+  b_val_count = 0;
+  res = pr_table_do(tab, do_with_remove_cb, tab, PR_TABLE_DO_FL_ALL);
+  fail_unless(res == 0, "Failed to do table: %s", strerror(errno));
+  fail_unless(b_val_count == 1, "Expected count %u, got %u", 1, b_val_count);
+
+  res = pr_table_count(tab);
+  fail_unless(res == 0, "Expected count 0, got %d", res);
+
+  pr_table_dump(table_dump, tab);
+}
+END_TEST
+
+static unsigned int table_bench_fill(pr_table_t *tab, const char **keys,
+    unsigned int nkeys, unsigned int nlookups) {
+  register unsigned int i;
+  unsigned int nfound = 0;
+
+  for (i = 0; i < nkeys; i++) {
+    (void) pr_table_add(tab, keys[i], keys[i], 0);
+  }
+
+  for (i = 0; i < nlookups; i++) {
+    if (pr_table_get(tab, keys[i % nkeys], NULL) != NULL) {
+      nfound++;
+    }
+  }
+
+  (void) pr_table_empty(tab);
+  return nfound;
+}
+
+START_TEST (table_open_addr_bench_test) {
+  register unsigned int i;
+  struct {
+    const char *name;
+    unsigned int nchains, nkeys, nlookups;
+  } loads[] = {
+    { "cmd notes", 8, 4, 16 },
+    { "session notes", 32, 24, 200 },
+    { "large", 256, 4000, 40000 },
+    { NULL, 0, 0, 0 }
+  };
+  unsigned int nreps = 200;
+
+  for (i = 0; loads[i].name != NULL; i++) {
+    register unsigned int j;
+    const char **keys;
+    int flags[2] = { 0, PR_TABLE_FL_OPEN_ADDR };
+    double elapsed[2];
+
+    keys = pcalloc(p, sizeof(char *) * loads[i].nkeys);
+    for (j = 0; j < loads[i].nkeys; j++) {
+      char buf[64];
+
+      snprintf(buf, sizeof(buf), "mod_bench.key-%u", j);
+      keys[j] = pstrdup(p, buf);
+    }
+
+    for (j = 0; j < 2; j++) {
+      register unsigned int k;
+      struct timeval start, end;
+      unsigned int nfound = 0;
+
+      gettimeofday(&start, NULL);
+      for (k = 0; k < nreps; k++) {
+        pool *tmp_pool;
+        pr_table_t *tab;
+
+        tmp_pool = make_sub_pool(p);
+        tab = pr_table_nalloc(tmp_pool, flags[j], loads[i].nchains);
+
+        nfound = table_bench_fill(tab, keys, loads[i].nkeys,
+          loads[i].nlookups);
+        destroy_pool(tmp_pool);
+      }
+      gettimeofday(&end, NULL);
+
+      fail_unless(nfound == loads[i].nlookups,
+        "Load '%s': expected %u lookups to succeed, got %u", loads[i].name,
+        loads[i].nlookups, nfound);
+
+      elapsed[j] = (((end.tv_sec - start.tv_sec) * 1000000.0) +
+        (end.tv_usec - start.tv_usec)) / nreps;
+    }
+
+    if (getenv("TEST_VERBOSE") != NULL) {
+      fprintf(stdout, "table load '%s': chained %.1f us, open addressing "
+        "%.1f us\n", loads[i].name, elapsed[0], elapsed[1]);
+    }
+  }
+}
+END_TEST
+
 Suite *tests_get_table_suite(void) {
   Suite *suite;
   TCase *testcase;
@@ -816,6 +1084,9 @@ Suite *tests_get_table_suite(void) {
   tcase_add_test(testcase, table_load_test);
   tcase_add_test(testcase, table_dump_test);
   tcase_add_test(testcase, table_pcalloc_test);
+  tcase_add_test(testcase, table_open_addr_test);
+  tcase_add_test(testcase, table_open_addr_multi_value_test);
+  tcase_add_test(testcase, table_open_addr_bench_test);
 
   suite_add_tcase(suite, testcase);
   return suite;
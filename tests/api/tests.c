@@ -73,6 +73,7 @@ static struct testsuite_info suites[] = {
   { "jot",		tests_get_jot_suite },
   { "redis",		tests_get_redis_suite },
   { "error",		tests_get_error_suite },
+  { "ioloop",		tests_get_ioloop_suite },
 
   { NULL, NULL }
 };
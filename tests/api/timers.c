@@ -243,6 +243,47 @@ START_TEST (timer_reset_test) {
 }
 END_TEST
 
+START_TEST (timer_reset_many_test) {
+  int res;
+  register unsigned int i;
+  time_t start;
+
+  mark_point();
+  res = pr_timer_add(1, 1, NULL, timers_test_cb, "test");
+  fail_unless(res == 1, "Failed to add timer: %s", strerror(errno));
+
+  /* Resetting a timer, as is done for every buffer of a data transfer,
+   * must not fire it, nor lose it.
+   */
+  for (i = 0; i < 100000; i++) {
+    res = pr_timer_reset(1, NULL);
+    fail_unless(res == 1, "Failed to reset timer: %s", strerror(errno));
+  }
+
+  timers_handle_signals();
+  fail_unless(timer_triggered_count == 0,
+    "Timer fired unexpectedly (expected count 0, got %u)",
+    timer_triggered_count);
+
+  /* The alarm scheduled when the timer was added interrupts sleep(3)
+   * before the reset timer expires, so keep waiting.
+   */
+  start = time(NULL);
+  while (timer_triggered_count == 0 &&
+         time(NULL) - start < 3) {
+    sleep(1);
+    timers_handle_signals();
+  }
+
+  fail_unless(timer_triggered_count == 1,
+    "Timer failed to fire (expected count 1, got %u)", timer_triggered_count);
+
+  res = pr_timer_reset(1, NULL);
+  fail_unless(res == 0, "Expected 0 when resetting removed timer, got %d",
+    res);
+}
+END_TEST
+
 START_TEST (timer_sleep_test) {
   int res;
 
@@ -287,6 +328,7 @@ Suite *tests_get_timers_suite(void) {
   tcase_add_test(testcase, timer_remove_test);
   tcase_add_test(testcase, timer_remove_multi_test);
   tcase_add_test(testcase, timer_reset_test);
+  tcase_add_test(testcase, timer_reset_many_test);
   tcase_add_test(testcase, timer_sleep_test);
   tcase_add_test(testcase, timer_usleep_test);
 
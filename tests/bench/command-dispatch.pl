@@ -0,0 +1,303 @@
+#!/usr/bin/env perl
+
+# Measures how many commands per second a single session handles, for a
+# chatty client sending many SIZE, MDTM and CWD commands, as e.g. mirroring
+# and synchronizing clients do.  The commands are pipelined in batches, so
+# that the round trips between client and server do not dominate.  On Linux,
+# the CPU time used by the session process, per command, is also reported.
+
+use strict;
+
+use Cwd qw(abs_path);
+use File::Path qw(mkpath);
+use File::Spec;
+use File::Temp qw(tempdir);
+use Getopt::Long;
+use IO::Socket::INET;
+use POSIX ();
+use Time::HiRes qw(gettimeofday sleep tv_interval);
+
+my $opts = {};
+GetOptions($opts, 'h|help', 'b|binary=s', 'c|commands=i', 'B|batch=i',
+  'r|runs=i', 'P|port=i');
+
+if ($opts->{h}) {
+  usage();
+}
+
+my $bench_dir = (File::Spec->splitpath(abs_path(__FILE__)))[1];
+
+my $proftpd = $opts->{b} || $ENV{PROFTPD_TEST_BIN} ||
+  File::Spec->catfile($bench_dir, '..', '..', 'proftpd');
+unless (-x $proftpd) {
+  die("Cannot execute '$proftpd'; use --binary to specify proftpd\n");
+}
+
+my $ncmds = $opts->{c} || 30000;
+my $batch = $opts->{B} || 100;
+my $nruns = $opts->{r} || 3;
+my $port = $opts->{P} || 2121;
+
+my $clock_ticks = POSIX::sysconf(POSIX::_SC_CLK_TCK()) || 100;
+
+my $user = 'proftpd';
+my $passwd = 'test';
+
+my $tmpdir = tempdir('proftpd-bench-XXXXXX', TMPDIR => 1, CLEANUP => 1);
+my ($config_file, $pid_file) = write_config($tmpdir, $port, $user, $passwd);
+
+my $res = system("$proftpd -c $config_file > /dev/null 2>&1");
+if ($res != 0) {
+  die("'$proftpd -c $config_file' failed: $?\n");
+}
+
+my $daemon_pid = wait_for_daemon($pid_file, $port);
+
+my @cmds = ("SIZE file.txt\r\n", "MDTM file.txt\r\n", "CWD dir\r\n",
+  "CWD ..\r\n");
+
+printf("%10s  %12s  %12s  %16s\n", 'commands', 'best (cmd/s)',
+  'mean (cmd/s)', 'best CPU (us/cmd)');
+
+my ($best, $total, $best_cpu);
+for (my $i = 0; $i < $nruns; $i++) {
+  my $client = login($port, $user, $passwd);
+  my $session_pid = get_session_pid($daemon_pid);
+  my $start_cpu = get_cpu_ticks($session_pid);
+
+  my $start = [gettimeofday()];
+
+  my $nsent = 0;
+  while ($nsent < $ncmds) {
+    my $buf = '';
+    my $n = 0;
+
+    while ($n < $batch &&
+           $nsent + $n < $ncmds) {
+      $buf .= $cmds[($nsent + $n) % scalar(@cmds)];
+      $n++;
+    }
+
+    $client->print($buf);
+
+    for (my $j = 0; $j < $n; $j++) {
+      read_response($client);
+    }
+
+    $nsent += $n;
+  }
+
+  my $elapsed = tv_interval($start);
+  my $rate = $ncmds / $elapsed;
+  $total += $rate;
+
+  my $end_cpu = get_cpu_ticks($session_pid);
+  if (defined($start_cpu) &&
+      defined($end_cpu)) {
+    my $cpu = (($end_cpu - $start_cpu) / $clock_ticks) * 1000000 / $ncmds;
+
+    if (!defined($best_cpu) ||
+        $cpu < $best_cpu) {
+      $best_cpu = $cpu;
+    }
+  }
+
+  if (!defined($best) ||
+      $rate > $best) {
+    $best = $rate;
+  }
+
+  $client->print("QUIT\r\n");
+  $client->close();
+}
+
+printf("%10d  %12d  %12d  %16s\n", $ncmds, $best, $total / $nruns,
+  defined($best_cpu) ? sprintf("%.1f", $best_cpu) : 'n/a');
+
+kill('TERM', $daemon_pid);
+exit 0;
+
+# Returns the user and system CPU time, in clock ticks, used by the given
+# process, if known.
+sub get_cpu_ticks {
+  my $pid = shift;
+
+  return undef unless defined($pid);
+
+  open(my $fh, "< /proc/$pid/stat") or return undef;
+  my $stat = <$fh>;
+  close($fh);
+
+  # The utime and stime fields are the 12th and 13th after the
+  # parenthesized name.
+  $stat =~ s/^.*\)\s+//;
+  my @fields = split(' ', $stat);
+  return $fields[11] + $fields[12];
+}
+
+sub get_session_pid {
+  my $daemon_pid = shift;
+
+  opendir(my $dirh, '/proc') or return undef;
+  my @pids = grep { /^\d+$/ } readdir($dirh);
+  closedir($dirh);
+
+  foreach my $pid (@pids) {
+    open(my $fh, "< /proc/$pid/stat") or next;
+    my $stat = <$fh>;
+    close($fh);
+
+    if ($stat =~ /\)\s+(\S+)\s+(\d+)/ &&
+        $1 ne 'Z' &&
+        $2 == $daemon_pid) {
+      return $pid;
+    }
+  }
+
+  return undef;
+}
+
+sub read_response {
+  my $client = shift;
+
+  while (my $line = <$client>) {
+    # The last line of a (possibly multiline) response has a space after
+    # the response code.
+    if ($line =~ /^\d{3} /) {
+      return $line;
+    }
+  }
+
+  die("Connection closed unexpectedly\n");
+}
+
+sub login {
+  my $port = shift;
+  my $user = shift;
+  my $passwd = shift;
+
+  my $client = IO::Socket::INET->new(
+    PeerAddr => '127.0.0.1',
+    PeerPort => $port,
+    Proto => 'tcp',
+  ) or die("Can't connect to 127.0.0.1:$port: $!\n");
+
+  read_response($client);
+
+  $client->print("USER $user\r\n");
+  read_response($client);
+
+  $client->print("PASS $passwd\r\n");
+  my $resp = read_response($client);
+  unless ($resp =~ /^230/) {
+    die("Login failed: $resp");
+  }
+
+  return $client;
+}
+
+sub wait_for_daemon {
+  my $pid_file = shift;
+  my $port = shift;
+
+  for (my $i = 0; $i < 100; $i++) {
+    if (-s $pid_file) {
+      open(my $fh, "< $pid_file") or die("Can't read $pid_file: $!\n");
+      my $pid = <$fh>;
+      close($fh);
+      chomp($pid);
+
+      return $pid;
+    }
+
+    sleep(0.1);
+  }
+
+  die("Daemon did not start listening on port $port\n");
+}
+
+sub write_config {
+  my $dir = shift;
+  my $port = shift;
+  my $user = shift;
+  my $passwd = shift;
+
+  my $home_dir = File::Spec->catdir($dir, 'home');
+  mkpath(File::Spec->catdir($home_dir, 'dir'));
+
+  my $path = File::Spec->catfile($home_dir, 'file.txt');
+  open(my $fh, "> $path") or die("Can't write $path: $!\n");
+  print $fh "Hello, World!\n";
+  close($fh);
+
+  # When run as root, the daemon and the session run as nobody.
+  my ($daemon_user, $daemon_group) = ('nobody', 'nogroup');
+  my ($uid, $gid) = ($<, $();
+  if ($< == 0) {
+    $uid = (getpwnam('nobody'))[2];
+    $gid = (getpwnam('nobody'))[3];
+    chown($uid, $gid, $dir, $home_dir);
+
+  } else {
+    $daemon_user = getpwuid($<);
+    $daemon_group = getgrgid($();
+  }
+  $gid = (split(' ', $gid))[0];
+
+  my $auth_user_file = File::Spec->catfile($dir, 'passwd');
+  open($fh, "> $auth_user_file") or die("Can't write $auth_user_file: $!\n");
+  print $fh join(':', $user, crypt($passwd, '$1$proftpd$'), $uid, $gid, '',
+    $home_dir, '/bin/sh'), "\n";
+  close($fh);
+  chmod(0600, $auth_user_file);
+
+  my $auth_group_file = File::Spec->catfile($dir, 'group');
+  open($fh, "> $auth_group_file") or die("Can't write $auth_group_file: $!\n");
+  print $fh "ftpd:x:$gid:$user\n";
+  close($fh);
+  chmod(0600, $auth_group_file);
+
+  my $pid_file = File::Spec->catfile($dir, 'proftpd.pid');
+
+  my $config_file = File::Spec->catfile($dir, 'proftpd.conf');
+  open($fh, "> $config_file") or die("Can't write $config_file: $!\n");
+  print $fh <<EOC;
+ServerType standalone
+Port $port
+User $daemon_user
+Group $daemon_group
+PidFile $pid_file
+ScoreboardFile $dir/proftpd.scoreboard
+SystemLog $dir/proftpd.log
+AuthUserFile $auth_user_file
+AuthGroupFile $auth_group_file
+AuthOrder mod_auth_file.c
+RequireValidShell off
+UseReverseDNS off
+WtmpLog off
+<IfModule mod_ctrls.c>
+  ControlsEngine off
+</IfModule>
+<IfModule mod_delay.c>
+  DelayEngine off
+</IfModule>
+EOC
+  close($fh);
+
+  return ($config_file, $pid_file);
+}
+
+sub usage {
+  print STDOUT <<EOH;
+
+$0: [--help] [--binary path] [--commands n] [--batch n] [--runs n]
+  [--port n]
+
+Examples:
+
+  perl $0
+  perl $0 --binary /usr/local/sbin/proftpd --commands 100000
+
+EOH
+  exit 0;
+}
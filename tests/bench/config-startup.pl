@@ -0,0 +1,144 @@
+#!/usr/bin/env perl
+
+# Measures how long proftpd takes to parse, and check, a configuration with
+# many <VirtualHost> sections (each with <Directory> and <Limit> sections),
+# spread over many Include files, as happens on startup and on restart.
+
+use strict;
+
+use Cwd qw(abs_path);
+use File::Path qw(mkpath);
+use File::Spec;
+use File::Temp qw(tempdir);
+use Getopt::Long;
+use Time::HiRes qw(gettimeofday tv_interval);
+
+my $opts = {};
+GetOptions($opts, 'h|help', 'b|binary=s', 'n|vhosts=s', 'p|per-file=i',
+  'r|runs=i');
+
+if ($opts->{h}) {
+  usage();
+}
+
+my $bench_dir = (File::Spec->splitpath(abs_path(__FILE__)))[1];
+
+my $proftpd = $opts->{b} || $ENV{PROFTPD_TEST_BIN} ||
+  File::Spec->catfile($bench_dir, '..', '..', 'proftpd');
+unless (-x $proftpd) {
+  die("Cannot execute '$proftpd'; use --binary to specify proftpd\n");
+}
+
+my $vhost_counts = [split(/,/, $opts->{n} || '500,1000,2000,4000')];
+my $per_file = $opts->{p} || 50;
+my $nruns = $opts->{r} || 3;
+
+my $tmpdir = tempdir('proftpd-bench-XXXXXX', TMPDIR => 1, CLEANUP => 1);
+
+printf("%8s  %10s  %10s\n", 'vhosts', 'best (s)', 'mean (s)');
+
+foreach my $nvhosts (@$vhost_counts) {
+  my $config_file = write_config($tmpdir, $nvhosts, $per_file);
+
+  my ($best, $total);
+  for (my $i = 0; $i < $nruns; $i++) {
+    my $start = [gettimeofday()];
+
+    my $res = system("$proftpd -t -c $config_file > /dev/null 2>&1");
+    if ($res != 0) {
+      die("'$proftpd -t -c $config_file' failed: $?\n");
+    }
+
+    my $elapsed = tv_interval($start);
+    $total += $elapsed;
+
+    if (!defined($best) ||
+        $elapsed < $best) {
+      $best = $elapsed;
+    }
+  }
+
+  printf("%8d  %10.3f  %10.3f\n", $nvhosts, $best, $total / $nruns);
+}
+
+exit 0;
+
+sub write_config {
+  my $dir = shift;
+  my $nvhosts = shift;
+  my $per_file = shift;
+
+  my $conf_dir = File::Spec->catdir($dir, $nvhosts);
+  my $vhosts_dir = File::Spec->catdir($conf_dir, 'vhosts');
+  mkpath($vhosts_dir);
+
+  my $config_file = File::Spec->catfile($conf_dir, 'proftpd.conf');
+  open(my $fh, "> $config_file") or die("Can't write $config_file: $!\n");
+  print $fh <<EOC;
+ServerType standalone
+Port 2121
+User nobody
+Group nogroup
+PidFile $conf_dir/proftpd.pid
+ScoreboardFile $conf_dir/proftpd.scoreboard
+UseReverseDNS off
+WtmpLog off
+<IfModule mod_ctrls.c>
+  ControlsEngine off
+</IfModule>
+<IfModule mod_delay.c>
+  DelayEngine off
+</IfModule>
+Include $vhosts_dir/*.conf
+EOC
+  close($fh);
+
+  for (my $i = 0; $i < $nvhosts; $i += $per_file) {
+    my $path = File::Spec->catfile($vhosts_dir, sprintf("%05d.conf", $i));
+    open($fh, "> $path") or die("Can't write $path: $!\n");
+
+    for (my $j = $i; $j < $nvhosts && $j < $i + $per_file; $j++) {
+      my $port = 10000 + $j;
+
+      print $fh <<EOC;
+<VirtualHost 127.0.0.1>
+  Port $port
+  ServerName "vhost $j"
+  DefaultRoot ~
+  <Directory /srv/ftp/$j>
+    AllowOverwrite on
+    <Limit WRITE>
+      DenyAll
+    </Limit>
+  </Directory>
+  <Directory /srv/ftp/$j/incoming>
+    <Limit STOR>
+      AllowAll
+    </Limit>
+  </Directory>
+  <Limit LOGIN>
+    AllowAll
+  </Limit>
+</VirtualHost>
+EOC
+    }
+
+    close($fh);
+  }
+
+  return $config_file;
+}
+
+sub usage {
+  print STDOUT <<EOH;
+
+$0: [--help] [--binary path] [--vhosts n,...] [--per-file n] [--runs n]
+
+Examples:
+
+  perl $0
+  perl $0 --binary /usr/local/sbin/proftpd --vhosts 1000,8000
+
+EOH
+  exit 0;
+}
@@ -0,0 +1,420 @@
+#!/usr/bin/env perl
+
+# Measures how a large download affects other users of the page cache, with
+# the default download path, with UseReadAhead, and with UseDirectIO.  While
+# the large file is downloaded, a separate process repeatedly reads a
+# smaller "hot" file, as e.g. other sessions downloading popular files would;
+# if the download evicts the hot file from the page cache, those reads slow
+# down.  The download rate, the hot file read rate, and how much the page
+# cache grew during the download are reported.  Linux only, as it reads
+# /proc/meminfo.
+#
+# For meaningful numbers, the large file should be larger than the free
+# memory, or the page cache should be dropped (as root) before each run,
+# using --drop-caches.
+
+use strict;
+
+use Cwd qw(abs_path);
+use File::Path qw(mkpath);
+use File::Spec;
+use File::Temp qw(tempdir);
+use Getopt::Long;
+use IO::Socket::INET;
+use POSIX ();
+use Time::HiRes qw(gettimeofday sleep tv_interval);
+
+my $opts = {};
+GetOptions($opts, 'h|help', 'b|binary=s', 'd|dir=s', 'D|drop-caches',
+  's|size=i', 'H|hot-size=i', 'r|runs=i', 'P|port=i');
+
+if ($opts->{h}) {
+  usage();
+}
+
+my $bench_dir = (File::Spec->splitpath(abs_path(__FILE__)))[1];
+
+my $proftpd = $opts->{b} || $ENV{PROFTPD_TEST_BIN} ||
+  File::Spec->catfile($bench_dir, '..', '..', 'proftpd');
+unless (-x $proftpd) {
+  die("Cannot execute '$proftpd'; use --binary to specify proftpd\n");
+}
+
+unless (-r '/proc/meminfo') {
+  die("Cannot read /proc/meminfo; Linux is needed\n");
+}
+
+if ($opts->{D} &&
+    $< != 0) {
+  die("Dropping the page cache requires root privileges\n");
+}
+
+# Sizes are in MB.
+my $size = $opts->{s} || 1024;
+my $hot_size = $opts->{H} || 64;
+my $nruns = $opts->{r} || 3;
+my $port = $opts->{P} || 2121;
+
+my $user = 'proftpd';
+my $passwd = 'test';
+
+# The files should be on a real disk, rather than e.g. a tmpfs /tmp, for
+# direct I/O to be supported, and for the page cache to matter.
+my $tmpdir = tempdir('proftpd-bench-XXXXXX', DIR => $opts->{d},
+  TMPDIR => ($opts->{d} ? 0 : 1), CLEANUP => 1);
+my $home_dir = write_files($tmpdir, $size, $hot_size);
+
+my $modes = [
+  [ 'default', '' ],
+  [ 'readahead', 'UseReadAhead on' ],
+  [ 'directio', 'UseDirectIO on' ],
+];
+
+printf("%10s  %15s  %15s  %17s\n", 'mode', 'download (MB/s)',
+  'hot read (MB/s)', 'cache growth (MB)');
+
+foreach my $mode (@$modes) {
+  my ($name, $directive) = @$mode;
+
+  my ($config_file, $pid_file) = write_config($tmpdir, $home_dir, $port,
+    $user, $passwd, $directive);
+
+  my $res = system("$proftpd -c $config_file > /dev/null 2>&1");
+  if ($res != 0) {
+    die("'$proftpd -c $config_file' failed: $?\n");
+  }
+
+  my $daemon_pid = wait_for_daemon($pid_file, $port);
+
+  my ($download_rate, $hot_rate, $growth) = (0, 0, 0);
+  for (my $i = 0; $i < $nruns; $i++) {
+    if ($opts->{D}) {
+      drop_caches();
+    }
+
+    # Make sure the hot file is cached before the download starts.
+    my $hot_path = File::Spec->catfile($home_dir, 'hot.dat');
+    read_file($hot_path, undef);
+
+    my $start_cached = get_cached_kb();
+
+    my ($hot_pid, $hot_fh) = start_hot_reader($hot_path);
+    my $rate = download($port, $user, $passwd, 'big.dat', $size);
+    my $hot_bytes = stop_hot_reader($hot_pid, $hot_fh);
+
+    $growth += (get_cached_kb() - $start_cached) / 1024;
+    $download_rate += $rate;
+    $hot_rate += $hot_bytes->{rate};
+  }
+
+  printf("%10s  %15.1f  %15.1f  %17.1f\n", $name, $download_rate / $nruns,
+    $hot_rate / $nruns, $growth / $nruns);
+
+  kill('TERM', $daemon_pid);
+  while (kill(0, $daemon_pid)) {
+    sleep(0.1);
+  }
+}
+
+exit 0;
+
+sub get_cached_kb {
+  open(my $fh, '< /proc/meminfo') or die("Can't read /proc/meminfo: $!\n");
+  while (my $line = <$fh>) {
+    if ($line =~ /^Cached:\s+(\d+) kB/) {
+      close($fh);
+      return $1;
+    }
+  }
+  close($fh);
+
+  return 0;
+}
+
+sub drop_caches {
+  system('sync');
+
+  open(my $fh, '> /proc/sys/vm/drop_caches') or
+    die("Can't write /proc/sys/vm/drop_caches: $!\n");
+  print $fh "3\n";
+  close($fh);
+}
+
+# Reads the given file, returning the number of bytes read.  If given a
+# reference to a flag, the file is read repeatedly, until the flag is set.
+sub read_file {
+  my $path = shift;
+  my $stop = shift;
+
+  my $nread = 0;
+  while (1) {
+    open(my $fh, "< $path") or die("Can't read $path: $!\n");
+    binmode($fh);
+
+    my $buf;
+    while (my $len = sysread($fh, $buf, 65536)) {
+      $nread += $len;
+    }
+    close($fh);
+
+    last unless defined($stop);
+    last if ${$stop};
+  }
+
+  return $nread;
+}
+
+sub start_hot_reader {
+  my $path = shift;
+
+  pipe(my $rfh, my $wfh) or die("Can't create pipe: $!\n");
+
+  my $pid = fork();
+  die("Can't fork: $!\n") unless defined($pid);
+
+  if ($pid == 0) {
+    close($rfh);
+
+    my $stop = 0;
+    local $SIG{TERM} = sub { $stop = 1 };
+
+    my $start = [gettimeofday()];
+    my $nread = read_file($path, \$stop);
+    my $elapsed = tv_interval($start);
+
+    print $wfh "$nread $elapsed\n";
+    close($wfh);
+    POSIX::_exit(0);
+  }
+
+  close($wfh);
+  return ($pid, $rfh);
+}
+
+sub stop_hot_reader {
+  my $pid = shift;
+  my $fh = shift;
+
+  kill('TERM', $pid);
+  my $line = <$fh>;
+  close($fh);
+  waitpid($pid, 0);
+
+  my ($nread, $elapsed) = split(' ', $line || '0 1');
+  return { rate => ($nread / (1024 * 1024)) / ($elapsed || 1) };
+}
+
+sub read_response {
+  my $client = shift;
+
+  while (my $line = <$client>) {
+    # The last line of a (possibly multiline) response has a space after
+    # the response code.
+    if ($line =~ /^\d{3} /) {
+      return $line;
+    }
+  }
+
+  die("Connection closed unexpectedly\n");
+}
+
+# Downloads the given file, discarding the data, and returns the rate, in
+# MB/s.
+sub download {
+  my $port = shift;
+  my $user = shift;
+  my $passwd = shift;
+  my $path = shift;
+  my $size = shift;
+
+  my $client = IO::Socket::INET->new(
+    PeerAddr => '127.0.0.1',
+    PeerPort => $port,
+    Proto => 'tcp',
+  ) or die("Can't connect to 127.0.0.1:$port: $!\n");
+
+  read_response($client);
+
+  $client->print("USER $user\r\n");
+  read_response($client);
+
+  $client->print("PASS $passwd\r\n");
+  my $resp = read_response($client);
+  unless ($resp =~ /^230/) {
+    die("Login failed: $resp");
+  }
+
+  $client->print("TYPE I\r\n");
+  read_response($client);
+
+  $client->print("PASV\r\n");
+  $resp = read_response($client);
+  unless ($resp =~ /\((\d+),(\d+),(\d+),(\d+),(\d+),(\d+)\)/) {
+    die("PASV failed: $resp");
+  }
+  my $data_port = ($5 * 256) + $6;
+
+  my $data = IO::Socket::INET->new(
+    PeerAddr => '127.0.0.1',
+    PeerPort => $data_port,
+    Proto => 'tcp',
+  ) or die("Can't connect to 127.0.0.1:$data_port: $!\n");
+
+  my $start = [gettimeofday()];
+
+  $client->print("RETR $path\r\n");
+  read_response($client);
+
+  my ($buf, $nread) = ('', 0);
+  while (my $len = sysread($data, $buf, 1024 * 1024)) {
+    $nread += $len;
+  }
+  $data->close();
+
+  $resp = read_response($client);
+  my $elapsed = tv_interval($start);
+
+  unless ($resp =~ /^226/) {
+    die("RETR failed: $resp");
+  }
+
+  if ($nread != $size * 1024 * 1024) {
+    die("Downloaded $nread bytes, expected " . ($size * 1024 * 1024) . "\n");
+  }
+
+  $client->print("QUIT\r\n");
+  $client->close();
+
+  return ($nread / (1024 * 1024)) / $elapsed;
+}
+
+sub wait_for_daemon {
+  my $pid_file = shift;
+  my $port = shift;
+
+  for (my $i = 0; $i < 100; $i++) {
+    if (-s $pid_file) {
+      open(my $fh, "< $pid_file") or die("Can't read $pid_file: $!\n");
+      my $pid = <$fh>;
+      close($fh);
+      chomp($pid);
+
+      return $pid;
+    }
+
+    sleep(0.1);
+  }
+
+  die("Daemon did not start listening on port $port\n");
+}
+
+sub write_file {
+  my $path = shift;
+  my $size = shift;
+
+  open(my $fh, "> $path") or die("Can't write $path: $!\n");
+  binmode($fh);
+
+  my $buf = pack('N*', map { int(rand(0xffffffff)) } (1..262144));
+  for (my $i = 0; $i < $size; $i++) {
+    print $fh $buf;
+  }
+  close($fh);
+}
+
+sub write_files {
+  my $dir = shift;
+  my $size = shift;
+  my $hot_size = shift;
+
+  my $home_dir = File::Spec->catdir($dir, 'home');
+  mkpath($home_dir);
+
+  write_file(File::Spec->catfile($home_dir, 'big.dat'), $size);
+  write_file(File::Spec->catfile($home_dir, 'hot.dat'), $hot_size);
+
+  return $home_dir;
+}
+
+sub write_config {
+  my $dir = shift;
+  my $home_dir = shift;
+  my $port = shift;
+  my $user = shift;
+  my $passwd = shift;
+  my $directive = shift;
+
+  # When run as root, the daemon and the session run as nobody.
+  my ($daemon_user, $daemon_group) = ('nobody', 'nogroup');
+  my ($uid, $gid) = ($<, $();
+  if ($< == 0) {
+    $uid = (getpwnam('nobody'))[2];
+    $gid = (getpwnam('nobody'))[3];
+    chown($uid, $gid, $dir, $home_dir);
+
+  } else {
+    $daemon_user = getpwuid($<);
+    $daemon_group = getgrgid($();
+  }
+  $gid = (split(' ', $gid))[0];
+
+  my $auth_user_file = File::Spec->catfile($dir, 'passwd');
+  open(my $fh, "> $auth_user_file") or
+    die("Can't write $auth_user_file: $!\n");
+  print $fh join(':', $user, crypt($passwd, '$1$proftpd$'), $uid, $gid, '',
+    $home_dir, '/bin/sh'), "\n";
+  close($fh);
+  chmod(0600, $auth_user_file);
+
+  my $auth_group_file = File::Spec->catfile($dir, 'group');
+  open($fh, "> $auth_group_file") or die("Can't write $auth_group_file: $!\n");
+  print $fh "ftpd:x:$gid:$user\n";
+  close($fh);
+  chmod(0600, $auth_group_file);
+
+  my $pid_file = File::Spec->catfile($dir, 'proftpd.pid');
+
+  my $config_file = File::Spec->catfile($dir, 'proftpd.conf');
+  open($fh, "> $config_file") or die("Can't write $config_file: $!\n");
+  print $fh <<EOC;
+ServerType standalone
+Port $port
+User $daemon_user
+Group $daemon_group
+PidFile $pid_file
+ScoreboardFile $dir/proftpd.scoreboard
+SystemLog $dir/proftpd.log
+AuthUserFile $auth_user_file
+AuthGroupFile $auth_group_file
+AuthOrder mod_auth_file.c
+RequireValidShell off
+UseReverseDNS off
+WtmpLog off
+$directive
+<IfModule mod_ctrls.c>
+  ControlsEngine off
+</IfModule>
+<IfModule mod_delay.c>
+  DelayEngine off
+</IfModule>
+EOC
+  close($fh);
+
+  return ($config_file, $pid_file);
+}
+
+sub usage {
+  print STDOUT <<EOH;
+
+$0: [--help] [--binary path] [--dir path] [--drop-caches] [--size MB]
+  [--hot-size MB] [--runs n] [--port n]
+
+Examples:
+
+  perl $0 --dir /var/tmp
+  perl $0 --binary /usr/local/sbin/proftpd --dir /srv --size 8192 \\
+    --drop-caches
+
+EOH
+  exit 0;
+}
@@ -0,0 +1,258 @@
+#!/usr/bin/env perl
+
+# Measures how much of the daemon's memory each forked session process
+# shares with the daemon, for configurations with many <VirtualHost>
+# sections, each with its own listening socket.  Every session inherits
+# the daemon's parsed configuration and bindings; the pages a session
+# writes to are copied, and show up as that session's Private_Dirty
+# memory.  Linux only, as it reads /proc/<pid>/smaps_rollup.
+
+use strict;
+
+use Cwd qw(abs_path);
+use File::Path qw(mkpath);
+use File::Spec;
+use File::Temp qw(tempdir);
+use Getopt::Long;
+use IO::Socket::INET;
+use Time::HiRes qw(sleep);
+
+my $opts = {};
+GetOptions($opts, 'h|help', 'b|binary=s', 'n|vhosts=s', 'p|per-file=i',
+  's|sessions=i', 'P|port=i');
+
+if ($opts->{h}) {
+  usage();
+}
+
+my $bench_dir = (File::Spec->splitpath(abs_path(__FILE__)))[1];
+
+my $proftpd = $opts->{b} || $ENV{PROFTPD_TEST_BIN} ||
+  File::Spec->catfile($bench_dir, '..', '..', 'proftpd');
+unless (-x $proftpd) {
+  die("Cannot execute '$proftpd'; use --binary to specify proftpd\n");
+}
+
+unless (-r "/proc/$$/smaps_rollup") {
+  die("Cannot read /proc/$$/smaps_rollup; Linux 4.14 or later is needed\n");
+}
+
+my $vhost_counts = [split(/,/, $opts->{n} || '0,1000,4000')];
+my $per_file = $opts->{p} || 50;
+my $nsessions = $opts->{s} || 4;
+my $port = $opts->{P} || 2121;
+
+my $tmpdir = tempdir('proftpd-bench-XXXXXX', TMPDIR => 1, CLEANUP => 1);
+
+printf("%8s  %16s  %17s  %27s\n", 'vhosts', 'daemon Pss (kB)',
+  'session Pss (kB)', 'session Private_Dirty (kB)');
+
+foreach my $nvhosts (@$vhost_counts) {
+  my ($config_file, $pid_file) = write_config($tmpdir, $nvhosts, $per_file,
+    $port);
+
+  my $res = system("$proftpd -c $config_file > /dev/null 2>&1");
+  if ($res != 0) {
+    die("'$proftpd -c $config_file' failed: $?\n");
+  }
+
+  my $daemon_pid = wait_for_daemon($pid_file, $port);
+
+  my $clients = [];
+  for (my $i = 0; $i < $nsessions; $i++) {
+    my $client = IO::Socket::INET->new(
+      PeerAddr => '127.0.0.1',
+      PeerPort => $port,
+      Proto => 'tcp',
+    ) or die("Can't connect to 127.0.0.1:$port: $!\n");
+
+    # Wait for the banner, so that the session is fully set up.
+    my $banner = <$client>;
+    push(@$clients, $client);
+  }
+
+  my $daemon = read_smaps($daemon_pid);
+
+  my ($pss, $dirty) = (0, 0);
+  my $session_pids = get_session_pids($daemon_pid);
+  foreach my $session_pid (@$session_pids) {
+    my $session = read_smaps($session_pid);
+    $pss += $session->{Pss};
+    $dirty += $session->{Private_Dirty};
+  }
+
+  my $nfound = scalar(@$session_pids) || 1;
+  printf("%8d  %16d  %17d  %27d\n", $nvhosts, $daemon->{Pss}, $pss / $nfound,
+    $dirty / $nfound);
+
+  foreach my $client (@$clients) {
+    $client->close();
+  }
+
+  kill('TERM', $daemon_pid);
+  while (kill(0, $daemon_pid)) {
+    sleep(0.1);
+  }
+}
+
+exit 0;
+
+sub read_smaps {
+  my $pid = shift;
+
+  my $smaps = {};
+  my $path = "/proc/$pid/smaps_rollup";
+  open(my $fh, "< $path") or die("Can't read $path: $!\n");
+  while (my $line = <$fh>) {
+    if ($line =~ /^(\S+):\s+(\d+) kB/) {
+      $smaps->{$1} = $2;
+    }
+  }
+  close($fh);
+
+  return $smaps;
+}
+
+sub get_session_pids {
+  my $daemon_pid = shift;
+
+  my $pids = [];
+  opendir(my $dirh, '/proc') or die("Can't read /proc: $!\n");
+  foreach my $pid (grep { /^\d+$/ } readdir($dirh)) {
+    my $path = "/proc/$pid/stat";
+    open(my $fh, "< $path") or next;
+    my $stat = <$fh>;
+    close($fh);
+
+    # The parent pid is the second field after the parenthesized name.
+    if ($stat =~ /\)\s+\S+\s+(\d+)/ &&
+        $1 == $daemon_pid) {
+      push(@$pids, $pid);
+    }
+  }
+  closedir($dirh);
+
+  return $pids;
+}
+
+sub wait_for_daemon {
+  my $pid_file = shift;
+  my $port = shift;
+
+  # Parsing a large configuration can take a while.
+  for (my $i = 0; $i < 600; $i++) {
+    if (-s $pid_file) {
+      my $client = IO::Socket::INET->new(
+        PeerAddr => '127.0.0.1',
+        PeerPort => $port,
+        Proto => 'tcp',
+      );
+
+      if ($client) {
+        my $banner = <$client>;
+        $client->close();
+
+        open(my $fh, "< $pid_file") or die("Can't read $pid_file: $!\n");
+        my $pid = <$fh>;
+        close($fh);
+        chomp($pid);
+
+        # Let the daemon reap the session process for that probe.
+        sleep(0.5);
+        return $pid;
+      }
+    }
+
+    sleep(0.1);
+  }
+
+  die("Daemon did not start listening on port $port\n");
+}
+
+sub write_config {
+  my $dir = shift;
+  my $nvhosts = shift;
+  my $per_file = shift;
+  my $port = shift;
+
+  my $conf_dir = File::Spec->catdir($dir, $nvhosts);
+  my $vhosts_dir = File::Spec->catdir($conf_dir, 'vhosts');
+  mkpath($vhosts_dir);
+
+  my $pid_file = File::Spec->catfile($conf_dir, 'proftpd.pid');
+
+  my ($user, $group) = ('nobody', 'nogroup');
+  if ($< != 0) {
+    $user = getpwuid($<);
+    $group = getgrgid($();
+  }
+
+  my $config_file = File::Spec->catfile($conf_dir, 'proftpd.conf');
+  open(my $fh, "> $config_file") or die("Can't write $config_file: $!\n");
+  print $fh <<EOC;
+ServerType standalone
+Port $port
+User $user
+Group $group
+PidFile $pid_file
+ScoreboardFile $conf_dir/proftpd.scoreboard
+SystemLog $conf_dir/proftpd.log
+UseReverseDNS off
+WtmpLog off
+<IfModule mod_ctrls.c>
+  ControlsEngine off
+</IfModule>
+<IfModule mod_delay.c>
+  DelayEngine off
+</IfModule>
+EOC
+  if ($nvhosts > 0) {
+    print $fh "Include $vhosts_dir/*.conf\n";
+  }
+  close($fh);
+
+  for (my $i = 0; $i < $nvhosts; $i += $per_file) {
+    my $path = File::Spec->catfile($vhosts_dir, sprintf("%05d.conf", $i));
+    open($fh, "> $path") or die("Can't write $path: $!\n");
+
+    for (my $j = $i; $j < $nvhosts && $j < $i + $per_file; $j++) {
+      my $vhost_port = $port + 10000 + $j;
+
+      print $fh <<EOC;
+<VirtualHost 127.0.0.1>
+  Port $vhost_port
+  ServerName "vhost $j"
+  DefaultRoot ~
+  <Directory /srv/ftp/$j>
+    AllowOverwrite on
+    <Limit WRITE>
+      DenyAll
+    </Limit>
+  </Directory>
+  <Limit LOGIN>
+    AllowAll
+  </Limit>
+</VirtualHost>
+EOC
+    }
+
+    close($fh);
+  }
+
+  return ($config_file, $pid_file);
+}
+
+sub usage {
+  print STDOUT <<EOH;
+
+$0: [--help] [--binary path] [--vhosts n,...] [--per-file n] [--sessions n]
+  [--port n]
+
+Examples:
+
+  perl $0
+  perl $0 --binary /usr/local/sbin/proftpd --vhosts 0,8000 --sessions 8
+
+EOH
+  exit 0;
+}
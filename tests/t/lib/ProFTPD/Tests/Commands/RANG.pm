@@ -85,6 +85,16 @@ my $TESTS = {
     test_class => [qw(forking)],
   },
 
+  rang_retr_ok_with_readahead => {
+    order => ++$order,
+    test_class => [qw(forking)],
+  },
+
+  rang_retr_ok_with_direct_io => {
+    order => ++$order,
+    test_class => [qw(forking)],
+  },
+
   rang_retr_fails_bad_start => {
     order => ++$order,
     test_class => [qw(forking)],
@@ -1234,6 +1244,134 @@ sub rang_retr_ok_no_sendfile {
   test_cleanup($setup->{log_file}, $ex);
 }
 
+# Downloads a range, ending well before the end of a large file, with the
+# given configuration directive (e.g. UseReadAhead), which sends the file in
+# chunks larger than the transfer buffer.
+sub rang_retr_large_file {
+  my $self = shift;
+  my $directive = shift;
+  my $tmpdir = $self->{tmpdir};
+  my $setup = test_setup($tmpdir, 'cmds');
+
+  my $test_file = File::Spec->rel2abs("$tmpdir/test.dat");
+  my $data = '';
+  if (open(my $fh, "> $test_file")) {
+    binmode($fh);
+
+    my $buf = pack('N*', map { int(rand(0xffffffff)) } (1..1024));
+    for (my $i = 0; $i < 750; $i++) {
+      $data .= $buf;
+    }
+
+    print $fh $data;
+    unless (close($fh)) {
+      die("Can't write $test_file: $!");
+    }
+
+  } else {
+    die("Can't open $test_file: $!");
+  }
+
+  my $range_start = 1000;
+  my $range_end = 1600000;
+  my $expected = substr($data, $range_start, $range_end - $range_start + 1);
+
+  my $config = {
+    PidFile => $setup->{pid_file},
+    ScoreboardFile => $setup->{scoreboard_file},
+    SystemLog => $setup->{log_file},
+
+    AuthUserFile => $setup->{auth_user_file},
+    AuthGroupFile => $setup->{auth_group_file},
+    $directive => 'on',
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($setup->{config_file},
+    $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port, 0);
+      $client->login($setup->{user}, $setup->{passwd});
+      $client->type('binary');
+      $client->rang($range_start, $range_end);
+
+      my $conn = $client->retr_raw('test.dat');
+      unless ($conn) {
+        die("RETR test.dat failed: " . $client->response_code() . ' ' .
+          $client->response_msg());
+      }
+
+      my ($buf, $tmp) = ('', '');
+      while ($conn->read($tmp, 65536, 30)) {
+        $buf .= $tmp;
+      }
+      eval { $conn->close() };
+
+      my $resp_code = $client->response_code();
+      my $resp_msg = $client->response_msg();
+      $self->assert_transfer_ok($resp_code, $resp_msg);
+      $client->quit();
+
+      my $len = length($buf);
+      my $expected_len = length($expected);
+      $self->assert($len == $expected_len,
+        "Expected len $expected_len, got $len");
+      $self->assert($buf eq $expected, "Expected data does not match");
+    };
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($setup->{config_file}, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($setup->{pid_file});
+  $self->assert_child_ok($pid);
+
+  test_cleanup($setup->{log_file}, $ex);
+}
+
+sub rang_retr_ok_with_readahead {
+  my $self = shift;
+  $self->rang_retr_large_file('UseReadAhead');
+}
+
+sub rang_retr_ok_with_direct_io {
+  my $self = shift;
+  $self->rang_retr_large_file('UseDirectIO');
+}
+
 sub rang_retr_ok_end_exceeds_file_size {
   my $self = shift;
   my $tmpdir = $self->{tmpdir};
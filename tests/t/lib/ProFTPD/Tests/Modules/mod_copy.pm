@@ -9,7 +9,7 @@ use File::Spec;
 use IO::Handle;
 
 use ProFTPD::TestSuite::FTP;
-use ProFTPD::TestSuite::Utils qw(:auth :config :running :test :testsuite);
+use ProFTPD::TestSuite::Utils qw(:auth :config :features :running :test :testsuite);
 
 $| = 1;
 
@@ -121,6 +121,16 @@ my $TESTS = {
     test_class => [qw(bug forking)],
   },
 
+  copy_dir_max_workers => {
+    order => ++$order,
+    test_class => [qw(forking)],
+  },
+
+  copy_dir_max_workers_failure => {
+    order => ++$order,
+    test_class => [qw(forking)],
+  },
+
 };
 
 sub new {
@@ -3652,4 +3662,346 @@ sub copy_cpto_timeout_bug4263 {
   test_cleanup($setup->{log_file}, $ex);
 }
 
+# Creates a tree of directories and files of various sizes under the given
+# directory, returning the contents of each file, keyed by relative path.
+sub write_copy_tree {
+  my $dir = shift;
+  my $uid = shift;
+  my $gid = shift;
+
+  my $files = {};
+  my @subdirs = ('', 'a', 'b', 'b/c');
+
+  foreach my $subdir (@subdirs) {
+    my $path = File::Spec->catdir($dir, $subdir);
+    mkpath($path);
+
+    for (my $i = 0; $i < 6; $i++) {
+      my $name = ($subdir ? "$subdir/" : '') . "file$i.dat";
+      my $data = join('', map { chr(int(rand(256))) } (1..256)) x
+        (1 + ($i * 200));
+
+      my $file = File::Spec->catfile($dir, $name);
+      if (open(my $fh, "> $file")) {
+        binmode($fh);
+        print $fh $data;
+
+        unless (close($fh)) {
+          die("Can't write $file: $!");
+        }
+
+      } else {
+        die("Can't open $file: $!");
+      }
+
+      $files->{$name} = $data;
+    }
+  }
+
+  if ($< == 0) {
+    foreach my $subdir (@subdirs) {
+      my $path = File::Spec->catdir($dir, $subdir);
+      unless (chown($uid, $gid, $path)) {
+        die("Can't set owner of $path to $uid/$gid: $!");
+      }
+    }
+
+    foreach my $name (keys(%$files)) {
+      my $path = File::Spec->catfile($dir, $name);
+      unless (chown($uid, $gid, $path)) {
+        die("Can't set owner of $path to $uid/$gid: $!");
+      }
+    }
+  }
+
+  return $files;
+}
+
+sub read_copy_file {
+  my $path = shift;
+
+  my $data = '';
+  if (open(my $fh, "< $path")) {
+    binmode($fh);
+    local $/;
+    $data = <$fh>;
+    close($fh);
+
+  } else {
+    die("Can't read $path: $!");
+  }
+
+  return $data;
+}
+
+sub copy_dir_max_workers {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+  my $setup = test_setup($tmpdir, 'copy');
+
+  my $src_dir = File::Spec->rel2abs("$tmpdir/src");
+  my $files = write_copy_tree($src_dir, $setup->{uid}, $setup->{gid});
+
+  my $dst_dir = File::Spec->rel2abs("$tmpdir/dst");
+
+  my $config = {
+    PidFile => $setup->{pid_file},
+    ScoreboardFile => $setup->{scoreboard_file},
+    SystemLog => $setup->{log_file},
+    TraceLog => $setup->{log_file},
+    Trace => 'copy:20',
+
+    AuthUserFile => $setup->{auth_user_file},
+    AuthGroupFile => $setup->{auth_group_file},
+
+    IfModules => {
+      'mod_copy.c' => {
+        CopyMaxWorkers => 4,
+      },
+
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($setup->{config_file},
+    $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port);
+      $client->login($setup->{user}, $setup->{passwd});
+
+      my ($resp_code, $resp_msg) = $client->site('CPFR', 'src');
+
+      my $expected = 350;
+      $self->assert($expected == $resp_code,
+        test_msg("Expected response code $expected, got $resp_code"));
+
+      ($resp_code, $resp_msg) = $client->site('CPTO', 'dst');
+
+      $expected = 250;
+      $self->assert($expected == $resp_code,
+        test_msg("Expected response code $expected, got $resp_code"));
+
+      $expected = "Copy successful";
+      $self->assert($expected eq $resp_msg,
+        test_msg("Expected response message '$expected', got '$resp_msg'"));
+
+      # The session must still be usable once the workers are gone.
+      ($resp_code, $resp_msg) = $client->noop();
+
+      $expected = 200;
+      $self->assert($expected == $resp_code,
+        test_msg("Expected response code $expected, got $resp_code"));
+
+      $client->quit();
+
+      foreach my $name (sort(keys(%$files))) {
+        my $dst_file = File::Spec->catfile($dst_dir, $name);
+        unless (-f $dst_file) {
+          die("File $dst_file does not exist as expected");
+        }
+
+        my $data = read_copy_file($dst_file);
+        $self->assert($data eq $files->{$name},
+          test_msg("Contents of $dst_file do not match"));
+      }
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($setup->{config_file}, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($setup->{pid_file});
+  $self->assert_child_ok($pid);
+
+  eval {
+    # Modules handling COPY commands themselves (e.g. mod_quotatab) need
+    # the files to be copied one at a time.
+    my $expected = 'started 4 copy workers';
+    if (feature_have_module_compiled('mod_quotatab.c')) {
+      $expected = 'COPY handlers present';
+    }
+
+    my $found = 0;
+    if (open(my $fh, "< $setup->{log_file}")) {
+      while (my $line = <$fh>) {
+        if (index($line, $expected) >= 0) {
+          $found = 1;
+          last;
+        }
+      }
+
+      close($fh);
+
+    } else {
+      die("Can't read $setup->{log_file}: $!");
+    }
+
+    $self->assert($found, test_msg("Did not see expected '$expected' log"));
+  };
+  if ($@) {
+    $ex = $@ unless $ex;
+  }
+
+  test_cleanup($setup->{log_file}, $ex);
+}
+
+sub copy_dir_max_workers_failure {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+  my $setup = test_setup($tmpdir, 'copy');
+
+  my $src_dir = File::Spec->rel2abs("$tmpdir/src");
+  my $files = write_copy_tree($src_dir, $setup->{uid}, $setup->{gid});
+
+  # Make one of the files partway through the tree unreadable, so that
+  # copying it fails.
+  my $bad_file = File::Spec->catfile($src_dir, 'b', 'file3.dat');
+  unless (chmod(0000, $bad_file)) {
+    die("Can't set perms on $bad_file to 0000: $!");
+  }
+
+  my $config = {
+    PidFile => $setup->{pid_file},
+    ScoreboardFile => $setup->{scoreboard_file},
+    SystemLog => $setup->{log_file},
+    TraceLog => $setup->{log_file},
+    Trace => 'copy:20',
+
+    AuthUserFile => $setup->{auth_user_file},
+    AuthGroupFile => $setup->{auth_group_file},
+
+    IfModules => {
+      'mod_copy.c' => {
+        CopyMaxWorkers => 4,
+      },
+
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($setup->{config_file},
+    $config);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port);
+      $client->login($setup->{user}, $setup->{passwd});
+
+      my ($resp_code, $resp_msg) = $client->site('CPFR', 'src');
+
+      my $expected = 350;
+      $self->assert($expected == $resp_code,
+        test_msg("Expected response code $expected, got $resp_code"));
+
+      eval { $client->site('CPTO', 'dst') };
+      unless ($@) {
+        die("SITE CPTO succeeded unexpectedly");
+      }
+
+      $resp_code = $client->response_code();
+      $resp_msg = $client->response_msg();
+
+      $expected = 550;
+      $self->assert($expected == $resp_code,
+        test_msg("Expected response code $expected, got $resp_code"));
+
+      $expected = 'Permission denied';
+      $self->assert($resp_msg =~ /$expected/,
+        test_msg("Expected response message '$expected', got '$resp_msg'"));
+
+      # The failure must not leave the session, or its workers, stuck; a
+      # later copy still works.
+      ($resp_code, $resp_msg) = $client->site('CPFR', 'src/a');
+
+      $expected = 350;
+      $self->assert($expected == $resp_code,
+        test_msg("Expected response code $expected, got $resp_code"));
+
+      ($resp_code, $resp_msg) = $client->site('CPTO', 'dst2');
+
+      $expected = 250;
+      $self->assert($expected == $resp_code,
+        test_msg("Expected response code $expected, got $resp_code"));
+
+      $client->quit();
+
+      foreach my $name (grep { /^a\// } keys(%$files)) {
+        my $dst_file = File::Spec->catfile($tmpdir, 'dst2',
+          substr($name, 2));
+        my $data = read_copy_file($dst_file);
+        $self->assert($data eq $files->{$name},
+          test_msg("Contents of $dst_file do not match"));
+      }
+    };
+
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($setup->{config_file}, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($setup->{pid_file});
+  $self->assert_child_ok($pid);
+
+  test_cleanup($setup->{log_file}, $ex);
+}
+
 1;
@@ -0,0 +1,1005 @@
+package ProFTPD::Tests::Modules::mod_filecache;
+
+use lib qw(t/lib);
+use base qw(ProFTPD::TestSuite::Child);
+use strict;
+
+use File::Spec;
+use IO::Handle;
+
+use ProFTPD::TestSuite::FTP;
+use ProFTPD::TestSuite::Utils qw(:auth :config :running :test :testsuite);
+
+$| = 1;
+
+my $order = 0;
+
+my $TESTS = {
+  filecache_retr_miss_then_hit => {
+    order => ++$order,
+    test_class => [qw(forking)],
+  },
+
+  filecache_stor_invalidates => {
+    order => ++$order,
+    test_class => [qw(forking)],
+  },
+
+  filecache_dele_invalidates => {
+    order => ++$order,
+    test_class => [qw(forking)],
+  },
+
+  filecache_rnto_invalidates => {
+    order => ++$order,
+    test_class => [qw(forking)],
+  },
+
+  filecache_rest_bypasses_cache => {
+    order => ++$order,
+    test_class => [qw(forking)],
+  },
+
+  filecache_rang_bypasses_cache => {
+    order => ++$order,
+    test_class => [qw(forking)],
+  },
+
+  filecache_ctrls_info => {
+    order => ++$order,
+    test_class => [qw(mod_ctrls)],
+  },
+
+};
+
+sub new {
+  return shift()->SUPER::new(@_);
+}
+
+sub list_tests {
+  return testsuite_get_runnable_tests($TESTS);
+}
+
+sub ftpdctl {
+  my $sock_file = shift;
+  my $ctrl_cmd = shift;
+
+  my $ftpdctl_bin;
+  if ($ENV{PROFTPD_TEST_PATH}) {
+    $ftpdctl_bin = "$ENV{PROFTPD_TEST_PATH}/ftpdctl";
+
+  } else {
+    $ftpdctl_bin = '../ftpdctl';
+  }
+
+  my $cmd = "$ftpdctl_bin -s $sock_file $ctrl_cmd";
+
+  if ($ENV{TEST_VERBOSE}) {
+    print STDERR "Executing ftpdctl: $cmd\n";
+  }
+
+  my @lines = `$cmd`;
+  return \@lines;
+}
+
+sub write_test_file {
+  my $path = shift;
+  my $len = shift;
+  my $uid = shift;
+  my $gid = shift;
+
+  my $data = substr(pack('N*', map { int(rand(0xffffffff)) }
+    (1..(($len / 4) + 1))), 0, $len);
+
+  if (open(my $fh, "> $path")) {
+    binmode($fh);
+    print $fh $data;
+
+    unless (close($fh)) {
+      die("Can't write $path: $!");
+    }
+
+  } else {
+    die("Can't open $path: $!");
+  }
+
+  if ($< == 0) {
+    unless (chown($uid, $gid, $path)) {
+      die("Can't set owner of $path to $uid/$gid: $!");
+    }
+  }
+
+  return $data;
+}
+
+sub retr_file {
+  my $client = shift;
+  my $path = shift;
+
+  my $conn = $client->retr_raw($path);
+  unless ($conn) {
+    die("RETR $path failed: " . $client->response_code() . ' ' .
+      $client->response_msg());
+  }
+
+  my ($buf, $tmp) = ('', '');
+  while ($conn->read($tmp, 16384, 25)) {
+    $buf .= $tmp;
+  }
+  eval { $conn->close() };
+
+  return $buf;
+}
+
+sub count_log_lines {
+  my $log_file = shift;
+  my $pattern = shift;
+
+  my $count = 0;
+  if (open(my $fh, "< $log_file")) {
+    while (my $line = <$fh>) {
+      if ($line =~ /$pattern/) {
+        $count++;
+      }
+    }
+
+    close($fh);
+
+  } else {
+    die("Can't read $log_file: $!");
+  }
+
+  return $count;
+}
+
+sub filecache_retr_miss_then_hit {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+  my $setup = test_setup($tmpdir, 'filecache');
+
+  my $test_file = File::Spec->rel2abs("$tmpdir/test.dat");
+  my $data = write_test_file($test_file, 20000, $setup->{uid}, $setup->{gid});
+
+  my $table_file = File::Spec->rel2abs("$tmpdir/filecache.tab");
+
+  my $config = {
+    PidFile => $setup->{pid_file},
+    ScoreboardFile => $setup->{scoreboard_file},
+    SystemLog => $setup->{log_file},
+    TraceLog => $setup->{log_file},
+    Trace => 'filecache:20 xfer:9',
+
+    AuthUserFile => $setup->{auth_user_file},
+    AuthGroupFile => $setup->{auth_group_file},
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_filecache.c' => {
+        FileCacheEngine => 'on',
+        FileCacheTable => $table_file,
+        FileCacheSize => '1 MB',
+        FileCacheMaxFileSize => '32 KB',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($setup->{config_file},
+    $config);
+
+  # Files which changed within the last second are not cached.
+  sleep(2);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port, 0);
+      $client->login($setup->{user}, $setup->{passwd});
+      $client->type('binary');
+
+      # The first download is a miss, which admits the file; the second one
+      # is a hit.  Both must serve the file as it is on disk.
+      for (my $i = 0; $i < 2; $i++) {
+        my $buf = retr_file($client, 'test.dat');
+        $self->assert_transfer_ok($client->response_code(),
+          $client->response_msg());
+
+        my $len = length($buf);
+        my $expected_len = length($data);
+        $self->assert($len == $expected_len,
+          test_msg("Expected len $expected_len, got $len"));
+        $self->assert($buf eq $data,
+          test_msg("Expected data does not match"));
+      }
+
+      $client->quit();
+    };
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($setup->{config_file}, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($setup->{pid_file});
+  $self->assert_child_ok($pid);
+
+  eval {
+    my $count = count_log_lines($setup->{log_file},
+      qr/stored '.*test\.dat' \(20000 bytes\) in cache/);
+    $self->assert($count == 1,
+      test_msg("Expected file to be stored once, got $count"));
+
+    $count = count_log_lines($setup->{log_file},
+      qr/cache hit for '.*test\.dat'/);
+    $self->assert($count == 1,
+      test_msg("Expected 1 cache hit, got $count"));
+
+    $count = count_log_lines($setup->{log_file},
+      qr/sending '.*test\.dat' \(20000 bytes\) from cache/);
+    $self->assert($count == 2,
+      test_msg("Expected 2 downloads from cache, got $count"));
+  };
+  if ($@) {
+    $ex = $@ unless $ex;
+  }
+
+  test_cleanup($setup->{log_file}, $ex);
+}
+
+sub filecache_stor_invalidates {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+  my $setup = test_setup($tmpdir, 'filecache');
+
+  my $test_file = File::Spec->rel2abs("$tmpdir/test.dat");
+  write_test_file($test_file, 20000, $setup->{uid}, $setup->{gid});
+
+  # Same size, different contents.
+  my $new_data = pack('N*', map { int(rand(0xffffffff)) } (1..5000));
+
+  my $table_file = File::Spec->rel2abs("$tmpdir/filecache.tab");
+
+  my $config = {
+    PidFile => $setup->{pid_file},
+    ScoreboardFile => $setup->{scoreboard_file},
+    SystemLog => $setup->{log_file},
+    TraceLog => $setup->{log_file},
+    Trace => 'filecache:20 xfer:9',
+
+    AuthUserFile => $setup->{auth_user_file},
+    AuthGroupFile => $setup->{auth_group_file},
+    AllowOverwrite => 'on',
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_filecache.c' => {
+        FileCacheEngine => 'on',
+        FileCacheTable => $table_file,
+        FileCacheSize => '1 MB',
+        FileCacheMaxFileSize => '32 KB',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($setup->{config_file},
+    $config);
+
+  # Files which changed within the last second are not cached.
+  sleep(2);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port, 0);
+      $client->login($setup->{user}, $setup->{passwd});
+      $client->type('binary');
+
+      retr_file($client, 'test.dat');
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+
+      my $conn = $client->stor_raw('test.dat');
+      unless ($conn) {
+        die("STOR test.dat failed: " . $client->response_code() . ' ' .
+          $client->response_msg());
+      }
+
+      $conn->write($new_data, length($new_data), 25);
+      eval { $conn->close() };
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+
+      my $buf = retr_file($client, 'test.dat');
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+
+      $self->assert($buf eq $new_data,
+        test_msg("Expected data of uploaded file, got stale data"));
+
+      $client->quit();
+    };
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($setup->{config_file}, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($setup->{pid_file});
+  $self->assert_child_ok($pid);
+
+  eval {
+    my $count = count_log_lines($setup->{log_file},
+      qr/removed '.*test\.dat' from cache/);
+    $self->assert($count == 1,
+      test_msg("Expected file to be removed from cache once, got $count"));
+
+    $count = count_log_lines($setup->{log_file},
+      qr/cache hit for '.*test\.dat'/);
+    $self->assert($count == 0,
+      test_msg("Expected no cache hits, got $count"));
+  };
+  if ($@) {
+    $ex = $@ unless $ex;
+  }
+
+  test_cleanup($setup->{log_file}, $ex);
+}
+
+sub filecache_dele_invalidates {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+  my $setup = test_setup($tmpdir, 'filecache');
+
+  my $test_file = File::Spec->rel2abs("$tmpdir/test.dat");
+  write_test_file($test_file, 20000, $setup->{uid}, $setup->{gid});
+
+  my $table_file = File::Spec->rel2abs("$tmpdir/filecache.tab");
+
+  my $config = {
+    PidFile => $setup->{pid_file},
+    ScoreboardFile => $setup->{scoreboard_file},
+    SystemLog => $setup->{log_file},
+    TraceLog => $setup->{log_file},
+    Trace => 'filecache:20 xfer:9',
+
+    AuthUserFile => $setup->{auth_user_file},
+    AuthGroupFile => $setup->{auth_group_file},
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_filecache.c' => {
+        FileCacheEngine => 'on',
+        FileCacheTable => $table_file,
+        FileCacheSize => '1 MB',
+        FileCacheMaxFileSize => '32 KB',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($setup->{config_file},
+    $config);
+
+  # Files which changed within the last second are not cached.
+  sleep(2);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port, 0);
+      $client->login($setup->{user}, $setup->{passwd});
+      $client->type('binary');
+
+      retr_file($client, 'test.dat');
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+
+      $client->dele('test.dat');
+
+      my $conn = $client->retr_raw('test.dat');
+      if ($conn) {
+        die("RETR test.dat succeeded unexpectedly");
+      }
+
+      my $resp_code = $client->response_code();
+      my $expected = 550;
+      $self->assert($expected == $resp_code,
+        test_msg("Expected response code $expected, got $resp_code"));
+
+      $client->quit();
+    };
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($setup->{config_file}, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($setup->{pid_file});
+  $self->assert_child_ok($pid);
+
+  eval {
+    my $count = count_log_lines($setup->{log_file},
+      qr/removed '.*test\.dat' from cache/);
+    $self->assert($count == 1,
+      test_msg("Expected file to be removed from cache once, got $count"));
+  };
+  if ($@) {
+    $ex = $@ unless $ex;
+  }
+
+  test_cleanup($setup->{log_file}, $ex);
+}
+
+sub filecache_rnto_invalidates {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+  my $setup = test_setup($tmpdir, 'filecache');
+
+  my $src_file = File::Spec->rel2abs("$tmpdir/src.dat");
+  my $src_data = write_test_file($src_file, 20000, $setup->{uid},
+    $setup->{gid});
+
+  my $dst_file = File::Spec->rel2abs("$tmpdir/dst.dat");
+  write_test_file($dst_file, 20000, $setup->{uid}, $setup->{gid});
+
+  my $table_file = File::Spec->rel2abs("$tmpdir/filecache.tab");
+
+  my $config = {
+    PidFile => $setup->{pid_file},
+    ScoreboardFile => $setup->{scoreboard_file},
+    SystemLog => $setup->{log_file},
+    TraceLog => $setup->{log_file},
+    Trace => 'filecache:20 xfer:9',
+
+    AuthUserFile => $setup->{auth_user_file},
+    AuthGroupFile => $setup->{auth_group_file},
+    AllowOverwrite => 'on',
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_filecache.c' => {
+        FileCacheEngine => 'on',
+        FileCacheTable => $table_file,
+        FileCacheSize => '1 MB',
+        FileCacheMaxFileSize => '32 KB',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($setup->{config_file},
+    $config);
+
+  # Files which changed within the last second are not cached.
+  sleep(2);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port, 0);
+      $client->login($setup->{user}, $setup->{passwd});
+      $client->type('binary');
+
+      retr_file($client, 'dst.dat');
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+
+      $client->rnfr('src.dat');
+      $client->rnto('dst.dat');
+
+      my $buf = retr_file($client, 'dst.dat');
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+
+      $self->assert($buf eq $src_data,
+        test_msg("Expected data of renamed file, got stale data"));
+
+      $client->quit();
+    };
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($setup->{config_file}, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($setup->{pid_file});
+  $self->assert_child_ok($pid);
+
+  eval {
+    my $count = count_log_lines($setup->{log_file},
+      qr/removed '.*dst\.dat' from cache/);
+    $self->assert($count == 1,
+      test_msg("Expected file to be removed from cache once, got $count"));
+  };
+  if ($@) {
+    $ex = $@ unless $ex;
+  }
+
+  test_cleanup($setup->{log_file}, $ex);
+}
+
+sub filecache_rest_bypasses_cache {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+  my $setup = test_setup($tmpdir, 'filecache');
+
+  my $test_file = File::Spec->rel2abs("$tmpdir/test.dat");
+  my $data = write_test_file($test_file, 20000, $setup->{uid}, $setup->{gid});
+
+  my $rest_offset = 1234;
+  my $expected_data = substr($data, $rest_offset);
+
+  my $table_file = File::Spec->rel2abs("$tmpdir/filecache.tab");
+
+  my $config = {
+    PidFile => $setup->{pid_file},
+    ScoreboardFile => $setup->{scoreboard_file},
+    SystemLog => $setup->{log_file},
+    TraceLog => $setup->{log_file},
+    Trace => 'filecache:20 xfer:9',
+
+    AuthUserFile => $setup->{auth_user_file},
+    AuthGroupFile => $setup->{auth_group_file},
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_filecache.c' => {
+        FileCacheEngine => 'on',
+        FileCacheTable => $table_file,
+        FileCacheSize => '1 MB',
+        FileCacheMaxFileSize => '32 KB',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($setup->{config_file},
+    $config);
+
+  # Files which changed within the last second are not cached.
+  sleep(2);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port, 0);
+      $client->login($setup->{user}, $setup->{passwd});
+      $client->type('binary');
+
+      # Cache the file first, so that a resumed download could be (wrongly)
+      # served from the cache.
+      retr_file($client, 'test.dat');
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+
+      $client->rest($rest_offset);
+
+      my $buf = retr_file($client, 'test.dat');
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+
+      my $len = length($buf);
+      my $expected_len = length($expected_data);
+      $self->assert($len == $expected_len,
+        test_msg("Expected len $expected_len, got $len"));
+      $self->assert($buf eq $expected_data,
+        test_msg("Expected data does not match"));
+
+      $client->quit();
+    };
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($setup->{config_file}, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($setup->{pid_file});
+  $self->assert_child_ok($pid);
+
+  eval {
+    my $count = count_log_lines($setup->{log_file},
+      qr/stored '.*test\.dat' \(20000 bytes\) in cache/);
+    $self->assert($count == 1,
+      test_msg("Expected file to be stored once, got $count"));
+
+    $count = count_log_lines($setup->{log_file},
+      qr/cache hit for '.*test\.dat'/);
+    $self->assert($count == 0,
+      test_msg("Expected no cache hits, got $count"));
+  };
+  if ($@) {
+    $ex = $@ unless $ex;
+  }
+
+  test_cleanup($setup->{log_file}, $ex);
+}
+
+sub filecache_rang_bypasses_cache {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+  my $setup = test_setup($tmpdir, 'filecache');
+
+  my $test_file = File::Spec->rel2abs("$tmpdir/test.dat");
+  my $data = write_test_file($test_file, 20000, $setup->{uid}, $setup->{gid});
+
+  my $range_start = 100;
+  my $range_end = 9999;
+  my $expected_data = substr($data, $range_start,
+    $range_end - $range_start + 1);
+
+  my $table_file = File::Spec->rel2abs("$tmpdir/filecache.tab");
+
+  my $config = {
+    PidFile => $setup->{pid_file},
+    ScoreboardFile => $setup->{scoreboard_file},
+    SystemLog => $setup->{log_file},
+    TraceLog => $setup->{log_file},
+    Trace => 'filecache:20 xfer:9',
+
+    AuthUserFile => $setup->{auth_user_file},
+    AuthGroupFile => $setup->{auth_group_file},
+
+    IfModules => {
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_filecache.c' => {
+        FileCacheEngine => 'on',
+        FileCacheTable => $table_file,
+        FileCacheSize => '1 MB',
+        FileCacheMaxFileSize => '32 KB',
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($setup->{config_file},
+    $config);
+
+  # Files which changed within the last second are not cached.
+  sleep(2);
+
+  # Open pipes, for use between the parent and child processes.  Specifically,
+  # the child will indicate when it's done with its test by writing a message
+  # to the parent.
+  my ($rfh, $wfh);
+  unless (pipe($rfh, $wfh)) {
+    die("Can't open pipe: $!");
+  }
+
+  my $ex;
+
+  # Fork child
+  $self->handle_sigchld();
+  defined(my $pid = fork()) or die("Can't fork: $!");
+  if ($pid) {
+    eval {
+      my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port, 0);
+      $client->login($setup->{user}, $setup->{passwd});
+      $client->type('binary');
+
+      # Cache the file first, so that a ranged download could be (wrongly)
+      # served from the cache.
+      retr_file($client, 'test.dat');
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+
+      $client->rang($range_start, $range_end);
+
+      my $buf = retr_file($client, 'test.dat');
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+
+      my $len = length($buf);
+      my $expected_len = length($expected_data);
+      $self->assert($len == $expected_len,
+        test_msg("Expected len $expected_len, got $len"));
+      $self->assert($buf eq $expected_data,
+        test_msg("Expected data does not match"));
+
+      $client->quit();
+    };
+    if ($@) {
+      $ex = $@;
+    }
+
+    $wfh->print("done\n");
+    $wfh->flush();
+
+  } else {
+    eval { server_wait($setup->{config_file}, $rfh) };
+    if ($@) {
+      warn($@);
+      exit 1;
+    }
+
+    exit 0;
+  }
+
+  # Stop server
+  server_stop($setup->{pid_file});
+  $self->assert_child_ok($pid);
+
+  eval {
+    my $count = count_log_lines($setup->{log_file},
+      qr/stored '.*test\.dat' \(20000 bytes\) in cache/);
+    $self->assert($count == 1,
+      test_msg("Expected file to be stored once, got $count"));
+
+    $count = count_log_lines($setup->{log_file},
+      qr/cache hit for '.*test\.dat'/);
+    $self->assert($count == 0,
+      test_msg("Expected no cache hits, got $count"));
+  };
+  if ($@) {
+    $ex = $@ unless $ex;
+  }
+
+  test_cleanup($setup->{log_file}, $ex);
+}
+
+sub filecache_ctrls_info {
+  my $self = shift;
+  my $tmpdir = $self->{tmpdir};
+  my $setup = test_setup($tmpdir, 'filecache');
+
+  my $test_file = File::Spec->rel2abs("$tmpdir/test.dat");
+  write_test_file($test_file, 20000, $setup->{uid}, $setup->{gid});
+
+  # Too large to be cached.
+  my $big_file = File::Spec->rel2abs("$tmpdir/big.dat");
+  write_test_file($big_file, 40000, $setup->{uid}, $setup->{gid});
+
+  my $table_file = File::Spec->rel2abs("$tmpdir/filecache.tab");
+  my $ctrls_sock = File::Spec->rel2abs("$tmpdir/filecache.sock");
+
+  my $config = {
+    PidFile => $setup->{pid_file},
+    ScoreboardFile => $setup->{scoreboard_file},
+    SystemLog => $setup->{log_file},
+    TraceLog => $setup->{log_file},
+    Trace => 'filecache:20 xfer:9',
+
+    AuthUserFile => $setup->{auth_user_file},
+    AuthGroupFile => $setup->{auth_group_file},
+
+    IfModules => {
+      'mod_ctrls.c' => {
+        ControlsEngine => 'on',
+        ControlsLog => $setup->{log_file},
+        ControlsSocket => $ctrls_sock,
+        ControlsACLs => "all allow user *",
+        ControlsSocketACL => "allow user *",
+        ControlsInterval => 1,
+      },
+
+      'mod_delay.c' => {
+        DelayEngine => 'off',
+      },
+
+      'mod_filecache.c' => {
+        FileCacheEngine => 'on',
+        FileCacheTable => $table_file,
+        FileCacheSize => '1 MB',
+        FileCacheMaxFileSize => '32 KB',
+        FileCacheControlsACLs => "all allow user *",
+      },
+    },
+  };
+
+  my ($port, $config_user, $config_group) = config_write($setup->{config_file},
+    $config);
+
+  # Files which changed within the last second are not cached.
+  sleep(2);
+
+  my $ex;
+
+  # Start server
+  server_start($setup->{config_file});
+  sleep(1);
+
+  eval {
+    my $client = ProFTPD::TestSuite::FTP->new('127.0.0.1', $port, 0);
+    $client->login($setup->{user}, $setup->{passwd});
+    $client->type('binary');
+
+    # A miss (storing the file), two hits, and a file too large to cache,
+    # which is neither a hit nor a miss.
+    for (my $i = 0; $i < 3; $i++) {
+      retr_file($client, 'test.dat');
+      $self->assert_transfer_ok($client->response_code(),
+        $client->response_msg());
+    }
+
+    retr_file($client, 'big.dat');
+    $self->assert_transfer_ok($client->response_code(),
+      $client->response_msg());
+
+    $client->quit();
+
+    my $lines = ftpdctl($ctrls_sock, 'filecache info');
+    my $info = join('', @$lines);
+
+    if ($ENV{TEST_VERBOSE}) {
+      print STDERR "# filecache info:\n$info";
+    }
+
+    my $expected_lines = [
+      'Max cached file size: 32768 bytes',
+      'Current cache size: 1 files',
+      'Cache lifetime hits: 2 (66.7%)',
+      'Cache lifetime misses: 1',
+      'Cache lifetime files stored: 1',
+      'Cache lifetime files not admitted: 0',
+      'Cache lifetime files evicted: 0',
+      'Cache lifetime files invalidated: 0',
+      'Cache lifetime errors reading files: 0',
+    ];
+
+    foreach my $expected (@$expected_lines) {
+      $self->assert(index($info, $expected) >= 0,
+        test_msg("Expected '$expected' in filecache info, got:\n$info"));
+    }
+
+    $lines = ftpdctl($ctrls_sock, 'filecache clear');
+    $info = join('', @$lines);
+
+    my $expected = 'file cache cleared';
+    $self->assert(index($info, $expected) >= 0,
+      test_msg("Expected '$expected', got '$info'"));
+
+    $lines = ftpdctl($ctrls_sock, 'filecache info');
+    $info = join('', @$lines);
+
+    # Clearing the cache drops its entries, but not the lifetime counters.
+    $expected_lines = [
+      'Current cache size: 0 files',
+      'Cache lifetime hits: 2 (66.7%)',
+    ];
+
+    foreach my $expected (@$expected_lines) {
+      $self->assert(index($info, $expected) >= 0,
+        test_msg("Expected '$expected' in filecache info, got:\n$info"));
+    }
+  };
+  if ($@) {
+    $ex = $@;
+  }
+
+  server_stop($setup->{pid_file});
+  test_cleanup($setup->{log_file}, $ex);
+}
+
+1;